@@ -0,0 +1,817 @@
+// Tencent is pleased to support the open source community by making RapidJSON available.
+//
+// Copyright (C) 2015 THL A29 Limited, a Tencent company, and Milo Yip. All rights reserved.
+//
+// Licensed under the MIT License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// http://opensource.org/licenses/MIT
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#ifndef RAPIDJSON_BINARYIMAGE_H_
+#define RAPIDJSON_BINARYIMAGE_H_
+
+#include "pointer.h"
+#include "internal/stack.h"
+
+RAPIDJSON_NAMESPACE_BEGIN
+
+namespace internal {
+
+//! Header at the start of a binary image.
+struct BinaryImageHeader {
+    char magic[4];          //!< "RJBI"
+    uint32_t byteOrder;     //!< 0x01020304 written in the byte order of the writer
+    uint32_t version;
+    uint32_t charSize;      //!< sizeof(Ch)
+    uint64_t nodeCount;
+    uint64_t stringOffset;  //!< Byte offset of the strings, after the nodes
+    uint64_t size;          //!< Size of the whole image in bytes
+};
+
+//! A value in a binary image, mirroring the layout of GenericValue with offsets for pointers.
+struct BinaryImageNode {
+    uint64_t payload;       //!< Bits of a number, offset of the characters from the strings, or offset of the children from the image
+    uint32_t count;         //!< String length, number of elements or number of members
+    uint32_t type;          //!< Type, and kind of number in the second byte
+};
+
+enum BinaryImageNumber {
+    kBinaryImageDouble = 1 << 8,
+    kBinaryImageInt64 = 2 << 8,     //!< Integer representable by int64_t
+    kBinaryImageUint64 = 3 << 8     //!< Integer only representable by uint64_t
+};
+
+} // namespace internal
+
+template <typename Encoding>
+class GenericBinaryImageValue;
+
+//! Read-only view of a member of an object in a binary image.
+template <typename Encoding>
+struct GenericBinaryImageMember {
+    GenericBinaryImageMember(const char* base, const internal::BinaryImageNode* node) : name(base, node), value(base, node + 1) {}
+
+    GenericBinaryImageValue<Encoding> name;     //!< name of member (must be a string)
+    GenericBinaryImageValue<Encoding> value;    //!< value of member.
+};
+
+//! Random access iterator over the elements of an array or the members of an object in a binary image.
+/*! Dereferencing gives a view by value, either a GenericBinaryImageValue or a GenericBinaryImageMember.
+    \tparam Encoding Encoding of the strings.
+    \tparam Member Whether it iterates the members of an object.
+*/
+template <typename Encoding, bool Member>
+class GenericBinaryImageIterator {
+public:
+    typedef typename internal::SelectIf<internal::BoolType<Member>, GenericBinaryImageMember<Encoding>, GenericBinaryImageValue<Encoding> >::Type value_type;
+    typedef value_type reference;
+    typedef std::ptrdiff_t difference_type;
+    typedef std::random_access_iterator_tag iterator_category;
+
+    //! Result of operator->(), holding the view.
+    class pointer {
+    public:
+        explicit pointer(const value_type& v) : v_(v) {}
+        const value_type* operator->() const { return &v_; }
+    private:
+        value_type v_;
+    };
+
+    GenericBinaryImageIterator() : base_(), node_() {}
+    GenericBinaryImageIterator(const char* base, const internal::BinaryImageNode* node) : base_(base), node_(node) {}
+
+    reference operator*() const { return value_type(base_, node_); }
+    pointer operator->() const { return pointer(**this); }
+    reference operator[](difference_type n) const { return *(*this + n); }
+
+    GenericBinaryImageIterator& operator++() { node_ += kStep; return *this; }
+    GenericBinaryImageIterator& operator--() { node_ -= kStep; return *this; }
+    GenericBinaryImageIterator operator++(int) { GenericBinaryImageIterator old(*this); node_ += kStep; return old; }
+    GenericBinaryImageIterator operator--(int) { GenericBinaryImageIterator old(*this); node_ -= kStep; return old; }
+
+    GenericBinaryImageIterator operator+(difference_type n) const { return GenericBinaryImageIterator(base_, node_ + n * kStep); }
+    GenericBinaryImageIterator operator-(difference_type n) const { return GenericBinaryImageIterator(base_, node_ - n * kStep); }
+    GenericBinaryImageIterator& operator+=(difference_type n) { node_ += n * kStep; return *this; }
+    GenericBinaryImageIterator& operator-=(difference_type n) { node_ -= n * kStep; return *this; }
+    difference_type operator-(const GenericBinaryImageIterator& that) const { return (node_ - that.node_) / kStep; }
+
+    bool operator==(const GenericBinaryImageIterator& that) const { return node_ == that.node_; }
+    bool operator!=(const GenericBinaryImageIterator& that) const { return node_ != that.node_; }
+    bool operator<=(const GenericBinaryImageIterator& that) const { return node_ <= that.node_; }
+    bool operator>=(const GenericBinaryImageIterator& that) const { return node_ >= that.node_; }
+    bool operator< (const GenericBinaryImageIterator& that) const { return node_ < that.node_; }
+    bool operator> (const GenericBinaryImageIterator& that) const { return node_ > that.node_; }
+
+private:
+    static const difference_type kStep = Member ? 2 : 1;
+
+    const char* base_;
+    const internal::BinaryImageNode* node_;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// GenericBinaryImageValue
+
+//! Read-only view of a value stored in a binary image.
+/*! It is a small handle, valid as long as the image memory, and mirrors the read-only part
+    of the GenericValue interface.
+    \tparam Encoding Encoding of the strings.
+*/
+template <typename Encoding>
+class GenericBinaryImageValue {
+public:
+    typedef typename Encoding::Ch Ch;
+    typedef GenericBinaryImageIterator<Encoding, false> ConstValueIterator;    //!< Iterator over the elements of an array
+    typedef GenericBinaryImageIterator<Encoding, true> ConstMemberIterator;    //!< Iterator over the members of an object
+
+    GenericBinaryImageValue(const char* base, const internal::BinaryImageNode* node) : base_(base), node_(node) {}
+
+    Type GetType() const { return static_cast<Type>(node_->type & 0xFF); }
+    bool IsNull()   const { return GetType() == kNullType; }
+    bool IsFalse()  const { return GetType() == kFalseType; }
+    bool IsTrue()   const { return GetType() == kTrueType; }
+    bool IsBool()   const { return IsFalse() || IsTrue(); }
+    bool IsObject() const { return GetType() == kObjectType; }
+    bool IsArray()  const { return GetType() == kArrayType; }
+    bool IsNumber() const { return GetType() == kNumberType; }
+    bool IsString() const { return GetType() == kStringType; }
+    bool IsDouble() const { return NumberKind() == internal::kBinaryImageDouble; }
+    bool IsInt64()  const { return NumberKind() == internal::kBinaryImageInt64; }
+    bool IsUint64() const { return NumberKind() == internal::kBinaryImageUint64 || (IsInt64() && GetInt64() >= 0); }
+    bool IsInt()    const { return IsInt64() && GetInt64() >= -2147483647 - 1 && GetInt64() <= 2147483647; }
+    bool IsUint()   const { return IsUint64() && GetUint64() <= 0xFFFFFFFFu; }
+
+    bool GetBool() const { RAPIDJSON_ASSERT(IsBool()); return IsTrue(); }
+    int GetInt() const { RAPIDJSON_ASSERT(IsInt()); return static_cast<int>(GetInt64()); }
+    unsigned GetUint() const { RAPIDJSON_ASSERT(IsUint()); return static_cast<unsigned>(GetUint64()); }
+    int64_t GetInt64() const { RAPIDJSON_ASSERT(IsNumber() && !IsDouble()); return static_cast<int64_t>(node_->payload); }
+    uint64_t GetUint64() const { RAPIDJSON_ASSERT(IsNumber() && !IsDouble()); return node_->payload; }
+
+    //! Get the value as double type, converting integers like GenericValue::GetDouble().
+    double GetDouble() const {
+        RAPIDJSON_ASSERT(IsNumber());
+        if (IsDouble()) {
+            double d;
+            std::memcpy(&d, &node_->payload, sizeof(d));
+            return d;
+        }
+        return IsInt64() ? static_cast<double>(GetInt64()) : static_cast<double>(GetUint64());
+    }
+
+    //! Get the characters, null-terminated, in place in the image.
+    const Ch* GetString() const {
+        RAPIDJSON_ASSERT(IsString());
+        return reinterpret_cast<const Ch*>(base_ + Header().stringOffset) + node_->payload;
+    }
+    SizeType GetStringLength() const { RAPIDJSON_ASSERT(IsString()); return node_->count; }
+
+    SizeType Size() const { RAPIDJSON_ASSERT(IsArray()); return node_->count; }
+    bool Empty() const { RAPIDJSON_ASSERT(IsArray()); return node_->count == 0; }
+    GenericBinaryImageValue operator[](SizeType index) const {
+        RAPIDJSON_ASSERT(IsArray());
+        RAPIDJSON_ASSERT(index < node_->count);
+        return GenericBinaryImageValue(base_, Children() + index);
+    }
+    ConstValueIterator Begin() const { RAPIDJSON_ASSERT(IsArray()); return ConstValueIterator(base_, Children()); }
+    ConstValueIterator End() const { RAPIDJSON_ASSERT(IsArray()); return ConstValueIterator(base_, Children() + node_->count); }
+
+    SizeType MemberCount() const { RAPIDJSON_ASSERT(IsObject()); return node_->count; }
+    bool ObjectEmpty() const { RAPIDJSON_ASSERT(IsObject()); return node_->count == 0; }
+    GenericBinaryImageValue GetMemberName(SizeType index) const {
+        RAPIDJSON_ASSERT(IsObject());
+        RAPIDJSON_ASSERT(index < node_->count);
+        return GenericBinaryImageValue(base_, Children() + 2 * index);
+    }
+    GenericBinaryImageValue GetMemberValue(SizeType index) const {
+        RAPIDJSON_ASSERT(IsObject());
+        RAPIDJSON_ASSERT(index < node_->count);
+        return GenericBinaryImageValue(base_, Children() + 2 * index + 1);
+    }
+    ConstMemberIterator MemberBegin() const { RAPIDJSON_ASSERT(IsObject()); return ConstMemberIterator(base_, Children()); }
+    ConstMemberIterator MemberEnd() const { RAPIDJSON_ASSERT(IsObject()); return ConstMemberIterator(base_, Children() + 2 * static_cast<size_t>(node_->count)); }
+
+    //! Find a member by name with a linear search, like GenericValue::FindMember().
+    /*! \return Iterator to the first member with this name, or MemberEnd() if there is none.
+    */
+    ConstMemberIterator FindMember(const Ch* name, SizeType length) const {
+        RAPIDJSON_ASSERT(IsObject());
+        ConstMemberIterator m = MemberBegin();
+        for (const ConstMemberIterator end = MemberEnd(); m != end; ++m) {
+            const GenericBinaryImageValue n = m->name;
+            if (n.GetStringLength() == length && std::memcmp(n.GetString(), name, length * sizeof(Ch)) == 0)
+                break;
+        }
+        return m;
+    }
+    ConstMemberIterator FindMember(const Ch* name) const { return FindMember(name, internal::StrLen(name)); }
+    bool HasMember(const Ch* name) const { return FindMember(name) != MemberEnd(); }
+
+    //! Get the value of a member, which must exist.
+    template <typename T>
+    RAPIDJSON_DISABLEIF_RETURN((internal::NotExpr<internal::IsSame<typename internal::RemoveConst<T>::Type, Ch> >),(GenericBinaryImageValue)) operator[](T* name) const {
+        const ConstMemberIterator m = FindMember(name);
+        RAPIDJSON_ASSERT(m != MemberEnd());
+        return m->value;
+    }
+
+    //! Generate events of this value to a Handler, like GenericValue::Accept().
+    /*! Strings are given with <tt>copy == false</tt> as they point into the image.
+    */
+    template <typename Handler>
+    bool Accept(Handler& handler) const {
+        switch (GetType()) {
+        case kNullType:     return handler.Null();
+        case kFalseType:    return handler.Bool(false);
+        case kTrueType:     return handler.Bool(true);
+
+        case kObjectType:
+            if (RAPIDJSON_UNLIKELY(!handler.StartObject()))
+                return false;
+            for (SizeType i = 0; i < node_->count; i++) {
+                const GenericBinaryImageValue name = GetMemberName(i);
+                if (RAPIDJSON_UNLIKELY(!handler.Key(name.GetString(), name.GetStringLength(), false)))
+                    return false;
+                if (RAPIDJSON_UNLIKELY(!GetMemberValue(i).Accept(handler)))
+                    return false;
+            }
+            return handler.EndObject(node_->count);
+
+        case kArrayType:
+            if (RAPIDJSON_UNLIKELY(!handler.StartArray()))
+                return false;
+            for (SizeType i = 0; i < node_->count; i++)
+                if (RAPIDJSON_UNLIKELY(!(*this)[i].Accept(handler)))
+                    return false;
+            return handler.EndArray(node_->count);
+
+        case kStringType:
+            return handler.String(GetString(), GetStringLength(), false);
+
+        default:
+            RAPIDJSON_ASSERT(GetType() == kNumberType);
+            if (IsDouble())         return handler.Double(GetDouble());
+            else if (IsInt())       return handler.Int(GetInt());
+            else if (IsUint())      return handler.Uint(GetUint());
+            else if (IsInt64())     return handler.Int64(GetInt64());
+            else                    return handler.Uint64(GetUint64());
+        }
+    }
+
+private:
+    unsigned NumberKind() const { return node_->type & 0xFF00; }
+    const internal::BinaryImageHeader& Header() const { return *reinterpret_cast<const internal::BinaryImageHeader*>(base_); }
+    const internal::BinaryImageNode* Children() const { return reinterpret_cast<const internal::BinaryImageNode*>(base_ + node_->payload); }
+
+    const char* base_;
+    const internal::BinaryImageNode* node_;
+};
+
+//! Resolve a JSON pointer in a binary image, like GenericPointer::Get().
+/*! \param root Root of the subtree to search.
+    \param pointer Pointer with the same encoding as the image.
+    \param result Receives the value pointed to, if any.
+    \param unresolvedTokenIndex If the pointer cannot resolve a token, receives its index.
+    \return Whether the value exists.
+*/
+template <typename Encoding, typename T, typename Allocator>
+bool GetValueByPointer(const GenericBinaryImageValue<Encoding>& root, const GenericPointer<T, Allocator>& pointer, GenericBinaryImageValue<Encoding>& result, size_t* unresolvedTokenIndex = 0) {
+    RAPIDJSON_STATIC_ASSERT((internal::IsSame<typename T::EncodingType, Encoding>::Value));
+    RAPIDJSON_ASSERT(pointer.IsValid());
+    GenericBinaryImageValue<Encoding> v = root;
+    const typename GenericPointer<T, Allocator>::Token* t = pointer.GetTokens();
+    for (size_t i = 0; i < pointer.GetTokenCount(); i++, t++) {
+        if (v.IsObject()) {
+            const typename GenericBinaryImageValue<Encoding>::ConstMemberIterator m = v.FindMember(t->name, t->length);
+            if (m != v.MemberEnd()) {
+                v = m->value;
+                continue;
+            }
+        }
+        else if (v.IsArray() && t->index != kPointerInvalidIndex && t->index < v.Size()) {
+            v = v[t->index];
+            continue;
+        }
+
+        // Error: unresolved token
+        if (unresolvedTokenIndex)
+            *unresolvedTokenIndex = i;
+        return false;
+    }
+    result = v;
+    return true;
+}
+
+//! Resolve a JSON pointer view in a binary image, without allocation.
+template <typename Encoding, typename T>
+bool GetValueByPointer(const GenericBinaryImageValue<Encoding>& root, const GenericPointerView<T>& pointer, GenericBinaryImageValue<Encoding>& result, size_t* unresolvedTokenIndex = 0) {
+    RAPIDJSON_STATIC_ASSERT((internal::IsSame<typename T::EncodingType, Encoding>::Value));
+    return pointer.GetView(root, result, unresolvedTokenIndex);
+}
+
+//! Resolve a JSON pointer given as a string literal in a binary image, without allocation.
+template <typename Encoding, typename CharType, size_t N>
+bool GetValueByPointer(const GenericBinaryImageValue<Encoding>& root, const CharType (&source)[N], GenericBinaryImageValue<Encoding>& result, size_t* unresolvedTokenIndex = 0) {
+    return GetValueByPointer(root, GenericPointerView<GenericValue<Encoding> >(source, N - 1), result, unresolvedTokenIndex);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// GenericBinaryImage
+
+//! Relocatable binary image of a DOM tree, loadable without parsing.
+/*! An image starts with a header, followed by one 16-byte node per value and then by the
+    characters of all strings, each null-terminated. Like GenericValue, a node holds the
+    type, a count and either a number or the position of its data, but positions are offsets
+    so that the image can be stored, read back with a single read or mapped into memory, and
+    used wherever it lands:
+
+    - GetRoot() gives a read-only view working in place, with no allocation.
+    - Load() rebuilds a GenericDocument in O(n), with one allocation per container.
+
+    Nodes are laid out depth-first, the elements of an array (or the names and values of the
+    members of an object) being consecutive. Numbers and offsets are stored in the byte order
+    of the writer, which is checked at loading.
+
+    \code
+    MemoryBuffer image;
+    BinaryImage::Write(image, d);
+    // ... store the image, read or map it back into memory p of n bytes ...
+    BinaryImage view(p, n);
+    if (view.Validate())
+        view.Load(d2);
+    \endcode
+
+    \tparam Encoding Encoding of the strings.
+    \note The memory of an image must be aligned on 8 bytes.
+*/
+template <typename Encoding = UTF8<> >
+class GenericBinaryImage {
+public:
+    typedef typename Encoding::Ch Ch;
+    typedef GenericBinaryImageValue<Encoding> ValueType;
+
+    static const uint32_t kVersion = 1;
+    static const unsigned kDefaultMaxDepth = 1024;  //!< Default maximum nesting of containers accepted by Validate()
+
+    //! Constructor
+    /*! \param data Memory of the image, aligned on 8 bytes, which must outlive the image and its values.
+        \param size Size of the memory in bytes.
+    */
+    GenericBinaryImage(const void* data, size_t size) : data_(static_cast<const char*>(data)), size_(size) {
+        RAPIDJSON_ASSERT(data_ != 0);
+        RAPIDJSON_ASSERT(reinterpret_cast<uintptr_t>(data_) % 8 == 0);
+    }
+
+    //! Check that the memory holds a complete image written on a compatible platform.
+    /*! Every node and string is checked, so that an image from an untrusted source can
+        then be used safely. Its cost is linear in the size of the image.
+
+        Reading an image recurses into its containers, as GenericValue::Accept() does, so
+        images whose arrays and objects are nested deeper than \c maxDepth are rejected.
+        \param maxDepth Maximum number of nested containers, the root counting as one.
+    */
+    bool Validate(unsigned maxDepth = kDefaultMaxDepth) const {
+        if (size_ < sizeof(internal::BinaryImageHeader) + sizeof(internal::BinaryImageNode))
+            return false;
+        const internal::BinaryImageHeader& h = Header();
+        if (std::memcmp(h.magic, "RJBI", 4) != 0 || h.byteOrder != 0x01020304u || h.version != kVersion || h.charSize != sizeof(Ch))
+            return false;
+        if (h.size != size_ || h.nodeCount == 0 || h.nodeCount > (size_ - sizeof(internal::BinaryImageHeader)) / sizeof(internal::BinaryImageNode) ||
+            h.stringOffset != sizeof(internal::BinaryImageHeader) + h.nodeCount * sizeof(internal::BinaryImageNode) || (size_ - h.stringOffset) % sizeof(Ch) != 0)
+            return false;
+        uint64_t next = 1;
+        return ValidateNode(0, next, false, maxDepth) && next == h.nodeCount;
+    }
+
+    //! Get the root value in place.
+    /*! \pre The image is valid, see Validate().
+    */
+    ValueType GetRoot() const {
+        return ValueType(data_, reinterpret_cast<const internal::BinaryImageNode*>(data_ + sizeof(internal::BinaryImageHeader)));
+    }
+
+    //! Rebuild a document from the image.
+    /*! \param document Document replaced by the root value.
+        \param copyStrings Whether to copy the strings into the allocator of the document.
+            Otherwise they reference the image, which must then outlive the document.
+        \return The document.
+        \pre The image is valid, see Validate().
+    */
+    template <typename DocumentType>
+    DocumentType& Load(DocumentType& document, bool copyStrings = true) const {
+        Generator g(GetRoot(), copyStrings);
+        return document.Populate(g);
+    }
+
+    //! Write the image of a value to an output byte stream.
+    /*! \param os Output stream, its character type must be one byte long.
+        \param value Value to write, typically a Document.
+        \return Size of the image in bytes.
+    */
+    template <typename OutputStream, typename SourceValueType>
+    static size_t Write(OutputStream& os, const SourceValueType& value) {
+        RAPIDJSON_STATIC_ASSERT(sizeof(typename OutputStream::Ch) == 1);
+        RAPIDJSON_STATIC_ASSERT((internal::IsSame<typename SourceValueType::EncodingType, Encoding>::Value));
+        internal::Stack<CrtAllocator> nodes(0, 256 * sizeof(internal::BinaryImageNode));
+        internal::Stack<CrtAllocator> strings(0, 256 * sizeof(Ch));
+        nodes.template Push<internal::BinaryImageNode>();
+        Fill(nodes, strings, 0, value);
+        return Output(os, nodes, strings);
+    }
+
+private:
+    template <typename, typename, typename> friend class BinaryImageWriter;
+    typedef internal::BinaryImageNode Node;
+
+    struct Generator {
+        Generator(const ValueType& root, bool copy) : root_(root), copy_(copy) {}
+
+        template <typename Handler>
+        bool operator()(Handler& handler) {
+            if (!copy_)
+                return root_.Accept(handler);
+            CopyHandler<Handler> h(handler);
+            return root_.Accept(h);
+        }
+
+        ValueType root_;
+        bool copy_;
+    };
+
+    // Forwards events, asking for the strings to be copied.
+    template <typename Handler>
+    struct CopyHandler {
+        explicit CopyHandler(Handler& handler) : handler_(handler) {}
+
+        bool Null() { return handler_.Null(); }
+        bool Bool(bool b) { return handler_.Bool(b); }
+        bool Int(int i) { return handler_.Int(i); }
+        bool Uint(unsigned u) { return handler_.Uint(u); }
+        bool Int64(int64_t i) { return handler_.Int64(i); }
+        bool Uint64(uint64_t u) { return handler_.Uint64(u); }
+        bool Double(double d) { return handler_.Double(d); }
+        bool String(const Ch* str, SizeType length, bool) { return handler_.String(str, length, true); }
+        bool StartObject() { return handler_.StartObject(); }
+        bool Key(const Ch* str, SizeType length, bool) { return handler_.Key(str, length, true); }
+        bool EndObject(SizeType memberCount) { return handler_.EndObject(memberCount); }
+        bool StartArray() { return handler_.StartArray(); }
+        bool EndArray(SizeType elementCount) { return handler_.EndArray(elementCount); }
+
+        Handler& handler_;
+
+    private:
+        CopyHandler& operator=(const CopyHandler&);
+    };
+
+    const internal::BinaryImageHeader& Header() const { return *reinterpret_cast<const internal::BinaryImageHeader*>(data_); }
+    const Node& NodeAt(uint64_t index) const { return reinterpret_cast<const Node*>(data_ + sizeof(internal::BinaryImageHeader))[index]; }
+
+    // Checks a node and its subtree, which must be laid out as Write() does and hold at most depth levels.
+    bool ValidateNode(uint64_t index, uint64_t& next, bool name, unsigned depth) const {
+        const Node& n = NodeAt(index);
+        const internal::BinaryImageHeader& h = Header();
+        const unsigned type = n.type & 0xFF;
+        const unsigned kind = n.type & ~0xFFu;
+        if (type > kNumberType || (name && type != kStringType) || (kind != 0 && (type != kNumberType || kind > internal::kBinaryImageUint64)) || (type == kNumberType && kind == 0))
+            return false;
+
+        if (type == kStringType) {
+            const uint64_t length = (size_ - h.stringOffset) / sizeof(Ch);
+            if (n.payload >= length || n.count > length - n.payload - 1)
+                return false;
+            return reinterpret_cast<const Ch*>(data_ + h.stringOffset)[n.payload + n.count] == '\0';
+        }
+
+        if (type == kArrayType || type == kObjectType) {
+            const uint64_t count = type == kObjectType ? 2 * static_cast<uint64_t>(n.count) : n.count;
+            if (depth == 0 || n.payload != sizeof(internal::BinaryImageHeader) + next * sizeof(Node) || count > h.nodeCount - next)
+                return false;
+            const uint64_t first = next;
+            next += count;
+            for (uint64_t i = 0; i < count; i++)
+                if (!ValidateNode(first + i, next, type == kObjectType && i % 2 == 0, depth - 1))
+                    return false;
+        }
+        return true;
+    }
+
+    template <typename SourceValueType>
+    static void Fill(internal::Stack<CrtAllocator>& nodes, internal::Stack<CrtAllocator>& strings, size_t index, const SourceValueType& v) {
+        Node n = { 0, 0, static_cast<uint32_t>(v.GetType()) };
+        switch (v.GetType()) {
+        case kStringType:
+            n.payload = strings.GetSize() / sizeof(Ch);
+            n.count = v.GetStringLength();
+            std::memcpy(strings.template Push<Ch>(n.count + 1), v.GetString(), (n.count + 1) * sizeof(Ch));
+            break;
+
+        case kArrayType:
+        case kObjectType: {
+            const size_t first = nodes.GetSize() / sizeof(Node);
+            n.payload = sizeof(internal::BinaryImageHeader) + first * sizeof(Node);
+            n.count = v.IsArray() ? v.Size() : v.MemberCount();
+            nodes.template Push<Node>(v.IsArray() ? n.count : 2 * n.count);
+            if (v.IsArray()) {
+                for (SizeType i = 0; i < n.count; i++)
+                    Fill(nodes, strings, first + i, v[i]);
+            }
+            else {
+                size_t i = first;
+                for (typename SourceValueType::ConstMemberIterator m = v.MemberBegin(); m != v.MemberEnd(); ++m, i += 2) {
+                    Fill(nodes, strings, i, m->name);
+                    Fill(nodes, strings, i + 1, m->value);
+                }
+            }
+            break;
+        }
+
+        case kNumberType:
+            if (v.IsDouble()) {
+                const double d = v.GetDouble();
+                std::memcpy(&n.payload, &d, sizeof(d));
+                n.type |= internal::kBinaryImageDouble;
+            }
+            else if (v.IsInt64()) {
+                n.payload = static_cast<uint64_t>(v.GetInt64());
+                n.type |= internal::kBinaryImageInt64;
+            }
+            else {
+                n.payload = v.GetUint64();
+                n.type |= internal::kBinaryImageUint64;
+            }
+            break;
+
+        default:
+            break;
+        }
+        nodes.template Bottom<Node>()[index] = n;
+    }
+
+    // Writes the header, the nodes laid out depth-first and the strings.
+    template <typename OutputStream, typename StackAllocator>
+    static size_t Output(OutputStream& os, internal::Stack<StackAllocator>& nodes, internal::Stack<StackAllocator>& strings) {
+        // Pad the strings so that the next image in a stream stays aligned
+        while (strings.GetSize() % 8 != 0)
+            *strings.template Push<char>() = '\0';
+
+        internal::BinaryImageHeader h;
+        std::memcpy(h.magic, "RJBI", 4);
+        h.byteOrder = 0x01020304u;
+        h.version = kVersion;
+        h.charSize = sizeof(Ch);
+        h.nodeCount = nodes.GetSize() / sizeof(Node);
+        h.stringOffset = sizeof(h) + nodes.GetSize();
+        h.size = h.stringOffset + strings.GetSize();
+
+        PutReserve(os, static_cast<size_t>(h.size));
+        PutBytes(os, &h, sizeof(h));
+        PutBytes(os, nodes.template Bottom<char>(), nodes.GetSize());
+        PutBytes(os, strings.template Bottom<char>(), strings.GetSize());
+        return static_cast<size_t>(h.size);
+    }
+
+    template <typename OutputStream>
+    static void PutBytes(OutputStream& os, const void* data, size_t size) {
+        const char* p = static_cast<const char*>(data);
+        for (size_t i = 0; i < size; i++)
+            PutUnsafe(os, static_cast<typename OutputStream::Ch>(p[i]));
+    }
+
+    const char* data_;
+    size_t size_;
+};
+
+//! GenericBinaryImage with UTF8 encoding
+typedef GenericBinaryImage<UTF8<> > BinaryImage;
+
+///////////////////////////////////////////////////////////////////////////////
+// BinaryImageWriter
+
+//! Handler writing the binary image of the value it receives.
+/*! It builds the same image as GenericBinaryImage::Write() from SAX events, so that JSON
+    text, or any other source of events, can be turned into an image without a DOM:
+    \code
+    BinaryImageWriter<FileWriteStream> writer(os);
+    reader.Parse(is, writer);
+    \endcode
+
+    The nodes of a container can only be placed once it ends, so the values are first
+    collected bottom-up, as GenericDocument does. When the root value ends, the nodes are
+    laid out depth-first and the image is written to the stream.
+
+    \tparam OutputStream Type of output byte stream.
+    \tparam SourceEncoding Encoding of the strings of the events, and of the image.
+    \tparam StackAllocator Type of allocator for allocating memory of the stacks.
+    \note RawNumber() stores the number as a string, like GenericDocument.
+*/
+template<typename OutputStream, typename SourceEncoding = UTF8<>, typename StackAllocator = CrtAllocator>
+class BinaryImageWriter {
+public:
+    typedef typename SourceEncoding::Ch Ch;
+
+    static const size_t kDefaultLevelDepth = 32;
+
+    //! Constructor
+    /*! \param os Output stream, its character type must be one byte long.
+        \param stackAllocator User supplied allocator. If it is null, it will create a private one.
+        \param levelDepth Initial capacity of stack.
+    */
+    explicit BinaryImageWriter(OutputStream& os, StackAllocator* stackAllocator = 0, size_t levelDepth = kDefaultLevelDepth) :
+        os_(&os), level_stack_(stackAllocator, levelDepth * sizeof(Level)), values_(stackAllocator, levelDepth * sizeof(Node)),
+        tree_(stackAllocator, 256 * sizeof(Node)), nodes_(stackAllocator, 0), strings_(stackAllocator, 256 * sizeof(Ch)), hasRoot_(false) {
+        RAPIDJSON_STATIC_ASSERT(sizeof(typename OutputStream::Ch) == 1);
+    }
+
+    //! Reset the writer with a new stream.
+    void Reset(OutputStream& os) {
+        os_ = &os;
+        Clear();
+        hasRoot_ = false;
+    }
+
+    //! Checks whether an image was written.
+    bool IsComplete() const { return hasRoot_ && level_stack_.Empty(); }
+
+    /*!@name Implementation of Handler
+        \see Handler
+    */
+    //@{
+
+    bool Null()                 { Prefix(kNullType); return AddValue(kNullType, 0); }
+    bool Bool(bool b)           { Prefix(b ? kTrueType : kFalseType); return AddValue(b ? kTrueType : kFalseType, 0); }
+    bool Int(int i)             { return Int64(i); }
+    bool Uint(unsigned u)       { return Uint64(u); }
+
+    bool Int64(int64_t i64) {
+        Prefix(kNumberType);
+        return AddValue(kNumberType | internal::kBinaryImageInt64, static_cast<uint64_t>(i64));
+    }
+
+    bool Uint64(uint64_t u64) {
+        Prefix(kNumberType);
+        return AddValue(kNumberType | (u64 <= static_cast<uint64_t>((std::numeric_limits<int64_t>::max)()) ? internal::kBinaryImageInt64 : internal::kBinaryImageUint64), u64);
+    }
+
+    bool Double(double d) {
+        Prefix(kNumberType);
+        uint64_t bits;
+        std::memcpy(&bits, &d, sizeof(bits));
+        return AddValue(kNumberType | internal::kBinaryImageDouble, bits);
+    }
+
+    bool RawNumber(const Ch* str, SizeType length, bool copy = false) { return String(str, length, copy); }
+
+    bool String(const Ch* str, SizeType length, bool copy = false) {
+        RAPIDJSON_ASSERT(str != 0);
+        (void)copy;
+        Prefix(kStringType);
+        const uint64_t offset = strings_.GetSize() / sizeof(Ch);
+        Ch* p = strings_.template Push<Ch>(length + 1);
+        std::memcpy(p, str, length * sizeof(Ch));
+        p[length] = '\0';
+        return AddValue(kStringType, offset, length);
+    }
+
+    bool StartObject() {
+        Prefix(kObjectType);
+        StartContainer(true);
+        return true;
+    }
+
+    bool Key(const Ch* str, SizeType length, bool copy = false) {
+        RAPIDJSON_ASSERT(!level_stack_.Empty());                                    // not in an object
+        RAPIDJSON_ASSERT(level_stack_.template Top<Level>()->map);                  // not in an object
+        RAPIDJSON_ASSERT(level_stack_.template Top<Level>()->valueCount % 2 == 0);  // Key() must not follow Key()
+        return String(str, length, copy);
+    }
+
+    bool EndObject(SizeType memberCount = 0) {
+        (void)memberCount;
+        RAPIDJSON_ASSERT(level_stack_.GetSize() >= sizeof(Level));                  // not inside an Object
+        RAPIDJSON_ASSERT(level_stack_.template Top<Level>()->map);                  // currently inside an Array, not Object
+        RAPIDJSON_ASSERT(level_stack_.template Top<Level>()->valueCount % 2 == 0);  // Object has a Key without a Value
+        return EndContainer();
+    }
+
+    bool StartArray() {
+        Prefix(kArrayType);
+        StartContainer(false);
+        return true;
+    }
+
+    bool EndArray(SizeType elementCount = 0) {
+        (void)elementCount;
+        RAPIDJSON_ASSERT(level_stack_.GetSize() >= sizeof(Level));
+        RAPIDJSON_ASSERT(!level_stack_.template Top<Level>()->map);
+        return EndContainer();
+    }
+    //@}
+
+    /*! @name Convenience extensions */
+    //@{
+
+    //! Simpler but slower overload.
+    bool String(const Ch* const& str) { return String(str, internal::StrLen(str)); }
+    bool Key(const Ch* const& str) { return Key(str, internal::StrLen(str)); }
+
+    //@}
+
+private:
+    // Prohibit copy constructor & assignment operator.
+    BinaryImageWriter(const BinaryImageWriter&);
+    BinaryImageWriter& operator=(const BinaryImageWriter&);
+
+    typedef internal::BinaryImageNode Node;
+
+    //! Information for each nested level
+    struct Level {
+        size_t valueCount;  //!< number of values in this level, names and values counting separately in maps
+        bool map;
+    };
+
+    void Clear() {
+        level_stack_.Clear();
+        values_.Clear();
+        tree_.Clear();
+        nodes_.Clear();
+        strings_.Clear();
+    }
+
+    void Prefix(Type type) {
+        (void)type;
+        if (RAPIDJSON_LIKELY(!level_stack_.Empty())) {
+            Level* level = level_stack_.template Top<Level>();
+            if (level->map && level->valueCount % 2 == 0)
+                RAPIDJSON_ASSERT(type == kStringType);  // if it's in object, then even number should be a name
+            level->valueCount++;
+        }
+        else {
+            RAPIDJSON_ASSERT(!hasRoot_);    // Should only has one and only one root.
+            hasRoot_ = true;
+        }
+    }
+
+    void StartContainer(bool map) {
+        Level* level = level_stack_.template Push<Level>();
+        level->valueCount = 0;
+        level->map = map;
+    }
+
+    // Moves the values of the container to the tree, where its node references them.
+    bool EndContainer() {
+        const Level level = *level_stack_.template Pop<Level>(1);
+        const uint64_t first = tree_.GetSize() / sizeof(Node);
+        if (level.valueCount > 0)
+            std::memcpy(tree_.template Push<Node>(level.valueCount), values_.template Pop<Node>(level.valueCount), level.valueCount * sizeof(Node));
+        return AddValue(level.map ? kObjectType : kArrayType, first, static_cast<SizeType>(level.map ? level.valueCount / 2 : level.valueCount));
+    }
+
+    bool AddValue(unsigned type, uint64_t payload, SizeType count = 0) {
+        Node* n = values_.template Push<Node>();
+        n->payload = payload;
+        n->count = count;
+        n->type = type;
+        if (RAPIDJSON_LIKELY(!level_stack_.Empty()))
+            return true;
+
+        // The root is complete
+        nodes_.template Push<Node>(1 + tree_.GetSize() / sizeof(Node));
+        uint64_t next = 1;
+        Layout(*n, 0, next);
+        GenericBinaryImage<SourceEncoding>::Output(*os_, nodes_, strings_);
+        Clear();
+        os_->Flush();
+        return true;
+    }
+
+    // Places a node of the tree at an index of the image, and its descendants after next, like GenericBinaryImage::Write().
+    void Layout(const Node& node, uint64_t index, uint64_t& next) {
+        Node n = node;
+        const unsigned type = n.type & 0xFF;
+        if (type == kArrayType || type == kObjectType) {
+            const uint64_t count = type == kObjectType ? 2 * static_cast<uint64_t>(n.count) : n.count;
+            const uint64_t first = next;
+            next += count;
+            for (uint64_t i = 0; i < count; i++)
+                Layout(tree_.template Bottom<Node>()[n.payload + i], first + i, next);
+            n.payload = sizeof(internal::BinaryImageHeader) + first * sizeof(Node);
+        }
+        nodes_.template Bottom<Node>()[index] = n;
+    }
+
+    OutputStream* os_;
+    internal::Stack<StackAllocator> level_stack_;
+    internal::Stack<StackAllocator> values_;    //!< Values of the open containers
+    internal::Stack<StackAllocator> tree_;      //!< Values of the ended containers, each one referencing its own by index
+    internal::Stack<StackAllocator> nodes_;     //!< Nodes of the image
+    internal::Stack<StackAllocator> strings_;   //!< Strings of the image
+    bool hasRoot_;
+};
+
+RAPIDJSON_NAMESPACE_END
+
+#endif // RAPIDJSON_BINARYIMAGE_H_
@@ -0,0 +1,602 @@
+// Tencent is pleased to support the open source community by making RapidJSON available.
+//
+// Copyright (C) 2015 THL A29 Limited, a Tencent company, and Milo Yip. All rights reserved.
+//
+// Licensed under the MIT License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// http://opensource.org/licenses/MIT
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#ifndef RAPIDJSON_BINDING_H_
+#define RAPIDJSON_BINDING_H_
+
+#include "rapidjson.h"
+#include "internal/stack.h"
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifdef __GNUC__
+RAPIDJSON_DIAG_PUSH
+RAPIDJSON_DIAG_OFF(effc++)
+#endif
+
+#ifdef _MSC_VER
+RAPIDJSON_DIAG_PUSH
+RAPIDJSON_DIAG_OFF(4512) // assignment operator could not be generated
+#endif
+
+RAPIDJSON_NAMESPACE_BEGIN
+
+//! Description of the members of a struct bound to JSON objects.
+/*! Specializations are written with \ref RAPIDJSON_BINDING_BEGIN, \ref RAPIDJSON_BINDING_FIELD
+    and \ref RAPIDJSON_BINDING_END. They have a static member function template
+    \c Describe(Visitor& v) calling <tt>v(name, &T::field)</tt> for each bound field, \c name
+    being a string literal.
+*/
+template <typename T>
+struct Binding;
+
+//! Begin the binding of the struct \c Type, at global scope.
+#define RAPIDJSON_BINDING_BEGIN(Type) \
+    RAPIDJSON_NAMESPACE_BEGIN \
+    template <> struct Binding<Type> { \
+        typedef Type BoundType; \
+        template <typename Visitor> static void Describe(Visitor& v) { \
+            (void)v;
+
+//! Bind a field of the struct to the member of the same name.
+#define RAPIDJSON_BINDING_FIELD(field) v(#field, &BoundType::field);
+
+//! Bind a field of the struct to the member \c name, a string literal.
+#define RAPIDJSON_BINDING_FIELD_NAMED(field, name) v(name, &BoundType::field);
+
+//! End the binding of a struct.
+#define RAPIDJSON_BINDING_END() \
+        } \
+    }; \
+    RAPIDJSON_NAMESPACE_END
+
+namespace internal {
+
+struct BindingTable;
+
+//! Handling of the SAX events by a bound type, with the value as an untyped pointer.
+struct BindingOps {
+    enum Kind { kScalar, kObject, kArray };
+
+    Kind kind;
+    bool (*null)(void* p);
+    bool (*boolean)(void* p, bool b);
+    bool (*int64)(void* p, int64_t i);
+    bool (*uint64)(void* p, uint64_t u);
+    bool (*number)(void* p, double d);
+    bool (*string)(void* p, const char* str, SizeType length);
+    const BindingTable* (*table)();         //!< Fields of an object.
+    void* (*append)(void* p);               //!< Add a default element to an array and return it.
+    void (*clear)(void* p);                 //!< Remove the elements of an array.
+    const BindingOps& (*element)();         //!< Operations of the elements of an array.
+};
+
+//! Bound field of a struct, at a fixed offset from the start of the struct.
+struct BindingField {
+    const char* name;
+    SizeType length;
+    size_t offset;
+    const BindingOps* ops;
+};
+
+//! Fields of a struct, looked up with a perfect hash of their names.
+/*! The seed and the size of the hash table are searched once, when the table is built, so
+    that every name has its own slot. A lookup hashes the key and compares it with the one
+    name of its slot.
+*/
+struct BindingTable {
+    static const SizeType kNoField = ~SizeType(0);
+
+    BindingTable() : fields(), slots(), seed(), mask() {}
+
+    void Add(const char* name, SizeType length, size_t offset, const BindingOps& ops) {
+        RAPIDJSON_ASSERT(FindLinear(name, length) == 0); // Names must be unique
+        BindingField f = { name, length, offset, &ops };
+        fields.push_back(f);
+    }
+
+    void Finalize() {
+        SizeType size = 1;
+        while (size < fields.size())
+            size <<= 1;
+        for (;; size <<= 1) {
+            RAPIDJSON_ASSERT(size <= (1u << 20));
+            for (unsigned s = 0; s < 64; s++)
+                if (TrySeed(s, size))
+                    return;
+        }
+    }
+
+    const BindingField* Find(const char* str, SizeType length) const {
+        if (fields.empty())
+            return 0;
+        SizeType i = slots[Hash(seed, str, length) & mask];
+        if (i == kNoField)
+            return 0;
+        const BindingField& f = fields[i];
+        return f.length == length && std::memcmp(f.name, str, length) == 0 ? &f : 0;
+    }
+
+    static unsigned Hash(unsigned s, const char* str, SizeType length) {
+        unsigned h = 2166136261u ^ s;   // FNV-1a
+        for (SizeType i = 0; i < length; i++) {
+            h ^= static_cast<unsigned char>(str[i]);
+            h *= 16777619u;
+        }
+        h ^= h >> 16;                   // Mixes the high bits into the ones of the slot
+        h *= 0x85ebca6bu;
+        h ^= h >> 13;
+        return h;
+    }
+
+    std::vector<BindingField> fields;
+    std::vector<SizeType> slots;
+    unsigned seed;
+    SizeType mask;
+
+private:
+    const BindingField* FindLinear(const char* str, SizeType length) const {
+        for (size_t i = 0; i < fields.size(); i++)
+            if (fields[i].length == length && std::memcmp(fields[i].name, str, length) == 0)
+                return &fields[i];
+        return 0;
+    }
+
+    bool TrySeed(unsigned s, SizeType size) {
+        slots.assign(size, static_cast<SizeType>(kNoField));  // By value, as kNoField has no definition
+        for (size_t i = 0; i < fields.size(); i++) {
+            SizeType& slot = slots[Hash(s, fields[i].name, fields[i].length) & (size - 1)];
+            if (slot != kNoField)
+                return false;
+            slot = static_cast<SizeType>(i);
+        }
+        seed = s;
+        mask = size - 1;
+        return true;
+    }
+};
+
+//! Operations of a bound type rejecting every event, to be overridden by the derived types.
+template <typename Derived, BindingOps::Kind kind>
+struct BindingBase {
+    static bool Null(void*) { return false; }
+    static bool Bool(void*, bool) { return false; }
+    static bool Int64(void*, int64_t) { return false; }
+    static bool Uint64(void*, uint64_t) { return false; }
+    static bool Double(void*, double) { return false; }
+    static bool String(void*, const char*, SizeType) { return false; }
+    static const BindingTable* GetTable() { return 0; }
+    static void* Append(void*) { return 0; }
+    static void Clear(void*) {}
+    static const BindingOps& GetElementOps() { return GetOps(); }
+
+    static const BindingOps& GetOps() {
+        static const BindingOps ops = {
+            kind, &Derived::Null, &Derived::Bool, &Derived::Int64, &Derived::Uint64, &Derived::Double,
+            &Derived::String, &Derived::GetTable, &Derived::Append, &Derived::Clear, &Derived::GetElementOps
+        };
+        return ops;
+    }
+};
+
+template <typename T>
+struct BindingValue;
+
+//! Visitor adding the fields described by a Binding to a BindingTable.
+template <typename T>
+class BindingTableBuilder {
+public:
+    BindingTableBuilder(const T& sample, BindingTable& table) : sample_(sample), table_(table) {}
+
+    template <size_t N, typename C, typename F>
+    void operator()(const char (&name)[N], F C::*member) {
+        const char* base = reinterpret_cast<const char*>(&sample_);
+        size_t offset = static_cast<size_t>(reinterpret_cast<const char*>(&(sample_.*member)) - base);
+        table_.Add(name, static_cast<SizeType>(N - 1), offset, BindingValue<F>::GetOps());
+    }
+
+private:
+    const T& sample_;
+    BindingTable& table_;
+};
+
+//! Visitor sending the fields described by a Binding to a handler.
+template <typename T, typename Handler>
+class BindingAcceptor {
+public:
+    BindingAcceptor(const T& value, Handler& handler) : value_(value), handler_(handler), count_(), ok_(true) {}
+
+    template <size_t N, typename C, typename F>
+    void operator()(const char (&name)[N], F C::*member) {
+        ok_ = ok_ && handler_.Key(name, static_cast<SizeType>(N - 1), false) &&
+            BindingValue<F>::Accept(value_.*member, handler_);
+        count_++;
+    }
+
+    SizeType GetCount() const { return count_; }
+    bool IsOk() const { return ok_; }
+
+private:
+    const T& value_;
+    Handler& handler_;
+    SizeType count_;
+    bool ok_;
+};
+
+//! Structs, bound to objects by a specialization of Binding.
+template <typename T>
+struct BindingValue : BindingBase<BindingValue<T>, BindingOps::kObject> {
+    //! Fields of the struct, built on the first call.
+    /*! The initialization of a local static is not thread-safe before C++11, so concurrent
+        first calls must be avoided with BindingHandler::Initialize().
+    */
+    static const BindingTable* GetTable() {
+        static const BindingTable table = MakeTable();
+        return &table;
+    }
+
+    template <typename Handler>
+    static bool Accept(const T& value, Handler& handler) {
+        if (!handler.StartObject())
+            return false;
+        BindingAcceptor<T, Handler> acceptor(value, handler);
+        Binding<T>::Describe(acceptor);
+        return acceptor.IsOk() && handler.EndObject(acceptor.GetCount());
+    }
+
+private:
+    static BindingTable MakeTable() {
+        // The offsets of the fields are measured on an instance, as member pointers may not be
+        // converted to offsets.
+        T sample;
+        BindingTable table;
+        BindingTableBuilder<T> builder(sample, table);
+        Binding<T>::Describe(builder);
+        table.Finalize();
+        return table;
+    }
+};
+
+template <>
+struct BindingValue<bool> : BindingBase<BindingValue<bool>, BindingOps::kScalar> {
+    static bool Bool(void* p, bool b) { *static_cast<bool*>(p) = b; return true; }
+
+    template <typename Handler>
+    static bool Accept(bool b, Handler& handler) { return handler.Bool(b); }
+};
+
+template <>
+struct BindingValue<int> : BindingBase<BindingValue<int>, BindingOps::kScalar> {
+    static bool Int64(void* p, int64_t i) {
+        if (i < -2147483647 - 1 || i > 2147483647)
+            return false;
+        *static_cast<int*>(p) = static_cast<int>(i);
+        return true;
+    }
+    static bool Uint64(void* p, uint64_t u) {
+        if (u > 2147483647u)
+            return false;
+        *static_cast<int*>(p) = static_cast<int>(u);
+        return true;
+    }
+
+    template <typename Handler>
+    static bool Accept(int i, Handler& handler) { return handler.Int(i); }
+};
+
+template <>
+struct BindingValue<unsigned> : BindingBase<BindingValue<unsigned>, BindingOps::kScalar> {
+    static bool Int64(void* p, int64_t i) {
+        if (i < 0 || i > 4294967295)
+            return false;
+        *static_cast<unsigned*>(p) = static_cast<unsigned>(i);
+        return true;
+    }
+    static bool Uint64(void* p, uint64_t u) {
+        if (u > 4294967295u)
+            return false;
+        *static_cast<unsigned*>(p) = static_cast<unsigned>(u);
+        return true;
+    }
+
+    template <typename Handler>
+    static bool Accept(unsigned u, Handler& handler) { return handler.Uint(u); }
+};
+
+template <>
+struct BindingValue<int64_t> : BindingBase<BindingValue<int64_t>, BindingOps::kScalar> {
+    static bool Int64(void* p, int64_t i) { *static_cast<int64_t*>(p) = i; return true; }
+    static bool Uint64(void* p, uint64_t u) {
+        if (u > static_cast<uint64_t>(RAPIDJSON_UINT64_C2(0x7FFFFFFF, 0xFFFFFFFF)))
+            return false;
+        *static_cast<int64_t*>(p) = static_cast<int64_t>(u);
+        return true;
+    }
+
+    template <typename Handler>
+    static bool Accept(int64_t i, Handler& handler) { return handler.Int64(i); }
+};
+
+template <>
+struct BindingValue<uint64_t> : BindingBase<BindingValue<uint64_t>, BindingOps::kScalar> {
+    static bool Int64(void* p, int64_t i) {
+        if (i < 0)
+            return false;
+        *static_cast<uint64_t*>(p) = static_cast<uint64_t>(i);
+        return true;
+    }
+    static bool Uint64(void* p, uint64_t u) { *static_cast<uint64_t*>(p) = u; return true; }
+
+    template <typename Handler>
+    static bool Accept(uint64_t u, Handler& handler) { return handler.Uint64(u); }
+};
+
+//! Floating-point types, taking any number.
+template <typename T>
+struct BindingFloat : BindingBase<BindingValue<T>, BindingOps::kScalar> {
+    static bool Int64(void* p, int64_t i) { *static_cast<T*>(p) = static_cast<T>(i); return true; }
+    static bool Uint64(void* p, uint64_t u) { *static_cast<T*>(p) = static_cast<T>(u); return true; }
+    static bool Double(void* p, double d) { *static_cast<T*>(p) = static_cast<T>(d); return true; }
+
+    template <typename Handler>
+    static bool Accept(T d, Handler& handler) { return handler.Double(static_cast<double>(d)); }
+};
+
+template <>
+struct BindingValue<double> : BindingFloat<double> {};
+
+template <>
+struct BindingValue<float> : BindingFloat<float> {};
+
+template <>
+struct BindingValue<std::string> : BindingBase<BindingValue<std::string>, BindingOps::kScalar> {
+    static bool String(void* p, const char* str, SizeType length) {
+        static_cast<std::string*>(p)->assign(str, length);
+        return true;
+    }
+
+    template <typename Handler>
+    static bool Accept(const std::string& s, Handler& handler) {
+        return handler.String(s.data(), static_cast<SizeType>(s.size()), false);
+    }
+};
+
+template <typename T>
+struct BindingValue<std::vector<T> > : BindingBase<BindingValue<std::vector<T> >, BindingOps::kArray> {
+    static void* Append(void* p) {
+        std::vector<T>& v = *static_cast<std::vector<T>*>(p);
+        v.push_back(T());
+        return &v.back();
+    }
+    static void Clear(void* p) { static_cast<std::vector<T>*>(p)->clear(); }
+    static const BindingOps& GetElementOps() { return BindingValue<T>::GetOps(); }
+
+    template <typename Handler>
+    static bool Accept(const std::vector<T>& v, Handler& handler) {
+        if (!handler.StartArray())
+            return false;
+        for (size_t i = 0; i < v.size(); i++)
+            if (!BindingValue<T>::Accept(v[i], handler))
+                return false;
+        return handler.EndArray(static_cast<SizeType>(v.size()));
+    }
+};
+
+//! Build the tables of the structs reachable from a bound type, each one once.
+inline void InitializeBindingTables(const BindingOps& ops, std::vector<const BindingTable*>& done) {
+    if (ops.kind == BindingOps::kArray)
+        InitializeBindingTables(ops.element(), done);
+    else if (ops.kind == BindingOps::kObject) {
+        const BindingTable* table = ops.table();
+        for (size_t i = 0; i < done.size(); i++)
+            if (done[i] == table)
+                return;
+        done.push_back(table);
+        for (size_t i = 0; i < table->fields.size(); i++)
+            InitializeBindingTables(*table->fields[i].ops, done);
+    }
+}
+
+} // namespace internal
+
+///////////////////////////////////////////////////////////////////////////////
+// BindingHandler
+
+//! Handler parsing a JSON text straight into a C++ value, without building a DOM.
+/*! The bound type \c T may be a struct described by a Binding, \c bool, \c int, \c unsigned,
+    \c int64_t, \c uint64_t, \c double, \c float, \c std::string, or a \c std::vector of any
+    of them except \c bool. Structs are bound to objects and vectors to arrays.
+
+    \code
+    struct Point { int x, y; std::string label; };
+    struct Shape { std::vector<Point> points; double width; };
+
+    RAPIDJSON_BINDING_BEGIN(Point)
+        RAPIDJSON_BINDING_FIELD(x)
+        RAPIDJSON_BINDING_FIELD(y)
+        RAPIDJSON_BINDING_FIELD_NAMED(label, "name")
+    RAPIDJSON_BINDING_END()
+
+    RAPIDJSON_BINDING_BEGIN(Shape)
+        RAPIDJSON_BINDING_FIELD(points)
+        RAPIDJSON_BINDING_FIELD(width)
+    RAPIDJSON_BINDING_END()
+
+    Shape shape;
+    BindingHandler<Shape> handler(shape);
+    Reader reader;
+    StringStream ss(json);
+    if (reader.Parse(ss, handler)) {
+        StringBuffer sb;
+        Writer<StringBuffer> writer(sb);
+        BindingAccept(shape, writer);
+    }
+    \endcode
+
+    Each key is looked up with a perfect hash of the names of the fields of its struct, built
+    the first time the struct is parsed. Members which are not bound are skipped, and fields
+    whose member is absent keep their value. Arrays replace the elements of their vectors.
+
+    The hash tables are built lazily in function-local statics, whose initialization is not
+    thread-safe before C++11. Call Initialize() once before parsing a type from several
+    threads at the same time.
+
+    The handler returns false, ending the parsing with \ref kParseErrorTermination, if a
+    value does not match the type of its field: a null, a value of another type, or an
+    integer out of the range of an integer field.
+
+    \tparam T Type of the value to parse into.
+    \tparam StackAllocator Allocator of the stack of the nested values.
+    \note implements Handler concept, for texts parsed to UTF-8
+*/
+template <typename T, typename StackAllocator = CrtAllocator>
+class BindingHandler {
+public:
+    typedef char Ch;
+
+    //! Constructor
+    /*! \param value Value to parse into.
+        \param allocator Allocator of the stack. If it is null, a private one is created.
+    */
+    explicit BindingHandler(T& value, StackAllocator* allocator = 0) :
+        value_(value), stack_(allocator, 16 * sizeof(Frame)), skipDepth_(), skip_(false) {}
+
+    //! Build the lookup tables of \c T and of the structs nested in it.
+    /*! They are otherwise built on first use. It is not thread-safe itself and is meant to be
+        called once, e.g. at startup, before several threads may parse into \c T.
+    */
+    static void Initialize() {
+        std::vector<const internal::BindingTable*> done;
+        internal::InitializeBindingTables(internal::BindingValue<T>::GetOps(), done);
+    }
+
+    bool Null() { void* p; const internal::BindingOps* ops; return Skip() || (Next(p, ops) && ops->null(p)); }
+    bool Bool(bool b) { void* p; const internal::BindingOps* ops; return Skip() || (Next(p, ops) && ops->boolean(p, b)); }
+    bool Int(int i) { return Int64(i); }
+    bool Uint(unsigned u) { return Uint64(u); }
+    bool Int64(int64_t i) { void* p; const internal::BindingOps* ops; return Skip() || (Next(p, ops) && ops->int64(p, i)); }
+    bool Uint64(uint64_t u) { void* p; const internal::BindingOps* ops; return Skip() || (Next(p, ops) && ops->uint64(p, u)); }
+    bool Double(double d) { void* p; const internal::BindingOps* ops; return Skip() || (Next(p, ops) && ops->number(p, d)); }
+    bool RawNumber(const Ch*, SizeType, bool) { return Skip(); }
+    bool String(const Ch* str, SizeType length, bool) {
+        void* p;
+        const internal::BindingOps* ops;
+        return Skip() || (Next(p, ops) && ops->string(p, str, length));
+    }
+
+    bool StartObject() { return Start(internal::BindingOps::kObject); }
+
+    bool Key(const Ch* str, SizeType length, bool) {
+        if (skip_)
+            return true;
+        Frame* f = stack_.template Top<Frame>();
+        f->field = f->ops->table()->Find(str, length);
+        skip_ = f->field == 0;  // Unknown members are skipped
+        return true;
+    }
+
+    bool EndObject(SizeType) { return End(); }
+    bool StartArray() { return Start(internal::BindingOps::kArray); }
+    bool EndArray(SizeType) { return End(); }
+
+private:
+    struct Frame {
+        const internal::BindingOps* ops;
+        void* value;
+        const internal::BindingField* field;    // Field of the next value of an object
+    };
+
+    //! Consume the event if it is part of a skipped value.
+    bool Skip() {
+        if (!skip_)
+            return false;
+        skip_ = skipDepth_ != 0;
+        return true;
+    }
+
+    //! Get the value receiving the next event.
+    bool Next(void*& p, const internal::BindingOps*& ops) {
+        if (stack_.Empty()) {
+            p = &value_;
+            ops = &internal::BindingValue<T>::GetOps();
+            return true;
+        }
+        Frame* f = stack_.template Top<Frame>();
+        if (f->ops->kind == internal::BindingOps::kArray) {
+            p = f->ops->append(f->value);
+            ops = &f->ops->element();
+        }
+        else {
+            RAPIDJSON_ASSERT(f->field);
+            p = static_cast<char*>(f->value) + f->field->offset;
+            ops = f->field->ops;
+        }
+        return true;
+    }
+
+    bool Start(internal::BindingOps::Kind kind) {
+        if (skip_) {
+            skipDepth_++;
+            return true;
+        }
+        void* p;
+        const internal::BindingOps* ops;
+        Next(p, ops);
+        if (ops->kind != kind)
+            return false;
+        if (kind == internal::BindingOps::kArray)
+            ops->clear(p);
+        Frame* f = stack_.template Push<Frame>();
+        f->ops = ops;
+        f->value = p;
+        f->field = 0;
+        return true;
+    }
+
+    bool End() {
+        if (skip_) {
+            skip_ = --skipDepth_ != 0;
+            return true;
+        }
+        stack_.template Pop<Frame>(1);
+        return true;
+    }
+
+    T& value_;
+    internal::Stack<StackAllocator> stack_;
+    SizeType skipDepth_;
+    bool skip_;
+};
+
+//! Send a value bound with a Binding to a handler, such as a Writer or a Document.
+/*! The fields of structs are sent in the order of their description.
+    \return Whether the handler accepted all the events.
+*/
+template <typename T, typename Handler>
+inline bool BindingAccept(const T& value, Handler& handler) {
+    return internal::BindingValue<T>::Accept(value, handler);
+}
+
+RAPIDJSON_NAMESPACE_END
+
+#ifdef _MSC_VER
+RAPIDJSON_DIAG_POP
+#endif
+
+#ifdef __GNUC__
+RAPIDJSON_DIAG_POP
+#endif
+
+#endif // RAPIDJSON_BINDING_H_
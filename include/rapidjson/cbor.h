@@ -0,0 +1,769 @@
+// Tencent is pleased to support the open source community by making RapidJSON available.
+//
+// Copyright (C) 2015 THL A29 Limited, a Tencent company, and Milo Yip. All rights reserved.
+//
+// Licensed under the MIT License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// http://opensource.org/licenses/MIT
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#ifndef RAPIDJSON_CBOR_H_
+#define RAPIDJSON_CBOR_H_
+
+#include "reader.h"
+#include "internal/bytestream.h"
+#include "internal/ieee754.h"
+#include "internal/stack.h"
+#include "internal/strfunc.h"
+#include <cmath>
+#include <limits>
+
+#ifdef __GNUC__
+RAPIDJSON_DIAG_PUSH
+RAPIDJSON_DIAG_OFF(effc++)
+#endif
+
+RAPIDJSON_NAMESPACE_BEGIN
+
+namespace internal {
+
+//! Major types of CBOR data items (RFC 8949, section 3.1).
+enum CborMajorType {
+    kCborUnsigned = 0,
+    kCborNegative = 1,
+    kCborByteString = 2,
+    kCborTextString = 3,
+    kCborArray = 4,
+    kCborMap = 5,
+    kCborTag = 6,
+    kCborSimple = 7
+};
+
+static const unsigned kCborIndefinite = 31;     //!< Additional information of indefinite lengths
+static const unsigned kCborBreak = 0xFF;        //!< Stop code of indefinite lengths
+
+//! Decodes an IEEE 754 half-precision float.
+inline double CborHalfToDouble(unsigned half) {
+    const unsigned exponent = (half >> 10) & 0x1F;
+    const unsigned mantissa = half & 0x3FF;
+    double d;
+    if (exponent == 0)
+        d = std::ldexp(static_cast<double>(mantissa), -24);
+    else if (exponent != 31)
+        d = std::ldexp(static_cast<double>(mantissa + 1024), static_cast<int>(exponent) - 25);
+    else
+        d = mantissa == 0 ? std::numeric_limits<double>::infinity() : std::numeric_limits<double>::quiet_NaN();
+    return (half & 0x8000) ? -d : d;
+}
+
+//! Encodes a finite or infinite float as a half-precision float, if it is exactly representable.
+inline bool CborFloatToHalf(float f, unsigned& half) {
+    uint32_t bits;
+    std::memcpy(&bits, &f, sizeof(bits));
+    const unsigned sign = (bits >> 16) & 0x8000u;
+    const int exponent = static_cast<int>((bits >> 23) & 0xFF) - 127 + 15;
+    const uint32_t mantissa = bits & 0x7FFFFF;
+    if ((bits & 0x7FFFFFFF) == 0 || exponent == 128 + 15) {
+        // Zero or infinity (NaN is handled by the caller)
+        half = sign | (exponent > 0 ? 0x7C00u : 0u);
+        return mantissa == 0;
+    }
+    if (exponent >= 31)
+        return false;
+    if (exponent >= 1) {
+        if ((mantissa & 0x1FFF) != 0)
+            return false;
+        half = sign | static_cast<unsigned>(exponent) << 10 | mantissa >> 13;
+        return true;
+    }
+    // Subnormal half
+    const int shift = 14 - exponent;
+    const uint32_t m = mantissa | 0x800000;
+    if (shift > 24 || (m & ((1u << shift) - 1)) != 0)
+        return false;
+    half = sign | (m >> shift);
+    return true;
+}
+
+} // namespace internal
+
+///////////////////////////////////////////////////////////////////////////////
+// GenericCborReader
+
+//! SAX-style reader of CBOR (RFC 8949).
+/*! Reads one CBOR data item from a byte stream and generates the same events as
+    GenericReader would for the equivalent JSON text, so that any Handler, including
+    GenericDocument through Populate(), can consume CBOR directly.
+
+    Integers are reported with Uint() or Int() when they fit in 32 bits, otherwise with
+    Uint64() or Int64(), and negative integers below -2^63 as well as all floats with
+    Double(). Byte strings and text strings are both reported as strings, with Key() for
+    map keys, which must be strings. Tags are skipped, and undefined is reported as null.
+    Other simple values have no JSON equivalent and are reported as \ref kParseErrorValueInvalid.
+    Definite and indefinite lengths are both supported.
+
+    With \ref kParseInsituFlag and an InsituMemoryStream, strings are not copied: each one is
+    moved over its own header, null-terminated in place and given with <tt>copy == false</tt>,
+    so the buffer must outlive the values referencing it.
+
+    Nesting is handled with an explicit stack, so deep input cannot overflow the call stack.
+    With a MemoryStream or an InsituMemoryStream, truncated input and counts larger than the
+    input are detected; other streams are expected to hold a complete data item.
+
+    \tparam TargetEncoding Encoding of the strings given to the handler. CBOR text strings are UTF-8.
+    \tparam StackAllocator Allocator of the internal stacks.
+*/
+template <typename TargetEncoding = UTF8<>, typename StackAllocator = CrtAllocator>
+class GenericCborReader {
+public:
+    typedef typename TargetEncoding::Ch Ch;
+
+    //! Constructor.
+    /*! \param stackAllocator Optional allocator for allocating stack memory. (Only use for non-destructive parsing)
+        \param stackCapacity stack capacity in bytes for storing a single decoded string.  (Only use for non-destructive parsing)
+    */
+    GenericCborReader(StackAllocator* stackAllocator = 0, size_t stackCapacity = kDefaultStackCapacity) :
+        levels_(stackAllocator, stackCapacity), bytes_(stackAllocator, stackCapacity), chars_(stackAllocator, stackCapacity), parseResult_() {}
+
+    //! Parse one CBOR data item from a stream.
+    /*! \tparam parseFlags Combination of \ref kParseInsituFlag, which requires an InsituMemoryStream,
+            and \ref kParseValidateEncodingFlag, which validates text strings.
+        \param is Input byte stream, positioned after the data item on success.
+        \param handler The handler to receive events.
+        \return Whether the parsing is successful.
+    */
+    template <unsigned parseFlags, typename InputStream, typename Handler>
+    ParseResult Parse(InputStream& is, Handler& handler) {
+        RAPIDJSON_STATIC_ASSERT(sizeof(typename InputStream::Ch) == 1);
+        RAPIDJSON_STATIC_ASSERT(!(parseFlags & kParseInsituFlag) ||
+            ((internal::IsSame<InputStream, InsituMemoryStream>::Value && internal::IsSame<TargetEncoding, UTF8<> >::Value)));
+        parseResult_.Clear();
+        ClearStackOnExit scope(*this);
+
+        if (RAPIDJSON_UNLIKELY(!internal::ByteStreamAvailable(is, 1))) {
+            parseResult_.Set(kParseErrorDocumentEmpty, is.Tell());
+            return parseResult_;
+        }
+
+        do {
+            if (RAPIDJSON_UNLIKELY(!ParseItem<parseFlags>(is, handler)))
+                return parseResult_;
+
+            // Close the definite containers whose items are all parsed
+            while (!levels_.Empty() && !levels_.template Top<Level>()->indefinite && levels_.template Top<Level>()->remaining == 0)
+                if (RAPIDJSON_UNLIKELY(!EndContainer(handler, is.Tell())))
+                    return parseResult_;
+        } while (!levels_.Empty());
+
+        return parseResult_;
+    }
+
+    //! Parse one CBOR data item from a stream, with the default flags.
+    template <typename InputStream, typename Handler>
+    ParseResult Parse(InputStream& is, Handler& handler) {
+        return Parse<kParseDefaultFlags>(is, handler);
+    }
+
+    //! Parse one CBOR data item into a document.
+    /*! \param is Input byte stream.
+        \param document Document replaced by the data item on success, unchanged otherwise.
+        \return Whether the parsing is successful.
+    */
+    template <unsigned parseFlags, typename InputStream, typename DocumentType>
+    bool Populate(InputStream& is, DocumentType& document) {
+        Generator<parseFlags, InputStream> g(*this, is);
+        document.Populate(g);
+        return !HasParseError();
+    }
+
+    //! Parse one CBOR data item into a document, with the default flags.
+    template <typename InputStream, typename DocumentType>
+    bool Populate(InputStream& is, DocumentType& document) {
+        return Populate<kParseDefaultFlags>(is, document);
+    }
+
+    //! Whether a parse error has occurred in the last parsing.
+    bool HasParseError() const { return parseResult_.IsError(); }
+
+    //! Get the \ref ParseErrorCode of last parsing.
+    ParseErrorCode GetParseErrorCode() const { return parseResult_.Code(); }
+
+    //! Get the position of last parsing error in input, 0 otherwise.
+    size_t GetErrorOffset() const { return parseResult_.Offset(); }
+
+private:
+    // Prohibit copy constructor & assignment operator.
+    GenericCborReader(const GenericCborReader&);
+    GenericCborReader& operator=(const GenericCborReader&);
+
+    static const size_t kDefaultStackCapacity = 256;
+
+    struct Level {
+        uint64_t remaining;     //!< Items left in a definite container, names and values counting separately in maps
+        uint64_t items;         //!< Items parsed, names and values counting separately in maps
+        bool map;
+        bool indefinite;
+    };
+
+    template <unsigned parseFlags, typename InputStream>
+    struct Generator {
+        Generator(GenericCborReader& reader, InputStream& is) : reader_(reader), is_(is) {}
+        template <typename Handler>
+        bool operator()(Handler& handler) { return !reader_.template Parse<parseFlags>(is_, handler).IsError(); }
+
+        GenericCborReader& reader_;
+        InputStream& is_;
+
+    private:
+        Generator& operator=(const Generator&);
+    };
+
+    class CharStream {
+    public:
+        typedef typename TargetEncoding::Ch Ch;
+        explicit CharStream(internal::Stack<StackAllocator>& stack) : stack_(stack) {}
+        void Put(Ch c) { *stack_.template Push<Ch>() = c; }
+    private:
+        CharStream& operator=(const CharStream&);
+        internal::Stack<StackAllocator>& stack_;
+    };
+
+    void ClearStack() { levels_.Clear(); bytes_.Clear(); chars_.Clear(); }
+
+    struct ClearStackOnExit {
+        explicit ClearStackOnExit(GenericCborReader& r) : r_(r) {}
+        ~ClearStackOnExit() { r_.ClearStack(); }
+    private:
+        GenericCborReader& r_;
+        ClearStackOnExit(const ClearStackOnExit&);
+        ClearStackOnExit& operator=(const ClearStackOnExit&);
+    };
+
+    bool Error(ParseErrorCode code, size_t offset) {
+        parseResult_.Set(code, offset);
+        return false;
+    }
+
+    // Reads a big-endian unsigned integer of n bytes.
+    template <typename InputStream>
+    static bool ReadBig(InputStream& is, unsigned n, uint64_t& value) {
+        unsigned char b[8];
+        if (!internal::ByteStreamRead(is, b, n))
+            return false;
+        value = 0;
+        for (unsigned i = 0; i < n; i++)
+            value = (value << 8) | b[i];
+        return true;
+    }
+
+    // Reads the argument following an initial byte, which must not be of indefinite length.
+    template <typename InputStream>
+    static bool ReadArgument(InputStream& is, unsigned info, uint64_t& value) {
+        if (info < 24) {
+            value = info;
+            return true;
+        }
+        if (info > 27)
+            return false;
+        return ReadBig(is, 1u << (info - 24), value);
+    }
+
+    // Skips n bytes known to be available.
+    template <typename InputStream>
+    static void Skip(InputStream& is, size_t n) {
+        for (size_t i = 0; i < n; i++)
+            is.Take();
+    }
+
+    static void Skip(InsituMemoryStream& is, size_t n) { is.src_ += n; }
+
+    // Beginning of the buffer of an in situ stream.
+    template <typename InputStream>
+    static char* InsituBegin(InputStream&) { RAPIDJSON_ASSERT(false); return 0; }
+
+    static char* InsituBegin(InsituMemoryStream& is) { return is.begin_; }
+
+    template <typename Handler>
+    static bool Unsigned(Handler& handler, uint64_t u) {
+        return u <= 0xFFFFFFFFu ? handler.Uint(static_cast<unsigned>(u)) : handler.Uint64(u);
+    }
+
+    template <typename Handler>
+    static bool Negative(Handler& handler, uint64_t u) {
+        // The value is -1 - u
+        if (u <= 0x7FFFFFFFu)
+            return handler.Int(-1 - static_cast<int>(u));
+        if (u <= static_cast<uint64_t>(std::numeric_limits<int64_t>::max()))
+            return handler.Int64(-1 - static_cast<int64_t>(u));
+        return handler.Double(-1.0 - static_cast<double>(u));
+    }
+
+    template <typename Handler>
+    bool EndContainer(Handler& handler, size_t offset) {
+        const Level level = *levels_.template Pop<Level>(1);
+        const SizeType count = static_cast<SizeType>(level.map ? level.items / 2 : level.items);
+        if (RAPIDJSON_UNLIKELY(!(level.map ? handler.EndObject(count) : handler.EndArray(count))))
+            return Error(kParseErrorTermination, offset);
+        return true;
+    }
+
+    // Parses a scalar, the header of a container which is then pushed, or the break closing an indefinite container.
+    template <unsigned parseFlags, typename InputStream, typename Handler>
+    bool ParseItem(InputStream& is, Handler& handler) {
+        size_t offset = is.Tell();
+        unsigned char b;
+        if (RAPIDJSON_UNLIKELY(!internal::ByteStreamRead(is, &b, 1)))
+            return Error(kParseErrorValueInvalid, offset);
+
+        Level* level = levels_.Empty() ? 0 : levels_.template Top<Level>();
+        const bool key = level && level->map && level->items % 2 == 0;
+        if (b == internal::kCborBreak) {
+            if (RAPIDJSON_UNLIKELY(!level || !level->indefinite || (level->map && !key)))
+                return Error(kParseErrorValueInvalid, offset);
+            return EndContainer(handler, offset);
+        }
+        if (level) {
+            level->items++;
+            level->remaining--;
+        }
+
+        // Tags only give a meaning to the following data item
+        while ((b >> 5) == internal::kCborTag) {
+            uint64_t tag;
+            if (RAPIDJSON_UNLIKELY(!ReadArgument(is, b & 0x1Fu, tag)))
+                return Error(kParseErrorValueInvalid, offset);
+            offset = is.Tell();
+            if (RAPIDJSON_UNLIKELY(!internal::ByteStreamRead(is, &b, 1)))
+                return Error(kParseErrorValueInvalid, offset);
+        }
+
+        const unsigned major = b >> 5;
+        const unsigned info = b & 0x1Fu;
+        if (RAPIDJSON_UNLIKELY(key && major != internal::kCborTextString && major != internal::kCborByteString))
+            return Error(kParseErrorObjectMissName, offset);
+
+        uint64_t u = 0;
+        if (info == internal::kCborIndefinite) {
+            if (major == internal::kCborByteString || major == internal::kCborTextString)
+                return ParseString<parseFlags>(is, handler, major, true, 0, key, offset);
+            if (major == internal::kCborArray || major == internal::kCborMap)
+                return StartContainer(handler, major == internal::kCborMap, true, 0, offset);
+            return Error(kParseErrorValueInvalid, offset);
+        }
+        if (RAPIDJSON_UNLIKELY(!ReadArgument(is, info, u)))
+            return Error(kParseErrorValueInvalid, offset);
+
+        bool cont;
+        switch (major) {
+        case internal::kCborUnsigned: cont = Unsigned(handler, u); break;
+        case internal::kCborNegative: cont = Negative(handler, u); break;
+
+        case internal::kCborByteString:
+        case internal::kCborTextString:
+            return ParseString<parseFlags>(is, handler, major, false, u, key, offset);
+
+        case internal::kCborArray:
+        case internal::kCborMap: {
+            const bool map = major == internal::kCborMap;
+            // Every item takes at least one byte
+            if (RAPIDJSON_UNLIKELY((map && u > (std::numeric_limits<uint64_t>::max)() / 2) || !internal::ByteStreamAvailable(is, map ? 2 * u : u)))
+                return Error(kParseErrorValueInvalid, offset);
+            return StartContainer(handler, map, false, map ? 2 * u : u, offset);
+        }
+
+        default:
+            switch (info) {
+            case 20: cont = handler.Bool(false); break;
+            case 21: cont = handler.Bool(true); break;
+            case 22:                                // null
+            case 23: cont = handler.Null(); break;  // undefined
+            case 25: cont = handler.Double(internal::CborHalfToDouble(static_cast<unsigned>(u))); break;
+            case 26: {
+                const uint32_t bits = static_cast<uint32_t>(u);
+                float f;
+                std::memcpy(&f, &bits, sizeof(f));
+                cont = handler.Double(static_cast<double>(f));
+                break;
+            }
+            case 27: {
+                double d;
+                std::memcpy(&d, &u, sizeof(d));
+                cont = handler.Double(d);
+                break;
+            }
+            default:
+                // Unassigned simple values
+                return Error(kParseErrorValueInvalid, offset);
+            }
+        }
+        if (RAPIDJSON_UNLIKELY(!cont))
+            return Error(kParseErrorTermination, offset);
+        return true;
+    }
+
+    template <typename Handler>
+    bool StartContainer(Handler& handler, bool map, bool indefinite, uint64_t remaining, size_t offset) {
+        if (RAPIDJSON_UNLIKELY(!(map ? handler.StartObject() : handler.StartArray())))
+            return Error(kParseErrorTermination, offset);
+        Level* level = levels_.template Push<Level>();
+        level->remaining = remaining;
+        level->items = 0;
+        level->map = map;
+        level->indefinite = indefinite;
+        return true;
+    }
+
+    // Parses the content of a string whose header is at offset, concatenating the chunks of an indefinite length.
+    template <unsigned parseFlags, typename InputStream, typename Handler>
+    bool ParseString(InputStream& is, Handler& handler, unsigned major, bool indefinite, uint64_t length, bool key, size_t offset) {
+        const bool insitu = (parseFlags & kParseInsituFlag) != 0;
+        char* head = insitu ? InsituBegin(is) + offset : 0;
+        size_t size = 0;
+        for (;;) {
+            if (indefinite) {
+                const size_t chunkOffset = is.Tell();
+                unsigned char b;
+                if (RAPIDJSON_UNLIKELY(!internal::ByteStreamRead(is, &b, 1)))
+                    return Error(kParseErrorValueInvalid, chunkOffset);
+                if (b == internal::kCborBreak)
+                    break;
+                // Chunks are definite strings of the same type
+                if (RAPIDJSON_UNLIKELY((b >> 5) != major || !ReadArgument(is, b & 0x1Fu, length)))
+                    return Error(kParseErrorValueInvalid, chunkOffset);
+            }
+            if (RAPIDJSON_UNLIKELY(!internal::ByteStreamAvailable(is, length)))
+                return Error(kParseErrorValueInvalid, offset);
+            const size_t n = static_cast<size_t>(length);
+            if (insitu) {
+                // Headers are at least one byte, so the content only moves backward
+                std::memmove(head + size, InsituBegin(is) + is.Tell(), n);
+                Skip(is, n);
+            }
+            else if (RAPIDJSON_UNLIKELY(!internal::ByteStreamRead(is, bytes_.template Push<unsigned char>(n), n)))
+                return Error(kParseErrorValueInvalid, offset);
+            size += n;
+            if (!indefinite)
+                break;
+        }
+
+        const char* bytes;
+        if (insitu) {
+            head[size] = '\0';
+            bytes = head;
+        }
+        else {
+            *bytes_.template Push<unsigned char>() = '\0';
+            bytes = bytes_.template Bottom<char>();
+        }
+
+        const Ch* str;
+        SizeType strLength;
+        const bool validate = (parseFlags & kParseValidateEncodingFlag) && major == internal::kCborTextString;
+        if (internal::IsSame<UTF8<>, TargetEncoding>::Value && !validate) {
+            str = reinterpret_cast<const Ch*>(bytes);
+            strLength = static_cast<SizeType>(size);
+        }
+        else {
+            GenericStringStream<UTF8<> > source(bytes);
+            CharStream target(chars_);
+            while (source.Tell() < size) {
+                if (RAPIDJSON_UNLIKELY(!(validate ?
+                    Transcoder<UTF8<>, TargetEncoding>::Validate(source, target) :
+                    Transcoder<UTF8<>, TargetEncoding>::Transcode(source, target))))
+                    return Error(kParseErrorStringInvalidEncoding, offset);
+            }
+            if (insitu) {
+                // Validated in place
+                str = reinterpret_cast<const Ch*>(bytes);
+                strLength = static_cast<SizeType>(size);
+            }
+            else {
+                strLength = static_cast<SizeType>(chars_.GetSize() / sizeof(Ch));
+                target.Put('\0');
+                str = chars_.template Bottom<Ch>();
+            }
+        }
+
+        const bool cont = key ? handler.Key(str, strLength, !insitu) : handler.String(str, strLength, !insitu);
+        bytes_.Clear();
+        chars_.Clear();
+        if (RAPIDJSON_UNLIKELY(!cont))
+            return Error(kParseErrorTermination, offset);
+        return true;
+    }
+
+    internal::Stack<StackAllocator> levels_;    //!< Open containers, of type Level
+    internal::Stack<StackAllocator> bytes_;     //!< Bytes of the current string
+    internal::Stack<StackAllocator> chars_;     //!< Current string transcoded or validated
+    ParseResult parseResult_;
+};
+
+//! CBOR reader with UTF8 encoding and default allocator.
+typedef GenericCborReader<UTF8<>, CrtAllocator> CborReader;
+
+///////////////////////////////////////////////////////////////////////////////
+// CborWriter
+
+//! CBOR writer implementing the Handler concept.
+/*! Value::Accept() and the readers can write CBOR through it. Integers take the smallest
+    encoding, doubles the smallest float keeping their exact value (the preferred
+    serialization of RFC 8949) and strings are converted to UTF-8 text strings.
+
+    The SAX events only give the number of elements of a container at its end, so arrays
+    and maps are written with indefinite lengths. Nothing is buffered: the output goes to
+    the stream as the events arrive.
+
+    \tparam OutputStream Type of output byte stream.
+    \tparam SourceEncoding Encoding of the strings of the events.
+    \tparam StackAllocator Type of allocator for allocating memory of the stacks.
+    \note RawNumber() writes the number as a text string, as CBOR has no textual numbers.
+*/
+template<typename OutputStream, typename SourceEncoding = UTF8<>, typename StackAllocator = CrtAllocator>
+class CborWriter {
+public:
+    typedef typename SourceEncoding::Ch Ch;
+
+    static const size_t kDefaultLevelDepth = 32;
+
+    //! Constructor
+    /*! \param os Output stream.
+        \param stackAllocator User supplied allocator. If it is null, it will create a private one.
+        \param levelDepth Initial capacity of stack.
+    */
+    explicit CborWriter(OutputStream& os, StackAllocator* stackAllocator = 0, size_t levelDepth = kDefaultLevelDepth) :
+        os_(&os), level_stack_(stackAllocator, levelDepth * sizeof(Level)), buffer_(stackAllocator, 256), hasRoot_(false) {}
+
+    //! Reset the writer with a new stream.
+    void Reset(OutputStream& os) {
+        os_ = &os;
+        level_stack_.Clear();
+        buffer_.Clear();
+        hasRoot_ = false;
+    }
+
+    //! Checks whether the output is a complete CBOR data item.
+    bool IsComplete() const { return hasRoot_ && level_stack_.Empty(); }
+
+    /*!@name Implementation of Handler
+        \see Handler
+    */
+    //@{
+
+    bool Null()                 { Prefix(kNullType); PutByte(0xF6); return EndValue(); }
+    bool Bool(bool b)           { Prefix(b ? kTrueType : kFalseType); PutByte(b ? 0xF5 : 0xF4); return EndValue(); }
+    bool Int(int i)             { Prefix(kNumberType); WriteSigned(i); return EndValue(); }
+    bool Uint(unsigned u)       { Prefix(kNumberType); WriteHead(internal::kCborUnsigned, u); return EndValue(); }
+    bool Int64(int64_t i64)     { Prefix(kNumberType); WriteSigned(i64); return EndValue(); }
+    bool Uint64(uint64_t u64)   { Prefix(kNumberType); WriteHead(internal::kCborUnsigned, u64); return EndValue(); }
+
+    bool Double(double d) {
+        Prefix(kNumberType);
+        WriteDouble(d);
+        return EndValue();
+    }
+
+    bool RawNumber(const Ch* str, SizeType length, bool copy = false) { return String(str, length, copy); }
+
+    bool String(const Ch* str, SizeType length, bool copy = false) {
+        RAPIDJSON_ASSERT(str != 0);
+        (void)copy;
+        Prefix(kStringType);
+        return EndValue(WriteString(str, length));
+    }
+
+    bool StartObject() {
+        Prefix(kObjectType);
+        StartContainer(true);
+        return true;
+    }
+
+    bool Key(const Ch* str, SizeType length, bool copy = false) {
+        RAPIDJSON_ASSERT(!level_stack_.Empty());                                    // not in an object
+        RAPIDJSON_ASSERT(level_stack_.template Top<Level>()->map);                  // not in an object
+        RAPIDJSON_ASSERT(level_stack_.template Top<Level>()->valueCount % 2 == 0);  // Key() must not follow Key()
+        return String(str, length, copy);
+    }
+
+    bool EndObject(SizeType memberCount = 0) {
+        (void)memberCount;
+        RAPIDJSON_ASSERT(level_stack_.GetSize() >= sizeof(Level));                  // not inside an Object
+        RAPIDJSON_ASSERT(level_stack_.template Top<Level>()->map);                  // currently inside an Array, not Object
+        RAPIDJSON_ASSERT(level_stack_.template Top<Level>()->valueCount % 2 == 0);  // Object has a Key without a Value
+        level_stack_.template Pop<Level>(1);
+        PutByte(internal::kCborBreak);
+        return EndValue();
+    }
+
+    bool StartArray() {
+        Prefix(kArrayType);
+        StartContainer(false);
+        return true;
+    }
+
+    bool EndArray(SizeType elementCount = 0) {
+        (void)elementCount;
+        RAPIDJSON_ASSERT(level_stack_.GetSize() >= sizeof(Level));
+        RAPIDJSON_ASSERT(!level_stack_.template Top<Level>()->map);
+        level_stack_.template Pop<Level>(1);
+        PutByte(internal::kCborBreak);
+        return EndValue();
+    }
+    //@}
+
+    /*! @name Convenience extensions */
+    //@{
+
+    //! Simpler but slower overload.
+    bool String(const Ch* const& str) { return String(str, internal::StrLen(str)); }
+    bool Key(const Ch* const& str) { return Key(str, internal::StrLen(str)); }
+
+    //@}
+
+private:
+    // Prohibit copy constructor & assignment operator.
+    CborWriter(const CborWriter&);
+    CborWriter& operator=(const CborWriter&);
+
+    //! Information for each nested level
+    struct Level {
+        size_t valueCount;  //!< number of values in this level, names and values counting separately in maps
+        bool map;
+    };
+
+    void PutByte(unsigned b) { os_->Put(static_cast<typename OutputStream::Ch>(b)); }
+
+    void PutBig(uint64_t v, unsigned n) {
+        PutReserve(*os_, n);
+        for (unsigned i = n; i-- > 0;)
+            PutUnsafe(*os_, static_cast<typename OutputStream::Ch>(static_cast<unsigned char>(v >> (8 * i))));
+    }
+
+    // Writes an initial byte with the smallest argument.
+    void WriteHead(unsigned major, uint64_t u) {
+        const unsigned type = major << 5;
+        if (u < 24)                 PutByte(type | static_cast<unsigned>(u));
+        else if (u <= 0xFF)         { PutByte(type | 24); PutBig(u, 1); }
+        else if (u <= 0xFFFF)       { PutByte(type | 25); PutBig(u, 2); }
+        else if (u <= 0xFFFFFFFFu)  { PutByte(type | 26); PutBig(u, 4); }
+        else                        { PutByte(type | 27); PutBig(u, 8); }
+    }
+
+    void WriteSigned(int64_t i) {
+        if (i >= 0)
+            WriteHead(internal::kCborUnsigned, static_cast<uint64_t>(i));
+        else
+            WriteHead(internal::kCborNegative, static_cast<uint64_t>(-(i + 1)));
+    }
+
+    void WriteDouble(double d) {
+        const unsigned type = internal::kCborSimple << 5;
+        if (internal::Double(d).IsNan()) {
+            PutByte(type | 25);
+            PutBig(0x7E00, 2);
+            return;
+        }
+        if (internal::Double(d).IsInf() || std::fabs(d) <= static_cast<double>((std::numeric_limits<float>::max)())) {
+            const float f = static_cast<float>(d);
+            const double back = static_cast<double>(f);
+            if (std::memcmp(&back, &d, sizeof(d)) == 0) {
+                unsigned half;
+                if (internal::CborFloatToHalf(f, half)) {
+                    PutByte(type | 25);
+                    PutBig(half, 2);
+                }
+                else {
+                    uint32_t bits;
+                    std::memcpy(&bits, &f, sizeof(bits));
+                    PutByte(type | 26);
+                    PutBig(bits, 4);
+                }
+                return;
+            }
+        }
+        uint64_t bits;
+        std::memcpy(&bits, &d, sizeof(bits));
+        PutByte(type | 27);
+        PutBig(bits, 8);
+    }
+
+    bool WriteString(const Ch* str, SizeType length) {
+        const char* bytes;
+        size_t size;
+        if (internal::IsSame<SourceEncoding, UTF8<> >::Value) {
+            bytes = reinterpret_cast<const char*>(str);
+            size = length;
+        }
+        else {
+            // The length in UTF-8 is only known after transcoding
+            GenericStringStream<SourceEncoding> is(str);
+            ByteStream os(buffer_);
+            while (is.Tell() < length)
+                if (RAPIDJSON_UNLIKELY(!(Transcoder<SourceEncoding, UTF8<> >::Transcode(is, os))))
+                    return false;
+            bytes = buffer_.template Bottom<char>();
+            size = buffer_.GetSize();
+        }
+        WriteHead(internal::kCborTextString, size);
+        PutReserve(*os_, size);
+        for (size_t i = 0; i < size; i++)
+            PutUnsafe(*os_, static_cast<typename OutputStream::Ch>(bytes[i]));
+        buffer_.Clear();
+        return true;
+    }
+
+    void StartContainer(bool map) {
+        Level* level = level_stack_.template Push<Level>();
+        level->valueCount = 0;
+        level->map = map;
+        PutByte((map ? internal::kCborMap : internal::kCborArray) << 5 | internal::kCborIndefinite);
+    }
+
+    void Prefix(Type type) {
+        (void)type;
+        if (RAPIDJSON_LIKELY(!level_stack_.Empty())) {
+            Level* level = level_stack_.template Top<Level>();
+            if (level->map && level->valueCount % 2 == 0)
+                RAPIDJSON_ASSERT(type == kStringType);  // if it's in object, then even number should be a name
+            level->valueCount++;
+        }
+        else {
+            RAPIDJSON_ASSERT(!hasRoot_);    // Should only has one and only one root.
+            hasRoot_ = true;
+        }
+    }
+
+    // Flush the value if it is the top level one.
+    bool EndValue(bool ret = true) {
+        if (RAPIDJSON_UNLIKELY(level_stack_.Empty()))
+            os_->Flush();
+        return ret;
+    }
+
+    class ByteStream {
+    public:
+        typedef char Ch;
+        explicit ByteStream(internal::Stack<StackAllocator>& stack) : stack_(stack) {}
+        void Put(char c) { *stack_.template Push<char>() = c; }
+    private:
+        ByteStream& operator=(const ByteStream&);
+        internal::Stack<StackAllocator>& stack_;
+    };
+
+    OutputStream* os_;
+    internal::Stack<StackAllocator> level_stack_;
+    internal::Stack<StackAllocator> buffer_;        //!< Current string transcoded to UTF-8
+    bool hasRoot_;
+};
+
+RAPIDJSON_NAMESPACE_END
+
+#ifdef __GNUC__
+RAPIDJSON_DIAG_POP
+#endif
+
+#endif // RAPIDJSON_CBOR_H_
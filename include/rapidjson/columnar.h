@@ -0,0 +1,548 @@
+// Tencent is pleased to support the open source community by making RapidJSON available.
+//
+// Copyright (C) 2015 THL A29 Limited, a Tencent company, and Milo Yip. All rights reserved.
+//
+// Licensed under the MIT License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// http://opensource.org/licenses/MIT
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#ifndef RAPIDJSON_COLUMNAR_H_
+#define RAPIDJSON_COLUMNAR_H_
+
+#include "stringbuffer.h"
+#include "writer.h"
+#include "internal/stack.h"
+#include "internal/strfunc.h"
+#include <cstring>
+
+#ifdef __GNUC__
+RAPIDJSON_DIAG_PUSH
+RAPIDJSON_DIAG_OFF(effc++)
+#endif
+
+#ifdef _MSC_VER
+RAPIDJSON_DIAG_PUSH
+RAPIDJSON_DIAG_OFF(4512) // assignment operator could not be generated
+#endif
+
+RAPIDJSON_NAMESPACE_BEGIN
+
+//! Type of the values of a column of a GenericColumnTable.
+enum ColumnType {
+    kNullColumn = 0,    //!< Only nulls, or no value.
+    kBoolColumn = 1,    //!< One byte per value, 0 or 1.
+    kInt64Column = 2,   //!< Integers as int64_t.
+    kDoubleColumn = 3,  //!< Numbers as double, when any of them is not an integer.
+    kStringColumn = 4,  //!< Strings, as offsets into the characters of the column.
+    kJsonColumn = 5     //!< Values of mixed types, arrays or objects, as JSON text laid out as strings.
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// GenericColumn
+
+//! Values of one member of the records of a GenericColumnTable.
+/*! Each column has a value for every row. Whether the value is null is given by a validity
+    bitmap, bit \c i%8 of byte \c i/8 being set for a non-null row \c i. Null rows hold zeros
+    or empty strings, so that the values can be scanned without looking at the bitmap.
+
+    Strings and JSON texts are not null-terminated: the one of row \c i is made of the
+    characters from <tt>GetOffsets()[i]</tt> to <tt>GetOffsets()[i + 1]</tt>.
+
+    \tparam Encoding Encoding of the names and strings.
+    \tparam Allocator Allocator of the values.
+*/
+template <typename Encoding, typename Allocator>
+class GenericColumn {
+public:
+    typedef typename Encoding::Ch Ch;   //!< Character type derived from Encoding.
+
+    //! Name of the member.
+    const Ch* GetName() const { return name_.GetString(); }
+    //! Length of the name.
+    SizeType GetNameLength() const { return static_cast<SizeType>(name_.GetLength()); }
+    //! Type of the values.
+    ColumnType GetType() const { return type_; }
+    //! Number of values, which is the number of rows of the table.
+    SizeType Size() const { return size_; }
+
+    //! Validity bitmap, with a bit set for each non-null value.
+    const uint8_t* GetValidity() const { return validity_.template Bottom<uint8_t>(); }
+    //! Whether the value of a row is null.
+    bool IsNull(SizeType row) const { RAPIDJSON_ASSERT(row < size_); return ((GetValidity()[row / 8] >> (row % 8)) & 1) == 0; }
+    //! Number of null values.
+    SizeType GetNullCount() const { return nullCount_; }
+
+    //! Booleans of a \ref kBoolColumn, as bytes.
+    const uint8_t* GetBools() const { RAPIDJSON_ASSERT(type_ == kBoolColumn); return values_.template Bottom<uint8_t>(); }
+    //! Integers of a \ref kInt64Column.
+    const int64_t* GetInt64s() const { RAPIDJSON_ASSERT(type_ == kInt64Column); return values_.template Bottom<int64_t>(); }
+    //! Numbers of a \ref kDoubleColumn.
+    const double* GetDoubles() const { RAPIDJSON_ASSERT(type_ == kDoubleColumn); return values_.template Bottom<double>(); }
+    //! Offsets of the strings of a \ref kStringColumn or \ref kJsonColumn into GetChars(), Size() + 1 of them.
+    const SizeType* GetOffsets() const { RAPIDJSON_ASSERT(IsText()); return values_.template Bottom<SizeType>(); }
+    //! Characters of the strings of a \ref kStringColumn or \ref kJsonColumn.
+    const Ch* GetChars() const { RAPIDJSON_ASSERT(IsText()); return chars_.stack_.template Bottom<Ch>(); }
+
+    //! String or JSON text of a row, not null-terminated.
+    const Ch* GetString(SizeType row) const { RAPIDJSON_ASSERT(row < size_); return GetChars() + GetOffsets()[row]; }
+    //! Length of the string or JSON text of a row.
+    SizeType GetStringLength(SizeType row) const { RAPIDJSON_ASSERT(row < size_); return GetOffsets()[row + 1] - GetOffsets()[row]; }
+
+private:
+    template <typename, typename> friend class GenericColumnTable;
+    typedef GenericStringBuffer<Encoding, Allocator> StringBufferType;
+    typedef Writer<StringBufferType, Encoding, Encoding, Allocator> WriterType;
+
+    static const size_t kDefaultCapacity = 256;
+
+    GenericColumn(const GenericColumn&);
+    GenericColumn& operator=(const GenericColumn&);
+
+    GenericColumn(const Ch* name, SizeType length, Allocator* allocator) :
+        allocator_(allocator), name_(allocator, (length + 1) * sizeof(Ch)), validity_(allocator, kDefaultCapacity),
+        values_(allocator, kDefaultCapacity), chars_(allocator, kDefaultCapacity), type_(kNullColumn), size_(), nullCount_()
+    {
+        std::memcpy(name_.Push(length), name, length * sizeof(Ch));
+    }
+
+    bool IsText() const { return type_ == kStringColumn || type_ == kJsonColumn; }
+
+    void PushValidity(bool valid) {
+        if (size_ % 8 == 0)
+            *validity_.template Push<uint8_t>() = 0;
+        if (valid)
+            validity_.template Top<uint8_t>()[0] = static_cast<uint8_t>(validity_.template Top<uint8_t>()[0] | (1u << (size_ % 8)));
+        else
+            nullCount_++;
+        size_++;
+    }
+
+    void PushOffset() { *values_.template Push<SizeType>() = static_cast<SizeType>(chars_.GetLength()); }
+
+    // Appends the zero value of the type, for a null.
+    void PushZero() {
+        switch (type_) {
+        case kBoolColumn:   *values_.template Push<uint8_t>() = 0; break;
+        case kInt64Column:  *values_.template Push<int64_t>() = 0; break;
+        case kDoubleColumn: *values_.template Push<double>() = 0.0; break;
+        case kStringColumn:
+        case kJsonColumn:   PushOffset(); break;
+        default: break;
+        }
+    }
+
+    // Makes the column able to hold a value of type t, converting the previous values if needed.
+    void Prepare(ColumnType t) {
+        if (type_ == t || type_ == kJsonColumn || (type_ == kDoubleColumn && t == kInt64Column))
+            return;
+        if (type_ == kNullColumn) {
+            type_ = t;
+            if (IsText())
+                PushOffset();
+            for (SizeType i = 0; i < size_; i++)
+                PushZero();
+        }
+        else if (type_ == kInt64Column && t == kDoubleColumn) {
+            int64_t* values = values_.template Bottom<int64_t>();
+            for (SizeType i = 0; i < size_; i++) {
+                const double d = static_cast<double>(values[i]);
+                std::memcpy(&values[i], &d, sizeof(double));
+            }
+            type_ = kDoubleColumn;
+        }
+        else
+            ToJson();
+    }
+
+    // Rewrites the values as JSON texts.
+    void ToJson() {
+        internal::Stack<Allocator> offsets(allocator_, (size_ + 1) * sizeof(SizeType));
+        StringBufferType chars(allocator_, kDefaultCapacity);
+        WriterType writer(allocator_);
+        *offsets.template Push<SizeType>() = 0;
+        for (SizeType i = 0; i < size_; i++) {
+            if (!IsNull(i)) {
+                writer.Reset(chars);
+                switch (type_) {
+                case kBoolColumn:   writer.Bool(GetBools()[i] != 0); break;
+                case kInt64Column:  writer.Int64(GetInt64s()[i]); break;
+                case kDoubleColumn: writer.Double(GetDoubles()[i]); break;
+                default:            writer.String(GetString(i), GetStringLength(i)); break;
+                }
+            }
+            *offsets.template Push<SizeType>() = static_cast<SizeType>(chars.GetLength());
+        }
+        values_.Swap(offsets);
+        chars_.stack_.Swap(chars.stack_);
+        type_ = kJsonColumn;
+    }
+
+    void Null() {
+        PushZero();
+        PushValidity(false);
+    }
+
+    void Bool(bool b, WriterType& writer) {
+        Prepare(kBoolColumn);
+        if (type_ == kBoolColumn)
+            *values_.template Push<uint8_t>() = b ? 1 : 0;
+        else
+            WriteJson(writer).Bool(b);
+        PushValue();
+    }
+
+    void Int64(int64_t i, WriterType& writer) {
+        Prepare(kInt64Column);
+        if (type_ == kInt64Column)
+            *values_.template Push<int64_t>() = i;
+        else if (type_ == kDoubleColumn)
+            *values_.template Push<double>() = static_cast<double>(i);
+        else
+            WriteJson(writer).Int64(i);
+        PushValue();
+    }
+
+    void Uint64(uint64_t u, WriterType& writer) {
+        if (u <= RAPIDJSON_UINT64_C2(0x7FFFFFFF, 0xFFFFFFFF))
+            return Int64(static_cast<int64_t>(u), writer);
+        Prepare(kDoubleColumn);
+        if (type_ == kDoubleColumn)
+            *values_.template Push<double>() = static_cast<double>(u);
+        else
+            WriteJson(writer).Uint64(u);
+        PushValue();
+    }
+
+    bool Double(double d, WriterType& writer) {
+        Prepare(kDoubleColumn);
+        if (type_ == kDoubleColumn)
+            *values_.template Push<double>() = d;
+        else if (!WriteJson(writer).Double(d))
+            return false;
+        PushValue();
+        return true;
+    }
+
+    void String(const Ch* str, SizeType length, WriterType& writer) {
+        Prepare(kStringColumn);
+        if (type_ == kStringColumn)
+            std::memcpy(chars_.Push(length), str, length * sizeof(Ch));
+        else
+            WriteJson(writer).String(str, length);
+        PushValue();
+    }
+
+    // Points the writer at the end of the characters, for a value of a kJsonColumn.
+    WriterType& WriteJson(WriterType& writer) {
+        Prepare(kJsonColumn);
+        writer.Reset(chars_);
+        return writer;
+    }
+
+    // Ends a value written into the values or the characters.
+    void PushValue() {
+        if (IsText())
+            PushOffset();
+        PushValidity(true);
+    }
+
+    Allocator* allocator_;
+    StringBufferType name_;
+    internal::Stack<Allocator> validity_;
+    internal::Stack<Allocator> values_;     // Values, or offsets of the strings
+    StringBufferType chars_;
+    ColumnType type_;
+    SizeType size_;
+    SizeType nullCount_;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// GenericColumnTable
+
+//! Columns built from an array of records, as a Handler.
+/*! The JSON text must be an array of objects, such as a result set or a log. Each member
+    name becomes a column which holds its values for all the records, with a null for the
+    records lacking it. Columns of booleans, integers and numbers are plain arrays of
+    \c uint8_t, \c int64_t and \c double, strings are offsets into one array of characters.
+    They can be scanned or exported without visiting a GenericValue per value.
+
+    The type of a column is found from its values. Integers are converted to doubles when
+    a number which is not an integer, or an unsigned integer above \c INT64_MAX, comes up.
+    Members whose values are arrays, objects, or of several types make a \ref kJsonColumn
+    holding the JSON text of each value. The first of duplicated names in a record is kept.
+
+    \code
+    ColumnTable table;
+    Reader reader;
+    StringStream ss(json);
+    if (reader.Parse(ss, table)) {
+        const ColumnTable::Column* c = table.FindColumn("latitude");
+        if (c && c->GetType() == kDoubleColumn) {
+            double sum = 0;
+            for (SizeType i = 0; i < c->Size(); i++)
+                sum += c->GetDoubles()[i];  // nulls are zeros
+        }
+    }
+    \endcode
+
+    The handler returns false, ending the parsing with \ref kParseErrorTermination, if the
+    root is not an array or one of its elements is not an object.
+
+    \tparam Encoding Encoding of the names and strings, the target encoding of the reader.
+    \tparam Allocator Allocator of the columns.
+    \note implements Handler concept
+*/
+template <typename Encoding = UTF8<>, typename Allocator = CrtAllocator>
+class GenericColumnTable {
+public:
+    typedef typename Encoding::Ch Ch;                   //!< Character type derived from Encoding.
+    typedef GenericColumn<Encoding, Allocator> Column;  //!< Column type of the table.
+
+    //! Constructor
+    /*! \param allocator Allocator of the columns. If it is null, a private one is created.
+    */
+    explicit GenericColumnTable(Allocator* allocator = 0) :
+        allocator_(allocator), ownAllocator_(), columns_(allocator, 16 * sizeof(Column*)),
+        writer_(allocator), scratch_(allocator), current_(), next_(), rows_(), depth_()
+    {
+        if (!allocator_)
+            ownAllocator_ = allocator_ = RAPIDJSON_NEW(Allocator)();
+    }
+
+    ~GenericColumnTable() {
+        Clear();
+        RAPIDJSON_DELETE(ownAllocator_);
+    }
+
+    //! Remove all the columns, for parsing another text.
+    void Clear() {
+        for (Column** c = columns_.template Bottom<Column*>(); c != columns_.template End<Column*>(); ++c)
+            RAPIDJSON_DELETE(*c);
+        columns_.Clear();
+        current_ = 0;
+        next_ = rows_ = 0;
+        depth_ = 0;
+    }
+
+    //! Number of records.
+    SizeType GetRowCount() const { return rows_; }
+    //! Number of distinct member names.
+    SizeType GetColumnCount() const { return static_cast<SizeType>(columns_.GetSize() / sizeof(Column*)); }
+    //! Column by index, in order of first appearance of the names.
+    const Column& GetColumn(SizeType index) const { RAPIDJSON_ASSERT(index < GetColumnCount()); return *columns_.template Bottom<Column*>()[index]; }
+
+    //! Find a column by name.
+    /*! \return The column, or 0 if no record has a member with this name.
+    */
+    const Column* FindColumn(const Ch* name, SizeType length) const {
+        for (SizeType i = 0; i < GetColumnCount(); i++) {
+            const Column& c = GetColumn(i);
+            if (c.GetNameLength() == length && std::memcmp(c.GetName(), name, length * sizeof(Ch)) == 0)
+                return &c;
+        }
+        return 0;
+    }
+
+    //! Find a column by null-terminated name.
+    const Column* FindColumn(const Ch* name) const { return FindColumn(name, internal::StrLen(name)); }
+
+    //!@name Implementation of Handler
+    //!@{
+
+    bool Null() {
+        if (depth_ > 2)
+            return writer_.Null();
+        if (!IsField())
+            return false;
+        if (current_)
+            current_->Null();
+        return true;
+    }
+
+    bool Bool(bool b) {
+        if (depth_ > 2)
+            return writer_.Bool(b);
+        if (!IsField())
+            return false;
+        if (current_)
+            current_->Bool(b, writer_);
+        return true;
+    }
+
+    bool Int(int i) { return depth_ > 2 ? writer_.Int(i) : Int64(i); }
+    bool Uint(unsigned u) { return depth_ > 2 ? writer_.Uint(u) : Int64(u); }
+
+    bool Int64(int64_t i) {
+        if (depth_ > 2)
+            return writer_.Int64(i);
+        if (!IsField())
+            return false;
+        if (current_)
+            current_->Int64(i, writer_);
+        return true;
+    }
+
+    bool Uint64(uint64_t u) {
+        if (depth_ > 2)
+            return writer_.Uint64(u);
+        if (!IsField())
+            return false;
+        if (current_)
+            current_->Uint64(u, writer_);
+        return true;
+    }
+
+    bool Double(double d) {
+        if (depth_ > 2)
+            return writer_.Double(d);
+        if (!IsField())
+            return false;
+        return !current_ || current_->Double(d, writer_);
+    }
+
+    bool RawNumber(const Ch* str, SizeType length, bool copy) {
+        if (depth_ > 2)
+            return writer_.RawNumber(str, length, copy);
+        return String(str, length, copy);
+    }
+
+    bool String(const Ch* str, SizeType length, bool copy) {
+        if (depth_ > 2)
+            return writer_.String(str, length, copy);
+        if (!IsField())
+            return false;
+        if (current_)
+            current_->String(str, length, writer_);
+        return true;
+    }
+
+    bool StartObject() {
+        if (depth_ == 1) {
+            depth_++;
+            next_ = 0;
+            return true;
+        }
+        if (!StartNested())
+            return false;
+        return writer_.StartObject();
+    }
+
+    bool Key(const Ch* str, SizeType length, bool copy) {
+        if (depth_ > 2)
+            return writer_.Key(str, length, copy);
+        SelectColumn(str, length);
+        return true;
+    }
+
+    bool EndObject(SizeType memberCount) {
+        if (depth_ > 2)
+            return EndNested(writer_.EndObject(memberCount));
+        // Nulls for the missing members
+        for (Column** c = columns_.template Bottom<Column*>(); c != columns_.template End<Column*>(); ++c)
+            if ((*c)->Size() == rows_)
+                (*c)->Null();
+        rows_++;
+        depth_--;
+        return true;
+    }
+
+    bool StartArray() {
+        if (depth_ == 0) {
+            depth_++;
+            return true;
+        }
+        if (!StartNested())
+            return false;
+        return writer_.StartArray();
+    }
+
+    bool EndArray(SizeType elementCount) {
+        if (depth_ > 2)
+            return EndNested(writer_.EndArray(elementCount));
+        depth_--;
+        return true;
+    }
+
+    //!@}
+
+private:
+    GenericColumnTable(const GenericColumnTable&);
+    GenericColumnTable& operator=(const GenericColumnTable&);
+
+    // Whether a scalar is the value of a member of a record, rather than the root or an element of the array.
+    bool IsField() const { return depth_ == 2; }
+
+    // Sets the column of the next value, 0 for a duplicated name.
+    void SelectColumn(const Ch* str, SizeType length) {
+        Column** columns = columns_.template Bottom<Column*>();
+        const SizeType count = GetColumnCount();
+        SizeType i = next_;     // Records usually have the same members in the same order
+        if (i >= count || columns[i]->GetNameLength() != length || std::memcmp(columns[i]->GetName(), str, length * sizeof(Ch)) != 0) {
+            for (i = 0; i < count; i++)
+                if (columns[i]->GetNameLength() == length && std::memcmp(columns[i]->GetName(), str, length * sizeof(Ch)) == 0)
+                    break;
+            if (i == count) {
+                Column* c = RAPIDJSON_NEW(Column)(str, length, allocator_);
+                for (SizeType r = 0; r < rows_; r++)
+                    c->Null();
+                *columns_.template Push<Column*>() = c;
+                columns = columns_.template Bottom<Column*>();
+            }
+        }
+        next_ = i + 1;
+        current_ = columns[i]->Size() == rows_ ? columns[i] : 0;
+    }
+
+    // Starts writing an array or object, as the value of a kJsonColumn or inside one.
+    bool StartNested() {
+        if (depth_ < 2)
+            return false;
+        if (depth_ == 2) {
+            if (current_)
+                current_->WriteJson(writer_);
+            else {
+                scratch_.Clear();
+                writer_.Reset(scratch_);
+            }
+        }
+        depth_++;
+        return true;
+    }
+
+    bool EndNested(bool result) {
+        if (--depth_ == 2 && current_)
+            current_->PushValue();
+        return result;
+    }
+
+    Allocator* allocator_;
+    Allocator* ownAllocator_;
+    internal::Stack<Allocator> columns_;    // Column*
+    typename Column::WriterType writer_;
+    typename Column::StringBufferType scratch_; // Values of duplicated names
+    Column* current_;
+    SizeType next_;
+    SizeType rows_;
+    unsigned depth_;
+};
+
+//! GenericColumnTable with UTF8 encoding
+typedef GenericColumnTable<UTF8<> > ColumnTable;
+
+RAPIDJSON_NAMESPACE_END
+
+#ifdef _MSC_VER
+RAPIDJSON_DIAG_POP
+#endif
+
+#ifdef __GNUC__
+RAPIDJSON_DIAG_POP
+#endif
+
+#endif // RAPIDJSON_COLUMNAR_H_
@@ -23,6 +23,7 @@
 #include "memorystream.h"
 #include "encodedstream.h"
 #include <new>      // placement new
+#include <algorithm> // std::stable_sort
 #include <limits>
 
 RAPIDJSON_DIAG_PUSH
@@ -58,6 +59,7 @@ RAPIDJSON_DIAG_OFF(terminate) // ignore throwing RAPIDJSON_ASSERT in RAPIDJSON_N
 
 #if RAPIDJSON_HAS_CXX11_RVALUE_REFS
 #include <utility> // std::move
+#include <atomic>  // std::atomic
 #endif
 
 RAPIDJSON_NAMESPACE_BEGIN
@@ -624,12 +626,12 @@ public:
         case kObjectType: {
                 SizeType count = rhs.data_.o.size;
                 Member* lm = reinterpret_cast<Member*>(allocator.Malloc(count * sizeof(Member)));
-                const typename GenericValue<Encoding,SourceAllocator>::Member* rm = rhs.GetMembersPointer();
+                const typename GenericValue<Encoding,SourceAllocator>::Member* rm = rhs.GetConstMembersPointer();
                 for (SizeType i = 0; i < count; i++) {
                     new (&lm[i].name) GenericValue(rm[i].name, allocator, copyConstStrings);
                     new (&lm[i].value) GenericValue(rm[i].value, allocator, copyConstStrings);
                 }
-                data_.f.flags = kObjectFlag;
+                data_.f.flags = static_cast<uint16_t>(rhs.data_.f.flags & ~kSharedFlag); // keeps the order of the members
                 data_.o.size = data_.o.capacity = count;
                 SetMembersPointer(lm);
             }
@@ -637,7 +639,7 @@ public:
         case kArrayType: {
                 SizeType count = rhs.data_.a.size;
                 GenericValue* le = reinterpret_cast<GenericValue*>(allocator.Malloc(count * sizeof(GenericValue)));
-                const GenericValue<Encoding,SourceAllocator>* re = rhs.GetElementsPointer();
+                const GenericValue<Encoding,SourceAllocator>* re = rhs.GetConstElementsPointer();
                 for (SizeType i = 0; i < count; i++)
                     new (&le[i]) GenericValue(re[i], allocator, copyConstStrings);
                 data_.f.flags = kArrayFlag;
@@ -780,6 +782,7 @@ public:
                 break;
 
             case kObjectFlag:
+            case kObjectFlag | kSortedFlag:
                 for (MemberIterator m = MemberBegin(); m != MemberEnd(); ++m)
                     m->~Member();
                 Allocator::Free(GetMembersPointer());
@@ -789,6 +792,12 @@ public:
                 Allocator::Free(const_cast<Ch*>(GetStringPointer()));
                 break;
 
+            case kArrayFlag | kSharedFlag:
+            case kObjectFlag | kSharedFlag:
+            case kObjectFlag | kSortedFlag | kSharedFlag:
+                Allocator::Free(GetSharedPointer()); // The children belong to the shared subtree
+                break;
+
             default:
                 break;  // Do nothing for other types.
             }
@@ -990,8 +999,8 @@ public:
     bool IsFalse()  const { return data_.f.flags == kFalseFlag; }
     bool IsTrue()   const { return data_.f.flags == kTrueFlag; }
     bool IsBool()   const { return (data_.f.flags & kBoolFlag) != 0; }
-    bool IsObject() const { return data_.f.flags == kObjectFlag; }
-    bool IsArray()  const { return data_.f.flags == kArrayFlag; }
+    bool IsObject() const { return GetType() == kObjectType; }
+    bool IsArray()  const { return GetType() == kArrayType; }
     bool IsNumber() const { return (data_.f.flags & kNumberFlag) != 0; }
     bool IsInt()    const { return (data_.f.flags & kIntFlag) != 0; }
     bool IsUint()   const { return (data_.f.flags & kUintFlag) != 0; }
@@ -1085,7 +1094,10 @@ public:
         return (*this)[n];
     }
     template <typename T>
-    RAPIDJSON_DISABLEIF_RETURN((internal::NotExpr<internal::IsSame<typename internal::RemoveConst<T>::Type, Ch> >),(const GenericValue&)) operator[](T* name) const { return const_cast<GenericValue&>(*this)[name]; }
+    RAPIDJSON_DISABLEIF_RETURN((internal::NotExpr<internal::IsSame<typename internal::RemoveConst<T>::Type, Ch> >),(const GenericValue&)) operator[](T* name) const {
+        GenericValue n(StringRef(name));
+        return (*this)[n];
+    }
 
     //! Get a value from an object associated with the name.
     /*! \pre IsObject() == true
@@ -1098,7 +1110,12 @@ public:
     */
     template <typename SourceAllocator>
     GenericValue& operator[](const GenericValue<Encoding, SourceAllocator>& name) {
-        MemberIterator member = FindMember(name);
+        Unshare();
+        return const_cast<GenericValue&>(static_cast<const GenericValue&>(*this)[name]);
+    }
+    template <typename SourceAllocator>
+    const GenericValue& operator[](const GenericValue<Encoding, SourceAllocator>& name) const {
+        ConstMemberIterator member = FindMember(name);
         if (member != MemberEnd())
             return member->value;
         else {
@@ -1113,8 +1130,6 @@ public:
             return *new (buffer) GenericValue();
         }
     }
-    template <typename SourceAllocator>
-    const GenericValue& operator[](const GenericValue<Encoding, SourceAllocator>& name) const { return const_cast<GenericValue&>(*this)[name]; }
 
 #if RAPIDJSON_HAS_STDSTRING
     //! Get a value from an object associated with name (string object).
@@ -1124,16 +1139,16 @@ public:
 
     //! Const member iterator
     /*! \pre IsObject() == true */
-    ConstMemberIterator MemberBegin() const { RAPIDJSON_ASSERT(IsObject()); return ConstMemberIterator(GetMembersPointer()); }
+    ConstMemberIterator MemberBegin() const { RAPIDJSON_ASSERT(IsObject()); return ConstMemberIterator(GetConstMembersPointer()); }
     //! Const \em past-the-end member iterator
     /*! \pre IsObject() == true */
-    ConstMemberIterator MemberEnd() const   { RAPIDJSON_ASSERT(IsObject()); return ConstMemberIterator(GetMembersPointer() + data_.o.size); }
+    ConstMemberIterator MemberEnd() const   { RAPIDJSON_ASSERT(IsObject()); return ConstMemberIterator(GetConstMembersPointer() + data_.o.size); }
     //! Member iterator
     /*! \pre IsObject() == true */
-    MemberIterator MemberBegin()            { RAPIDJSON_ASSERT(IsObject()); return MemberIterator(GetMembersPointer()); }
+    MemberIterator MemberBegin()            { RAPIDJSON_ASSERT(IsObject()); Unshare(); return MemberIterator(GetMembersPointer()); }
     //! \em Past-the-end member iterator
     /*! \pre IsObject() == true */
-    MemberIterator MemberEnd()              { RAPIDJSON_ASSERT(IsObject()); return MemberIterator(GetMembersPointer() + data_.o.size); }
+    MemberIterator MemberEnd()              { RAPIDJSON_ASSERT(IsObject()); Unshare(); return MemberIterator(GetMembersPointer() + data_.o.size); }
 
     //! Check whether a member exists in the object.
     /*!
@@ -1186,7 +1201,10 @@ public:
         return FindMember(n);
     }
 
-    ConstMemberIterator FindMember(const Ch* name) const { return const_cast<GenericValue&>(*this).FindMember(name); }
+    ConstMemberIterator FindMember(const Ch* name) const {
+        GenericValue n(StringRef(name));
+        return FindMember(n);
+    }
 
     //! Find member by name.
     /*!
@@ -1203,15 +1221,10 @@ public:
     */
     template <typename SourceAllocator>
     MemberIterator FindMember(const GenericValue<Encoding, SourceAllocator>& name) {
-        RAPIDJSON_ASSERT(IsObject());
-        RAPIDJSON_ASSERT(name.IsString());
-        MemberIterator member = MemberBegin();
-        for ( ; member != MemberEnd(); ++member)
-            if (name.StringEqual(member->name))
-                break;
-        return member;
+        Unshare();
+        return MemberIterator(const_cast<Member*>(DoFindMember(name)));
     }
-    template <typename SourceAllocator> ConstMemberIterator FindMember(const GenericValue<Encoding, SourceAllocator>& name) const { return const_cast<GenericValue&>(*this).FindMember(name); }
+    template <typename SourceAllocator> ConstMemberIterator FindMember(const GenericValue<Encoding, SourceAllocator>& name) const { return ConstMemberIterator(DoFindMember(name)); }
 
 #if RAPIDJSON_HAS_STDSTRING
     //! Find member by string object name.
@@ -1238,6 +1251,7 @@ public:
     GenericValue& AddMember(GenericValue& name, GenericValue& value, Allocator& allocator) {
         RAPIDJSON_ASSERT(IsObject());
         RAPIDJSON_ASSERT(name.IsString());
+        Unshare();
 
         ObjectData& o = data_.o;
         if (o.size >= o.capacity) {
@@ -1255,6 +1269,7 @@ public:
         members[o.size].name.RawAssign(name);
         members[o.size].value.RawAssign(value);
         o.size++;
+        data_.f.flags = kObjectFlag;
         return *this;
     }
 
@@ -1436,8 +1451,10 @@ public:
         RAPIDJSON_ASSERT(m >= MemberBegin() && m < MemberEnd());
 
         MemberIterator last(GetMembersPointer() + (data_.o.size - 1));
-        if (data_.o.size > 1 && m != last)
+        if (data_.o.size > 1 && m != last) {
             *m = *last; // Move the last one to this place
+            data_.f.flags = kObjectFlag;
+        }
         else
             m->~Member(); // Only one left, just destroy
         --data_.o.size;
@@ -1470,14 +1487,16 @@ public:
         RAPIDJSON_ASSERT(IsObject());
         RAPIDJSON_ASSERT(data_.o.size > 0);
         RAPIDJSON_ASSERT(GetMembersPointer() != 0);
-        RAPIDJSON_ASSERT(first >= MemberBegin());
+        const ConstMemberIterator begin = static_cast<const GenericValue&>(*this).MemberBegin(); // first and last may refer to shared members
+        RAPIDJSON_ASSERT(first >= begin);
         RAPIDJSON_ASSERT(first <= last);
-        RAPIDJSON_ASSERT(last <= MemberEnd());
+        RAPIDJSON_ASSERT(last <= begin + data_.o.size);
 
-        MemberIterator pos = MemberBegin() + (first - MemberBegin());
-        for (MemberIterator itr = pos; itr != last; ++itr)
+        MemberIterator pos = MemberBegin() + (first - begin);
+        MemberIterator end = pos + (last - first);
+        for (MemberIterator itr = pos; itr != end; ++itr)
             itr->~Member();
-        std::memmove(&*pos, &*last, static_cast<size_t>(MemberEnd() - last) * sizeof(Member));
+        std::memmove(&*pos, &*end, static_cast<size_t>(MemberEnd() - end) * sizeof(Member));
         data_.o.size -= static_cast<SizeType>(last - first);
         return pos;
     }
@@ -1534,6 +1553,7 @@ public:
     */
     void Clear() {
         RAPIDJSON_ASSERT(IsArray()); 
+        Unshare();
         GenericValue* e = GetElementsPointer();
         for (GenericValue* v = e; v != e + data_.a.size; ++v)
             v->~GenericValue();
@@ -1548,22 +1568,27 @@ public:
     GenericValue& operator[](SizeType index) {
         RAPIDJSON_ASSERT(IsArray());
         RAPIDJSON_ASSERT(index < data_.a.size);
+        Unshare();
         return GetElementsPointer()[index];
     }
-    const GenericValue& operator[](SizeType index) const { return const_cast<GenericValue&>(*this)[index]; }
+    const GenericValue& operator[](SizeType index) const {
+        RAPIDJSON_ASSERT(IsArray());
+        RAPIDJSON_ASSERT(index < data_.a.size);
+        return GetConstElementsPointer()[index];
+    }
 
     //! Element iterator
     /*! \pre IsArray() == true */
-    ValueIterator Begin() { RAPIDJSON_ASSERT(IsArray()); return GetElementsPointer(); }
+    ValueIterator Begin() { RAPIDJSON_ASSERT(IsArray()); Unshare(); return GetElementsPointer(); }
     //! \em Past-the-end element iterator
     /*! \pre IsArray() == true */
-    ValueIterator End() { RAPIDJSON_ASSERT(IsArray()); return GetElementsPointer() + data_.a.size; }
+    ValueIterator End() { RAPIDJSON_ASSERT(IsArray()); Unshare(); return GetElementsPointer() + data_.a.size; }
     //! Constant element iterator
     /*! \pre IsArray() == true */
-    ConstValueIterator Begin() const { return const_cast<GenericValue&>(*this).Begin(); }
+    ConstValueIterator Begin() const { RAPIDJSON_ASSERT(IsArray()); return GetConstElementsPointer(); }
     //! Constant \em past-the-end element iterator
     /*! \pre IsArray() == true */
-    ConstValueIterator End() const { return const_cast<GenericValue&>(*this).End(); }
+    ConstValueIterator End() const { RAPIDJSON_ASSERT(IsArray()); return GetConstElementsPointer() + data_.a.size; }
 
     //! Request the array to have enough capacity to store elements.
     /*! \param newCapacity  The capacity that the array at least need to have.
@@ -1573,6 +1598,7 @@ public:
     */
     GenericValue& Reserve(SizeType newCapacity, Allocator &allocator) {
         RAPIDJSON_ASSERT(IsArray());
+        Unshare();
         if (newCapacity > data_.a.capacity) {
             SetElementsPointer(reinterpret_cast<GenericValue*>(allocator.Realloc(GetElementsPointer(), data_.a.capacity * sizeof(GenericValue), newCapacity * sizeof(GenericValue))));
             data_.a.capacity = newCapacity;
@@ -1592,6 +1618,7 @@ public:
     */
     GenericValue& PushBack(GenericValue& value, Allocator& allocator) {
         RAPIDJSON_ASSERT(IsArray());
+        Unshare();
         if (data_.a.size >= data_.a.capacity)
             Reserve(data_.a.capacity == 0 ? kDefaultArrayCapacity : (data_.a.capacity + (data_.a.capacity + 1) / 2), allocator);
         GetElementsPointer()[data_.a.size++].RawAssign(value);
@@ -1648,6 +1675,7 @@ public:
     GenericValue& PopBack() {
         RAPIDJSON_ASSERT(IsArray());
         RAPIDJSON_ASSERT(!Empty());
+        Unshare();
         GetElementsPointer()[--data_.a.size].~GenericValue();
         return *this;
     }
@@ -1675,13 +1703,15 @@ public:
         RAPIDJSON_ASSERT(IsArray());
         RAPIDJSON_ASSERT(data_.a.size > 0);
         RAPIDJSON_ASSERT(GetElementsPointer() != 0);
-        RAPIDJSON_ASSERT(first >= Begin());
+        const ConstValueIterator begin = static_cast<const GenericValue&>(*this).Begin(); // first and last may refer to shared elements
+        RAPIDJSON_ASSERT(first >= begin);
         RAPIDJSON_ASSERT(first <= last);
-        RAPIDJSON_ASSERT(last <= End());
-        ValueIterator pos = Begin() + (first - Begin());
-        for (ValueIterator itr = pos; itr != last; ++itr)
+        RAPIDJSON_ASSERT(last <= begin + data_.a.size);
+        ValueIterator pos = Begin() + (first - begin);
+        ValueIterator end = pos + (last - first);
+        for (ValueIterator itr = pos; itr != end; ++itr)
             itr->~GenericValue();       
-        std::memmove(pos, last, static_cast<size_t>(End() - last) * sizeof(GenericValue));
+        std::memmove(pos, end, static_cast<size_t>(End() - end) * sizeof(GenericValue));
         data_.a.size -= static_cast<SizeType>(last - first);
         return pos;
     }
@@ -1871,6 +1901,8 @@ private:
         kStringFlag     = 0x0400,
         kCopyFlag       = 0x0800,
         kInlineStrFlag  = 0x1000,
+        kSortedFlag     = 0x2000,   //!< Object whose members are sorted by name
+        kSharedFlag     = 0x4000,   //!< Array or object whose children, or string whose characters, are borrowed from a shared subtree
 
         // Initial flags of different types.
         kNullFlag = kNullType,
@@ -1884,6 +1916,7 @@ private:
         kNumberAnyFlag = kNumberType | kNumberFlag | kIntFlag | kInt64Flag | kUintFlag | kUint64Flag | kDoubleFlag,
         kConstStringFlag = kStringType | kStringFlag,
         kCopyStringFlag = kStringType | kStringFlag | kCopyFlag,
+        kBorrowedStringFlag = kStringType | kStringFlag | kSharedFlag,  //!< Neither freed nor referenced by copies
         kShortStringFlag = kStringType | kStringFlag | kCopyFlag | kInlineStrFlag,
         kObjectFlag = kObjectType,
         kArrayFlag = kArrayType,
@@ -1982,6 +2015,88 @@ private:
     RAPIDJSON_FORCEINLINE Member* GetMembersPointer() const { return RAPIDJSON_GETPOINTER(Member, data_.o.members); }
     RAPIDJSON_FORCEINLINE Member* SetMembersPointer(Member* members) { return RAPIDJSON_SETPOINTER(Member, data_.o.members, members); }
 
+    // Children for const access, which may be borrowed from a shared subtree. Non-const
+    // access calls Unshare() first, and then uses GetElementsPointer() and GetMembersPointer().
+    RAPIDJSON_FORCEINLINE const GenericValue* GetConstElementsPointer() const {
+        return RAPIDJSON_UNLIKELY(data_.f.flags & kSharedFlag) ? static_cast<const GenericValue*>(GetSharedPointer()->children) : GetElementsPointer();
+    }
+    RAPIDJSON_FORCEINLINE const Member* GetConstMembersPointer() const {
+        return RAPIDJSON_UNLIKELY(data_.f.flags & kSharedFlag) ? static_cast<const Member*>(GetSharedPointer()->children) : GetMembersPointer();
+    }
+
+    //! What the pointer of an array or object with kSharedFlag refers to.
+    struct SharedData {
+        Allocator* allocator;   //!< Allocator of the document, for copying the children on write
+        void* children;         //!< Elements or members in the shared subtree
+    };
+
+    SharedData* GetSharedPointer() const { return reinterpret_cast<SharedData*>(RAPIDJSON_GETPOINTER(GenericValue, data_.a.elements)); }
+
+    // Makes a bitwise copy of a value of a shared subtree refer to it: a non-empty
+    // container borrows its children until it is written, a string its characters.
+    void SetSharedRaw(Allocator& allocator) {
+        if (IsArray() || IsObject()) {
+            RAPIDJSON_ASSERT(!(data_.f.flags & kSharedFlag));
+            if (data_.a.size == 0) {    // Same layout for ArrayData and ObjectData
+                data_.a.capacity = 0;
+                SetElementsPointer(0);
+                return;
+            }
+            SharedData* shared = static_cast<SharedData*>(allocator.Malloc(sizeof(SharedData)));
+            shared->allocator = &allocator;
+            shared->children = GetElementsPointer();
+            data_.f.flags = static_cast<uint16_t>(data_.f.flags | kSharedFlag);
+            SetElementsPointer(reinterpret_cast<GenericValue*>(shared));
+        }
+        else if (data_.f.flags == kCopyStringFlag)
+            data_.f.flags = kBorrowedStringFlag;
+    }
+
+    // Copies the borrowed children of a container before it is written, one level only.
+    RAPIDJSON_FORCEINLINE void Unshare() {
+        if (RAPIDJSON_UNLIKELY(data_.f.flags & kSharedFlag))
+            DoUnshare();
+    }
+
+    void DoUnshare() {
+        SharedData* shared = GetSharedPointer();
+        Allocator& allocator = *shared->allocator;
+        const SizeType count = IsArray() ? data_.a.size : data_.o.size * 2;
+        GenericValue* children = static_cast<GenericValue*>(allocator.Malloc(count * sizeof(GenericValue)));
+        std::memcpy(static_cast<void*>(children), shared->children, count * sizeof(GenericValue));
+        for (SizeType i = 0; i < count; i++)
+            children[i].SetSharedRaw(allocator);
+        Allocator::Free(shared);
+        data_.f.flags = static_cast<uint16_t>(data_.f.flags & ~kSharedFlag);
+        data_.a.capacity = data_.a.size;    // Same layout for ArrayData and ObjectData
+        SetElementsPointer(children);
+    }
+
+    template <typename SourceAllocator>
+    const Member* DoFindMember(const GenericValue<Encoding, SourceAllocator>& name) const {
+        RAPIDJSON_ASSERT(IsObject());
+        RAPIDJSON_ASSERT(name.IsString());
+        const Member* first = GetConstMembersPointer();
+        const Member* const last = first + data_.o.size;
+        if (data_.f.flags & kSortedFlag) {
+            // Binary search of the first member whose name is not less than the one searched
+            for (SizeType count = data_.o.size; count > 0;) {
+                const SizeType half = count / 2;
+                if (first[half].name.StringCompare(name) < 0) {
+                    first += half + 1;
+                    count -= half + 1;
+                }
+                else
+                    count = half;
+            }
+            return (first != last && name.StringEqual(first->name)) ? first : last;
+        }
+        for ( ; first != last; ++first)
+            if (name.StringEqual(first->name))
+                break;
+        return first;
+    }
+
     // Initialize this value as array with initial data, without calling destructor.
     void SetArrayRaw(GenericValue* values, SizeType count, Allocator& allocator) {
         data_.f.flags = kArrayFlag;
@@ -2055,12 +2170,120 @@ private:
         return (std::memcmp(str1, str2, sizeof(Ch) * len1) == 0);
     }
 
+    //! Lexicographic comparison by code units, the order of the members of sorted objects.
+    template <typename SourceAllocator>
+    int StringCompare(const GenericValue<Encoding, SourceAllocator>& rhs) const {
+        RAPIDJSON_ASSERT(IsString());
+        RAPIDJSON_ASSERT(rhs.IsString());
+
+        const SizeType len1 = GetStringLength();
+        const SizeType len2 = rhs.GetStringLength();
+        const Ch* const str1 = GetString();
+        const Ch* const str2 = rhs.GetString();
+        const SizeType len = len1 < len2 ? len1 : len2;
+        for (SizeType i = 0; i < len; i++)
+            if (str1[i] != str2[i])
+                return static_cast<unsigned>(str1[i]) < static_cast<unsigned>(str2[i]) ? -1 : 1;
+        return len1 < len2 ? -1 : (len1 > len2 ? 1 : 0);
+    }
+
     Data data_;
 };
 
 //! GenericValue with UTF8 encoding
 typedef GenericValue<UTF8<> > Value;
 
+///////////////////////////////////////////////////////////////////////////////
+// GenericSharedValue
+
+//! An immutable subtree which many documents can refer to without copying it.
+/*! The subtree is copied once, strings included, into memory of its own which is
+    reference-counted. GenericDocument::Attach() makes a value of a document refer to it
+    in constant time, the document keeping the subtree alive until it is destroyed.
+
+    An array or object of the subtree is copied into the document lazily, one level at a
+    time, when it is accessed through a non-const member function such as operator[],
+    FindMember(), MemberBegin(), Begin() or PushBack(). Its children are then borrowed in
+    turn. Const member functions never copy.
+
+    \code
+    SharedValue headers(config["headers"]);
+    for (...) {
+        Document d;
+        d.SetObject();
+        Value h;
+        d.AddMember("headers", d.Attach(h, headers), d.GetAllocator());
+        ...
+    }
+    \endcode
+
+    \tparam Encoding Encoding of the subtree.
+    \tparam Allocator Allocator of the documents which the subtree is attached to. The
+        subtree uses one of its own.
+
+    \note The reference count is atomic in C++11 only. Otherwise copies of a shared value
+        and documents which it is attached to must be used by a single thread.
+*/
+template <typename Encoding, typename Allocator = MemoryPoolAllocator<> >
+class GenericSharedValue {
+public:
+    typedef GenericValue<Encoding, Allocator> ValueType;    //!< Value type of the subtree.
+
+    //! Copy a value into a new shared subtree.
+    template <typename SourceAllocator>
+    explicit GenericSharedValue(const GenericValue<Encoding, SourceAllocator>& value) : shared_(RAPIDJSON_NEW(Shared)()) {
+        shared_->value.CopyFrom(value, shared_->allocator, true);
+    }
+
+    //! Refer to the same subtree.
+    GenericSharedValue(const GenericSharedValue& rhs) : shared_(rhs.shared_) { ++shared_->count; }
+
+    //! Refer to the same subtree as \c rhs.
+    GenericSharedValue& operator=(const GenericSharedValue& rhs) {
+        ++rhs.shared_->count;
+        Release(shared_);
+        shared_ = rhs.shared_;
+        return *this;
+    }
+
+    ~GenericSharedValue() { Release(shared_); }
+
+    //! Root of the subtree.
+    const ValueType& Get() const { return shared_->value; }
+
+    //! Number of shared values and documents referring to the subtree.
+    unsigned UseCount() const { return shared_->count; }
+
+private:
+    template <typename, typename, typename> friend class GenericDocument;
+
+    struct Shared {
+        Shared() : count(1), allocator(), value() {}
+
+#if RAPIDJSON_HAS_CXX11_RVALUE_REFS
+        std::atomic<unsigned> count;
+#else
+        unsigned count;
+#endif
+        Allocator allocator;
+        ValueType value;
+
+    private:
+        Shared(const Shared&);
+        Shared& operator=(const Shared&);
+    };
+
+    static void Release(Shared* shared) {
+        if (--shared->count == 0)
+            RAPIDJSON_DELETE(shared);
+    }
+
+    Shared* shared_;
+};
+
+//! GenericSharedValue with UTF8 encoding
+typedef GenericSharedValue<UTF8<> > SharedValue;
+
 ///////////////////////////////////////////////////////////////////////////////
 // GenericDocument 
 
@@ -2078,6 +2301,7 @@ public:
     typedef typename Encoding::Ch Ch;                       //!< Character type derived from Encoding.
     typedef GenericValue<Encoding, Allocator> ValueType;    //!< Value type of the document.
     typedef Allocator AllocatorType;                        //!< Allocator type from template parameter.
+    typedef GenericSharedValue<Encoding, Allocator> SharedValueType;    //!< Shared subtree type which can be attached to the document.
 
     //! Constructor
     /*! Creates an empty document of specified type.
@@ -2087,7 +2311,8 @@ public:
         \param stackAllocator   Optional allocator for allocating memory for stack.
     */
     explicit GenericDocument(Type type, Allocator* allocator = 0, size_t stackCapacity = kDefaultStackCapacity, StackAllocator* stackAllocator = 0) :
-        GenericValue<Encoding, Allocator>(type),  allocator_(allocator), ownAllocator_(0), stack_(stackAllocator, stackCapacity), parseResult_()
+        GenericValue<Encoding, Allocator>(type),  allocator_(allocator), ownAllocator_(0), stack_(stackAllocator, stackCapacity), parseResult_(), sharedRefs_(0),
+        internTable_(stackAllocator, 0), internCount_(0), internKeys_(false), sortKeys_(false)
     {
         if (!allocator_)
             ownAllocator_ = allocator_ = RAPIDJSON_NEW(Allocator)();
@@ -2100,7 +2325,8 @@ public:
         \param stackAllocator   Optional allocator for allocating memory for stack.
     */
     GenericDocument(Allocator* allocator = 0, size_t stackCapacity = kDefaultStackCapacity, StackAllocator* stackAllocator = 0) : 
-        allocator_(allocator), ownAllocator_(0), stack_(stackAllocator, stackCapacity), parseResult_()
+        allocator_(allocator), ownAllocator_(0), stack_(stackAllocator, stackCapacity), parseResult_(), sharedRefs_(0),
+        internTable_(stackAllocator, 0), internCount_(0), internKeys_(false), sortKeys_(false)
     {
         if (!allocator_)
             ownAllocator_ = allocator_ = RAPIDJSON_NEW(Allocator)();
@@ -2113,11 +2339,17 @@ public:
           allocator_(rhs.allocator_),
           ownAllocator_(rhs.ownAllocator_),
           stack_(std::move(rhs.stack_)),
-          parseResult_(rhs.parseResult_)
+          parseResult_(rhs.parseResult_),
+          sharedRefs_(rhs.sharedRefs_),
+          internTable_(std::move(rhs.internTable_)),
+          internCount_(0),
+          internKeys_(false),
+          sortKeys_(false)
     {
         rhs.allocator_ = 0;
         rhs.ownAllocator_ = 0;
         rhs.parseResult_ = ParseResult();
+        rhs.sharedRefs_ = 0;
     }
 #endif
 
@@ -2140,10 +2372,13 @@ public:
         ownAllocator_ = rhs.ownAllocator_;
         stack_ = std::move(rhs.stack_);
         parseResult_ = rhs.parseResult_;
+        sharedRefs_ = rhs.sharedRefs_;
+        internTable_ = std::move(rhs.internTable_);
 
         rhs.allocator_ = 0;
         rhs.ownAllocator_ = 0;
         rhs.parseResult_ = ParseResult();
+        rhs.sharedRefs_ = 0;
 
         return *this;
     }
@@ -2161,6 +2396,8 @@ public:
         internal::Swap(allocator_, rhs.allocator_);
         internal::Swap(ownAllocator_, rhs.ownAllocator_);
         internal::Swap(parseResult_, rhs.parseResult_);
+        internal::Swap(sharedRefs_, rhs.sharedRefs_);
+        internTable_.Swap(rhs.internTable_);
         return *this;
     }
 
@@ -2193,6 +2430,171 @@ public:
         return *this;
     }
 
+    //! Make a value of this document refer to a shared subtree, without copying it.
+    /*! \param value Value of this document, which is replaced by the root of the subtree.
+        \param shared Shared subtree, kept alive until the document is destroyed.
+        \return \c value for fluent API.
+        \see GenericSharedValue
+    */
+    ValueType& Attach(ValueType& value, const SharedValueType& shared) {
+        SharedRef* ref = sharedRefs_;
+        while (ref && ref->shared != shared.shared_)
+            ref = ref->next;
+        if (!ref) {
+            ref = static_cast<SharedRef*>(allocator_->Malloc(sizeof(SharedRef)));
+            ref->shared = shared.shared_;
+            ref->next = sharedRefs_;
+            sharedRefs_ = ref;
+            ++shared.shared_->count;
+        }
+
+        ValueType root;
+        root.data_ = shared.Get().data_;
+        root.SetSharedRaw(*allocator_);
+        return value = root;
+    }
+
+    //! Sort the members of all the objects of the document by name.
+    /*! Names are compared by code units, as StringCompare() does, and duplicated names keep
+        their order. The objects are marked as sorted so that FindMember() uses a binary search,
+        without the memory of an index. Accept() then emits the members in this canonical
+        order, giving the same text for documents with the same members in any order.
+
+        Parsing with \ref kParseSortKeysFlag sorts the objects as they are parsed. Adding a
+        member, or removing one with RemoveMember(), turns an object back to a linear search.
+        Names must not be changed through the iterators of a sorted object.
+
+        Attached shared subtrees are copied into the document, as they are modified.
+        \return The document itself for fluent API.
+    */
+    GenericDocument& SortMembers() {
+        ClearStackOnExit scope(*this);
+
+        // The stack is used as a queue of the containers, as in Freeze()
+        if (this->IsObject() || this->IsArray())
+            *stack_.template Push<ValueType*>() = this;
+        for (size_t i = 0; i < stack_.GetSize() / sizeof(ValueType*); i++) {
+            ValueType& v = *stack_.template Bottom<ValueType*>()[i];
+            if (v.IsArray()) {
+                for (typename ValueType::ValueIterator e = v.Begin(); e != v.End(); ++e)
+                    if (e->IsObject() || e->IsArray())
+                        *stack_.template Push<ValueType*>() = e;
+                continue;
+            }
+            v.Unshare();
+            if (!(v.data_.f.flags & ValueType::kSortedFlag)) {
+                v.data_.f.flags = ValueType::kObjectFlag | ValueType::kSortedFlag;
+                SortMembersRaw(v.GetMembersPointer(), v.data_.o.size);
+            }
+            for (typename ValueType::MemberIterator m = v.MemberBegin(); m != v.MemberEnd(); ++m)
+                if (m->value.IsObject() || m->value.IsArray())
+                    *stack_.template Push<ValueType*>() = &m->value;
+        }
+        stack_.Clear();     // The queue holds pointers, not values to be destroyed by ClearStack()
+        return *this;
+    }
+
+    //! Re-lay the tree into one contiguous block, for fast and concurrent reading.
+    /*! The elements and members of all arrays and objects are copied breadth-first into a
+        single block aligned on a cache line, so that the children of a container are
+        consecutive and close to those of its siblings. The strings of the children that
+        are shorter than a cache line follow them, the longer ones are at the end of the
+        block, and strings which fit are stored inline as short strings.
+
+        The members of each object are sorted by name, keeping the order of duplicates, and
+        the object is marked as sorted so that FindMember() uses a binary search. Adding a
+        member, or removing one with RemoveMember(), turns it back to a linear search.
+        Names must not be changed through the iterators of a frozen object.
+
+        If the document owns its allocator, the block is made with a new allocator and the
+        memory of the previous tree is released. Otherwise the previous tree stays in the
+        user allocator until it is cleared. Attached shared subtrees are copied into the
+        block and released.
+
+        As for any document, const member functions do not modify a frozen document, so it
+        can be read from many threads at the same time.
+
+        \note It requires an allocator which does not need Free(), such as MemoryPoolAllocator.
+        \return The document itself for fluent API.
+    */
+    GenericDocument& Freeze() {
+        RAPIDJSON_STATIC_ASSERT(!Allocator::kNeedFree);
+        ClearStackOnExit scope(*this);
+
+        // The stack is used as a queue of the containers in breadth-first order
+        size_t nearSize = 0, farSize = 0;
+        FreezeMeasure(this, 1, nearSize, farSize);
+        if (this->IsObject() || this->IsArray())
+            *stack_.template Push<ValueType*>() = this;
+        for (size_t i = 0; i < stack_.GetSize() / sizeof(ValueType*); i++) {
+            const ValueType& v = *stack_.template Bottom<ValueType*>()[i];
+            const SizeType count = FreezeChildCount(v);
+            const ValueType* children = FreezeChildren(v);
+            nearSize += RAPIDJSON_ALIGN(count * sizeof(ValueType));
+            FreezeMeasure(children, count, nearSize, farSize);
+            for (SizeType c = 0; c < count; c++)
+                if (children[c].IsObject() || children[c].IsArray())
+                    *stack_.template Push<ValueType*>() = const_cast<ValueType*>(&children[c]);    // Only read by this pass
+        }
+        stack_.Clear();
+
+        Allocator* allocator = ownAllocator_ ? RAPIDJSON_NEW(Allocator)() : allocator_;
+        char* block = 0;
+        if (nearSize + farSize > 0) {
+            const uintptr_t p = reinterpret_cast<uintptr_t>(allocator->Malloc(nearSize + farSize + kFreezeAlignment - 1));
+            block = reinterpret_cast<char*>((p + kFreezeAlignment - 1) & ~static_cast<uintptr_t>(kFreezeAlignment - 1));
+        }
+        char* near = block;
+        char* far = block + nearSize;
+        FreezeStrings(this, 1, near, far);
+
+        if (this->IsObject() || this->IsArray())
+            *stack_.template Push<ValueType*>() = this;
+        for (size_t i = 0; i < stack_.GetSize() / sizeof(ValueType*); i++) {
+            ValueType& v = *stack_.template Bottom<ValueType*>()[i];
+            const SizeType count = FreezeChildCount(v);
+            // An empty container gets no children, its previous ones may be in a released allocator
+            ValueType* children = count ? reinterpret_cast<ValueType*>(near) : 0;
+            if (v.IsArray()) {
+                if (count)
+                    std::memcpy(static_cast<void*>(children), v.GetConstElementsPointer(), count * sizeof(ValueType));
+                v.SetElementsPointer(children);
+                v.data_.a.capacity = v.data_.a.size;
+                v.data_.f.flags = ValueType::kArrayFlag;
+            }
+            else {
+                // Sort pointers to the members, which are then moved in that order
+                typedef typename ValueType::Member Member;
+                const Member* members = v.GetConstMembersPointer();
+                const SizeType memberCount = v.data_.o.size;
+                const Member** sorted = stack_.template Push<const Member*>(memberCount);
+                for (SizeType m = 0; m < memberCount; m++)
+                    sorted[m] = &members[m];
+                std::stable_sort(sorted, sorted + memberCount, MemberNameLess);
+                for (SizeType m = 0; m < memberCount; m++)
+                    std::memcpy(static_cast<void*>(reinterpret_cast<Member*>(children) + m), sorted[m], sizeof(Member));
+                stack_.template Pop<const Member*>(memberCount);
+                v.SetMembersPointer(reinterpret_cast<Member*>(children));
+                v.data_.o.capacity = memberCount;
+                v.data_.f.flags = ValueType::kObjectFlag | ValueType::kSortedFlag;
+            }
+            near += RAPIDJSON_ALIGN(count * sizeof(ValueType));
+            FreezeStrings(children, count, near, far);
+            for (SizeType c = 0; c < count; c++)
+                if (children[c].IsObject() || children[c].IsArray())
+                    *stack_.template Push<ValueType*>() = &children[c];
+        }
+        RAPIDJSON_ASSERT(near == block + nearSize);
+        RAPIDJSON_ASSERT(far == block + nearSize + farSize);
+        ReleaseShared();    // Nothing refers to the shared subtrees any more
+
+        if (ownAllocator_) {
+            RAPIDJSON_DELETE(ownAllocator_);
+            ownAllocator_ = allocator_ = allocator;
+        }
+        return *this;
+    }
+
     //!@name Parse from stream
     //!@{
 
@@ -2208,6 +2610,8 @@ public:
         GenericReader<SourceEncoding, Encoding, StackAllocator> reader(
             stack_.HasAllocator() ? &stack_.GetAllocator() : 0);
         ClearStackOnExit scope(*this);
+        internKeys_ = !Allocator::kNeedFree && (parseFlags & kParseInternKeysFlag) != 0;
+        sortKeys_ = (parseFlags & kParseSortKeysFlag) != 0;
         parseResult_ = reader.template Parse<parseFlags>(is, *this);
         if (parseResult_) {
             RAPIDJSON_ASSERT(stack_.GetSize() == sizeof(ValueType)); // Got one and only one root object
@@ -2408,11 +2812,20 @@ public:
 
     bool StartObject() { new (stack_.template Push<ValueType>()) ValueType(kObjectType); return true; }
     
-    bool Key(const Ch* str, SizeType length, bool copy) { return String(str, length, copy); }
+    bool Key(const Ch* str, SizeType length, bool copy) {
+        if (internKeys_ && copy && !ValueType::ShortString::Usable(length))
+            return InternKey(str, length);
+        return String(str, length, copy);
+    }
 
     bool EndObject(SizeType memberCount) {
         typename ValueType::Member* members = stack_.template Pop<typename ValueType::Member>(memberCount);
-        stack_.template Top<ValueType>()->SetObjectRaw(members, memberCount, GetAllocator());
+        ValueType* object = stack_.template Top<ValueType>();
+        object->SetObjectRaw(members, memberCount, GetAllocator());
+        if (sortKeys_) {
+            object->data_.f.flags = ValueType::kObjectFlag | ValueType::kSortedFlag;
+            SortMembersRaw(object->GetMembersPointer(), memberCount);   // May move the stack, not the members
+        }
         return true;
     }
 
@@ -2437,17 +2850,183 @@ private:
         else
             stack_.Clear();
         stack_.ShrinkToFit();
+        internTable_.Clear();
+        internTable_.ShrinkToFit();
+        internCount_ = 0;
+        internKeys_ = false;
+        sortKeys_ = false;
+    }
+
+    //! A key stored once in the allocator for kParseInternKeysFlag.
+    struct InternedKey {
+        const Ch* str;
+        SizeType length;
+        uint32_t hash;
+    };
+
+    static const size_t kDefaultInternCapacity = 64;    //!< Initial number of slots of the table of interned keys
+
+    // Pushes a key referencing the stored copy of the equal keys, making that copy at first.
+    bool InternKey(const Ch* str, SizeType length) {
+        uint32_t hash = 2166136261u;    // FNV-1a
+        for (SizeType i = 0; i < length; i++)
+            hash = (hash ^ static_cast<uint32_t>(str[i])) * 16777619u;
+
+        if (internCount_ * 2 >= internTable_.GetSize() / sizeof(InternedKey))
+            GrowInternTable();
+        InternedKey* table = internTable_.template Bottom<InternedKey>();
+        const size_t mask = internTable_.GetSize() / sizeof(InternedKey) - 1;
+        size_t i = hash & mask;
+        for (; table[i].str; i = (i + 1) & mask)
+            if (table[i].hash == hash && table[i].length == length && std::memcmp(table[i].str, str, length * sizeof(Ch)) == 0)
+                break;
+        if (!table[i].str) {
+            Ch* copy = static_cast<Ch*>(allocator_->Malloc((length + 1) * sizeof(Ch)));
+            std::memcpy(copy, str, length * sizeof(Ch));
+            copy[length] = '\0';
+            table[i].str = copy;
+            table[i].length = length;
+            table[i].hash = hash;
+            internCount_++;
+        }
+        // A copy-string owned by the document, so that CopyFrom() copies it. Values referencing
+        // the same characters are never freed one by one, as the allocator does not need Free().
+        ValueType* key = new (stack_.template Push<ValueType>()) ValueType(StringRef(table[i].str, length));
+        key->data_.f.flags = ValueType::kCopyStringFlag;
+        return true;
+    }
+
+    // Doubles the open-addressing table, rehashing into new slots pushed above the old ones.
+    void GrowInternTable() {
+        const size_t oldCapacity = internTable_.GetSize() / sizeof(InternedKey);
+        const size_t capacity = oldCapacity ? oldCapacity * 2 : kDefaultInternCapacity;
+        internTable_.template Push<InternedKey>(capacity);
+        InternedKey* oldTable = internTable_.template Bottom<InternedKey>();
+        InternedKey* table = oldTable + oldCapacity;
+        std::memset(static_cast<void*>(table), 0, capacity * sizeof(InternedKey));
+        for (size_t i = 0; i < oldCapacity; i++)
+            if (oldTable[i].str) {
+                size_t j = oldTable[i].hash & (capacity - 1);
+                while (table[j].str)
+                    j = (j + 1) & (capacity - 1);
+                table[j] = oldTable[i];
+            }
+        std::memmove(static_cast<void*>(oldTable), table, capacity * sizeof(InternedKey));
+        internTable_.template Pop<InternedKey>(oldCapacity);
     }
 
     void Destroy() {
+        ReleaseShared();
         RAPIDJSON_DELETE(ownAllocator_);
     }
 
+    //! A shared subtree attached to the document.
+    struct SharedRef {
+        typename SharedValueType::Shared* shared;
+        SharedRef* next;
+    };
+
+    void ReleaseShared() {
+        while (sharedRefs_) {
+            SharedRef* next = sharedRefs_->next;
+            SharedValueType::Release(sharedRefs_->shared);
+            Allocator::Free(sharedRefs_);
+            sharedRefs_ = next;
+        }
+    }
+
+    // Sort members by name in place, keeping the order of duplicates, with the stack as scratch.
+    void SortMembersRaw(typename ValueType::Member* members, SizeType count) {
+        typedef typename ValueType::Member Member;
+        if (count < 2)
+            return;
+        stack_.template Reserve<char>(count * (sizeof(Member) + sizeof(const Member*)));
+        Member* copy = stack_.template PushUnsafe<Member>(count);
+        const Member** sorted = stack_.template PushUnsafe<const Member*>(count);
+        for (SizeType m = 0; m < count; m++)
+            sorted[m] = &members[m];
+        std::stable_sort(sorted, sorted + count, MemberNameLess);
+        std::memcpy(static_cast<void*>(copy), members, count * sizeof(Member));
+        for (SizeType m = 0; m < count; m++)
+            std::memcpy(static_cast<void*>(&members[m]), &copy[sorted[m] - members], sizeof(Member));
+        stack_.template Pop<const Member*>(count);
+        stack_.template Pop<Member>(count);
+    }
+
+    static const size_t kFreezeAlignment = 64;         //!< Alignment of the block made by Freeze(), a cache line
+    static const size_t kFreezeNearStringSize = 64;    //!< Strings up to this size in bytes are kept next to their owners by Freeze()
+
+    // Number of values in the children of a container, names and values counting separately in objects.
+    static SizeType FreezeChildCount(const ValueType& v) { return v.IsArray() ? v.data_.a.size : 2 * v.data_.o.size; }
+
+    // Children of a container, members being pairs of values.
+    static const ValueType* FreezeChildren(const ValueType& v) {
+        return v.IsArray() ? v.GetConstElementsPointer() : reinterpret_cast<const ValueType*>(v.GetConstMembersPointer());
+    }
+
+    static bool MemberNameLess(const typename ValueType::Member* a, const typename ValueType::Member* b) {
+        return a->name.StringCompare(b->name) < 0;
+    }
+
+    // Size in bytes of a string which Freeze() stores out of its value, 0 otherwise.
+    static size_t FreezeStringSize(const ValueType& v) {
+        if (!v.IsString() || (v.data_.f.flags & ValueType::kInlineStrFlag) || ValueType::ShortString::Usable(v.data_.s.length))
+            return 0;
+        return (v.data_.s.length + 1) * sizeof(Ch);
+    }
+
+    // Adds the space taken by the strings of consecutive values, next to them or at the end of the block.
+    static void FreezeMeasure(const ValueType* values, SizeType count, size_t& nearSize, size_t& farSize) {
+        size_t size = 0;
+        for (SizeType i = 0; i < count; i++) {
+            const size_t bytes = FreezeStringSize(values[i]);
+            if (bytes <= kFreezeNearStringSize)
+                size += bytes;
+            else
+                farSize += bytes;
+        }
+        nearSize += RAPIDJSON_ALIGN(size);
+    }
+
+    // Moves the strings of consecutive values next to them, to the end of the block, or inline.
+    static void FreezeStrings(ValueType* values, SizeType count, char*& near, char*& far) {
+        char* const begin = near;
+        for (SizeType i = 0; i < count; i++) {
+            ValueType& v = values[i];
+            if (!v.IsString() || (v.data_.f.flags & ValueType::kInlineStrFlag))
+                continue;
+            const SizeType length = v.data_.s.length;
+            const Ch* const str = v.GetStringPointer();
+            Ch* dest;
+            if (ValueType::ShortString::Usable(length)) {
+                v.data_.f.flags = ValueType::kShortStringFlag;
+                v.data_.ss.SetLength(length);
+                dest = v.data_.ss.str;
+            }
+            else {
+                const size_t bytes = FreezeStringSize(v);
+                char*& cursor = bytes <= kFreezeNearStringSize ? near : far;
+                dest = reinterpret_cast<Ch*>(cursor);
+                cursor += bytes;
+                v.data_.f.flags = ValueType::kCopyStringFlag;
+                v.SetStringPointer(dest);
+            }
+            std::memmove(dest, str, length * sizeof(Ch));
+            dest[length] = '\0';
+        }
+        near = begin + RAPIDJSON_ALIGN(static_cast<size_t>(near - begin));
+    }
+
     static const size_t kDefaultStackCapacity = 1024;
     Allocator* allocator_;
     Allocator* ownAllocator_;
     internal::Stack<StackAllocator> stack_;
     ParseResult parseResult_;
+    SharedRef* sharedRefs_;
+    internal::Stack<StackAllocator> internTable_;
+    size_t internCount_;
+    bool internKeys_;
+    bool sortKeys_;
 };
 
 //! GenericDocument with UTF8 encoding
@@ -68,6 +68,10 @@ class FileReadStream;
 
 class FileWriteStream;
 
+// gatherwritestream.h
+
+class GatherWriteStream;
+
 // memorybuffer.h
 
 template <typename Allocator>
@@ -78,6 +82,7 @@ typedef GenericMemoryBuffer<CrtAllocator> MemoryBuffer;
 // memorystream.h
 
 struct MemoryStream;
+struct InsituMemoryStream;
 
 // reader.h
 
@@ -99,6 +104,54 @@ class Writer;
 template<typename OutputStream, typename SourceEncoding, typename TargetEncoding, typename StackAllocator, unsigned writeFlags>
 class PrettyWriter;
 
+// parallelwriter.h
+
+template<typename SourceEncoding, typename TargetEncoding, typename StackAllocator, unsigned writeFlags>
+class ParallelWriter;
+
+// binding.h
+
+template <typename T>
+struct Binding;
+
+template <typename T, typename StackAllocator>
+class BindingHandler;
+
+// cbor.h
+
+template <typename TargetEncoding, typename StackAllocator>
+class GenericCborReader;
+
+typedef GenericCborReader<UTF8<char>, CrtAllocator> CborReader;
+
+template<typename OutputStream, typename SourceEncoding, typename StackAllocator>
+class CborWriter;
+
+// columnar.h
+
+template <typename Encoding, typename Allocator>
+class GenericColumn;
+
+template <typename Encoding, typename Allocator>
+class GenericColumnTable;
+
+typedef GenericColumnTable<UTF8<char>, CrtAllocator> ColumnTable;
+
+// msgpack.h
+
+template <typename TargetEncoding, typename StackAllocator>
+class GenericMsgPackReader;
+
+typedef GenericMsgPackReader<UTF8<char>, CrtAllocator> MsgPackReader;
+
+template<typename OutputStream, typename SourceEncoding, typename StackAllocator>
+class MsgPackWriter;
+
+// serializedsize.h
+
+template <typename ValueType, unsigned writeFlags, typename Allocator>
+class GenericSerializedSize;
+
 // document.h
 
 template <typename Encoding, typename Allocator> 
@@ -115,11 +168,29 @@ class GenericValue;
 
 typedef GenericValue<UTF8<char>, MemoryPoolAllocator<CrtAllocator> > Value;
 
+template <typename Encoding, typename Allocator>
+class GenericSharedValue;
+
+typedef GenericSharedValue<UTF8<char>, MemoryPoolAllocator<CrtAllocator> > SharedValue;
+
 template <typename Encoding, typename Allocator, typename StackAllocator>
 class GenericDocument;
 
 typedef GenericDocument<UTF8<char>, MemoryPoolAllocator<CrtAllocator>, CrtAllocator> Document;
 
+// binaryimage.h
+
+template <typename Encoding>
+class GenericBinaryImageValue;
+
+template <typename Encoding>
+class GenericBinaryImage;
+
+typedef GenericBinaryImage<UTF8<char> > BinaryImage;
+
+template<typename OutputStream, typename SourceEncoding, typename StackAllocator>
+class BinaryImageWriter;
+
 // pointer.h
 
 template <typename ValueType, typename Allocator>
@@ -127,6 +198,30 @@ class GenericPointer;
 
 typedef GenericPointer<Value, CrtAllocator> Pointer;
 
+template <typename ValueType>
+class GenericPointerView;
+
+typedef GenericPointerView<Value> PointerView;
+
+// pointerset.h
+
+template <typename ValueType, typename Allocator>
+class GenericPointerSet;
+
+typedef GenericPointerSet<Value, CrtAllocator> PointerSet;
+
+template <typename ValueType, typename Allocator>
+class GenericPointerExtractor;
+
+typedef GenericPointerExtractor<Value, CrtAllocator> PointerExtractor;
+
+// patch.h
+
+template <typename ValueType, typename Allocator>
+class GenericPatchApplier;
+
+typedef GenericPatchApplier<Value, CrtAllocator> PatchApplier;
+
 // schema.h
 
 template <typename SchemaDocumentType>
@@ -0,0 +1,259 @@
+// Tencent is pleased to support the open source community by making RapidJSON available.
+//
+// Copyright (C) 2015 THL A29 Limited, a Tencent company, and Milo Yip. All rights reserved.
+//
+// Licensed under the MIT License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// http://opensource.org/licenses/MIT
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#ifndef RAPIDJSON_GATHERWRITESTREAM_H_
+#define RAPIDJSON_GATHERWRITESTREAM_H_
+
+#include "stream.h"
+#include <cstring>
+
+#if !defined(_WIN32)
+#include <cerrno>
+#include <climits>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+#ifdef __clang__
+RAPIDJSON_DIAG_PUSH
+RAPIDJSON_DIAG_OFF(unreachable-code)
+#endif
+
+RAPIDJSON_NAMESPACE_BEGIN
+
+//! Output byte stream gathering the output as a list of segments for a scatter-gather write.
+/*!
+    Small writes are coalesced into a user buffer, while long strings written by Writer may be
+    referenced in place instead of being copied. When the buffer or the segment table is full,
+    and on Flush(), the segments are handed to a flush function at once, typically writev().
+
+    A referenced string is read at the next flush, so referencing is opt-in with
+    SetReferenceMode(). By default every string is copied. With kReferenceBorrowed, strings
+    given with <tt>copy == false</tt> are referenced, which suits a Document parsed in situ or
+    holding StringRef() strings, but not a caller passing its own temporary buffers to
+    Writer::String(const Ch*, SizeType). With kReferenceAll, strings with <tt>copy == true</tt>
+    are referenced too, which is safe when writing a Document since its strings live as long as
+    the Document itself; it is not when writing from a Reader, which gives transient strings.
+    The convenience overloads of Writer taking a \c std::string or a null-terminated string
+    always give <tt>copy == true</tt>.
+
+    \code
+    char buffer[4096];
+    int fd = ::open("out.json", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    GatherWriteStream os(GatherWriteStream::Writev, &fd, buffer, sizeof(buffer));
+    os.SetReferenceMode(GatherWriteStream::kReferenceAll);
+    Writer<GatherWriteStream> writer(os);
+    d.Accept(writer);   // flushes at the end of the root
+    \endcode
+
+    \note implements Stream concept
+*/
+class GatherWriteStream {
+public:
+    typedef char Ch;    //!< Character type. Only support char.
+
+    //! A contiguous piece of output.
+    struct Segment {
+        const Ch* data;
+        size_t length;
+    };
+
+    //! Function writing segments in order.
+    /*! \param userData Pointer given to the constructor.
+        \return Whether all the segments were written.
+    */
+    typedef bool (*FlushFunction)(void* userData, const Segment* segments, size_t count);
+
+    //! Which strings are referenced instead of copied.
+    enum ReferenceMode {
+        kReferenceNone,     //!< Copy every string (default).
+        kReferenceBorrowed, //!< Reference strings given with <tt>copy == false</tt>.
+        kReferenceAll       //!< Reference every string, whatever \c copy says.
+    };
+
+    //! Maximum number of segments before flushing.
+    static const size_t kMaxSegments = 64;
+
+    //! Strings shorter than this are copied even if they could be referenced.
+    static const size_t kDefaultMinReferenceLength = 256;
+
+    //! Constructor
+    /*! \param flush Function writing the segments.
+        \param userData Pointer passed to \c flush.
+        \param buffer Buffer coalescing small writes.
+        \param bufferSize Size of \c buffer.
+        \param minReferenceLength Minimum length of a run of characters to reference.
+    */
+    GatherWriteStream(FlushFunction flush, void* userData, char* buffer, size_t bufferSize, size_t minReferenceLength = kDefaultMinReferenceLength) :
+        flush_(flush), userData_(userData), buffer_(buffer), bufferEnd_(buffer + bufferSize), current_(buffer), open_(buffer),
+        segmentCount_(), minReferenceLength_(minReferenceLength), referenceMode_(kReferenceNone), error_(false)
+    {
+        RAPIDJSON_ASSERT(flush_ != 0);
+        RAPIDJSON_ASSERT(bufferSize > 0);
+        if (minReferenceLength_ == 0)
+            minReferenceLength_ = 1;
+    }
+
+    //! Sets which long strings may be referenced until the next flush.
+    void SetReferenceMode(ReferenceMode referenceMode) { referenceMode_ = referenceMode; }
+
+    //! Whether a flush function failed since construction.
+    bool HasError() const { return error_; }
+
+    void Put(char c) {
+        if (current_ == bufferEnd_)
+            Flush();
+        *current_++ = c;
+    }
+
+    void PutN(char c, size_t n) {
+        while (n > 0) {
+            if (current_ == bufferEnd_)
+                Flush();
+            size_t count = static_cast<size_t>(bufferEnd_ - current_);
+            if (count > n)
+                count = n;
+            std::memset(current_, c, count);
+            current_ += count;
+            n -= count;
+        }
+    }
+
+    //! Writes characters, referencing them if they are long enough and the reference mode allows it.
+    void PutReference(const char* s, size_t length, bool copy) {
+        if (length >= minReferenceLength_ && referenceMode_ != kReferenceNone && (!copy || referenceMode_ == kReferenceAll)) {
+            Seal();
+            if (segmentCount_ == kMaxSegments)
+                Flush();
+            Segment& segment = segments_[segmentCount_++];
+            segment.data = s;
+            segment.length = length;
+            return;
+        }
+        while (length > 0) {
+            if (current_ == bufferEnd_)
+                Flush();
+            size_t count = static_cast<size_t>(bufferEnd_ - current_);
+            if (count > length)
+                count = length;
+            std::memcpy(current_, s, count);
+            current_ += count;
+            s += count;
+            length -= count;
+        }
+    }
+
+    //! Hands all the segments to the flush function.
+    void Flush() {
+        Seal();
+        if (segmentCount_ > 0 && !flush_(userData_, segments_, segmentCount_))
+            error_ = true;
+        segmentCount_ = 0;
+        current_ = open_ = buffer_;
+    }
+
+#if !defined(_WIN32)
+    //! Flush function writing to the file descriptor pointed to by \c userData with writev().
+    static bool Writev(void* userData, const Segment* segments, size_t count) {
+        const int fd = *static_cast<const int*>(userData);
+        struct iovec iov[kMaxSegments];
+        RAPIDJSON_ASSERT(count <= kMaxSegments);
+        for (size_t i = 0; i < count; i++) {
+            iov[i].iov_base = const_cast<Ch*>(segments[i].data);
+            iov[i].iov_len = segments[i].length;
+        }
+        // Retry partial writes from where they stopped
+        struct iovec* v = iov;
+        int n = static_cast<int>(count);
+        while (n > 0) {
+            const ssize_t written = ::writev(fd, v, n < IOV_MAX ? n : IOV_MAX);
+            if (written < 0) {
+                if (errno == EINTR)
+                    continue;
+                return false;
+            }
+            size_t remaining = static_cast<size_t>(written);
+            while (n > 0 && remaining >= v->iov_len) {
+                remaining -= v->iov_len;
+                ++v;
+                --n;
+            }
+            if (n > 0) {
+                v->iov_base = static_cast<char*>(v->iov_base) + remaining;
+                v->iov_len -= remaining;
+            }
+        }
+        return true;
+    }
+#endif
+
+    // Not implemented
+    char Peek() const { RAPIDJSON_ASSERT(false); return 0; }
+    char Take() { RAPIDJSON_ASSERT(false); return 0; }
+    size_t Tell() const { RAPIDJSON_ASSERT(false); return 0; }
+    char* PutBegin() { RAPIDJSON_ASSERT(false); return 0; }
+    size_t PutEnd(char*) { RAPIDJSON_ASSERT(false); return 0; }
+
+private:
+    // Prohibit copy constructor & assignment operator.
+    GatherWriteStream(const GatherWriteStream&);
+    GatherWriteStream& operator=(const GatherWriteStream&);
+
+    // Closes the segment of the characters put in the buffer since the last one.
+    void Seal() {
+        if (current_ == open_)
+            return;
+        if (segmentCount_ == kMaxSegments) {
+            // The open characters stay in the buffer, after the ones of the flushed segments
+            if (!flush_(userData_, segments_, segmentCount_))
+                error_ = true;
+            segmentCount_ = 0;
+        }
+        Segment& segment = segments_[segmentCount_++];
+        segment.data = open_;
+        segment.length = static_cast<size_t>(current_ - open_);
+        open_ = current_;
+    }
+
+    FlushFunction flush_;
+    void* userData_;
+    char* buffer_;
+    char* bufferEnd_;
+    char* current_;
+    char* open_;            //!< Start of the characters not yet in a segment.
+    Segment segments_[kMaxSegments];
+    size_t segmentCount_;
+    size_t minReferenceLength_;
+    ReferenceMode referenceMode_;
+    bool error_;
+};
+
+//! Implement specialized traits for GatherWriteStream.
+template<>
+struct OutputStreamTraits<GatherWriteStream> {
+    enum { referenceOptimization = 1 };
+};
+
+//! Implement specialized PutReference() for GatherWriteStream.
+inline void PutReference(GatherWriteStream& stream, const char* s, size_t length, bool copy) {
+    stream.PutReference(s, length, copy);
+}
+
+RAPIDJSON_NAMESPACE_END
+
+#ifdef __clang__
+RAPIDJSON_DIAG_POP
+#endif
+
+#endif // RAPIDJSON_GATHERWRITESTREAM_H_
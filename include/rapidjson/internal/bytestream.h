@@ -0,0 +1,66 @@
+// Tencent is pleased to support the open source community by making RapidJSON available.
+//
+// Copyright (C) 2015 THL A29 Limited, a Tencent company, and Milo Yip. All rights reserved.
+//
+// Licensed under the MIT License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// http://opensource.org/licenses/MIT
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#ifndef RAPIDJSON_INTERNAL_BYTESTREAM_H_
+#define RAPIDJSON_INTERNAL_BYTESTREAM_H_
+
+#include "../memorystream.h"
+#include <cstring>
+
+RAPIDJSON_NAMESPACE_BEGIN
+namespace internal {
+
+//! Whether n more bytes can be read from a byte stream.
+/*! Binary formats cannot use '\0' as end of stream, so only streams of known size can tell.
+    Other streams are trusted to hold complete input.
+*/
+template <typename InputStream>
+inline bool ByteStreamAvailable(InputStream&, uint64_t) { return true; }
+
+inline bool ByteStreamAvailable(MemoryStream& is, uint64_t n) {
+    return static_cast<uint64_t>(is.end_ - is.src_) >= n;
+}
+
+inline bool ByteStreamAvailable(InsituMemoryStream& is, uint64_t n) {
+    return static_cast<uint64_t>(is.end_ - is.src_) >= n;
+}
+
+//! Read n bytes from a byte stream, returning false if fewer are available.
+template <typename InputStream>
+inline bool ByteStreamRead(InputStream& is, unsigned char* out, size_t n) {
+    for (size_t i = 0; i < n; i++)
+        out[i] = static_cast<unsigned char>(is.Take());
+    return true;
+}
+
+inline bool ByteStreamRead(MemoryStream& is, unsigned char* out, size_t n) {
+    if (!ByteStreamAvailable(is, n))
+        return false;
+    std::memcpy(out, is.src_, n);
+    is.src_ += n;
+    return true;
+}
+
+inline bool ByteStreamRead(InsituMemoryStream& is, unsigned char* out, size_t n) {
+    if (!ByteStreamAvailable(is, n))
+        return false;
+    std::memcpy(out, is.src_, n);
+    is.src_ += n;
+    return true;
+}
+
+} // namespace internal
+RAPIDJSON_NAMESPACE_END
+
+#endif // RAPIDJSON_INTERNAL_BYTESTREAM_H_
@@ -0,0 +1,127 @@
+// Tencent is pleased to support the open source community by making RapidJSON available.
+//
+// Copyright (C) 2015 THL A29 Limited, a Tencent company, and Milo Yip. All rights reserved.
+//
+// Licensed under the MIT License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// http://opensource.org/licenses/MIT
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#ifndef RAPIDJSON_INTERNAL_HASHTABLE_H_
+#define RAPIDJSON_INTERNAL_HASHTABLE_H_
+
+#include "../rapidjson.h"
+#include <cstring>
+
+RAPIDJSON_NAMESPACE_BEGIN
+namespace internal {
+
+///////////////////////////////////////////////////////////////////////////////
+// HashTable
+
+//! Open addressing (linear probing) hash table keyed by integers or pointers.
+/*! Slots are plain structs with a \c key member of type \c Slot::KeyType, a zero key marking
+    an empty slot, so that zero is not a valid key. The capacity is a power of two and the
+    table grows at a load factor of 1/2. Keys are spread with Fibonacci hashing, indexing with
+    the top bits of the 64-bit product.
+    \tparam Slot Type of the slots, zero-initialized by memset.
+    \tparam Allocator Allocator of the slots, which must not be null once a key is inserted.
+*/
+template <typename Slot, typename Allocator>
+class HashTable {
+public:
+    typedef typename Slot::KeyType KeyType;
+
+    HashTable(Allocator* allocator, size_t initialCapacity) : allocator_(allocator), slots_(), shift_(), mask_(), size_(), initialCapacity_(initialCapacity) {
+        RAPIDJSON_ASSERT(initialCapacity >= 2 && (initialCapacity & (initialCapacity - 1)) == 0);
+    }
+
+    ~HashTable() { Release(); }
+
+    //! Returns the slot of key, or the empty slot where it would be inserted, or 0 if nothing was ever inserted.
+    Slot* Find(KeyType key) const {
+        RAPIDJSON_ASSERT(key != KeyType());
+        if (!slots_)
+            return 0;
+        size_t i = static_cast<size_t>((ToInteger(key) * RAPIDJSON_UINT64_C2(0x9E3779B9, 0x7F4A7C15)) >> shift_);
+        while (slots_[i].key != KeyType() && slots_[i].key != key)
+            i = (i + 1) & mask_;
+        return &slots_[i];
+    }
+
+    //! Returns the slot of key, taking an empty one if it is not in the table.
+    /*! \param inserted If not null, receives whether the key was not in the table.
+    */
+    Slot* Insert(KeyType key, bool* inserted = 0) {
+        if ((size_ + 1) * 2 > (slots_ ? mask_ + 1 : 0))
+            Rehash(slots_ ? (mask_ + 1) * 2 : initialCapacity_);
+        Slot* slot = Find(key);
+        const bool empty = slot->key == KeyType();
+        if (empty) {
+            slot->key = key;
+            size_++;
+        }
+        if (inserted)
+            *inserted = empty;
+        return slot;
+    }
+
+    //! Removes all the keys, keeping the capacity.
+    void Clear() {
+        if (slots_)
+            std::memset(static_cast<void*>(slots_), 0, sizeof(Slot) * (mask_ + 1));
+        size_ = 0;
+    }
+
+    //! Removes all the keys and frees the slots.
+    void Release() {
+        if (slots_)
+            allocator_->Free(slots_);
+        slots_ = 0;
+        size_ = 0;
+    }
+
+    size_t GetSize() const { return size_; }
+
+private:
+    HashTable(const HashTable&);
+    HashTable& operator=(const HashTable&);
+
+    static uint64_t ToInteger(uint64_t key) { return key; }
+    template <typename T>
+    static uint64_t ToInteger(const T* key) { return static_cast<uint64_t>(reinterpret_cast<uintptr_t>(key)); }
+
+    void Rehash(size_t capacity) {
+        RAPIDJSON_ASSERT(allocator_ != 0);
+        Slot* old = slots_;
+        const size_t oldCapacity = old ? mask_ + 1 : 0;
+        slots_ = static_cast<Slot*>(allocator_->Malloc(sizeof(Slot) * capacity));
+        std::memset(static_cast<void*>(slots_), 0, sizeof(Slot) * capacity);
+        mask_ = capacity - 1;
+        shift_ = 64;
+        for (size_t c = capacity; c > 1; c >>= 1)
+            shift_--;
+        for (size_t i = 0; i < oldCapacity; i++)
+            if (old[i].key != KeyType())
+                *Find(old[i].key) = old[i];
+        if (old)
+            allocator_->Free(old);
+    }
+
+    Allocator* allocator_;
+    Slot* slots_;
+    unsigned shift_;    // 64 - log2(capacity)
+    size_t mask_;       // capacity - 1, capacity is a power of two
+    size_t size_;
+    size_t initialCapacity_;
+};
+
+} // namespace internal
+RAPIDJSON_NAMESPACE_END
+
+#endif // RAPIDJSON_INTERNAL_HASHTABLE_H_
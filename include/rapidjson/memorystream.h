@@ -62,6 +62,32 @@ struct MemoryStream {
     size_t size_;       //!< Size of the stream.
 };
 
+//! Represents a mutable in-memory input byte stream, for parsing binary formats in situ.
+/*!
+    Unlike InsituStringStream, the end of the stream is known from its size rather than
+    from a null character, which binary formats may contain anywhere.
+
+    \note implements Stream concept
+*/
+struct InsituMemoryStream {
+    typedef char Ch; // byte
+
+    InsituMemoryStream(Ch* src, size_t size) : src_(src), begin_(src), end_(src + size) {}
+
+    Ch Peek() const { return RAPIDJSON_UNLIKELY(src_ == end_) ? '\0' : *src_; }
+    Ch Take() { return RAPIDJSON_UNLIKELY(src_ == end_) ? '\0' : *src_++; }
+    size_t Tell() const { return static_cast<size_t>(src_ - begin_); }
+
+    Ch* PutBegin() { RAPIDJSON_ASSERT(false); return 0; }
+    void Put(Ch) { RAPIDJSON_ASSERT(false); }
+    void Flush() { RAPIDJSON_ASSERT(false); }
+    size_t PutEnd(Ch*) { RAPIDJSON_ASSERT(false); return 0; }
+
+    Ch* src_;           //!< Current read position.
+    Ch* begin_;         //!< Original head of the buffer.
+    Ch* end_;           //!< End of stream.
+};
+
 RAPIDJSON_NAMESPACE_END
 
 #ifdef __clang__
@@ -0,0 +1,660 @@
+// Tencent is pleased to support the open source community by making RapidJSON available.
+//
+// Copyright (C) 2015 THL A29 Limited, a Tencent company, and Milo Yip. All rights reserved.
+//
+// Licensed under the MIT License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// http://opensource.org/licenses/MIT
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#ifndef RAPIDJSON_MSGPACK_H_
+#define RAPIDJSON_MSGPACK_H_
+
+#include "reader.h"
+#include "internal/bytestream.h"
+#include "internal/stack.h"
+#include "internal/strfunc.h"
+
+#ifdef __GNUC__
+RAPIDJSON_DIAG_PUSH
+RAPIDJSON_DIAG_OFF(effc++)
+#endif
+
+RAPIDJSON_NAMESPACE_BEGIN
+
+///////////////////////////////////////////////////////////////////////////////
+// GenericMsgPackReader
+
+//! SAX-style reader of MessagePack.
+/*! Reads one MessagePack object from a byte stream and generates the same events as
+    GenericReader would for the equivalent JSON text, so that any Handler, including
+    GenericDocument through Populate(), can consume MessagePack directly.
+
+    Integers are reported with Uint() or Int() when they fit in 32 bits, otherwise with
+    Uint64() or Int64(), and floats with Double(). Strings, and map keys which must be
+    strings, are given with <tt>copy == true</tt>. Binary and extension types have no JSON
+    equivalent and are reported as \ref kParseErrorValueInvalid.
+
+    Nesting is handled with an explicit stack, so deep input cannot overflow the call stack.
+    With a MemoryStream, truncated input and counts larger than the input are detected;
+    other streams are expected to hold a complete object.
+
+    \tparam TargetEncoding Encoding of the strings given to the handler. MessagePack strings are UTF-8.
+    \tparam StackAllocator Allocator of the internal stacks.
+*/
+template <typename TargetEncoding = UTF8<>, typename StackAllocator = CrtAllocator>
+class GenericMsgPackReader {
+public:
+    typedef typename TargetEncoding::Ch Ch;
+
+    //! Constructor.
+    /*! \param stackAllocator Optional allocator for allocating stack memory. (Only use for non-destructive parsing)
+        \param stackCapacity stack capacity in bytes for storing a single decoded string.  (Only use for non-destructive parsing)
+    */
+    GenericMsgPackReader(StackAllocator* stackAllocator = 0, size_t stackCapacity = kDefaultStackCapacity) :
+        levels_(stackAllocator, stackCapacity), bytes_(stackAllocator, stackCapacity), chars_(stackAllocator, stackCapacity), parseResult_() {}
+
+    //! Parse one MessagePack object from a stream.
+    /*! \tparam parseFlags Only \ref kParseValidateEncodingFlag is used.
+        \param is Input byte stream, positioned after the object on success.
+        \param handler The handler to receive events.
+        \return Whether the parsing is successful.
+    */
+    template <unsigned parseFlags, typename InputStream, typename Handler>
+    ParseResult Parse(InputStream& is, Handler& handler) {
+        RAPIDJSON_STATIC_ASSERT(sizeof(typename InputStream::Ch) == 1);
+        parseResult_.Clear();
+        ClearStackOnExit scope(*this);
+
+        if (RAPIDJSON_UNLIKELY(!internal::ByteStreamAvailable(is, 1))) {
+            parseResult_.Set(kParseErrorDocumentEmpty, is.Tell());
+            return parseResult_;
+        }
+
+        do {
+            if (RAPIDJSON_UNLIKELY(!ParseItem<parseFlags>(is, handler)))
+                return parseResult_;
+
+            // Close the containers whose items are all parsed
+            while (!levels_.Empty() && levels_.template Top<Level>()->remaining == 0) {
+                const Level level = *levels_.template Pop<Level>(1);
+                if (RAPIDJSON_UNLIKELY(!(level.map ? handler.EndObject(level.count) : handler.EndArray(level.count)))) {
+                    parseResult_.Set(kParseErrorTermination, is.Tell());
+                    return parseResult_;
+                }
+            }
+        } while (!levels_.Empty());
+
+        return parseResult_;
+    }
+
+    //! Parse one MessagePack object from a stream, with the default flags.
+    template <typename InputStream, typename Handler>
+    ParseResult Parse(InputStream& is, Handler& handler) {
+        return Parse<kParseDefaultFlags>(is, handler);
+    }
+
+    //! Parse one MessagePack object into a document.
+    /*! \param is Input byte stream.
+        \param document Document replaced by the object on success, unchanged otherwise.
+        \return Whether the parsing is successful.
+    */
+    template <unsigned parseFlags, typename InputStream, typename DocumentType>
+    bool Populate(InputStream& is, DocumentType& document) {
+        Generator<parseFlags, InputStream> g(*this, is);
+        document.Populate(g);
+        return !HasParseError();
+    }
+
+    //! Parse one MessagePack object into a document, with the default flags.
+    template <typename InputStream, typename DocumentType>
+    bool Populate(InputStream& is, DocumentType& document) {
+        return Populate<kParseDefaultFlags>(is, document);
+    }
+
+    //! Whether a parse error has occurred in the last parsing.
+    bool HasParseError() const { return parseResult_.IsError(); }
+
+    //! Get the \ref ParseErrorCode of last parsing.
+    ParseErrorCode GetParseErrorCode() const { return parseResult_.Code(); }
+
+    //! Get the position of last parsing error in input, 0 otherwise.
+    size_t GetErrorOffset() const { return parseResult_.Offset(); }
+
+private:
+    // Prohibit copy constructor & assignment operator.
+    GenericMsgPackReader(const GenericMsgPackReader&);
+    GenericMsgPackReader& operator=(const GenericMsgPackReader&);
+
+    static const size_t kDefaultStackCapacity = 256;
+
+    struct Level {
+        uint64_t remaining;     //!< Items left, names and values counting separately in maps
+        SizeType count;         //!< Number of elements or members
+        bool map;
+    };
+
+    template <unsigned parseFlags, typename InputStream>
+    struct Generator {
+        Generator(GenericMsgPackReader& reader, InputStream& is) : reader_(reader), is_(is) {}
+        template <typename Handler>
+        bool operator()(Handler& handler) { return !reader_.template Parse<parseFlags>(is_, handler).IsError(); }
+
+        GenericMsgPackReader& reader_;
+        InputStream& is_;
+
+    private:
+        Generator& operator=(const Generator&);
+    };
+
+    class CharStream {
+    public:
+        typedef typename TargetEncoding::Ch Ch;
+        explicit CharStream(internal::Stack<StackAllocator>& stack) : stack_(stack) {}
+        void Put(Ch c) { *stack_.template Push<Ch>() = c; }
+    private:
+        CharStream& operator=(const CharStream&);
+        internal::Stack<StackAllocator>& stack_;
+    };
+
+    void ClearStack() { levels_.Clear(); bytes_.Clear(); chars_.Clear(); }
+
+    struct ClearStackOnExit {
+        explicit ClearStackOnExit(GenericMsgPackReader& r) : r_(r) {}
+        ~ClearStackOnExit() { r_.ClearStack(); }
+    private:
+        GenericMsgPackReader& r_;
+        ClearStackOnExit(const ClearStackOnExit&);
+        ClearStackOnExit& operator=(const ClearStackOnExit&);
+    };
+
+    bool Error(ParseErrorCode code, size_t offset) {
+        parseResult_.Set(code, offset);
+        return false;
+    }
+
+    // Reads a big-endian unsigned integer of n bytes.
+    template <typename InputStream>
+    static bool ReadBig(InputStream& is, unsigned n, uint64_t& value) {
+        unsigned char b[8];
+        if (!internal::ByteStreamRead(is, b, n))
+            return false;
+        value = 0;
+        for (unsigned i = 0; i < n; i++)
+            value = (value << 8) | b[i];
+        return true;
+    }
+
+    template <typename Handler>
+    static bool Unsigned(Handler& handler, uint64_t u) {
+        return u <= 0xFFFFFFFFu ? handler.Uint(static_cast<unsigned>(u)) : handler.Uint64(u);
+    }
+
+    template <typename Handler>
+    static bool Signed(Handler& handler, int64_t i) {
+        if (i >= 0)
+            return Unsigned(handler, static_cast<uint64_t>(i));
+        return i >= -2147483647 - 1 ? handler.Int(static_cast<int>(i)) : handler.Int64(i);
+    }
+
+    // Parses a scalar, or the header of a container which is then pushed.
+    template <unsigned parseFlags, typename InputStream, typename Handler>
+    bool ParseItem(InputStream& is, Handler& handler) {
+        bool key = false;
+        if (!levels_.Empty()) {
+            Level* level = levels_.template Top<Level>();
+            key = level->map && level->remaining % 2 == 0;
+            level->remaining--;
+        }
+
+        const size_t offset = is.Tell();
+        unsigned char b;
+        if (RAPIDJSON_UNLIKELY(!internal::ByteStreamRead(is, &b, 1)))
+            return Error(kParseErrorValueInvalid, offset);
+        const bool string = (b >= 0xA0 && b <= 0xBF) || (b >= 0xD9 && b <= 0xDB);
+        if (RAPIDJSON_UNLIKELY(key && !string))
+            return Error(kParseErrorObjectMissName, offset);
+
+        uint64_t u;
+        bool cont;
+        if (b <= 0x7F)
+            cont = handler.Uint(b);
+        else if (b >= 0xE0)
+            cont = handler.Int(static_cast<int>(b) - 256);
+        else if (b <= 0x8F)
+            return StartContainer(is, handler, true, b & 0x0Fu, offset);
+        else if (b <= 0x9F)
+            return StartContainer(is, handler, false, b & 0x0Fu, offset);
+        else if (b <= 0xBF)
+            return ParseString<parseFlags>(is, handler, b & 0x1Fu, key, offset);
+        else {
+            static const unsigned char kLengthSize[] = { 1, 2, 4, 8 };
+            switch (b) {
+            case 0xC0: cont = handler.Null(); break;
+            case 0xC2: cont = handler.Bool(false); break;
+            case 0xC3: cont = handler.Bool(true); break;
+
+            case 0xCA: {
+                if (RAPIDJSON_UNLIKELY(!ReadBig(is, 4, u)))
+                    return Error(kParseErrorValueInvalid, offset);
+                const uint32_t bits = static_cast<uint32_t>(u);
+                float f;
+                std::memcpy(&f, &bits, sizeof(f));
+                cont = handler.Double(static_cast<double>(f));
+                break;
+            }
+            case 0xCB: {
+                if (RAPIDJSON_UNLIKELY(!ReadBig(is, 8, u)))
+                    return Error(kParseErrorValueInvalid, offset);
+                double d;
+                std::memcpy(&d, &u, sizeof(d));
+                cont = handler.Double(d);
+                break;
+            }
+
+            case 0xCC: case 0xCD: case 0xCE: case 0xCF:
+                if (RAPIDJSON_UNLIKELY(!ReadBig(is, kLengthSize[b - 0xCC], u)))
+                    return Error(kParseErrorValueInvalid, offset);
+                cont = Unsigned(handler, u);
+                break;
+
+            case 0xD0: case 0xD1: case 0xD2: case 0xD3: {
+                const unsigned n = kLengthSize[b - 0xD0];
+                if (RAPIDJSON_UNLIKELY(!ReadBig(is, n, u)))
+                    return Error(kParseErrorValueInvalid, offset);
+                // Sign extension
+                if (n < 8 && (u >> (8 * n - 1)) != 0)
+                    u |= ~static_cast<uint64_t>(0) << (8 * n);
+                cont = Signed(handler, static_cast<int64_t>(u));
+                break;
+            }
+
+            case 0xD9: case 0xDA: case 0xDB:
+                if (RAPIDJSON_UNLIKELY(!ReadBig(is, kLengthSize[b - 0xD9], u)))
+                    return Error(kParseErrorValueInvalid, offset);
+                return ParseString<parseFlags>(is, handler, u, key, offset);
+
+            case 0xDC: case 0xDD: case 0xDE: case 0xDF:
+                if (RAPIDJSON_UNLIKELY(!ReadBig(is, (b & 1) ? 4 : 2, u)))
+                    return Error(kParseErrorValueInvalid, offset);
+                return StartContainer(is, handler, b >= 0xDE, u, offset);
+
+            default:
+                // Never used (0xC1), binary and extension types
+                return Error(kParseErrorValueInvalid, offset);
+            }
+        }
+        if (RAPIDJSON_UNLIKELY(!cont))
+            return Error(kParseErrorTermination, offset);
+        return true;
+    }
+
+    template <typename InputStream, typename Handler>
+    bool StartContainer(InputStream& is, Handler& handler, bool map, uint64_t count, size_t offset) {
+        const uint64_t remaining = map ? 2 * count : count;
+        // Every item takes at least one byte
+        if (RAPIDJSON_UNLIKELY(!internal::ByteStreamAvailable(is, remaining)))
+            return Error(kParseErrorValueInvalid, offset);
+        if (RAPIDJSON_UNLIKELY(!(map ? handler.StartObject() : handler.StartArray())))
+            return Error(kParseErrorTermination, offset);
+        Level* level = levels_.template Push<Level>();
+        level->remaining = remaining;
+        level->count = static_cast<SizeType>(count);
+        level->map = map;
+        return true;
+    }
+
+    template <unsigned parseFlags, typename InputStream, typename Handler>
+    bool ParseString(InputStream& is, Handler& handler, uint64_t length, bool key, size_t offset) {
+        if (RAPIDJSON_UNLIKELY(!internal::ByteStreamAvailable(is, length)))
+            return Error(kParseErrorValueInvalid, offset);
+        const size_t n = static_cast<size_t>(length);
+        unsigned char* bytes = bytes_.template Push<unsigned char>(n + 1);
+        if (RAPIDJSON_UNLIKELY(!internal::ByteStreamRead(is, bytes, n)))
+            return Error(kParseErrorValueInvalid, offset);
+        bytes[n] = '\0';
+
+        const Ch* str;
+        SizeType strLength;
+        if (internal::IsSame<UTF8<>, TargetEncoding>::Value && !(parseFlags & kParseValidateEncodingFlag)) {
+            str = reinterpret_cast<const Ch*>(bytes);
+            strLength = static_cast<SizeType>(n);
+        }
+        else {
+            GenericStringStream<UTF8<> > source(reinterpret_cast<const char*>(bytes));
+            CharStream target(chars_);
+            while (source.Tell() < n) {
+                if (RAPIDJSON_UNLIKELY(!((parseFlags & kParseValidateEncodingFlag) ?
+                    Transcoder<UTF8<>, TargetEncoding>::Validate(source, target) :
+                    Transcoder<UTF8<>, TargetEncoding>::Transcode(source, target))))
+                    return Error(kParseErrorStringInvalidEncoding, offset);
+            }
+            strLength = static_cast<SizeType>(chars_.GetSize() / sizeof(Ch));
+            target.Put('\0');
+            str = chars_.template Bottom<Ch>();
+        }
+
+        const bool cont = key ? handler.Key(str, strLength, true) : handler.String(str, strLength, true);
+        bytes_.Clear();
+        chars_.Clear();
+        if (RAPIDJSON_UNLIKELY(!cont))
+            return Error(kParseErrorTermination, offset);
+        return true;
+    }
+
+    internal::Stack<StackAllocator> levels_;    //!< Open containers, of type Level
+    internal::Stack<StackAllocator> bytes_;     //!< Bytes of the current string
+    internal::Stack<StackAllocator> chars_;     //!< Current string transcoded or validated
+    ParseResult parseResult_;
+};
+
+//! MessagePack reader with UTF8 encoding and default allocator.
+typedef GenericMsgPackReader<UTF8<>, CrtAllocator> MsgPackReader;
+
+///////////////////////////////////////////////////////////////////////////////
+// MsgPackWriter
+
+//! MessagePack writer implementing the Handler concept.
+/*! Value::Accept() and the readers can write MessagePack through it. Integers take the
+    smallest encoding keeping their sign, doubles are written as float64 and strings are
+    converted to UTF-8.
+
+    The SAX events only give the number of elements of a container at its end, while
+    MessagePack writes it first, so the output of a root value is buffered. Each container
+    reserves the largest header, the actual header is written at its end and the unused
+    bytes are skipped when the root value is completed and written to the stream.
+
+    \tparam OutputStream Type of output byte stream.
+    \tparam SourceEncoding Encoding of the strings of the events.
+    \tparam StackAllocator Type of allocator for allocating memory of the buffer and stacks.
+    \note RawNumber() writes the number as a string, as MessagePack has no textual numbers.
+*/
+template<typename OutputStream, typename SourceEncoding = UTF8<>, typename StackAllocator = CrtAllocator>
+class MsgPackWriter {
+public:
+    typedef typename SourceEncoding::Ch Ch;
+
+    static const size_t kDefaultLevelDepth = 32;
+
+    //! Constructor
+    /*! \param os Output stream.
+        \param stackAllocator User supplied allocator. If it is null, it will create a private one.
+        \param levelDepth Initial capacity of stack.
+    */
+    explicit MsgPackWriter(OutputStream& os, StackAllocator* stackAllocator = 0, size_t levelDepth = kDefaultLevelDepth) :
+        os_(&os), buffer_(stackAllocator, 256), level_stack_(stackAllocator, levelDepth * sizeof(Level)),
+        gaps_(stackAllocator, levelDepth * sizeof(Gap)), hasRoot_(false) {}
+
+    //! Reset the writer with a new stream.
+    void Reset(OutputStream& os) {
+        os_ = &os;
+        buffer_.Clear();
+        level_stack_.Clear();
+        gaps_.Clear();
+        hasRoot_ = false;
+    }
+
+    //! Checks whether the output is a complete MessagePack object.
+    bool IsComplete() const { return hasRoot_ && level_stack_.Empty(); }
+
+    /*!@name Implementation of Handler
+        \see Handler
+    */
+    //@{
+
+    bool Null()                 { Prefix(kNullType); PutByte(0xC0); return EndValue(); }
+    bool Bool(bool b)           { Prefix(b ? kTrueType : kFalseType); PutByte(b ? 0xC3 : 0xC2); return EndValue(); }
+    bool Int(int i)             { Prefix(kNumberType); WriteSigned(i); return EndValue(); }
+    bool Uint(unsigned u)       { Prefix(kNumberType); WriteUnsigned(u); return EndValue(); }
+    bool Int64(int64_t i64)     { Prefix(kNumberType); WriteSigned(i64); return EndValue(); }
+    bool Uint64(uint64_t u64)   { Prefix(kNumberType); WriteUnsigned(u64); return EndValue(); }
+
+    bool Double(double d) {
+        Prefix(kNumberType);
+        uint64_t bits;
+        std::memcpy(&bits, &d, sizeof(bits));
+        PutByte(0xCB);
+        PutBig(bits, 8);
+        return EndValue();
+    }
+
+    bool RawNumber(const Ch* str, SizeType length, bool copy = false) { return String(str, length, copy); }
+
+    bool String(const Ch* str, SizeType length, bool copy = false) {
+        RAPIDJSON_ASSERT(str != 0);
+        (void)copy;
+        Prefix(kStringType);
+        return EndValue(WriteString(str, length));
+    }
+
+    bool StartObject() {
+        Prefix(kObjectType);
+        StartContainer(true);
+        return true;
+    }
+
+    bool Key(const Ch* str, SizeType length, bool copy = false) {
+        RAPIDJSON_ASSERT(!level_stack_.Empty());                                    // not in an object
+        RAPIDJSON_ASSERT(level_stack_.template Top<Level>()->map);                  // not in an object
+        RAPIDJSON_ASSERT(level_stack_.template Top<Level>()->valueCount % 2 == 0);  // Key() must not follow Key()
+        return String(str, length, copy);
+    }
+
+    bool EndObject(SizeType memberCount = 0) {
+        (void)memberCount;
+        RAPIDJSON_ASSERT(level_stack_.GetSize() >= sizeof(Level));                  // not inside an Object
+        RAPIDJSON_ASSERT(level_stack_.template Top<Level>()->map);                  // currently inside an Array, not Object
+        RAPIDJSON_ASSERT(level_stack_.template Top<Level>()->valueCount % 2 == 0);  // Object has a Key without a Value
+        EndContainer();
+        return EndValue();
+    }
+
+    bool StartArray() {
+        Prefix(kArrayType);
+        StartContainer(false);
+        return true;
+    }
+
+    bool EndArray(SizeType elementCount = 0) {
+        (void)elementCount;
+        RAPIDJSON_ASSERT(level_stack_.GetSize() >= sizeof(Level));
+        RAPIDJSON_ASSERT(!level_stack_.template Top<Level>()->map);
+        EndContainer();
+        return EndValue();
+    }
+    //@}
+
+    /*! @name Convenience extensions */
+    //@{
+
+    //! Simpler but slower overload.
+    bool String(const Ch* const& str) { return String(str, internal::StrLen(str)); }
+    bool Key(const Ch* const& str) { return Key(str, internal::StrLen(str)); }
+
+    //@}
+
+private:
+    // Prohibit copy constructor & assignment operator.
+    MsgPackWriter(const MsgPackWriter&);
+    MsgPackWriter& operator=(const MsgPackWriter&);
+
+    //! Information for each nested level
+    struct Level {
+        size_t valueCount;  //!< number of values in this level, names and values counting separately in maps
+        size_t gap;         //!< index of the gap of the reserved header
+        bool map;
+    };
+
+    //! Unused bytes of a reserved header, skipped when writing to the stream.
+    struct Gap {
+        size_t position;
+        size_t length;
+    };
+
+    static const size_t kMaxHeaderSize = 5;
+
+    void PutByte(unsigned b) { *buffer_.template Push<unsigned char>() = static_cast<unsigned char>(b); }
+
+    void PutBig(uint64_t v, unsigned n) {
+        unsigned char* p = buffer_.template Push<unsigned char>(n);
+        for (unsigned i = n; i-- > 0; v >>= 8)
+            p[i] = static_cast<unsigned char>(v);
+    }
+
+    void WriteUnsigned(uint64_t u) {
+        if (u <= 0x7F)              PutByte(static_cast<unsigned>(u));
+        else if (u <= 0xFF)         { PutByte(0xCC); PutBig(u, 1); }
+        else if (u <= 0xFFFF)       { PutByte(0xCD); PutBig(u, 2); }
+        else if (u <= 0xFFFFFFFFu)  { PutByte(0xCE); PutBig(u, 4); }
+        else                        { PutByte(0xCF); PutBig(u, 8); }
+    }
+
+    void WriteSigned(int64_t i) {
+        const uint64_t u = static_cast<uint64_t>(i);
+        if (i >= 0)                         WriteUnsigned(u);
+        else if (i >= -32)                  PutByte(static_cast<unsigned>(u & 0xFF));
+        else if (i >= -128)                 { PutByte(0xD0); PutBig(u, 1); }
+        else if (i >= -32768)               { PutByte(0xD1); PutBig(u, 2); }
+        else if (i >= -2147483647 - 1)      { PutByte(0xD2); PutBig(u, 4); }
+        else                                { PutByte(0xD3); PutBig(u, 8); }
+    }
+
+    // Writes a header of a string (0xA0), array (0x90) or map (0x80), returning its size.
+    static size_t WriteHeader(unsigned char* p, unsigned fix, size_t count) {
+        const unsigned fixMax = fix == 0xA0 ? 31 : 15;
+        if (count <= fixMax) {
+            p[0] = static_cast<unsigned char>(fix | count);
+            return 1;
+        }
+        unsigned char type;
+        unsigned n;
+        if (fix == 0xA0 && count <= 0xFF) { type = 0xD9; n = 1; }
+        else if (count <= 0xFFFF)         { type = fix == 0xA0 ? 0xDA : fix == 0x90 ? 0xDC : 0xDE; n = 2; }
+        else                              { type = fix == 0xA0 ? 0xDB : fix == 0x90 ? 0xDD : 0xDF; n = 4; }
+        p[0] = type;
+        for (unsigned i = n; i > 0; i--, count >>= 8)
+            p[i] = static_cast<unsigned char>(count);
+        return 1 + n;
+    }
+
+    // Reserves the largest header, to be written by FillHeader().
+    size_t ReserveHeader() {
+        Gap* gap = gaps_.template Push<Gap>();
+        gap->position = buffer_.GetSize();
+        gap->length = kMaxHeaderSize;
+        buffer_.template Push<unsigned char>(kMaxHeaderSize);
+        return gaps_.GetSize() / sizeof(Gap) - 1;
+    }
+
+    // Writes a header at the end of its reserved space, leaving the gap in front.
+    void FillHeader(size_t gapIndex, unsigned fix, size_t count) {
+        Gap& gap = gaps_.template Bottom<Gap>()[gapIndex];
+        unsigned char header[kMaxHeaderSize];
+        const size_t size = WriteHeader(header, fix, count);
+        std::memcpy(buffer_.template Bottom<unsigned char>() + gap.position + kMaxHeaderSize - size, header, size);
+        gap.length = kMaxHeaderSize - size;
+    }
+
+    bool WriteString(const Ch* str, SizeType length) {
+        if (internal::IsSame<SourceEncoding, UTF8<> >::Value) {
+            unsigned char header[kMaxHeaderSize];
+            const size_t size = WriteHeader(header, 0xA0, length);
+            unsigned char* p = buffer_.template Push<unsigned char>(size + length);
+            std::memcpy(p, header, size);
+            std::memcpy(p + size, str, length);
+            return true;
+        }
+
+        // The length in UTF-8 is only known after transcoding
+        const size_t gap = ReserveHeader();
+        const size_t begin = buffer_.GetSize();
+        GenericStringStream<SourceEncoding> is(str);
+        ByteStream os(buffer_);
+        while (is.Tell() < length)
+            if (RAPIDJSON_UNLIKELY(!(Transcoder<SourceEncoding, UTF8<> >::Transcode(is, os))))
+                return false;
+        FillHeader(gap, 0xA0, buffer_.GetSize() - begin);
+        return true;
+    }
+
+    void StartContainer(bool map) {
+        const size_t gap = ReserveHeader();
+        Level* level = level_stack_.template Push<Level>();
+        level->valueCount = 0;
+        level->gap = gap;
+        level->map = map;
+    }
+
+    void EndContainer() {
+        const Level level = *level_stack_.template Pop<Level>(1);
+        FillHeader(level.gap, level.map ? 0x80 : 0x90, level.map ? level.valueCount / 2 : level.valueCount);
+    }
+
+    void Prefix(Type type) {
+        (void)type;
+        if (RAPIDJSON_LIKELY(!level_stack_.Empty())) {
+            Level* level = level_stack_.template Top<Level>();
+            if (level->map && level->valueCount % 2 == 0)
+                RAPIDJSON_ASSERT(type == kStringType);  // if it's in object, then even number should be a name
+            level->valueCount++;
+        }
+        else {
+            RAPIDJSON_ASSERT(!hasRoot_);    // Should only has one and only one root.
+            hasRoot_ = true;
+        }
+    }
+
+    // Writes the buffer to the stream, skipping the gaps, once the root is complete.
+    bool EndValue(bool ret = true) {
+        if (RAPIDJSON_UNLIKELY(level_stack_.Empty())) {
+            const unsigned char* p = buffer_.template Bottom<unsigned char>();
+            const Gap* gaps = gaps_.template Bottom<Gap>();
+            const size_t gapCount = gaps_.GetSize() / sizeof(Gap);
+            size_t size = buffer_.GetSize();
+            for (size_t i = 0; i < gapCount; i++)
+                size -= gaps[i].length;
+            PutReserve(*os_, size);
+            size_t position = 0;
+            for (size_t i = 0; i <= gapCount; i++) {
+                const size_t end = i < gapCount ? gaps[i].position : buffer_.GetSize();
+                for (; position < end; position++)
+                    PutUnsafe(*os_, static_cast<typename OutputStream::Ch>(p[position]));
+                if (i < gapCount)
+                    position += gaps[i].length;
+            }
+            buffer_.Clear();
+            gaps_.Clear();
+            os_->Flush();
+        }
+        return ret;
+    }
+
+    class ByteStream {
+    public:
+        typedef char Ch;
+        explicit ByteStream(internal::Stack<StackAllocator>& stack) : stack_(stack) {}
+        void Put(char c) { *stack_.template Push<char>() = c; }
+    private:
+        ByteStream& operator=(const ByteStream&);
+        internal::Stack<StackAllocator>& stack_;
+    };
+
+    OutputStream* os_;
+    internal::Stack<StackAllocator> buffer_;        //!< Output of the current root value
+    internal::Stack<StackAllocator> level_stack_;
+    internal::Stack<StackAllocator> gaps_;          //!< Reserved headers, in increasing positions
+    bool hasRoot_;
+};
+
+RAPIDJSON_NAMESPACE_END
+
+#ifdef __GNUC__
+RAPIDJSON_DIAG_POP
+#endif
+
+#endif // RAPIDJSON_MSGPACK_H_
@@ -0,0 +1,316 @@
+// Tencent is pleased to support the open source community by making RapidJSON available.
+//
+// Copyright (C) 2015 THL A29 Limited, a Tencent company, and Milo Yip. All rights reserved.
+//
+// Licensed under the MIT License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// http://opensource.org/licenses/MIT
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#ifndef RAPIDJSON_PARALLELWRITER_H_
+#define RAPIDJSON_PARALLELWRITER_H_
+
+#include "writer.h"
+#include "memorybuffer.h"
+
+#if RAPIDJSON_HAS_CXX11_RVALUE_REFS
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#ifdef __GNUC__
+RAPIDJSON_DIAG_PUSH
+RAPIDJSON_DIAG_OFF(effc++)
+#endif
+
+RAPIDJSON_NAMESPACE_BEGIN
+
+namespace internal {
+
+template <typename OutputStream, typename Ch>
+inline void PutString(OutputStream& os, const Ch* s, size_t length) {
+    for (size_t i = 0; i < length; i++)
+        PutUnsafe(os, static_cast<typename OutputStream::Ch>(s[i]));
+}
+
+template <typename Encoding, typename Allocator>
+inline void PutString(GenericStringBuffer<Encoding, Allocator>& os, const typename Encoding::Ch* s, size_t length) {
+    std::memcpy(os.Push(length), s, length * sizeof(typename Encoding::Ch));
+}
+
+template <typename Allocator>
+inline void PutString(GenericMemoryBuffer<Allocator>& os, const char* s, size_t length) {
+    std::memcpy(os.Push(length), s, length);
+}
+
+} // namespace internal
+
+//! Serializes a DOM tree on several threads.
+/*! Arrays and objects having at least \c chunkSize elements are split into ranges of
+    elements (or members). Each range is written by its own Writer into its own string buffer,
+    on a pool of threads, and the buffers are concatenated with the brackets and separators
+    in between. The output is byte-identical to the one of a Writer with the same template
+    arguments and the same maximum decimal places.
+
+    Containers with fewer elements are written by a single Writer, so the split only
+    happens along the large arrays and objects near the root. A document whose root is not
+    large, or any document when using a single thread, is written directly to the output stream.
+
+    \tparam SourceEncoding Encoding of both source strings.
+    \tparam TargetEncoding Encoding of output stream.
+    \tparam StackAllocator Type of allocator for allocating memory of the Writer stacks.
+    \tparam writeFlags Flags of the Writers, see \ref WriteFlag.
+    \note Requires C++11 threads. PrettyWriter is not supported.
+    \note Values must not be modified while they are written.
+*/
+template<typename SourceEncoding = UTF8<>, typename TargetEncoding = UTF8<>, typename StackAllocator = CrtAllocator, unsigned writeFlags = kWriteDefaultFlags>
+class ParallelWriter {
+public:
+    typedef typename SourceEncoding::Ch Ch;
+    typedef GenericStringBuffer<TargetEncoding, CrtAllocator> BufferType;
+    typedef Writer<BufferType, SourceEncoding, TargetEncoding, StackAllocator, writeFlags> WriterType;
+
+    static const size_t kDefaultChunkSize = 4096;
+
+    //! Constructor
+    /*! \param threadCount Number of threads writing, including the calling one. 0 for \c std::thread::hardware_concurrency().
+        \param chunkSize Minimum number of elements or members in a range written as one task.
+    */
+    explicit ParallelWriter(unsigned threadCount = 0, size_t chunkSize = kDefaultChunkSize) :
+        threadCount_(threadCount != 0 ? threadCount : std::thread::hardware_concurrency()),
+        chunkSize_(chunkSize), maxDecimalPlaces_(WriterType::kDefaultMaxDecimalPlaces), segments_(), buffers_(), next_(0), failed_(false)
+    {
+        RAPIDJSON_ASSERT(chunkSize_ > 0);
+        if (threadCount_ == 0)
+            threadCount_ = 1;
+        buffers_.resize(threadCount_);
+    }
+
+    int GetMaxDecimalPlaces() const { return maxDecimalPlaces_; }
+
+    //! Sets the maximum number of decimal places for double output, see Writer::SetMaxDecimalPlaces().
+    void SetMaxDecimalPlaces(int maxDecimalPlaces) { maxDecimalPlaces_ = maxDecimalPlaces; }
+
+    //! Writes a value to an output stream.
+    /*! \param os Output stream.
+        \param value Value to write, typically a Document.
+        \return Whether all the handlers of the Writers succeeded. On failure nothing is
+            written to \c os, unless the value was written directly.
+    */
+    template <typename OutputStream, typename ValueType>
+    bool Write(OutputStream& os, const ValueType& value) {
+        if (threadCount_ == 1 || !IsLarge(value)) {
+            Writer<OutputStream, SourceEncoding, TargetEncoding, StackAllocator, writeFlags> writer(os);
+            writer.SetMaxDecimalPlaces(maxDecimalPlaces_);
+            return value.Accept(writer);
+        }
+
+        segments_.clear();
+        Plan(value);
+        for (size_t i = 0; i < buffers_.size(); i++)
+            buffers_[i].Clear();
+        next_ = 0;
+        failed_ = false;
+
+        std::vector<std::thread> threads;
+        for (unsigned i = 1; i < threadCount_ && i < segments_.size(); i++)
+            threads.push_back(std::thread(&ParallelWriter::Work<ValueType>, this, i));
+        Work<ValueType>(0);
+        for (size_t i = 0; i < threads.size(); i++)
+            threads[i].join();
+
+        bool ret = !failed_;
+        if (ret) {
+            size_t length = 0;
+            for (size_t i = 0; i < segments_.size(); i++)
+                length += segments_[i].kind == kLiteral ? 1 : segments_[i].length;
+            PutReserve(os, length);
+            for (size_t i = 0; i < segments_.size(); i++) {
+                const Segment& seg = segments_[i];
+                if (seg.kind == kLiteral)
+                    PutUnsafe(os, static_cast<typename OutputStream::Ch>(seg.literal));
+                else
+                    internal::PutString(os, buffers_[seg.buffer].GetString() + seg.offset, seg.length);
+            }
+            os.Flush();
+        }
+
+        segments_.clear();
+        return ret;
+    }
+
+private:
+    ParallelWriter(const ParallelWriter&);
+    ParallelWriter& operator=(const ParallelWriter&);
+
+    enum SegmentKind {
+        kLiteral,   //!< A bracket or separator.
+        kKey,       //!< Name of a member whose value is split.
+        kElements,  //!< Range of array elements, written without brackets.
+        kMembers    //!< Range of object members, written without braces.
+    };
+
+    struct Segment {
+        SegmentKind kind;
+        char literal;
+        const void* value;  //!< Container or name, type-erased since Write() is a template.
+        SizeType begin;
+        SizeType end;
+        unsigned buffer;    //!< Index of the buffer of the thread which wrote the segment.
+        size_t offset;      //!< Position of the output in the buffer.
+        size_t length;      //!< Length of the output.
+    };
+
+    template <typename ValueType>
+    bool IsLarge(const ValueType& v) const {
+        return (v.IsArray() && v.Size() >= chunkSize_) || (v.IsObject() && v.MemberCount() >= chunkSize_);
+    }
+
+    template <typename ValueType>
+    static size_t Weight(const ValueType& v) {
+        return 1 + (v.IsArray() ? v.Size() : v.IsObject() ? v.MemberCount() : 0);
+    }
+
+    void AddLiteral(char c) {
+        Segment s = { kLiteral, c, 0, 0, 0, 0, 0, 0 };
+        segments_.push_back(s);
+    }
+
+    void AddRange(SegmentKind kind, const void* value, SizeType begin, SizeType end, bool& first) {
+        if (begin == end)
+            return;
+        if (!first)
+            AddLiteral(',');
+        first = false;
+        Segment s = { kind, '\0', value, begin, end, 0, 0, 0 };
+        segments_.push_back(s);
+    }
+
+    // Splits a large container, recursing into its large children.
+    template <typename ValueType>
+    void Plan(const ValueType& v) {
+        bool first = true;
+        SizeType begin = 0;
+        size_t weight = 0;
+        if (v.IsArray()) {
+            AddLiteral('[');
+            for (SizeType i = 0; i < v.Size(); i++) {
+                if (IsLarge(v[i])) {
+                    AddRange(kElements, &v, begin, i, first);
+                    if (!first)
+                        AddLiteral(',');
+                    first = false;
+                    Plan(v[i]);
+                    begin = i + 1;
+                    weight = 0;
+                }
+                else if ((weight += Weight(v[i])) >= chunkSize_) {
+                    AddRange(kElements, &v, begin, i + 1, first);
+                    begin = i + 1;
+                    weight = 0;
+                }
+            }
+            AddRange(kElements, &v, begin, v.Size(), first);
+            AddLiteral(']');
+        }
+        else {
+            RAPIDJSON_ASSERT(v.IsObject());
+            AddLiteral('{');
+            SizeType i = 0;
+            for (typename ValueType::ConstMemberIterator m = v.MemberBegin(); m != v.MemberEnd(); ++m, ++i) {
+                if (IsLarge(m->value)) {
+                    AddRange(kMembers, &v, begin, i, first);
+                    if (!first)
+                        AddLiteral(',');
+                    first = false;
+                    Segment s = { kKey, '\0', &m->name, 0, 0, 0, 0, 0 };
+                    segments_.push_back(s);
+                    AddLiteral(':');
+                    Plan(m->value);
+                    begin = i + 1;
+                    weight = 0;
+                }
+                else if ((weight += Weight(m->value)) >= chunkSize_) {
+                    AddRange(kMembers, &v, begin, i + 1, first);
+                    begin = i + 1;
+                    weight = 0;
+                }
+            }
+            AddRange(kMembers, &v, begin, i, first);
+            AddLiteral('}');
+        }
+    }
+
+    // Appends the segments taken by a thread to its own buffer.
+    template <typename ValueType>
+    void Work(unsigned thread) {
+        BufferType& buffer = buffers_[thread];
+        for (size_t i; !failed_ && (i = next_++) < segments_.size(); ) {
+            Segment& s = segments_[i];
+            if (s.kind == kLiteral)
+                continue;
+            const size_t offset = buffer.GetLength();
+            if (!Run<ValueType>(s, buffer)) {
+                failed_ = true;
+                break;
+            }
+            // Ranges are written as complete arrays or objects, drop their brackets
+            const size_t trim = s.kind == kKey ? 0 : 1;
+            s.buffer = thread;
+            s.offset = offset + trim;
+            s.length = buffer.GetLength() - offset - 2 * trim;
+        }
+    }
+
+    template <typename ValueType>
+    bool Run(const Segment& s, BufferType& buffer) const {
+        WriterType writer(buffer);
+        writer.SetMaxDecimalPlaces(maxDecimalPlaces_);
+        const ValueType& v = *static_cast<const ValueType*>(s.value);
+        switch (s.kind) {
+        case kKey:
+            return writer.String(v.GetString(), v.GetStringLength());
+
+        case kElements:
+            writer.StartArray();
+            for (SizeType i = s.begin; i < s.end; i++)
+                if (RAPIDJSON_UNLIKELY(!v[i].Accept(writer)))
+                    return false;
+            return writer.EndArray();
+
+        default:
+            RAPIDJSON_ASSERT(s.kind == kMembers);
+            writer.StartObject();
+            for (typename ValueType::ConstMemberIterator m = v.MemberBegin() + s.begin; m != v.MemberBegin() + s.end; ++m) {
+                if (RAPIDJSON_UNLIKELY(!writer.Key(m->name.GetString(), m->name.GetStringLength())))
+                    return false;
+                if (RAPIDJSON_UNLIKELY(!m->value.Accept(writer)))
+                    return false;
+            }
+            return writer.EndObject();
+        }
+    }
+
+    unsigned threadCount_;
+    size_t chunkSize_;
+    int maxDecimalPlaces_;
+    std::vector<Segment> segments_;
+    std::vector<BufferType> buffers_;
+    std::atomic<size_t> next_;
+    std::atomic<bool> failed_;
+};
+
+RAPIDJSON_NAMESPACE_END
+
+#ifdef __GNUC__
+RAPIDJSON_DIAG_POP
+#endif
+
+#endif // RAPIDJSON_HAS_CXX11_RVALUE_REFS
+
+#endif // RAPIDJSON_PARALLELWRITER_H_
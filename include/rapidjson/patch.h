@@ -0,0 +1,457 @@
+// Tencent is pleased to support the open source community by making RapidJSON available.
+//
+// Copyright (C) 2015 THL A29 Limited, a Tencent company, and Milo Yip. All rights reserved.
+//
+// Licensed under the MIT License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// http://opensource.org/licenses/MIT
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#ifndef RAPIDJSON_PATCH_H_
+#define RAPIDJSON_PATCH_H_
+
+#include "pointer.h"
+#include "internal/stack.h"
+
+#ifdef _MSC_VER
+RAPIDJSON_DIAG_PUSH
+RAPIDJSON_DIAG_OFF(4512) // assignment operator could not be generated
+#endif
+
+RAPIDJSON_NAMESPACE_BEGIN
+
+//! Error code of applying a JSON patch.
+/*! \ingroup RAPIDJSON_ERRORS
+    \see GenericPatchApplier::GetErrorCode
+*/
+enum PatchErrorCode {
+    kPatchErrorNone = 0,            //!< All operations are applied
+
+    kPatchErrorInvalidPatch,        //!< The patch is not an array
+    kPatchErrorInvalidOperation,    //!< An operation is malformed, e.g. unknown "op", missing member or invalid pointer
+    kPatchErrorPathNotFound,        //!< The target location, or the parent of a location to be added, does not exist
+    kPatchErrorMoveIntoChild,       //!< A "move" operation moves a value into one of its children
+    kPatchErrorTestFailed           //!< A "test" operation fails
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// GenericPatchApplier
+
+//! Applies JSON patches (RFC 6902) to DOM trees.
+/*!
+    Each operation is applied in order. Instead of resolving every path from the root,
+    the applier caches the values along the last resolved path. The next path only resolves
+    the tokens after its common prefix with the cached one, unless an operation has modified
+    a container on that prefix. Therefore batches of operations on nearby locations, e.g.
+    many members of the same object, resolve the shared parents once.
+
+    A "move" operation swaps the value out of its source, so no value is deep copied.
+    The "value" of "add" and "replace" operations are copied into the allocator of the
+    patched tree by Apply(). ApplyMove() moves them out of the patch instead, leaving them
+    null, which is only valid when the patch uses the allocator of the patched tree.
+
+    \code
+    Document d;
+    d.Parse("{\"a\":[1,2]}");
+    Document patch;
+    patch.Parse("[{\"op\":\"add\",\"path\":\"/a/-\",\"value\":3},{\"op\":\"move\",\"from\":\"/a\",\"path\":\"/b\"}]");
+    PatchApplier applier;
+    if (!applier.Apply(d, patch))
+        printf("Operation %u failed with error %d\n", applier.GetErrorOperation(), applier.GetErrorCode());
+    \endcode
+
+    \note Unlike RFC 6902, a patch is not applied atomically. If an operation fails, the
+    operations before it remain applied.
+
+    \tparam ValueType Type of the DOM values. E.g. GenericValue<UTF8<> >
+    \tparam Allocator Allocator type for the internal states.
+*/
+template <typename ValueType, typename Allocator = CrtAllocator>
+class GenericPatchApplier {
+public:
+    typedef typename ValueType::EncodingType EncodingType;  //!< Encoding type from Value
+    typedef typename ValueType::Ch Ch;                      //!< Character type from Value
+    typedef typename ValueType::AllocatorType ValueAllocatorType;
+
+    //! Constructor.
+    /*!
+        \param allocator An optional allocator for the internal states. Can be null.
+    */
+    explicit GenericPatchApplier(Allocator* allocator = 0) :
+        pool_(poolBuffer_, sizeof(poolBuffer_), kDefaultPoolChunkCapacity, allocator),
+        entries_(allocator, kDefaultEntryCapacity * sizeof(Entry)),
+        cachedPath_(),
+        cachedPathLength_(),
+        errorCode_(kPatchErrorNone),
+        errorOperation_()
+    {
+    }
+
+    //! Apply a patch to a subtree, copying the values from the patch.
+    /*!
+        \param root Root value of a DOM subtree to be patched.
+        \param patch An array of operations. The "value" of "add" and "replace" operations are copied into root.
+        \param allocator Allocator of root.
+        \return Whether all operations are applied.
+    */
+    bool Apply(ValueType& root, const ValueType& patch, ValueAllocatorType& allocator) {
+        return ApplyOperations(root, patch, allocator);
+    }
+
+    //! Apply a patch to a document, copying the values from the patch.
+    template <typename stackAllocator>
+    bool Apply(GenericDocument<EncodingType, ValueAllocatorType, stackAllocator>& document, const ValueType& patch) {
+        return Apply(document, patch, document.GetAllocator());
+    }
+
+    //! Apply a patch to a subtree, moving the values out of the patch.
+    /*!
+        \param root Root value of a DOM subtree to be patched.
+        \param patch An array of operations. The "value" of "add" and "replace" operations are moved into root.
+        \param allocator Allocator of root.
+        \return Whether all operations are applied.
+        \pre The patch uses \c allocator, e.g. it was built with the allocator of the patched
+            document, as moved values keep referring to the memory of the patch.
+    */
+    bool ApplyMove(ValueType& root, ValueType& patch, ValueAllocatorType& allocator) {
+        return ApplyOperations(root, patch, allocator);
+    }
+
+    //! Apply a patch to a document, moving the values out of the patch.
+    /*! \pre The patch uses the allocator of the document.
+    */
+    template <typename stackAllocator>
+    bool ApplyMove(GenericDocument<EncodingType, ValueAllocatorType, stackAllocator>& document, ValueType& patch) {
+        return ApplyMove(document, patch, document.GetAllocator());
+    }
+
+    //! Get the error code of the last Apply().
+    PatchErrorCode GetErrorCode() const { return errorCode_; }
+
+    //! Get the index of the failed operation in the last Apply().
+    SizeType GetErrorOperation() const { return errorOperation_; }
+
+private:
+    //! Prohibit copying
+    GenericPatchApplier(const GenericPatchApplier&);
+    //! Prohibit assignment
+    GenericPatchApplier& operator=(const GenericPatchApplier&);
+
+    typedef MemoryPoolAllocator<Allocator> PoolAllocatorType;
+    typedef GenericPointer<ValueType, PoolAllocatorType> PointerType;
+    typedef typename PointerType::Token Token;
+
+    static const size_t kPoolBufferSize = 1024;
+    static const size_t kDefaultPoolChunkCapacity = 4096;
+    static const size_t kDefaultEntryCapacity = 16;
+
+    //! A resolved value along the cached path.
+    struct Entry {
+        ValueType* value;
+        SizeType end;       //!< Offset in the cached path after the token of this value.
+    };
+
+    // The values are moved out of a ValueType patch, and copied out of a const ValueType one.
+    template <typename PatchValueType>
+    bool ApplyOperations(ValueType& root, PatchValueType& patch, ValueAllocatorType& allocator) {
+        errorCode_ = kPatchErrorNone;
+        errorOperation_ = 0;
+        if (!patch.IsArray())
+            return Error(kPatchErrorInvalidPatch, 0);
+
+        entries_.Clear();
+        Entry* e = entries_.template Push<Entry>();
+        e->value = &root;
+        e->end = 0;
+        cachedPath_ = 0;
+        cachedPathLength_ = 0;
+
+        for (SizeType i = 0; i < patch.Size(); i++) {
+            pool_.Clear();
+            PatchErrorCode code = ApplyOperation(root, patch[i], allocator);
+            if (code != kPatchErrorNone)
+                return Error(code, i);
+        }
+        pool_.Clear();
+        return true;
+    }
+
+    bool Error(PatchErrorCode code, SizeType operation) {
+        errorCode_ = code;
+        errorOperation_ = operation;
+        return false;
+    }
+
+    template <typename PatchValueType>
+    PatchErrorCode ApplyOperation(ValueType& root, PatchValueType& op, ValueAllocatorType& allocator) {
+        static const Ch kOp[] = { 'o', 'p', '\0' };
+        static const Ch kPath[] = { 'p', 'a', 't', 'h', '\0' };
+        static const Ch kFrom[] = { 'f', 'r', 'o', 'm', '\0' };
+        static const Ch kValue[] = { 'v', 'a', 'l', 'u', 'e', '\0' };
+        static const Ch kAdd[] = { 'a', 'd', 'd', '\0' };
+        static const Ch kRemove[] = { 'r', 'e', 'm', 'o', 'v', 'e', '\0' };
+        static const Ch kReplace[] = { 'r', 'e', 'p', 'l', 'a', 'c', 'e', '\0' };
+        static const Ch kMove[] = { 'm', 'o', 'v', 'e', '\0' };
+        static const Ch kCopy[] = { 'c', 'o', 'p', 'y', '\0' };
+        static const Ch kTest[] = { 't', 'e', 's', 't', '\0' };
+
+        if (!op.IsObject())
+            return kPatchErrorInvalidOperation;
+        PatchValueType* name = GetMember(op, kOp);
+        PatchValueType* path = GetMember(op, kPath);
+        if (!name || !name->IsString() || !path || !path->IsString())
+            return kPatchErrorInvalidOperation;
+        PointerType pointer(path->GetString(), path->GetStringLength(), &pool_);
+        if (!pointer.IsValid())
+            return kPatchErrorInvalidOperation;
+
+        if (*name == GenericStringRef<Ch>(kRemove))
+            return Remove(root, *path, pointer, 0);
+
+        if (*name == GenericStringRef<Ch>(kMove) || *name == GenericStringRef<Ch>(kCopy)) {
+            PatchValueType* from = GetMember(op, kFrom);
+            if (!from || !from->IsString())
+                return kPatchErrorInvalidOperation;
+            PointerType fromPointer(from->GetString(), from->GetStringLength(), &pool_);
+            if (!fromPointer.IsValid())
+                return kPatchErrorInvalidOperation;
+
+            ValueType v;
+            if (*name == GenericStringRef<Ch>(kMove)) {
+                if (IsPrefix(fromPointer, pointer)) {
+                    if (fromPointer.GetTokenCount() != pointer.GetTokenCount())
+                        return kPatchErrorMoveIntoChild;
+                    return Resolve(root, *from, fromPointer, fromPointer.GetTokenCount()) ? kPatchErrorNone : kPatchErrorPathNotFound;
+                }
+                PatchErrorCode code = Remove(root, *from, fromPointer, &v);
+                if (code != kPatchErrorNone)
+                    return code;
+            }
+            else {
+                ValueType* source = Resolve(root, *from, fromPointer, fromPointer.GetTokenCount());
+                if (!source)
+                    return kPatchErrorPathNotFound;
+                v.CopyFrom(*source, allocator);
+            }
+            return Add(root, *path, pointer, v, allocator);
+        }
+
+        PatchValueType* value = GetMember(op, kValue);
+        if (!value)
+            return kPatchErrorInvalidOperation;
+
+        if (*name == GenericStringRef<Ch>(kTest)) {
+            ValueType* target = Resolve(root, *path, pointer, pointer.GetTokenCount());
+            if (!target)
+                return kPatchErrorPathNotFound;
+            return *target == *value ? kPatchErrorNone : kPatchErrorTestFailed;
+        }
+
+        bool isAdd = *name == GenericStringRef<Ch>(kAdd);
+        if (!isAdd && !(*name == GenericStringRef<Ch>(kReplace)))
+            return kPatchErrorInvalidOperation;
+
+        ValueType v;
+        TakeValue(v, *value, allocator);
+
+        if (isAdd)
+            return Add(root, *path, pointer, v, allocator);
+
+        ValueType* target = Resolve(root, *path, pointer, pointer.GetTokenCount());
+        if (!target)
+            return kPatchErrorPathNotFound;
+        *target = v;
+        Invalidate(pointer.GetTokenCount());
+        return kPatchErrorNone;
+    }
+
+    //! Add a value at a location, with move semantics.
+    PatchErrorCode Add(ValueType& root, const ValueType& path, const PointerType& pointer, ValueType& value, ValueAllocatorType& allocator) {
+        size_t depth = pointer.GetTokenCount();
+        if (depth == 0) {
+            root = value;
+            Invalidate(0);
+            return kPatchErrorNone;
+        }
+
+        ValueType* parent = Resolve(root, path, pointer, depth - 1);
+        if (!parent)
+            return kPatchErrorPathNotFound;
+        const Token& t = pointer.GetTokens()[depth - 1];
+        if (parent->IsObject()) {
+            typename ValueType::MemberIterator m = FindMember(*parent, t);
+            if (m != parent->MemberEnd())
+                m->value = value;
+            else
+                parent->AddMember(ValueType(t.name, t.length, allocator).Move(), value, allocator);
+        }
+        else if (parent->IsArray()) {
+            if (t.length == 1 && t.name[0] == '-')
+                parent->PushBack(value, allocator);
+            else if (t.index == kPointerInvalidIndex || t.index > parent->Size())
+                return kPatchErrorPathNotFound;
+            else {
+                parent->PushBack(value, allocator);
+                for (SizeType i = parent->Size() - 1; i > t.index; i--)
+                    (*parent)[i].Swap((*parent)[i - 1]);
+            }
+        }
+        else
+            return kPatchErrorPathNotFound;
+
+        Invalidate(depth - 1);
+        return kPatchErrorNone;
+    }
+
+    //! Remove the value at a location, optionally moving it to removed.
+    PatchErrorCode Remove(ValueType& root, const ValueType& path, const PointerType& pointer, ValueType* removed) {
+        size_t depth = pointer.GetTokenCount();
+        if (depth == 0)
+            return kPatchErrorInvalidOperation; // Cannot remove the root
+
+        ValueType* parent = Resolve(root, path, pointer, depth - 1);
+        if (!parent)
+            return kPatchErrorPathNotFound;
+        const Token& t = pointer.GetTokens()[depth - 1];
+        if (parent->IsObject()) {
+            typename ValueType::MemberIterator m = FindMember(*parent, t);
+            if (m == parent->MemberEnd())
+                return kPatchErrorPathNotFound;
+            if (removed)
+                removed->Swap(m->value);
+            parent->EraseMember(m);
+        }
+        else if (parent->IsArray()) {
+            if (t.index == kPointerInvalidIndex || t.index >= parent->Size())
+                return kPatchErrorPathNotFound;
+            if (removed)
+                removed->Swap((*parent)[t.index]);
+            parent->Erase(parent->Begin() + t.index);
+        }
+        else
+            return kPatchErrorPathNotFound;
+
+        Invalidate(depth - 1);
+        return kPatchErrorNone;
+    }
+
+    //! Resolve the first depth tokens of a pointer, reusing the values cached along the last resolved path.
+    /*!
+        Values are cached by the source string of the path. Tokens with identical source are identical,
+        so a token is reused when both paths have the same source up to the end of that token.
+    */
+    ValueType* Resolve(ValueType& root, const ValueType& path, const PointerType& pointer, size_t depth) {
+        RAPIDJSON_ASSERT(depth <= pointer.GetTokenCount());
+        const Ch* s = path.GetString();
+        SizeType length = path.GetStringLength();
+
+        // Length of the common source prefix
+        SizeType common = 0;
+        if (cachedPath_) {
+            SizeType n = length < cachedPathLength_ ? length : cachedPathLength_;
+            while (common < n && s[common] == cachedPath_[common])
+                common++;
+        }
+
+        // Number of reusable tokens
+        size_t count = entries_.GetSize() / sizeof(Entry);
+        Entry* entries = entries_.template Bottom<Entry>();
+        size_t k = 0;
+        while (k < depth && k + 1 < count && entries[k + 1].end <= common && (entries[k + 1].end == length || s[entries[k + 1].end] == '/'))
+            k++;
+        entries_.template Pop<Entry>(count - (k + 1));
+        cachedPath_ = s;
+        cachedPathLength_ = length;
+
+        // Offset after token k
+        SizeType end = entries[k].end;
+        if (k == 0)
+            end = (length > 0 && s[0] == '#') ? 1 : 0;
+
+        ValueType* v = entries[k].value;
+        RAPIDJSON_ASSERT(k > 0 || v == &root);
+        (void)root;
+        for (const Token* t = pointer.GetTokens() + k; t != pointer.GetTokens() + depth; ++t) {
+            v = GetChild(*v, *t);
+            if (!v)
+                return 0;
+            // Skip the '/' of this token, and find the next '/'
+            for (end++; end < length && s[end] != '/'; end++)
+                ;
+            Entry* e = entries_.template Push<Entry>();
+            e->value = v;
+            e->end = end;
+        }
+        return v;
+    }
+
+    //! Invalidate the cached values inside the container at depth, as its storage of children may be reallocated.
+    void Invalidate(size_t depth) {
+        size_t count = entries_.GetSize() / sizeof(Entry);
+        if (count > depth + 1)
+            entries_.template Pop<Entry>(count - (depth + 1));
+    }
+
+    static ValueType* GetChild(ValueType& v, const Token& t) {
+        if (v.IsObject()) {
+            typename ValueType::MemberIterator m = FindMember(v, t);
+            return m != v.MemberEnd() ? &m->value : 0;
+        }
+        if (v.IsArray() && t.index != kPointerInvalidIndex && t.index < v.Size())
+            return &v[t.index];
+        return 0;
+    }
+
+    static typename ValueType::MemberIterator FindMember(ValueType& v, const Token& t) {
+        return v.FindMember(ValueType(GenericStringRef<Ch>(t.name, t.length))); // Name may contain null character
+    }
+
+    static ValueType* GetMember(ValueType& op, const Ch* name) {
+        typename ValueType::MemberIterator m = op.FindMember(name);
+        return m != op.MemberEnd() ? &m->value : 0;
+    }
+
+    static const ValueType* GetMember(const ValueType& op, const Ch* name) {
+        typename ValueType::ConstMemberIterator m = op.FindMember(name);
+        return m != op.MemberEnd() ? &m->value : 0;
+    }
+
+    static void TakeValue(ValueType& v, ValueType& value, ValueAllocatorType&) { v.Swap(value); }
+    static void TakeValue(ValueType& v, const ValueType& value, ValueAllocatorType& allocator) { v.CopyFrom(value, allocator); }
+
+    static bool IsPrefix(const PointerType& prefix, const PointerType& pointer) {
+        if (prefix.GetTokenCount() > pointer.GetTokenCount())
+            return false;
+        for (size_t i = 0; i < prefix.GetTokenCount(); i++) {
+            const Token& a = prefix.GetTokens()[i];
+            const Token& b = pointer.GetTokens()[i];
+            if (a.length != b.length || std::memcmp(a.name, b.name, sizeof(Ch) * a.length) != 0)
+                return false;
+        }
+        return true;
+    }
+
+    char poolBuffer_[kPoolBufferSize];      //!< Initial buffer of pool_, so that short pointers do not allocate.
+    PoolAllocatorType pool_;                //!< Allocator of the pointers of one operation.
+    internal::Stack<Allocator> entries_;    //!< Values along the cached path (Entry), the first is the root.
+    const Ch* cachedPath_;                  //!< Source string of the cached path.
+    SizeType cachedPathLength_;
+    PatchErrorCode errorCode_;
+    SizeType errorOperation_;
+};
+
+//! GenericPatchApplier for Value (UTF-8, default allocator).
+typedef GenericPatchApplier<Value> PatchApplier;
+
+RAPIDJSON_NAMESPACE_END
+
+#ifdef _MSC_VER
+RAPIDJSON_DIAG_POP
+#endif
+
+#endif // RAPIDJSON_PATCH_H_
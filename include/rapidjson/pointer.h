@@ -45,6 +45,9 @@ enum PointerParseErrorCode {
     kPointerParseErrorCharacterMustPercentEncode    //!< A character must percent encoded in URI fragment
 };
 
+template <typename ValueType>
+class GenericPointerView;
+
 ///////////////////////////////////////////////////////////////////////////////
 // GenericPointer
 
@@ -83,6 +86,8 @@ public:
     typedef typename ValueType::EncodingType EncodingType;  //!< Encoding type from Value
     typedef typename ValueType::Ch Ch;                      //!< Character type from Value
 
+    template <typename> friend class GenericPointerView;
+
     //! A token is the basic units of internal representation.
     /*!
         A JSON pointer string representation "/foo/123" is parsed to two tokens: 
@@ -477,33 +482,7 @@ public:
         Use unresolvedTokenIndex to retrieve the token index.
     */
     ValueType* Get(ValueType& root, size_t* unresolvedTokenIndex = 0) const {
-        RAPIDJSON_ASSERT(IsValid());
-        ValueType* v = &root;
-        for (const Token *t = tokens_; t != tokens_ + tokenCount_; ++t) {
-            switch (v->GetType()) {
-            case kObjectType:
-                {
-                    typename ValueType::MemberIterator m = v->FindMember(GenericStringRef<Ch>(t->name, t->length));
-                    if (m == v->MemberEnd())
-                        break;
-                    v = &m->value;
-                }
-                continue;
-            case kArrayType:
-                if (t->index == kPointerInvalidIndex || t->index >= v->Size())
-                    break;
-                v = &((*v)[t->index]);
-                continue;
-            default:
-                break;
-            }
-
-            // Error: unresolved token
-            if (unresolvedTokenIndex)
-                *unresolvedTokenIndex = static_cast<size_t>(t - tokens_);
-            return 0;
-        }
-        return v;
+        return DoGet(root, unresolvedTokenIndex);
     }
 
     //! Query a const value in a const subtree.
@@ -512,7 +491,7 @@ public:
         \return Pointer to the value if it can be resolved. Otherwise null.
     */
     const ValueType* Get(const ValueType& root, size_t* unresolvedTokenIndex = 0) const { 
-        return Get(const_cast<ValueType&>(root), unresolvedTokenIndex);
+        return DoGet(root, unresolvedTokenIndex);
     }
 
     //@}
@@ -749,6 +728,39 @@ public:
     }
 
 private:
+    //! Resolve the pointer in a subtree, with const access for a const \c V so that shared subtrees are not copied.
+    template <typename V>
+    V* DoGet(V& root, size_t* unresolvedTokenIndex) const {
+        typedef typename internal::SelectIf<internal::IsConst<V>, typename ValueType::ConstMemberIterator, typename ValueType::MemberIterator>::Type MemberIterator;
+        RAPIDJSON_ASSERT(IsValid());
+        V* v = &root;
+        for (const Token *t = tokens_; t != tokens_ + tokenCount_; ++t) {
+            switch (v->GetType()) {
+            case kObjectType:
+                {
+                    MemberIterator m = v->FindMember(GenericStringRef<Ch>(t->name, t->length));
+                    if (m == v->MemberEnd())
+                        break;
+                    v = &m->value;
+                }
+                continue;
+            case kArrayType:
+                if (t->index == kPointerInvalidIndex || t->index >= v->Size())
+                    break;
+                v = &((*v)[t->index]);
+                continue;
+            default:
+                break;
+            }
+
+            // Error: unresolved token
+            if (unresolvedTokenIndex)
+                *unresolvedTokenIndex = static_cast<size_t>(t - tokens_);
+            return 0;
+        }
+        return v;
+    }
+
     //! Clone the content from rhs to this.
     /*!
         \param rhs Source pointer.
@@ -787,7 +799,7 @@ private:
         According to RFC 3986 2.3 Unreserved Characters.
         \param c The character (code unit) to be tested.
     */
-    bool NeedPercentEncode(Ch c) const {
+    static bool NeedPercentEncode(Ch c) {
         return !((c >= '0' && c <= '9') || (c >= 'A' && c <='Z') || (c >= 'a' && c <= 'z') || c == '-' || c == '.' || c == '_' || c =='~');
     }
 
@@ -1048,6 +1060,513 @@ private:
 //! GenericPointer for Value (UTF-8, default allocator).
 typedef GenericPointer<Value> Pointer;
 
+///////////////////////////////////////////////////////////////////////////////
+// GenericPointerView
+
+//! A non-owning JSON pointer which tokenizes its source lazily during resolution.
+/*!
+    Unlike GenericPointer, it does not allocate a token array nor a name buffer.
+    The source is only validated at construction, and each token is decoded
+    on the fly while resolving. Tokens without escapes are compared in place,
+    so that a query with a literal pointer string does no heap allocation.
+
+    It is suitable for one-off queries. For a pointer which is used repeatedly,
+    GenericPointer is faster as it decodes the tokens once.
+
+    \note The source string must outlive the view.
+    \tparam ValueType The value type of the DOM tree. E.g. GenericValue<UTF8<> >
+    \see GenericPointer
+*/
+template <typename ValueType>
+class GenericPointerView {
+public:
+    typedef typename ValueType::EncodingType EncodingType;  //!< Encoding type from Value
+    typedef typename ValueType::Ch Ch;                      //!< Character type from Value
+
+    //! Constructor with a null-terminated string or URI fragment representation.
+    explicit GenericPointerView(const Ch* source) : source_(source), end_(source + internal::StrLen(source)), begin_(), uriFragment_(), parseErrorOffset_(), parseErrorCode_(kPointerParseErrorNone) {
+        Validate();
+    }
+
+#if RAPIDJSON_HAS_STDSTRING
+    //! Constructor with a string or URI fragment representation.
+    /*!
+        \note Requires the definition of the preprocessor symbol \ref RAPIDJSON_HAS_STDSTRING.
+    */
+    explicit GenericPointerView(const std::basic_string<Ch>& source) : source_(source.data()), end_(source.data() + source.size()), begin_(), uriFragment_(), parseErrorOffset_(), parseErrorCode_(kPointerParseErrorNone) {
+        Validate();
+    }
+#endif
+
+    //! Constructor with a string or URI fragment representation, and its length.
+    GenericPointerView(const Ch* source, size_t length) : source_(source), end_(source + length), begin_(), uriFragment_(), parseErrorOffset_(), parseErrorCode_(kPointerParseErrorNone) {
+        Validate();
+    }
+
+    //! Check whether this is a valid pointer.
+    bool IsValid() const { return parseErrorCode_ == kPointerParseErrorNone; }
+
+    //! Get the parsing error offset in code unit.
+    size_t GetParseErrorOffset() const { return parseErrorOffset_; }
+
+    //! Get the parsing error code.
+    PointerParseErrorCode GetParseErrorCode() const { return parseErrorCode_; }
+
+    //! Create a value in a subtree. \see GenericPointer::Create()
+    ValueType& Create(ValueType& root, typename ValueType::AllocatorType& allocator, bool* alreadyExist = 0) const {
+        RAPIDJSON_ASSERT(IsValid());
+        static const Ch kDash[] = { '-' };
+        ValueType* v = &root;
+        bool exist = true;
+        Token t;
+        for (const Ch* cursor = begin_; NextToken(cursor, t);) {
+            if (v->IsArray() && Equals(t, kDash, 1)) {
+                v->PushBack(ValueType().Move(), allocator);
+                v = &((*v)[v->Size() - 1]);
+                exist = false;
+            }
+            else {
+                SizeType index = GetIndex(t);
+                if (index == kPointerInvalidIndex) { // must be object name
+                    if (!v->IsObject())
+                        v->SetObject(); // Change to Object
+                }
+                else { // object name or array index
+                    if (!v->IsArray() && !v->IsObject())
+                        v->SetArray(); // Change to Array
+                }
+
+                if (v->IsArray()) {
+                    if (index >= v->Size()) {
+                        v->Reserve(index + 1, allocator);
+                        while (index >= v->Size())
+                            v->PushBack(ValueType().Move(), allocator);
+                        exist = false;
+                    }
+                    v = &((*v)[index]);
+                }
+                else {
+                    typename ValueType::MemberIterator m = FindMember(*v, t);
+                    if (m == v->MemberEnd()) {
+                        ValueType name;
+                        CreateName(t, name, allocator);
+                        v->AddMember(name, ValueType().Move(), allocator);
+                        v = &(--v->MemberEnd())->value; // Assumes AddMember() appends at the end
+                        exist = false;
+                    }
+                    else
+                        v = &m->value;
+                }
+            }
+        }
+
+        if (alreadyExist)
+            *alreadyExist = exist;
+
+        return *v;
+    }
+
+    //! Create a value in a document.
+    template <typename stackAllocator>
+    ValueType& Create(GenericDocument<EncodingType, typename ValueType::AllocatorType, stackAllocator>& document, bool* alreadyExist = 0) const {
+        return Create(document, document.GetAllocator(), alreadyExist);
+    }
+
+    //! Query a value in a subtree. \see GenericPointer::Get()
+    ValueType* Get(ValueType& root, size_t* unresolvedTokenIndex = 0) const {
+        return DoGet(root, unresolvedTokenIndex);
+    }
+
+    //! Query a const value in a const subtree.
+    const ValueType* Get(const ValueType& root, size_t* unresolvedTokenIndex = 0) const {
+        return DoGet(root, unresolvedTokenIndex);
+    }
+
+    //! Query a value in a read-only view of a tree, such as GenericBinaryImageValue.
+    /*!
+        The view is a handle held by value, which provides the read-only interface of
+        GenericValue used here: GetType(), Size(), operator[](SizeType), MemberBegin(),
+        MemberEnd() and FindMember(const Ch*, SizeType).
+        \param root Root of the subtree to search.
+        \param result Receives the value pointed to, if any.
+        \param unresolvedTokenIndex If the pointer cannot resolve a token, receives its index.
+        \return Whether the value exists.
+    */
+    template <typename View>
+    bool GetView(const View& root, View& result, size_t* unresolvedTokenIndex = 0) const {
+        RAPIDJSON_ASSERT(IsValid());
+        View v = root;
+        size_t tokenIndex = 0;
+        Token t;
+        for (const Ch* cursor = begin_; NextToken(cursor, t); tokenIndex++) {
+            switch (v.GetType()) {
+            case kObjectType:
+                {
+                    typename View::ConstMemberIterator m = v.MemberEnd();
+                    if (!t.escaped)
+                        m = v.FindMember(t.begin, static_cast<SizeType>(t.end - t.begin));
+                    else {
+                        SizeType length = GetLength(t);
+                        for (m = v.MemberBegin(); m != v.MemberEnd(); ++m)
+                            if (m->name.GetStringLength() == length && Equals(t, m->name.GetString(), length))
+                                break;
+                    }
+                    if (m == v.MemberEnd())
+                        break;
+                    v = m->value;
+                }
+                continue;
+            case kArrayType:
+                {
+                    SizeType index = GetIndex(t);
+                    if (index == kPointerInvalidIndex || index >= v.Size())
+                        break;
+                    v = v[index];
+                }
+                continue;
+            default:
+                break;
+            }
+
+            // Error: unresolved token
+            if (unresolvedTokenIndex)
+                *unresolvedTokenIndex = tokenIndex;
+            return false;
+        }
+        result = v;
+        return true;
+    }
+
+    //! Set a value in a subtree, with move semantics. \see GenericPointer::Set()
+    ValueType& Set(ValueType& root, ValueType& value, typename ValueType::AllocatorType& allocator) const {
+        return Create(root, allocator) = value;
+    }
+
+    //! Set a value in a subtree, with copy semantics.
+    ValueType& Set(ValueType& root, const ValueType& value, typename ValueType::AllocatorType& allocator) const {
+        return Create(root, allocator).CopyFrom(value, allocator);
+    }
+
+    //! Set a null-terminated string in a subtree.
+    ValueType& Set(ValueType& root, const Ch* value, typename ValueType::AllocatorType& allocator) const {
+        return Create(root, allocator) = ValueType(value, allocator).Move();
+    }
+
+#if RAPIDJSON_HAS_STDSTRING
+    //! Set a std::basic_string in a subtree.
+    ValueType& Set(ValueType& root, const std::basic_string<Ch>& value, typename ValueType::AllocatorType& allocator) const {
+        return Create(root, allocator) = ValueType(value, allocator).Move();
+    }
+#endif
+
+    //! Set a primitive value in a subtree.
+    template <typename T>
+    RAPIDJSON_DISABLEIF_RETURN((internal::OrExpr<internal::IsPointer<T>, internal::IsGenericValue<T> >), (ValueType&))
+    Set(ValueType& root, T value, typename ValueType::AllocatorType& allocator) const {
+        return Create(root, allocator) = ValueType(value).Move();
+    }
+
+    //! Set a value in a document, with move semantics.
+    template <typename stackAllocator>
+    ValueType& Set(GenericDocument<EncodingType, typename ValueType::AllocatorType, stackAllocator>& document, ValueType& value) const {
+        return Create(document) = value;
+    }
+
+    //! Set a value in a document, with copy semantics.
+    template <typename stackAllocator>
+    ValueType& Set(GenericDocument<EncodingType, typename ValueType::AllocatorType, stackAllocator>& document, const ValueType& value) const {
+        return Create(document).CopyFrom(value, document.GetAllocator());
+    }
+
+    //! Set a null-terminated string in a document.
+    template <typename stackAllocator>
+    ValueType& Set(GenericDocument<EncodingType, typename ValueType::AllocatorType, stackAllocator>& document, const Ch* value) const {
+        return Create(document) = ValueType(value, document.GetAllocator()).Move();
+    }
+
+#if RAPIDJSON_HAS_STDSTRING
+    //! Sets a std::basic_string in a document.
+    template <typename stackAllocator>
+    ValueType& Set(GenericDocument<EncodingType, typename ValueType::AllocatorType, stackAllocator>& document, const std::basic_string<Ch>& value) const {
+        return Create(document) = ValueType(value, document.GetAllocator()).Move();
+    }
+#endif
+
+    //! Set a primitive value in a document.
+    template <typename T, typename stackAllocator>
+    RAPIDJSON_DISABLEIF_RETURN((internal::OrExpr<internal::IsPointer<T>, internal::IsGenericValue<T> >), (ValueType&))
+    Set(GenericDocument<EncodingType, typename ValueType::AllocatorType, stackAllocator>& document, T value) const {
+        return Create(document) = value;
+    }
+
+    //! Swap a value with a value in a subtree. \see GenericPointer::Swap()
+    ValueType& Swap(ValueType& root, ValueType& value, typename ValueType::AllocatorType& allocator) const {
+        return Create(root, allocator).Swap(value);
+    }
+
+    //! Swap a value with a value in a document.
+    template <typename stackAllocator>
+    ValueType& Swap(GenericDocument<EncodingType, typename ValueType::AllocatorType, stackAllocator>& document, ValueType& value) const {
+        return Create(document).Swap(value);
+    }
+
+private:
+    typedef typename GenericPointer<ValueType>::PercentDecodeStream PercentDecodeStream;
+
+    static const SizeType kNameBufferSize = 64;
+
+    //! The source range of a token, excluding the leading '/'.
+    struct Token {
+        const Ch* begin;
+        const Ch* end;
+        bool escaped;   //!< Whether it may contain escapes or percent-encodings, so that it must be decoded.
+    };
+
+    //! Receives the code units of one percent-encoded code point.
+    struct CodeUnitBuffer {
+        typedef typename ValueType::Ch Ch;
+        CodeUnitBuffer() : count() {}
+        void Put(Ch c) { RAPIDJSON_ASSERT(count < 4); units[count++] = c; }
+        Ch units[4];
+        size_t count;
+    };
+
+    //! Decodes a token into code units, following the same rules as GenericPointer::Parse().
+    class TokenDecoder {
+    public:
+        TokenDecoder(const Ch* begin, const Ch* end, bool uriFragment) : src_(begin), end_(end), uriFragment_(uriFragment), buffer_(), pending_(), errorPos_(), errorCode_(kPointerParseErrorNone) {}
+
+        //! Take the next decoded code unit. Returns false at the end of the token or on error.
+        bool Take(Ch& c) {
+            if (pending_ < buffer_.count) {
+                c = buffer_.units[pending_++];
+                return true;
+            }
+            if (src_ == end_)
+                return false;
+
+            c = *src_;
+            if (uriFragment_) {
+                // Decoding percent-encoding for URI fragment
+                if (c == '%') {
+                    PercentDecodeStream is(src_, end_);
+                    buffer_.count = 0;
+                    if (!Transcoder<UTF8<>, EncodingType>().Validate(is, buffer_) || !is.IsValid())
+                        return Error(src_, kPointerParseErrorInvalidPercentEncoding);
+                    src_ += is.Tell();
+                    c = buffer_.units[0];
+                    pending_ = 1;
+                    if (buffer_.count != 1)
+                        return true;
+                    src_--; // A single code unit may still be an escape, as in GenericPointer::Parse()
+                }
+                else if (GenericPointer<ValueType>::NeedPercentEncode(c))
+                    return Error(src_, kPointerParseErrorCharacterMustPercentEncode);
+            }
+            src_++;
+
+            // Escaping "~0" -> '~', "~1" -> '/'
+            if (c == '~') {
+                if (src_ == end_)
+                    return Error(src_, kPointerParseErrorInvalidEscape);
+                if (*src_ == '0')       c = '~';
+                else if (*src_ == '1')  c = '/';
+                else
+                    return Error(src_, kPointerParseErrorInvalidEscape);
+                src_++;
+            }
+            return true;
+        }
+
+        const Ch* GetErrorPosition() const { return errorPos_; }
+        PointerParseErrorCode GetErrorCode() const { return errorCode_; }
+
+    private:
+        bool Error(const Ch* pos, PointerParseErrorCode code) {
+            errorPos_ = pos;
+            errorCode_ = code;
+            return false;
+        }
+
+        const Ch* src_;
+        const Ch* end_;
+        bool uriFragment_;
+        CodeUnitBuffer buffer_;
+        size_t pending_;
+        const Ch* errorPos_;
+        PointerParseErrorCode errorCode_;
+    };
+
+    void Validate() {
+        RAPIDJSON_ASSERT(source_ != NULL);
+        begin_ = source_;
+        if (begin_ != end_ && *begin_ == '#') {
+            uriFragment_ = true;
+            begin_++;
+        }
+        if (begin_ != end_ && *begin_ != '/') {
+            parseErrorCode_ = kPointerParseErrorTokenMustBeginWithSolidus;
+            parseErrorOffset_ = static_cast<size_t>(begin_ - source_);
+            return;
+        }
+
+        Token t;
+        for (const Ch* cursor = begin_; NextToken(cursor, t);) {
+            if (!t.escaped)
+                continue;
+            TokenDecoder d(t.begin, t.end, uriFragment_);
+            for (Ch c; d.Take(c);)
+                ;
+            if (d.GetErrorCode() != kPointerParseErrorNone) {
+                parseErrorCode_ = d.GetErrorCode();
+                parseErrorOffset_ = static_cast<size_t>(d.GetErrorPosition() - source_);
+                return;
+            }
+        }
+    }
+
+    //! Find the next token from cursor. Returns false if there is no more token.
+    bool NextToken(const Ch*& cursor, Token& t) const {
+        if (cursor == end_)
+            return false;
+        RAPIDJSON_ASSERT(*cursor == '/');
+        t.begin = ++cursor;
+        t.escaped = false;
+        for (; cursor != end_ && *cursor != '/'; ++cursor)
+            if (*cursor == '~' || (uriFragment_ && (*cursor == '%' || GenericPointer<ValueType>::NeedPercentEncode(*cursor))))
+                t.escaped = true;
+        t.end = cursor;
+        return true;
+    }
+
+    //! Get the length of a token after decoding.
+    SizeType GetLength(const Token& t) const {
+        if (!t.escaped)
+            return static_cast<SizeType>(t.end - t.begin);
+        TokenDecoder d(t.begin, t.end, uriFragment_);
+        SizeType length = 0;
+        for (Ch c; d.Take(c);)
+            length++;
+        return length;
+    }
+
+    //! Compare a decoded token with a name.
+    bool Equals(const Token& t, const Ch* name, SizeType length) const {
+        if (!t.escaped)
+            return static_cast<SizeType>(t.end - t.begin) == length && std::memcmp(t.begin, name, sizeof(Ch) * length) == 0;
+        TokenDecoder d(t.begin, t.end, uriFragment_);
+        Ch c;
+        for (SizeType i = 0; i < length; i++)
+            if (!d.Take(c) || c != name[i])
+                return false;
+        return !d.Take(c);
+    }
+
+    //! Get the array index of a token, or kPointerInvalidIndex.
+    SizeType GetIndex(const Token& t) const {
+        TokenDecoder d(t.begin, t.end, uriFragment_);
+        SizeType n = 0;
+        SizeType length = 0;
+        for (Ch c; d.Take(c); length++) {
+            if (c < '0' || c > '9' || (length == 1 && n == 0)) // Not a digit, or leading zero
+                return kPointerInvalidIndex;
+            SizeType m = n * 10 + static_cast<SizeType>(c - '0');
+            if (m < n) // overflow detection
+                return kPointerInvalidIndex;
+            n = m;
+        }
+        return length == 0 ? kPointerInvalidIndex : n;
+    }
+
+    //! Resolve the view in a subtree, with const access for a const \c V. \see GenericPointer::DoGet()
+    template <typename V>
+    V* DoGet(V& root, size_t* unresolvedTokenIndex) const {
+        typedef typename internal::SelectIf<internal::IsConst<V>, typename ValueType::ConstMemberIterator, typename ValueType::MemberIterator>::Type MemberIterator;
+        RAPIDJSON_ASSERT(IsValid());
+        V* v = &root;
+        size_t tokenIndex = 0;
+        Token t;
+        for (const Ch* cursor = begin_; NextToken(cursor, t); tokenIndex++) {
+            switch (v->GetType()) {
+            case kObjectType:
+                {
+                    MemberIterator m = FindMember(*v, t);
+                    if (m == v->MemberEnd())
+                        break;
+                    v = &m->value;
+                }
+                continue;
+            case kArrayType:
+                {
+                    SizeType index = GetIndex(t);
+                    if (index == kPointerInvalidIndex || index >= v->Size())
+                        break;
+                    v = &((*v)[index]);
+                }
+                continue;
+            default:
+                break;
+            }
+
+            // Error: unresolved token
+            if (unresolvedTokenIndex)
+                *unresolvedTokenIndex = tokenIndex;
+            return 0;
+        }
+        return v;
+    }
+
+    typename ValueType::MemberIterator FindMember(ValueType& v, const Token& t) const {
+        if (!t.escaped)
+            return v.FindMember(ValueType(GenericStringRef<Ch>(t.begin, static_cast<SizeType>(t.end - t.begin)))); // Not null-terminated
+        SizeType length = GetLength(t);
+        typename ValueType::MemberIterator m = v.MemberBegin();
+        for (; m != v.MemberEnd(); ++m)
+            if (m->name.GetStringLength() == length && Equals(t, m->name.GetString(), length))
+                break;
+        return m;
+    }
+
+    typename ValueType::ConstMemberIterator FindMember(const ValueType& v, const Token& t) const {
+        if (!t.escaped)
+            return v.FindMember(ValueType(GenericStringRef<Ch>(t.begin, static_cast<SizeType>(t.end - t.begin)))); // Not null-terminated
+        SizeType length = GetLength(t);
+        typename ValueType::ConstMemberIterator m = v.MemberBegin();
+        for (; m != v.MemberEnd(); ++m)
+            if (m->name.GetStringLength() == length && Equals(t, m->name.GetString(), length))
+                break;
+        return m;
+    }
+
+    //! Set a string value to the decoded token.
+    void CreateName(const Token& t, ValueType& name, typename ValueType::AllocatorType& allocator) const {
+        if (!t.escaped) {
+            name.SetString(t.begin, static_cast<SizeType>(t.end - t.begin), allocator);
+            return;
+        }
+
+        SizeType length = GetLength(t);
+        Ch buffer[kNameBufferSize];
+        Ch* p = length <= kNameBufferSize ? buffer : static_cast<Ch*>(allocator.Malloc(length * sizeof(Ch)));
+        TokenDecoder d(t.begin, t.end, uriFragment_);
+        for (Ch* q = p; d.Take(*q); ++q)
+            ;
+        name.SetString(p, length, allocator);
+        if (p != buffer)
+            ValueType::AllocatorType::Free(p);
+    }
+
+    const Ch* source_;                      //!< Start of the source, including '#' of a URI fragment.
+    const Ch* end_;                         //!< Past-the-end of the source.
+    const Ch* begin_;                       //!< Start of the first token.
+    bool uriFragment_;                      //!< Whether the source is a URI fragment representation.
+    size_t parseErrorOffset_;               //!< Offset in code unit when validation fails.
+    PointerParseErrorCode parseErrorCode_;  //!< Validation error code.
+};
+
+//! GenericPointerView for Value (UTF-8).
+typedef GenericPointerView<Value> PointerView;
+
 //!@name Helper functions for GenericPointer
 //@{
 
@@ -1060,7 +1579,7 @@ typename T::ValueType& CreateValueByPointer(T& root, const GenericPointer<typena
 
 template <typename T, typename CharType, size_t N>
 typename T::ValueType& CreateValueByPointer(T& root, const CharType(&source)[N], typename T::AllocatorType& a) {
-    return GenericPointer<typename T::ValueType>(source, N - 1).Create(root, a);
+    return GenericPointerView<typename T::ValueType>(source, N - 1).Create(root, a);
 }
 
 // No allocator parameter
@@ -1072,7 +1591,7 @@ typename DocumentType::ValueType& CreateValueByPointer(DocumentType& document, c
 
 template <typename DocumentType, typename CharType, size_t N>
 typename DocumentType::ValueType& CreateValueByPointer(DocumentType& document, const CharType(&source)[N]) {
-    return GenericPointer<typename DocumentType::ValueType>(source, N - 1).Create(document);
+    return GenericPointerView<typename DocumentType::ValueType>(source, N - 1).Create(document);
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -1089,12 +1608,12 @@ const typename T::ValueType* GetValueByPointer(const T& root, const GenericPoint
 
 template <typename T, typename CharType, size_t N>
 typename T::ValueType* GetValueByPointer(T& root, const CharType (&source)[N], size_t* unresolvedTokenIndex = 0) {
-    return GenericPointer<typename T::ValueType>(source, N - 1).Get(root, unresolvedTokenIndex);
+    return GenericPointerView<typename T::ValueType>(source, N - 1).Get(root, unresolvedTokenIndex);
 }
 
 template <typename T, typename CharType, size_t N>
 const typename T::ValueType* GetValueByPointer(const T& root, const CharType(&source)[N], size_t* unresolvedTokenIndex = 0) {
-    return GenericPointer<typename T::ValueType>(source, N - 1).Get(root, unresolvedTokenIndex);
+    return GenericPointerView<typename T::ValueType>(source, N - 1).Get(root, unresolvedTokenIndex);
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -1225,30 +1744,30 @@ SetValueByPointer(T& root, const GenericPointer<typename T::ValueType>& pointer,
 
 template <typename T, typename CharType, size_t N>
 typename T::ValueType& SetValueByPointer(T& root, const CharType(&source)[N], typename T::ValueType& value, typename T::AllocatorType& a) {
-    return GenericPointer<typename T::ValueType>(source, N - 1).Set(root, value, a);
+    return GenericPointerView<typename T::ValueType>(source, N - 1).Set(root, value, a);
 }
 
 template <typename T, typename CharType, size_t N>
 typename T::ValueType& SetValueByPointer(T& root, const CharType(&source)[N], const typename T::ValueType& value, typename T::AllocatorType& a) {
-    return GenericPointer<typename T::ValueType>(source, N - 1).Set(root, value, a);
+    return GenericPointerView<typename T::ValueType>(source, N - 1).Set(root, value, a);
 }
 
 template <typename T, typename CharType, size_t N>
 typename T::ValueType& SetValueByPointer(T& root, const CharType(&source)[N], const typename T::Ch* value, typename T::AllocatorType& a) {
-    return GenericPointer<typename T::ValueType>(source, N - 1).Set(root, value, a);
+    return GenericPointerView<typename T::ValueType>(source, N - 1).Set(root, value, a);
 }
 
 #if RAPIDJSON_HAS_STDSTRING
 template <typename T, typename CharType, size_t N>
 typename T::ValueType& SetValueByPointer(T& root, const CharType(&source)[N], const std::basic_string<typename T::Ch>& value, typename T::AllocatorType& a) {
-    return GenericPointer<typename T::ValueType>(source, N - 1).Set(root, value, a);
+    return GenericPointerView<typename T::ValueType>(source, N - 1).Set(root, value, a);
 }
 #endif
 
 template <typename T, typename CharType, size_t N, typename T2>
 RAPIDJSON_DISABLEIF_RETURN((internal::OrExpr<internal::IsPointer<T2>, internal::IsGenericValue<T2> >), (typename T::ValueType&))
 SetValueByPointer(T& root, const CharType(&source)[N], T2 value, typename T::AllocatorType& a) {
-    return GenericPointer<typename T::ValueType>(source, N - 1).Set(root, value, a);
+    return GenericPointerView<typename T::ValueType>(source, N - 1).Set(root, value, a);
 }
 
 // No allocator parameter
@@ -1283,30 +1802,30 @@ SetValueByPointer(DocumentType& document, const GenericPointer<typename Document
 
 template <typename DocumentType, typename CharType, size_t N>
 typename DocumentType::ValueType& SetValueByPointer(DocumentType& document, const CharType(&source)[N], typename DocumentType::ValueType& value) {
-    return GenericPointer<typename DocumentType::ValueType>(source, N - 1).Set(document, value);
+    return GenericPointerView<typename DocumentType::ValueType>(source, N - 1).Set(document, value);
 }
 
 template <typename DocumentType, typename CharType, size_t N>
 typename DocumentType::ValueType& SetValueByPointer(DocumentType& document, const CharType(&source)[N], const typename DocumentType::ValueType& value) {
-    return GenericPointer<typename DocumentType::ValueType>(source, N - 1).Set(document, value);
+    return GenericPointerView<typename DocumentType::ValueType>(source, N - 1).Set(document, value);
 }
 
 template <typename DocumentType, typename CharType, size_t N>
 typename DocumentType::ValueType& SetValueByPointer(DocumentType& document, const CharType(&source)[N], const typename DocumentType::Ch* value) {
-    return GenericPointer<typename DocumentType::ValueType>(source, N - 1).Set(document, value);
+    return GenericPointerView<typename DocumentType::ValueType>(source, N - 1).Set(document, value);
 }
 
 #if RAPIDJSON_HAS_STDSTRING
 template <typename DocumentType, typename CharType, size_t N>
 typename DocumentType::ValueType& SetValueByPointer(DocumentType& document, const CharType(&source)[N], const std::basic_string<typename DocumentType::Ch>& value) {
-    return GenericPointer<typename DocumentType::ValueType>(source, N - 1).Set(document, value);
+    return GenericPointerView<typename DocumentType::ValueType>(source, N - 1).Set(document, value);
 }
 #endif
 
 template <typename DocumentType, typename CharType, size_t N, typename T2>
 RAPIDJSON_DISABLEIF_RETURN((internal::OrExpr<internal::IsPointer<T2>, internal::IsGenericValue<T2> >), (typename DocumentType::ValueType&))
 SetValueByPointer(DocumentType& document, const CharType(&source)[N], T2 value) {
-    return GenericPointer<typename DocumentType::ValueType>(source, N - 1).Set(document, value);
+    return GenericPointerView<typename DocumentType::ValueType>(source, N - 1).Set(document, value);
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -1318,7 +1837,7 @@ typename T::ValueType& SwapValueByPointer(T& root, const GenericPointer<typename
 
 template <typename T, typename CharType, size_t N>
 typename T::ValueType& SwapValueByPointer(T& root, const CharType(&source)[N], typename T::ValueType& value, typename T::AllocatorType& a) {
-    return GenericPointer<typename T::ValueType>(source, N - 1).Swap(root, value, a);
+    return GenericPointerView<typename T::ValueType>(source, N - 1).Swap(root, value, a);
 }
 
 template <typename DocumentType>
@@ -1328,7 +1847,7 @@ typename DocumentType::ValueType& SwapValueByPointer(DocumentType& document, con
 
 template <typename DocumentType, typename CharType, size_t N>
 typename DocumentType::ValueType& SwapValueByPointer(DocumentType& document, const CharType(&source)[N], typename DocumentType::ValueType& value) {
-    return GenericPointer<typename DocumentType::ValueType>(source, N - 1).Swap(document, value);
+    return GenericPointerView<typename DocumentType::ValueType>(source, N - 1).Swap(document, value);
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,536 @@
+// Tencent is pleased to support the open source community by making RapidJSON available.
+//
+// Copyright (C) 2015 THL A29 Limited, a Tencent company, and Milo Yip. All rights reserved.
+//
+// Licensed under the MIT License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// http://opensource.org/licenses/MIT
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#ifndef RAPIDJSON_POINTERSET_H_
+#define RAPIDJSON_POINTERSET_H_
+
+#include "pointer.h"
+#include "internal/stack.h"
+
+#ifdef _MSC_VER
+RAPIDJSON_DIAG_PUSH
+RAPIDJSON_DIAG_OFF(4512) // assignment operator could not be generated
+#endif
+
+RAPIDJSON_NAMESPACE_BEGIN
+
+///////////////////////////////////////////////////////////////////////////////
+// GenericPointerSet
+
+template <typename ValueType, typename Allocator>
+class GenericPointerExtractor;
+
+//! A set of JSON pointers compiled into a prefix trie, for resolving all of them in one traversal.
+/*!
+    Pointers sharing a prefix share the nodes of the trie, so that each common prefix is resolved once
+    per document instead of once per pointer.
+
+    Each node of the trie caches the index of the member it matched in the last resolved object.
+    When documents have the same shape, the cached index is checked first and the linear search of
+    \c GenericValue::FindMember() is skipped. Therefore \c Get() modifies the set, and it is not thread-safe.
+
+    \code
+    PointerSet set;
+    SizeType foo = set.Add(Pointer("/foo"));
+    SizeType bar = set.Add(Pointer("/bar/0"));
+    Value* values[2];
+    set.Get(document, values);  // values[foo] and values[bar] are resolved values or null.
+    \endcode
+
+    \tparam ValueType The value type of the DOM tree. E.g. GenericValue<UTF8<> >
+    \tparam Allocator The allocator type for allocating memory for the trie.
+*/
+template <typename ValueType, typename Allocator = CrtAllocator>
+class GenericPointerSet {
+public:
+    typedef typename ValueType::EncodingType EncodingType;  //!< Encoding type from Value
+    typedef typename ValueType::Ch Ch;                      //!< Character type from Value
+    typedef GenericPointer<ValueType, Allocator> PointerType;
+    friend class GenericPointerExtractor<ValueType, Allocator>;
+
+    //! Constructor.
+    /*!
+        \param allocator An optional allocator for the trie. Can be null.
+    */
+    explicit GenericPointerSet(Allocator* allocator = 0) :
+        nodes_(allocator, kDefaultNodeCapacity * sizeof(Node)),
+        names_(allocator, kDefaultNameCapacity * sizeof(Ch)),
+        pointerCount_()
+    {
+        new (nodes_.template Push<Node>()) Node(); // root
+    }
+
+    //! Add a pointer to the set.
+    /*!
+        \param pointer A valid pointer. Its tokens are copied.
+        \return Identifier of the pointer, which is the index of its value in the result of \c Get().
+            Adding an equal pointer again returns the same identifier.
+    */
+    SizeType Add(const PointerType& pointer) {
+        RAPIDJSON_ASSERT(pointer.IsValid());
+        SizeType node = 0;
+        for (const typename PointerType::Token* t = pointer.GetTokens(); t != pointer.GetTokens() + pointer.GetTokenCount(); ++t)
+            node = AddChild(node, *t);
+        Node& n = GetNode(node);
+        if (n.pointerId == kInvalidIndex)
+            n.pointerId = pointerCount_++;
+        return n.pointerId;
+    }
+
+    //! Get the number of distinct pointers in the set.
+    SizeType GetPointerCount() const { return pointerCount_; }
+
+    //! Resolve all pointers of the set in a subtree.
+    /*!
+        \param root Root value of a DOM sub-tree to be resolved.
+        \param values Array of \c GetPointerCount() elements, receiving the value of each pointer by its identifier,
+            or null if the pointer cannot be resolved (see \c GenericPointer::Get()).
+        \return Number of resolved pointers.
+    */
+    SizeType Get(ValueType& root, ValueType** values) {
+        for (SizeType i = 0; i < pointerCount_; i++)
+            values[i] = 0;
+        return Resolve(0, root, values);
+    }
+
+    //! Resolve all pointers of the set in a const subtree.
+    SizeType Get(const ValueType& root, const ValueType** values) {
+        for (SizeType i = 0; i < pointerCount_; i++)
+            values[i] = 0;
+        return Resolve(0, root, values);
+    }
+
+private:
+    //! Prohibit copying
+    GenericPointerSet(const GenericPointerSet&);
+    //! Prohibit assignment
+    GenericPointerSet& operator=(const GenericPointerSet&);
+
+    static const SizeType kInvalidIndex = ~SizeType(0);
+    static const size_t kDefaultNodeCapacity = 16;
+    static const size_t kDefaultNameCapacity = 256;
+
+    //! A token in the trie. Nodes are referenced by index as nodes_ grows.
+    struct Node {
+        Node() : nameOffset(), nameLength(), index(kPointerInvalidIndex), firstChild(kInvalidIndex), nextSibling(kInvalidIndex), pointerId(kInvalidIndex), hint() {}
+        size_t nameOffset;      //!< Offset of the name in names_.
+        SizeType nameLength;
+        SizeType index;         //!< Array index, or kPointerInvalidIndex.
+        SizeType firstChild;
+        SizeType nextSibling;
+        SizeType pointerId;     //!< Identifier of the pointer ending at this node, or kInvalidIndex.
+        SizeType hint;          //!< Index of the member matched in the last resolved object.
+    };
+
+    Node& GetNode(SizeType i) { return nodes_.template Bottom<Node>()[i]; }
+    const Ch* GetName(const Node& n) const { return names_.template Bottom<Ch>() + n.nameOffset; }
+
+    SizeType AddChild(SizeType parent, const typename PointerType::Token& t) {
+        SizeType* link = &GetNode(parent).firstChild;
+        while (*link != kInvalidIndex) {
+            const Node& c = GetNode(*link);
+            if (c.nameLength == t.length && std::memcmp(GetName(c), t.name, sizeof(Ch) * t.length) == 0)
+                return *link;
+            link = &GetNode(*link).nextSibling;
+        }
+
+        size_t nameOffset = names_.GetSize() / sizeof(Ch);
+        Ch* name = names_.template Push<Ch>(t.length + 1);
+        std::memcpy(name, t.name, sizeof(Ch) * t.length);
+        name[t.length] = '\0';
+
+        SizeType child = static_cast<SizeType>(nodes_.GetSize() / sizeof(Node));
+        *link = child; // Before Push(), which may move the nodes
+        Node* n = new (nodes_.template Push<Node>()) Node();
+        n->nameOffset = nameOffset;
+        n->nameLength = t.length;
+        n->index = t.index;
+        return child;
+    }
+
+    SizeType FindChild(SizeType node, const Ch* name, SizeType length) {
+        for (SizeType c = GetNode(node).firstChild; c != kInvalidIndex; c = GetNode(c).nextSibling) {
+            const Node& n = GetNode(c);
+            if (n.nameLength == length && std::memcmp(GetName(n), name, sizeof(Ch) * length) == 0)
+                return c;
+        }
+        return kInvalidIndex;
+    }
+
+    SizeType FindChild(SizeType node, SizeType index) {
+        for (SizeType c = GetNode(node).firstChild; c != kInvalidIndex; c = GetNode(c).nextSibling)
+            if (GetNode(c).index == index)
+                return c;
+        return kInvalidIndex;
+    }
+
+    // V is const ValueType for the const Get(), whose access does not copy shared subtrees.
+    template <typename V>
+    SizeType Resolve(SizeType node, V& v, V** values) {
+        Node& n = GetNode(node);
+        SizeType count = 0;
+        if (n.pointerId != kInvalidIndex) {
+            values[n.pointerId] = &v;
+            count++;
+        }
+
+        for (SizeType c = n.firstChild; c != kInvalidIndex; c = GetNode(c).nextSibling) {
+            if (V* child = GetChild(GetNode(c), v))
+                count += Resolve(c, *child, values);
+        }
+        return count;
+    }
+
+    template <typename V>
+    V* GetChild(Node& n, V& v) {
+        typedef typename internal::SelectIf<internal::IsConst<V>, typename ValueType::ConstMemberIterator, typename ValueType::MemberIterator>::Type MemberIterator;
+        switch (v.GetType()) {
+        case kObjectType:
+            {
+                const Ch* name = GetName(n);
+                if (n.hint < v.MemberCount()) {
+                    MemberIterator m = v.MemberBegin() + n.hint;
+                    if (m->name.GetStringLength() == n.nameLength && std::memcmp(m->name.GetString(), name, sizeof(Ch) * n.nameLength) == 0)
+                        return &m->value;
+                }
+                MemberIterator m = v.FindMember(GenericStringRef<Ch>(name, n.nameLength));
+                if (m == v.MemberEnd())
+                    return 0;
+                n.hint = static_cast<SizeType>(m - v.MemberBegin());
+                return &m->value;
+            }
+        case kArrayType:
+            if (n.index == kPointerInvalidIndex || n.index >= v.Size())
+                return 0;
+            return &v[n.index];
+        default:
+            return 0;
+        }
+    }
+
+    internal::Stack<Allocator> nodes_;  //!< Trie nodes (Node), the first is the root.
+    internal::Stack<Allocator> names_;  //!< Null-terminated token names (Ch).
+    SizeType pointerCount_;
+};
+
+//! GenericPointerSet for Value (UTF-8, default allocator).
+typedef GenericPointerSet<Value> PointerSet;
+
+///////////////////////////////////////////////////////////////////////////////
+// GenericPointerExtractor
+
+//! A SAX handler extracting the values of a pointer set without building a DOM.
+/*!
+    It tracks the path of the current value in the trie of a \c GenericPointerSet during parsing.
+    Only the subtrees of matching values are built, and subtrees which no pointer points into are skipped.
+
+    Once every pointer is resolved, or cannot be resolved any more because its parent has ended,
+    the handler returns false to stop parsing early. The reader then reports \c kParseErrorTermination,
+    which is expected when \c IsDone() returns true.
+
+    \code
+    PointerSet set;
+    SizeType id = set.Add(Pointer("/foo/0"));
+    Document d;
+    PointerExtractor extractor(set, d.GetAllocator());
+    Reader reader;
+    StringStream ss(json);
+    reader.Parse(ss, extractor);
+    if (extractor.IsDone() && extractor.GetValue(id))
+        ...
+    \endcode
+
+    \note Pointers must not be added to the set after the extractor is constructed.
+    For duplicated names in an object, the first one is extracted.
+
+    \tparam ValueType Type of the extracted values. E.g. GenericValue<UTF8<> >
+    \tparam Allocator Allocator type of the pointer set, also used for the internal states.
+*/
+template <typename ValueType, typename Allocator = CrtAllocator>
+class GenericPointerExtractor {
+public:
+    typedef typename ValueType::Ch Ch;
+    typedef typename ValueType::AllocatorType ValueAllocatorType;
+    typedef GenericPointerSet<ValueType, Allocator> PointerSetType;
+
+    //! Constructor.
+    /*!
+        \param set The pointers to extract.
+        \param valueAllocator Allocator of the extracted values.
+        \param allocator An optional allocator for the internal states. Can be null.
+    */
+    GenericPointerExtractor(PointerSetType& set, ValueAllocatorType& valueAllocator, Allocator* allocator = 0) :
+        set_(set),
+        valueAllocator_(valueAllocator),
+        roots_(allocator, set.GetPointerCount() * sizeof(ValueType)),
+        values_(allocator, set.GetPointerCount() * sizeof(ValueType*)),
+        finished_(allocator, set.GetPointerCount() * sizeof(bool)),
+        frames_(allocator, kDefaultFrameCapacity * sizeof(Frame)),
+        builder_(allocator, kDefaultBuilderCapacity * sizeof(ValueType)),
+        remaining_(),
+        skipDepth_(),
+        builderNode_(kInvalidIndex)
+    {
+        for (SizeType i = 0; i < set.GetPointerCount(); i++) {
+            new (roots_.template Push<ValueType>()) ValueType();
+            *values_.template Push<ValueType*>() = 0;
+            *finished_.template Push<bool>() = false;
+        }
+        remaining_ = set.GetPointerCount();
+    }
+
+    //! Destructor.
+    ~GenericPointerExtractor() {
+        ClearBuilder();
+        for (ValueType* v = roots_.template Bottom<ValueType>(); v != roots_.template End<ValueType>(); ++v)
+            v->~ValueType();
+    }
+
+    //! Reset for extracting from another JSON. Values extracted previously are released.
+    void Reset() {
+        ClearBuilder();
+        for (SizeType i = 0; i < GetPointerCount(); i++) {
+            roots_.template Bottom<ValueType>()[i].SetNull();
+            values_.template Bottom<ValueType*>()[i] = 0;
+            finished_.template Bottom<bool>()[i] = false;
+        }
+        frames_.Clear();
+        remaining_ = GetPointerCount();
+        skipDepth_ = 0;
+        builderNode_ = kInvalidIndex;
+    }
+
+    //! Whether every pointer has been resolved or cannot be resolved any more.
+    bool IsDone() const { return remaining_ == 0; }
+
+    //! Get the extracted value of a pointer.
+    /*!
+        \param id Identifier of the pointer returned by \c GenericPointerSet::Add().
+        \return The value, or null if it has not been found.
+    */
+    ValueType* GetValue(SizeType id) {
+        RAPIDJSON_ASSERT(id < GetPointerCount());
+        return values_.template Bottom<ValueType*>()[id];
+    }
+
+    //! Get the extracted value of a pointer (const version).
+    const ValueType* GetValue(SizeType id) const { return const_cast<GenericPointerExtractor&>(*this).GetValue(id); }
+
+    // Implementation of Handler
+    bool Null()             { ValueType v;    return Scalar(v); }
+    bool Bool(bool b)       { ValueType v(b); return Scalar(v); }
+    bool Int(int i)         { ValueType v(i); return Scalar(v); }
+    bool Uint(unsigned i)   { ValueType v(i); return Scalar(v); }
+    bool Int64(int64_t i)   { ValueType v(i); return Scalar(v); }
+    bool Uint64(uint64_t i) { ValueType v(i); return Scalar(v); }
+    bool Double(double d)   { ValueType v(d); return Scalar(v); }
+    bool RawNumber(const Ch* str, SizeType length, bool copy) { return String(str, length, copy); }
+
+    bool String(const Ch* str, SizeType length, bool) {
+        if (skipDepth_ > 0 || (builder_.Empty() && !IsMatch(PeekValueNode())))
+            return Scalar(); // Not copied
+        ValueType v(str, length, valueAllocator_);
+        return Scalar(v);
+    }
+
+    bool StartObject() { return StartContainer(false); }
+
+    bool Key(const Ch* str, SizeType length, bool) {
+        if (!builder_.Empty())
+            new (builder_.template Push<ValueType>()) ValueType(str, length, valueAllocator_);
+        else if (skipDepth_ == 0)
+            frames_.template Top<Frame>()->child = set_.FindChild(frames_.template Top<Frame>()->node, str, length);
+        return true;
+    }
+
+    bool EndObject(SizeType) { return EndContainer(); }
+    bool StartArray() { return StartContainer(true); }
+    bool EndArray(SizeType) { return EndContainer(); }
+
+private:
+    //! Prohibit copying
+    GenericPointerExtractor(const GenericPointerExtractor&);
+    //! Prohibit assignment
+    GenericPointerExtractor& operator=(const GenericPointerExtractor&);
+
+    static const SizeType kInvalidIndex = ~SizeType(0);
+    static const size_t kDefaultFrameCapacity = 16;
+    static const size_t kDefaultBuilderCapacity = 16;
+
+    //! A container being tracked in the trie.
+    struct Frame {
+        SizeType node;          //!< Trie node of the container.
+        SizeType child;         //!< Trie node of the current member, or kInvalidIndex.
+        SizeType elementIndex;  //!< Index of the next element.
+        bool inArray;
+    };
+
+    SizeType GetPointerCount() const { return static_cast<SizeType>(values_.GetSize() / sizeof(ValueType*)); }
+
+    // Trie node of the value being started, or kInvalidIndex if no pointer points into it.
+    SizeType PeekValueNode() const {
+        if (frames_.Empty())
+            return 0;
+        const Frame& f = *frames_.template Top<Frame>();
+        return f.inArray ? set_.FindChild(f.node, f.elementIndex) : f.child;
+    }
+
+    SizeType BeginValue() {
+        SizeType node = PeekValueNode();
+        if (!frames_.Empty()) {
+            Frame& f = *frames_.template Top<Frame>();
+            f.elementIndex++;
+            f.child = kInvalidIndex;
+        }
+        if (node != kInvalidIndex) {
+            SizeType id = set_.GetNode(node).pointerId;
+            if (id != kInvalidIndex && finished_.template Bottom<bool>()[id])
+                return kInvalidIndex; // Duplicated name
+        }
+        return node;
+    }
+
+    // Stops when done, unless the root has ended so that the reader can complete normally.
+    bool Continue() const { return !IsDone() || frames_.Empty(); }
+
+    bool IsMatch(SizeType node) const {
+        return node != kInvalidIndex && set_.GetNode(node).pointerId != kInvalidIndex;
+    }
+
+    bool Scalar() {
+        if (skipDepth_ > 0)
+            return true;
+        if (!builder_.Empty()) {
+            ValueType v;
+            return Scalar(v);
+        }
+        SizeType node = BeginValue();
+        if (node != kInvalidIndex)
+            Finish(node); // Not a container, so the pointers below it cannot be resolved
+        return Continue();
+    }
+
+    bool Scalar(ValueType& v) {
+        if (skipDepth_ > 0)
+            return true;
+        if (!builder_.Empty()) {
+            AddToBuilder(v);
+            return true;
+        }
+        SizeType node = BeginValue();
+        if (node == kInvalidIndex)
+            return true;
+        if (IsMatch(node))
+            Extract(node, v);
+        else
+            Finish(node);
+        return Continue();
+    }
+
+    bool StartContainer(bool isArray) {
+        if (skipDepth_ > 0)
+            skipDepth_++;
+        else if (!builder_.Empty())
+            new (builder_.template Push<ValueType>()) ValueType(isArray ? kArrayType : kObjectType);
+        else {
+            SizeType node = BeginValue();
+            if (node == kInvalidIndex)
+                skipDepth_ = 1;
+            else if (IsMatch(node)) {
+                builderNode_ = node;
+                new (builder_.template Push<ValueType>()) ValueType(isArray ? kArrayType : kObjectType);
+            }
+            else {
+                Frame* f = frames_.template Push<Frame>();
+                f->node = node;
+                f->child = kInvalidIndex;
+                f->elementIndex = 0;
+                f->inArray = isArray;
+            }
+        }
+        return Continue();
+    }
+
+    bool EndContainer() {
+        if (skipDepth_ > 0) {
+            skipDepth_--;
+            return true;
+        }
+        if (!builder_.Empty()) {
+            ValueType* v = builder_.template Pop<ValueType>(1);
+            if (builder_.Empty())
+                Extract(builderNode_, *v);
+            else
+                AddToBuilder(*v);
+            return Continue();
+        }
+        Finish(frames_.template Pop<Frame>(1)->node);
+        return Continue();
+    }
+
+    void AddToBuilder(ValueType& v) {
+        ValueType* top = builder_.template Top<ValueType>();
+        if (top->IsString()) { // Name of a member
+            ValueType* name = builder_.template Pop<ValueType>(1);
+            builder_.template Top<ValueType>()->AddMember(*name, v, valueAllocator_);
+        }
+        else
+            top->PushBack(v, valueAllocator_);
+    }
+
+    void ClearBuilder() {
+        while (!builder_.Empty())
+            builder_.template Pop<ValueType>(1)->~ValueType();
+    }
+
+    // Stores the value of a matching node, and resolves the pointers below it within the value.
+    void Extract(SizeType node, ValueType& v) {
+        ValueType& root = roots_.template Bottom<ValueType>()[set_.GetNode(node).pointerId];
+        root = v;
+        set_.Resolve(node, root, values_.template Bottom<ValueType*>());
+        Finish(node);
+    }
+
+    void Finish(SizeType node) {
+        SizeType id = set_.GetNode(node).pointerId;
+        if (id != kInvalidIndex && !finished_.template Bottom<bool>()[id]) {
+            finished_.template Bottom<bool>()[id] = true;
+            remaining_--;
+        }
+        for (SizeType c = set_.GetNode(node).firstChild; c != kInvalidIndex; c = set_.GetNode(c).nextSibling)
+            Finish(c);
+    }
+
+    PointerSetType& set_;
+    ValueAllocatorType& valueAllocator_;
+    internal::Stack<Allocator> roots_;      //!< Extracted values (ValueType), by pointer identifier.
+    internal::Stack<Allocator> values_;     //!< Values of pointers (ValueType*), into roots_.
+    internal::Stack<Allocator> finished_;   //!< Whether a pointer is resolved or unresolvable (bool).
+    internal::Stack<Allocator> frames_;     //!< Tracked containers (Frame).
+    internal::Stack<Allocator> builder_;    //!< Containers and member names of the value being extracted (ValueType).
+    SizeType remaining_;                    //!< Number of pointers not finished.
+    SizeType skipDepth_;                    //!< Depth of nesting inside an untracked container.
+    SizeType builderNode_;                  //!< Trie node of the value being built.
+};
+
+//! GenericPointerExtractor for Value (UTF-8, default allocator).
+typedef GenericPointerExtractor<Value> PointerExtractor;
+
+RAPIDJSON_NAMESPACE_END
+
+#ifdef _MSC_VER
+RAPIDJSON_DIAG_POP
+#endif
+
+#endif // RAPIDJSON_POINTERSET_H_
@@ -109,14 +109,13 @@ public:
 
     bool String(const Ch* str, SizeType length, bool copy = false) {
         RAPIDJSON_ASSERT(str != 0);
-        (void)copy;
         PrettyPrefix(kStringType);
-        return Base::WriteString(str, length);
+        return Base::WriteString(str, length, copy);
     }
 
 #if RAPIDJSON_HAS_STDSTRING
     bool String(const std::basic_string<Ch>& str) {
-        return String(str.data(), SizeType(str.size()));
+        return String(str.data(), SizeType(str.size()), true);
     }
 #endif
 
@@ -130,9 +129,16 @@ public:
 
 #if RAPIDJSON_HAS_STDSTRING
     bool Key(const std::basic_string<Ch>& str) {
-        return Key(str.data(), SizeType(str.size()));
+        return Key(str.data(), SizeType(str.size()), true);
     }
 #endif
+
+    //! Write a member name in its JSON form. The colon is written with the value, as ": ".
+    bool Key(const GenericPreEscapedKey<Ch>& key) {
+        RAPIDJSON_ASSERT(!Base::level_stack_.Empty()); // must be inside an Object
+        PrettyPrefix(kStringType);
+        return Base::WriteRawValue(key.s, key.length - 1);
+    }
 	
     bool EndObject(SizeType memberCount = 0) {
         (void)memberCount;
@@ -184,8 +190,8 @@ public:
     //@{
 
     //! Simpler but slower overload.
-    bool String(const Ch* str) { return String(str, internal::StrLen(str)); }
-    bool Key(const Ch* str) { return Key(str, internal::StrLen(str)); }
+    bool String(const Ch* str) { return String(str, internal::StrLen(str), true); }
+    bool Key(const Ch* str) { return Key(str, internal::StrLen(str), true); }
 
     //@}
 
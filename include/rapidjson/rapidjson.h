@@ -325,11 +325,11 @@
 #endif
 
 ///////////////////////////////////////////////////////////////////////////////
-// RAPIDJSON_SSE2/RAPIDJSON_SSE42/RAPIDJSON_NEON/RAPIDJSON_SIMD
+// RAPIDJSON_SSE2/RAPIDJSON_SSE42/RAPIDJSON_AVX2/RAPIDJSON_NEON/RAPIDJSON_SIMD
 
 /*! \def RAPIDJSON_SIMD
     \ingroup RAPIDJSON_CONFIG
-    \brief Enable SSE2/SSE4.2/Neon optimization.
+    \brief Enable SSE2/SSE4.2/AVX2/Neon optimization.
 
     RapidJSON supports optimized implementations for some parsing operations
     based on the SSE2, SSE4.2 or NEon SIMD extensions on modern Intel
@@ -346,12 +346,17 @@
 
     // Enable ARM Neon optimization.
     #define RAPIDJSON_NEON
+
+    // Enable AVX2 optimization of string output in Writer.
+    #define RAPIDJSON_AVX2
     \endcode
 
     \c RAPIDJSON_SSE42 takes precedence over SSE2, if both are defined.
+    \c RAPIDJSON_AVX2 only affects Writer and may be combined with
+    \c RAPIDJSON_SSE42 or \c RAPIDJSON_SSE2 for parsing.
 
-    If any of these symbols is defined, RapidJSON defines the macro
-    \c RAPIDJSON_SIMD to indicate the availability of the optimized code.
+    If any of these symbols but \c RAPIDJSON_AVX2 is defined, RapidJSON defines the
+    macro \c RAPIDJSON_SIMD to indicate the availability of the optimized parsing code.
 */
 #if defined(RAPIDJSON_SSE2) || defined(RAPIDJSON_SSE42) \
     || defined(RAPIDJSON_NEON) || defined(RAPIDJSON_DOXYGEN_RUNNING)
@@ -155,6 +155,8 @@ enum ParseFlag {
     kParseNumbersAsStringsFlag = 64,    //!< Parse all numbers (ints/doubles) as strings.
     kParseTrailingCommasFlag = 128, //!< Allow trailing commas at the end of objects and arrays.
     kParseNanAndInfFlag = 256,      //!< Allow parsing NaN, Inf, Infinity, -Inf and -Infinity as doubles.
+    kParseInternKeysFlag = 512,     //!< GenericDocument stores one copy of equal keys which are too long for short strings (allocators without Free() only).
+    kParseSortKeysFlag = 1024,      //!< GenericDocument sorts the members of each object by name, for binary search in FindMember().
     kParseDefaultFlags = RAPIDJSON_PARSE_DEFAULT_FLAGS  //!< Default parse flags. Can be customized by defining RAPIDJSON_PARSE_DEFAULT_FLAGS
 };
 
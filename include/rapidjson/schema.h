@@ -17,6 +17,7 @@
 
 #include "document.h"
 #include "pointer.h"
+#include "internal/hashtable.h"
 #include <cmath> // abs, floor
 
 #if !defined(RAPIDJSON_SCHEMA_USE_INTERNALREGEX)
@@ -215,6 +216,8 @@ public:
 
     bool IsValid() const { return stack_.GetSize() == sizeof(uint64_t); }
 
+    void Reset() { stack_.Clear(); }
+
     uint64_t GetHashCode() const {
         RAPIDJSON_ASSERT(IsValid());
         return *stack_.template Top<uint64_t>();
@@ -254,6 +257,47 @@ private:
     Stack<Allocator> stack_;
 };
 
+///////////////////////////////////////////////////////////////////////////////
+// HashCodeSet
+
+// Set of hash codes from Hasher, for uniqueItems and enum.
+// The full 64-bit hash code is compared on probing, which is the equality used by the validator.
+template<typename Allocator>
+class HashCodeSet {
+public:
+    explicit HashCodeSet(Allocator* allocator) : table_(allocator, kInitialCapacity), hasZero_() {}
+
+    //! Returns false if h is already in the set.
+    bool Insert(uint64_t h) {
+        if (h == 0) { // 0 marks an empty slot
+            bool inserted = !hasZero_;
+            hasZero_ = true;
+            return inserted;
+        }
+        bool inserted;
+        table_.Insert(h, &inserted);
+        return inserted;
+    }
+
+    bool Contains(uint64_t h) const {
+        if (h == 0)
+            return hasZero_;
+        const Slot* slot = table_.Find(h);
+        return slot && slot->key == h;
+    }
+
+private:
+    struct Slot {
+        typedef uint64_t KeyType;
+        uint64_t key;
+    };
+
+    static const size_t kInitialCapacity = 16;
+
+    HashTable<Slot, Allocator> table_;
+    bool hasZero_;
+};
+
 ///////////////////////////////////////////////////////////////////////////////
 // SchemaValidationContext
 
@@ -287,7 +331,8 @@ struct SchemaValidationContext {
         propertyExist(),
         inArray(false),
         valueUniqueness(false),
-        arrayUniqueness(false)
+        arrayUniqueness(false),
+        discriminatorPending(false)
     {
     }
 
@@ -296,7 +341,8 @@ struct SchemaValidationContext {
             factory.DestroryHasher(hasher);
         if (validators) {
             for (SizeType i = 0; i < validatorCount; i++)
-                factory.DestroySchemaValidator(validators[i]);
+                if (validators[i])
+                    factory.DestroySchemaValidator(validators[i]);
             factory.FreeState(validators);
         }
         if (patternPropertiesValidators) {
@@ -329,6 +375,7 @@ struct SchemaValidationContext {
     bool inArray;
     bool valueUniqueness;
     bool arrayUniqueness;
+    bool discriminatorPending; // The value of the next member is the discriminator of anyOf/oneOf
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -352,9 +399,11 @@ public:
         typeless_(schemaDocument->GetTypeless()),
         enum_(),
         enumCount_(),
+        enumSet_(allocator),
         not_(),
         type_((1 << kTotalSchemaType) - 1), // typeless
         validatorCount_(),
+        discriminator_(),
         properties_(),
         additionalPropertiesSchema_(),
         patternProperties_(),
@@ -406,6 +455,7 @@ public:
                     EnumHasherType h(&hasherAllocator, 256);
                     itr->Accept(h);
                     enum_[enumCount_++] = h.GetHashCode();
+                    enumSet_.Insert(h.GetHashCode());
                 }
             }
 
@@ -476,6 +526,8 @@ public:
             for (ConstMemberIterator itr = v->MemberBegin(); itr != v->MemberEnd(); ++itr) {
                 new (&patternProperties_[patternPropertyCount_]) PatternProperty();
                 patternProperties_[patternPropertyCount_].pattern = CreatePattern(itr->name);
+                if (patternProperties_[patternPropertyCount_].pattern)
+                    patternProperties_[patternPropertyCount_].source.CopyFrom(itr->name, *allocator_);
                 schemaDocument->CreateSchema(&patternProperties_[patternPropertyCount_].schema, q.Append(itr->name, allocator_), itr->value, document);
                 patternPropertyCount_++;
             }
@@ -556,7 +608,8 @@ public:
         AssignIfExist(maxLength_, value, GetMaxLengthString());
 
         if (const ValueType* v = GetMember(value, GetPatternString()))
-            pattern_ = CreatePattern(*v);
+            if ((pattern_ = CreatePattern(*v)) != 0)
+                patternSource_.CopyFrom(*v, *allocator_);
 
         // Number
         if (const ValueType* v = GetMember(value, GetMinimumString()))
@@ -598,14 +651,17 @@ public:
 
     bool BeginValue(Context& context) const {
         if (context.inArray) {
+            // Incremented before any failure, so that the current element is always arrayElementIndex - 1
+            SizeType index = context.arrayElementIndex++;
+
             if (uniqueItems_)
                 context.valueUniqueness = true;
 
             if (itemsList_)
                 context.valueSchema = itemsList_;
             else if (itemsTuple_) {
-                if (context.arrayElementIndex < itemsTupleCount_)
-                    context.valueSchema = itemsTuple_[context.arrayElementIndex];
+                if (index < itemsTupleCount_)
+                    context.valueSchema = itemsTuple_[index];
                 else if (additionalItemsSchema_)
                     context.valueSchema = additionalItemsSchema_;
                 else if (additionalItems_)
@@ -615,8 +671,6 @@ public:
             }
             else
                 context.valueSchema = typeless_;
-
-            context.arrayElementIndex++;
         }
         return true;
     }
@@ -647,14 +701,8 @@ public:
                 RAPIDJSON_INVALID_KEYWORD_RETURN(GetPatternPropertiesString());
         }
 
-        if (enum_) {
-            const uint64_t h = context.factory.GetHashCode(context.hasher);
-            for (SizeType i = 0; i < enumCount_; i++)
-                if (enum_[i] == h)
-                    goto foundEnum;
+        if (enum_ && !HasEnum(context.factory.GetHashCode(context.hasher)))
             RAPIDJSON_INVALID_KEYWORD_RETURN(GetEnumString());
-            foundEnum:;
-        }
 
         if (allOf_.schemas)
             for (SizeType i = allOf_.begin; i < allOf_.begin + allOf_.count; i++)
@@ -663,7 +711,7 @@ public:
         
         if (anyOf_.schemas) {
             for (SizeType i = anyOf_.begin; i < anyOf_.begin + anyOf_.count; i++)
-                if (context.validators[i]->IsValid())
+                if (context.validators[i] && context.validators[i]->IsValid())
                     goto foundAny;
             RAPIDJSON_INVALID_KEYWORD_RETURN(GetAnyOfString());
             foundAny:;
@@ -672,7 +720,7 @@ public:
         if (oneOf_.schemas) {
             bool oneValid = false;
             for (SizeType i = oneOf_.begin; i < oneOf_.begin + oneOf_.count; i++)
-                if (context.validators[i]->IsValid()) {
+                if (context.validators[i] && context.validators[i]->IsValid()) {
                     if (oneValid)
                         RAPIDJSON_INVALID_KEYWORD_RETURN(GetOneOfString());
                     else
@@ -682,7 +730,7 @@ public:
                 RAPIDJSON_INVALID_KEYWORD_RETURN(GetOneOfString());
         }
 
-        if (not_ && context.validators[notValidatorIndex_]->IsValid())
+        if (not_ && context.validators[notValidatorIndex_] && context.validators[notValidatorIndex_]->IsValid())
             RAPIDJSON_INVALID_KEYWORD_RETURN(GetNotString());
 
         return true;
@@ -691,37 +739,37 @@ public:
     bool Null(Context& context) const { 
         if (!(type_ & (1 << kNullSchemaType)))
             RAPIDJSON_INVALID_KEYWORD_RETURN(GetTypeString());
-        return CreateParallelValidator(context);
+        return CreateParallelValidator(context, 1 << kNullSchemaType);
     }
     
     bool Bool(Context& context, bool) const { 
         if (!(type_ & (1 << kBooleanSchemaType)))
             RAPIDJSON_INVALID_KEYWORD_RETURN(GetTypeString());
-        return CreateParallelValidator(context);
+        return CreateParallelValidator(context, 1 << kBooleanSchemaType);
     }
 
     bool Int(Context& context, int i) const {
         if (!CheckInt(context, i))
             return false;
-        return CreateParallelValidator(context);
+        return CreateParallelValidator(context, (1 << kIntegerSchemaType) | (1 << kNumberSchemaType));
     }
 
     bool Uint(Context& context, unsigned u) const {
         if (!CheckUint(context, u))
             return false;
-        return CreateParallelValidator(context);
+        return CreateParallelValidator(context, (1 << kIntegerSchemaType) | (1 << kNumberSchemaType));
     }
 
     bool Int64(Context& context, int64_t i) const {
         if (!CheckInt(context, i))
             return false;
-        return CreateParallelValidator(context);
+        return CreateParallelValidator(context, (1 << kIntegerSchemaType) | (1 << kNumberSchemaType));
     }
 
     bool Uint64(Context& context, uint64_t u) const {
         if (!CheckUint(context, u))
             return false;
-        return CreateParallelValidator(context);
+        return CreateParallelValidator(context, (1 << kIntegerSchemaType) | (1 << kNumberSchemaType));
     }
 
     bool Double(Context& context, double d) const {
@@ -737,7 +785,7 @@ public:
         if (!multipleOf_.IsNull() && !CheckDoubleMultipleOf(context, d))
             return false;
         
-        return CreateParallelValidator(context);
+        return CreateParallelValidator(context, 1 << kNumberSchemaType);
     }
     
     bool String(Context& context, const Ch* str, SizeType length, bool) const {
@@ -757,7 +805,7 @@ public:
         if (pattern_ && !IsPatternMatch(pattern_, str, length))
             RAPIDJSON_INVALID_KEYWORD_RETURN(GetPatternString());
 
-        return CreateParallelValidator(context);
+        return CreateParallelValidator(context, 1 << kStringSchemaType);
     }
 
     bool StartObject(Context& context) const { 
@@ -776,10 +824,14 @@ public:
             std::memset(context.patternPropertiesSchemas, 0, sizeof(SchemaType*) * count);
         }
 
-        return CreateParallelValidator(context);
+        return CreateParallelValidator(context, 1 << kObjectSchemaType);
     }
     
     bool Key(Context& context, const Ch* str, SizeType len, bool) const {
+        if (discriminator_)
+            context.discriminatorPending = discriminator_->GetStringLength() == len &&
+                std::memcmp(discriminator_->GetString(), str, sizeof(Ch) * len) == 0;
+
         if (patternProperties_) {
             context.patternPropertiesSchemaCount = 0;
             for (SizeType i = 0; i < patternPropertyCount_; i++)
@@ -863,7 +915,16 @@ public:
         context.arrayElementIndex = 0;
         context.inArray = true;
 
-        return CreateParallelValidator(context);
+        return CreateParallelValidator(context, 1 << kArraySchemaType);
+    }
+
+    //! Prunes anyOf/oneOf branches by the hash code of the discriminator value.
+    void PruneBranches(Context& context, uint64_t h) const {
+        context.discriminatorPending = false;
+        if (context.validators) {
+            PruneBranches(context, anyOf_, h);
+            PruneBranches(context, oneOf_, h);
+        }
     }
 
     bool EndArray(Context& context, SizeType elementCount) const { 
@@ -934,6 +995,13 @@ private:
         kTotalSchemaType
     };
 
+    enum NumberTag {
+        kNumberTag_Null,
+        kNumberTag_Uint64,
+        kNumberTag_Int64,
+        kNumberTag_Double
+    };
+
 #if RAPIDJSON_SCHEMA_USE_INTERNALREGEX
         typedef internal::GenericRegex<EncodingType> RegexType;
 #elif RAPIDJSON_SCHEMA_USE_STDREGEX
@@ -943,11 +1011,15 @@ private:
 #endif
 
     struct SchemaArray {
-        SchemaArray() : schemas(), count() {}
-        ~SchemaArray() { AllocatorType::Free(schemas); }
+        SchemaArray() : schemas(), count(), discriminatorSchemas() {}
+        ~SchemaArray() {
+            AllocatorType::Free(schemas);
+            AllocatorType::Free(discriminatorSchemas);
+        }
         const SchemaType** schemas;
         SizeType begin; // begin index of context.validators
         SizeType count;
+        const SchemaType** discriminatorSchemas; // Schema of discriminator property in each branch
     };
 
     template <typename V1, typename V2>
@@ -1043,7 +1115,10 @@ private:
         else if (type == GetNumberString() ) type_ |= (1 << kNumberSchemaType) | (1 << kIntegerSchemaType);
     }
 
-    bool CreateParallelValidator(Context& context) const {
+    // typeMask is the set of kSchemaType bits that accept the current value.
+    // Branches of allOf/anyOf/oneOf/not whose type excludes the value can never be valid, so they are
+    // pruned (left as null validators) instead of being fed with every event of the value.
+    bool CreateParallelValidator(Context& context, unsigned typeMask) const {
         if (enum_ || context.arrayUniqueness)
             context.hasher = context.factory.CreateHasher();
 
@@ -1051,17 +1126,18 @@ private:
             RAPIDJSON_ASSERT(context.validators == 0);
             context.validators = static_cast<ISchemaValidator**>(context.factory.MallocState(sizeof(ISchemaValidator*) * validatorCount_));
             context.validatorCount = validatorCount_;
+            std::memset(context.validators, 0, sizeof(ISchemaValidator*) * validatorCount_);
 
-            if (allOf_.schemas)
-                CreateSchemaValidators(context, allOf_);
+            if (allOf_.schemas && CreateSchemaValidators(context, allOf_, typeMask) != allOf_.count)
+                RAPIDJSON_INVALID_KEYWORD_RETURN(GetAllOfString());
 
-            if (anyOf_.schemas)
-                CreateSchemaValidators(context, anyOf_);
+            if (anyOf_.schemas && CreateSchemaValidators(context, anyOf_, typeMask) == 0)
+                RAPIDJSON_INVALID_KEYWORD_RETURN(GetAnyOfString());
             
-            if (oneOf_.schemas)
-                CreateSchemaValidators(context, oneOf_);
+            if (oneOf_.schemas && CreateSchemaValidators(context, oneOf_, typeMask) == 0)
+                RAPIDJSON_INVALID_KEYWORD_RETURN(GetOneOfString());
             
-            if (not_)
+            if (not_ && (not_->type_ & typeMask))
                 context.validators[notValidatorIndex_] = context.factory.CreateSchemaValidator(*not_);
             
             if (hasSchemaDependencies_) {
@@ -1074,11 +1150,73 @@ private:
         return true;
     }
 
-    void CreateSchemaValidators(Context& context, const SchemaArray& schemas) const {
+    // Returns the number of validators created, i.e. branches not pruned by type.
+    SizeType CreateSchemaValidators(Context& context, const SchemaArray& schemas, unsigned typeMask) const {
+        SizeType count = 0;
         for (SizeType i = 0; i < schemas.count; i++)
-            context.validators[schemas.begin + i] = context.factory.CreateSchemaValidator(*schemas.schemas[i]);
+            if (schemas.schemas[i]->type_ & typeMask) {
+                context.validators[schemas.begin + i] = context.factory.CreateSchemaValidator(*schemas.schemas[i]);
+                count++;
+            }
+        return count;
+    }
+
+    void ResolveDiscriminators() {
+        ResolveDiscriminator(anyOf_);
+        ResolveDiscriminator(oneOf_);
     }
 
+    // Discriminator: a property which every branch of anyOf/oneOf constrains with an enum.
+    // Once its value is known, branches whose enum does not contain it are destroyed.
+    void ResolveDiscriminator(SchemaArray& schemas) {
+        if (!schemas.schemas || schemas.count < 2)
+            return;
+
+        if (!discriminator_) {
+            const SchemaType* first = schemas.schemas[0];
+            for (SizeType i = 0; i < first->propertyCount_ && !discriminator_; i++)
+                if (first->properties_[i].schema->enum_ && IsDiscriminator(schemas, first->properties_[i].name))
+                    discriminator_ = &first->properties_[i].name;
+        }
+        else if (!IsDiscriminator(schemas, *discriminator_))
+            return;
+
+        if (!discriminator_)
+            return;
+
+        const ValueType name(discriminator_->GetString(), discriminator_->GetStringLength());
+        schemas.discriminatorSchemas = static_cast<const SchemaType**>(allocator_->Malloc(sizeof(const SchemaType*) * schemas.count));
+        for (SizeType i = 0; i < schemas.count; i++) {
+            SizeType index = 0;
+            schemas.schemas[i]->FindPropertyIndex(name, &index);
+            schemas.discriminatorSchemas[i] = schemas.schemas[i]->properties_[index].schema;
+        }
+    }
+
+    static bool IsDiscriminator(const SchemaArray& schemas, const SValue& discriminator) {
+        const ValueType name(discriminator.GetString(), discriminator.GetStringLength());
+        for (SizeType i = 0; i < schemas.count; i++) {
+            SizeType index;
+            if (!schemas.schemas[i]->FindPropertyIndex(name, &index) || !schemas.schemas[i]->properties_[index].schema->enum_)
+                return false;
+        }
+        return true;
+    }
+
+    static void PruneBranches(Context& context, const SchemaArray& schemas, uint64_t h) {
+        if (!schemas.discriminatorSchemas)
+            return;
+        for (SizeType i = 0; i < schemas.count; i++) {
+            ISchemaValidator*& v = context.validators[schemas.begin + i];
+            if (v && !schemas.discriminatorSchemas[i]->HasEnum(h)) {
+                context.factory.DestroySchemaValidator(v);
+                v = 0;
+            }
+        }
+    }
+
+    bool HasEnum(uint64_t h) const { return enumSet_.Contains(h); }
+
     // O(n)
     bool FindPropertyIndex(const ValueType& name, SizeType* outIndex) const {
         SizeType len = name.GetStringLength();
@@ -1093,6 +1231,234 @@ private:
         return false;
     }
 
+    // Schema image (see GenericSchemaDocument::Serialize()). Referenced schemas are written as
+    // indices by the ImageWriter, and strings are referenced in place by the ImageReader.
+    template <typename ImageWriter>
+    void Serialize(ImageWriter& w) const {
+        w.Write(type_);
+        w.Write(validatorCount_);
+        w.Write(enumCount_);
+        w.Write(enum_, sizeof(uint64_t) * enumCount_);
+        SerializeSchemaArray(w, allOf_);
+        SerializeSchemaArray(w, anyOf_);
+        SerializeSchemaArray(w, oneOf_);
+        w.WriteSchema(not_);
+        w.Write(notValidatorIndex_);
+
+        w.Write(propertyCount_);
+        for (SizeType i = 0; i < propertyCount_; i++) {
+            const Property& property = properties_[i];
+            w.WriteString(property.name.GetString(), property.name.GetStringLength());
+            w.WriteSchema(property.schema);
+            w.WriteSchema(property.dependenciesSchema);
+            w.Write(property.dependenciesValidatorIndex);
+            w.Write(property.required);
+            w.Write(property.dependencies != 0);
+            if (property.dependencies)
+                for (SizeType j = 0; j < propertyCount_; j++)
+                    w.Write(property.dependencies[j]);
+        }
+        w.WriteSchema(additionalPropertiesSchema_);
+        w.Write(patternProperties_ ? patternPropertyCount_ : SizeType(0));
+        for (SizeType i = 0; patternProperties_ && i < patternPropertyCount_; i++) {
+            SerializePattern(w, patternProperties_[i].pattern, patternProperties_[i].source);
+            w.WriteSchema(patternProperties_[i].schema);
+        }
+        w.Write(minProperties_);
+        w.Write(maxProperties_);
+        w.Write(additionalProperties_);
+        w.Write(hasDependencies_);
+        w.Write(hasRequired_);
+        w.Write(hasSchemaDependencies_);
+
+        w.WriteSchema(additionalItemsSchema_);
+        w.WriteSchema(itemsList_);
+        w.Write(itemsTuple_ != 0);
+        w.Write(itemsTupleCount_);
+        for (SizeType i = 0; i < itemsTupleCount_; i++)
+            w.WriteSchema(itemsTuple_[i]);
+        w.Write(minItems_);
+        w.Write(maxItems_);
+        w.Write(additionalItems_);
+        w.Write(uniqueItems_);
+
+        SerializePattern(w, pattern_, patternSource_);
+        w.Write(minLength_);
+        w.Write(maxLength_);
+
+        SerializeNumber(w, minimum_);
+        SerializeNumber(w, maximum_);
+        SerializeNumber(w, multipleOf_);
+        w.Write(exclusiveMinimum_);
+        w.Write(exclusiveMaximum_);
+    }
+
+    // Returns false if the image is truncated or inconsistent. The schema is left destructible.
+    template <typename ImageReader>
+    bool Deserialize(ImageReader& r) {
+        SizeType count;
+        // Each validator is created for a schema index stored below, which bounds validatorCount_.
+        if (!r.Read(type_) || !r.Read(validatorCount_) || !r.CanRead(validatorCount_, sizeof(SizeType)) ||
+            !r.Read(count) || !r.CanRead(count, sizeof(uint64_t)))
+            return false;
+        if (count > 0) {
+            enum_ = static_cast<uint64_t*>(allocator_->Malloc(sizeof(uint64_t) * count));
+            enumCount_ = count;
+            r.Read(enum_, sizeof(uint64_t) * count);
+            for (SizeType i = 0; i < count; i++)
+                enumSet_.Insert(enum_[i]);
+        }
+        if (!DeserializeSchemaArray(r, allOf_) || !DeserializeSchemaArray(r, anyOf_) || !DeserializeSchemaArray(r, oneOf_) ||
+            !r.ReadSchema(not_) || !r.Read(notValidatorIndex_) || (not_ && notValidatorIndex_ >= validatorCount_))
+            return false;
+
+        if (!r.Read(count) || !r.CanRead(count, 1))
+            return false;
+        if (count > 0) {
+            properties_ = static_cast<Property*>(allocator_->Malloc(sizeof(Property) * count));
+            for (SizeType i = 0; i < count; i++)
+                new (&properties_[i]) Property();
+            propertyCount_ = count;
+        }
+        for (SizeType i = 0; i < propertyCount_; i++) {
+            Property& property = properties_[i];
+            const Ch* name;
+            SizeType length;
+            bool hasDependencies;
+            if (!r.ReadString(name, length) || !r.ReadSchema(property.schema) || !r.ReadSchema(property.dependenciesSchema) ||
+                !r.Read(property.dependenciesValidatorIndex) || !r.Read(property.required) || !r.Read(hasDependencies))
+                return false;
+            property.name.SetString(StringRef(name, length));
+            if (!property.schema || (property.dependenciesSchema && property.dependenciesValidatorIndex >= validatorCount_))
+                return false;
+            if (hasDependencies) {
+                if (!r.CanRead(propertyCount_, 1))
+                    return false;
+                property.dependencies = static_cast<bool*>(allocator_->Malloc(sizeof(bool) * propertyCount_));
+                std::memset(property.dependencies, 0, sizeof(bool) * propertyCount_);
+                for (SizeType j = 0; j < propertyCount_; j++)
+                    if (!r.Read(property.dependencies[j]))
+                        return false;
+            }
+        }
+        if (!r.ReadSchema(additionalPropertiesSchema_) || !r.Read(count) || !r.CanRead(count, 1))
+            return false;
+        if (count > 0) {
+            patternProperties_ = static_cast<PatternProperty*>(allocator_->Malloc(sizeof(PatternProperty) * count));
+            for (SizeType i = 0; i < count; i++)
+                new (&patternProperties_[i]) PatternProperty();
+            patternPropertyCount_ = count;
+        }
+        for (SizeType i = 0; i < patternPropertyCount_; i++)
+            if (!DeserializePattern(r, patternProperties_[i].pattern, patternProperties_[i].source) || 
+                !r.ReadSchema(patternProperties_[i].schema) || !patternProperties_[i].schema)
+                return false;
+        bool hasItemsTuple;
+        if (!r.Read(minProperties_) || !r.Read(maxProperties_) || !r.Read(additionalProperties_) ||
+            !r.Read(hasDependencies_) || !r.Read(hasRequired_) || !r.Read(hasSchemaDependencies_) ||
+            !r.ReadSchema(additionalItemsSchema_) || !r.ReadSchema(itemsList_) ||
+            !r.Read(hasItemsTuple) || !r.Read(count) || !r.CanRead(count, sizeof(SizeType)))
+            return false;
+        if (hasItemsTuple) {
+            itemsTuple_ = static_cast<const Schema**>(allocator_->Malloc(sizeof(const Schema*) * (count > 0 ? count : 1)));
+            for (; itemsTupleCount_ < count; itemsTupleCount_++)
+                if (!r.ReadSchema(itemsTuple_[itemsTupleCount_]) || !itemsTuple_[itemsTupleCount_])
+                    return false;
+        }
+        else if (count > 0)
+            return false;
+
+        return
+            r.Read(minItems_) && r.Read(maxItems_) && r.Read(additionalItems_) && r.Read(uniqueItems_) &&
+            DeserializePattern(r, pattern_, patternSource_) && r.Read(minLength_) && r.Read(maxLength_) &&
+            DeserializeNumber(r, minimum_) && DeserializeNumber(r, maximum_) && DeserializeNumber(r, multipleOf_) &&
+            r.Read(exclusiveMinimum_) && r.Read(exclusiveMaximum_);
+    }
+
+    template <typename ImageWriter>
+    static void SerializeSchemaArray(ImageWriter& w, const SchemaArray& schemas) {
+        w.Write(schemas.schemas ? schemas.count : SizeType(0));
+        if (schemas.schemas) {
+            w.Write(schemas.begin);
+            for (SizeType i = 0; i < schemas.count; i++)
+                w.WriteSchema(schemas.schemas[i]);
+        }
+    }
+
+    template <typename ImageReader>
+    bool DeserializeSchemaArray(ImageReader& r, SchemaArray& schemas) {
+        SizeType count;
+        if (!r.Read(count) || !r.CanRead(count, sizeof(SizeType)))
+            return false;
+        if (count == 0)
+            return true;
+        schemas.schemas = static_cast<const Schema**>(allocator_->Malloc(count * sizeof(const Schema*)));
+        memset(schemas.schemas, 0, sizeof(Schema*) * count);
+        schemas.count = count;
+        if (!r.Read(schemas.begin))
+            return false;
+        for (SizeType i = 0; i < count; i++)
+            if (!r.ReadSchema(schemas.schemas[i]) || !schemas.schemas[i])
+                return false;
+        return schemas.begin + count >= schemas.begin && schemas.begin + count <= validatorCount_;
+    }
+
+    template <typename ImageWriter>
+    static void SerializePattern(ImageWriter& w, const RegexType* pattern, const SValue& source) {
+        w.Write(pattern != 0);
+        if (pattern)
+            w.WriteString(source.GetString(), source.GetStringLength());
+    }
+
+    // The compiled regex cannot be stored in the image, so it is compiled again from its source.
+    template <typename ImageReader>
+    bool DeserializePattern(ImageReader& r, RegexType*& pattern, SValue& source) {
+        bool hasPattern;
+        if (!r.Read(hasPattern))
+            return false;
+        if (hasPattern) {
+            const Ch* s;
+            SizeType length;
+            if (!r.ReadString(s, length))
+                return false;
+            source.SetString(StringRef(s, length));
+            pattern = CreatePattern(source);
+        }
+        return true;
+    }
+
+    template <typename ImageWriter>
+    static void SerializeNumber(ImageWriter& w, const SValue& v) {
+        if (v.IsUint64()) {
+            w.Write(static_cast<unsigned char>(kNumberTag_Uint64));
+            w.Write(v.GetUint64());
+        }
+        else if (v.IsInt64()) {
+            w.Write(static_cast<unsigned char>(kNumberTag_Int64));
+            w.Write(v.GetInt64());
+        }
+        else if (v.IsNumber()) {
+            w.Write(static_cast<unsigned char>(kNumberTag_Double));
+            w.Write(v.GetDouble());
+        }
+        else
+            w.Write(static_cast<unsigned char>(kNumberTag_Null));
+    }
+
+    template <typename ImageReader>
+    static bool DeserializeNumber(ImageReader& r, SValue& v) {
+        unsigned char tag;
+        if (!r.Read(tag))
+            return false;
+        switch (tag) {
+        case kNumberTag_Null:   v.SetNull(); return true;
+        case kNumberTag_Uint64: { uint64_t u; if (!r.Read(u)) return false; v.SetUint64(u); return true; }
+        case kNumberTag_Int64:  { int64_t i;  if (!r.Read(i)) return false; v.SetInt64(i);  return true; }
+        case kNumberTag_Double: { double d;   if (!r.Read(d)) return false; v.SetDouble(d); return true; }
+        default:                return false;
+        }
+    }
+
     bool CheckInt(Context& context, int64_t i) const {
         if (!(type_ & ((1 << kIntegerSchemaType) | (1 << kNumberSchemaType))))
             RAPIDJSON_INVALID_KEYWORD_RETURN(GetTypeString());
@@ -1210,6 +1576,7 @@ private:
                 AllocatorType::Free(pattern);
             }
         }
+        SValue source; // Kept for serializing into schema image
         const SchemaType* schema;
         RegexType* pattern;
     };
@@ -1218,6 +1585,7 @@ private:
     const SchemaType* typeless_;
     uint64_t* enum_;
     SizeType enumCount_;
+    HashCodeSet<AllocatorType> enumSet_;
     SchemaArray allOf_;
     SchemaArray anyOf_;
     SchemaArray oneOf_;
@@ -1225,6 +1593,7 @@ private:
     unsigned type_; // bitmask of kSchemaType
     SizeType validatorCount_;
     SizeType notValidatorIndex_;
+    const SValue* discriminator_; // Property name shared by anyOf/oneOf branches for pruning
 
     Property* properties_;
     const SchemaType* additionalPropertiesSchema_;
@@ -1248,6 +1617,7 @@ private:
     bool uniqueItems_;
 
     RegexType* pattern_;
+    SValue patternSource_;
     SizeType minLength_;
     SizeType maxLength_;
 
@@ -1343,7 +1713,8 @@ public:
         root_(),
         typeless_(),
         schemaMap_(allocator, kInitialSchemaMapSize),
-        schemaRef_(allocator, kInitialSchemaRefSize)
+        schemaRef_(allocator, kInitialSchemaRefSize),
+        imageError_()
     {
         if (!allocator_)
             ownAllocator_ = allocator_ = RAPIDJSON_NEW(Allocator)();
@@ -1373,11 +1744,57 @@ public:
             refEntry->~SchemaRefEntry();
         }
 
+        // Find discriminators of anyOf/oneOf, which requires all $ref being resolved
+        for (SchemaEntry* entry = schemaMap_.template Bottom<SchemaEntry>(); entry != schemaMap_.template End<SchemaEntry>(); ++entry)
+            if (entry->owned)
+                entry->schema->ResolveDiscriminators();
+
         RAPIDJSON_ASSERT(root_ != 0);
 
         schemaRef_.ShrinkToFit(); // Deallocate all memory for ref
     }
 
+    //! Constructor from a schema image.
+    /*!
+        Load a schema document from an image written by \c Serialize(), without parsing and compiling the JSON schema again.
+        The image can be memory-mapped from a file.
+
+        Property names and regex sources are referenced in place, so the image must outlive this document and
+        be aligned to \c sizeof(Ch). Regexes are compiled again from their sources.
+
+        If the image is truncated, malformed or was written for another platform or encoding, \c HasImageError() returns true
+        and the root schema accepts everything.
+
+        \param image Pointer to the image.
+        \param length Length of the image in bytes.
+        \param allocator An optional allocator instance for allocating memory. Can be null.
+    */
+    GenericSchemaDocument(const void* image, size_t length, Allocator* allocator = 0) :
+        remoteProvider_(),
+        allocator_(allocator),
+        ownAllocator_(),
+        root_(),
+        typeless_(),
+        schemaMap_(allocator, kInitialSchemaMapSize),
+        schemaRef_(allocator, kInitialSchemaRefSize),
+        imageError_()
+    {
+        if (!allocator_)
+            ownAllocator_ = allocator_ = RAPIDJSON_NEW(Allocator)();
+
+        typeless_ = static_cast<SchemaType*>(allocator_->Malloc(sizeof(SchemaType)));
+        new (typeless_) SchemaType(this, PointerType(), ValueType(kObjectType).Move(), ValueType(kObjectType).Move(), 0);
+
+        if (!image || !LoadImage(static_cast<const char*>(image), length)) {
+            while (!schemaMap_.Empty())
+                schemaMap_.template Pop<SchemaEntry>(1)->~SchemaEntry();
+            root_ = typeless_;
+            imageError_ = true;
+        }
+
+        schemaRef_.ShrinkToFit();
+    }
+
 #if RAPIDJSON_HAS_CXX11_RVALUE_REFS
     //! Move constructor in C++11
     GenericSchemaDocument(GenericSchemaDocument&& rhs) RAPIDJSON_NOEXCEPT :
@@ -1387,7 +1804,8 @@ public:
         root_(rhs.root_),
         typeless_(rhs.typeless_),
         schemaMap_(std::move(rhs.schemaMap_)),
-        schemaRef_(std::move(rhs.schemaRef_))
+        schemaRef_(std::move(rhs.schemaRef_)),
+        imageError_(rhs.imageError_)
     {
         rhs.remoteProvider_ = 0;
         rhs.allocator_ = 0;
@@ -1412,6 +1830,57 @@ public:
     //! Get the root schema.
     const SchemaType& GetRoot() const { return *root_; }
 
+    //! Whether the image given to the constructor was rejected.
+    bool HasImageError() const { return imageError_; }
+
+    //! Write the compiled schemas as a binary image.
+    /*!
+        The image can be loaded by \c GenericSchemaDocument(const void*, size_t, Allocator*) on a platform with the same
+        byte order, \c Ch and \c SizeType.
+
+        \tparam OutputStream Type of output stream with single-byte \c Ch, e.g. \c StringBuffer.
+        \param os Output stream.
+        \return false if a schema refers to another (remote) schema document, which cannot be stored in the image.
+            The image written is then incomplete.
+    */
+    template <typename OutputStream>
+    bool Serialize(OutputStream& os) const {
+        RAPIDJSON_STATIC_ASSERT(sizeof(typename OutputStream::Ch) == 1);
+        ImageWriter<OutputStream> w(*this, os);
+
+        uint32_t version = kImageVersion, byteOrder = kImageByteOrder;
+        w.Write(GetImageMagic(), 4);
+        w.Write(version);
+        w.Write(byteOrder);
+        w.Write(static_cast<unsigned char>(sizeof(Ch)));
+        w.Write(static_cast<unsigned char>(sizeof(SizeType)));
+
+        SizeType schemaCount = 0, aliasCount = 0;
+        for (const SchemaEntry* entry = schemaMap_.template Bottom<SchemaEntry>(); entry != schemaMap_.template End<SchemaEntry>(); ++entry)
+            if (entry->owned)
+                schemaCount++;
+            else
+                aliasCount++;
+        w.Write(schemaCount);
+        w.Write(aliasCount);
+        w.WriteSchema(root_);
+
+        // Owned schemas first, so that their indices are known before any of them is read.
+        for (const SchemaEntry* entry = schemaMap_.template Bottom<SchemaEntry>(); entry != schemaMap_.template End<SchemaEntry>(); ++entry)
+            if (entry->owned)
+                SerializePointer(w, entry->pointer);
+        for (const SchemaEntry* entry = schemaMap_.template Bottom<SchemaEntry>(); entry != schemaMap_.template End<SchemaEntry>(); ++entry)
+            if (!entry->owned) {
+                SerializePointer(w, entry->pointer);
+                w.WriteSchema(entry->schema);
+            }
+        for (const SchemaEntry* entry = schemaMap_.template Bottom<SchemaEntry>(); entry != schemaMap_.template End<SchemaEntry>(); ++entry)
+            if (entry->owned)
+                entry->schema->Serialize(w);
+
+        return w.IsValid();
+    }
+
 private:
     //! Prohibit copying
     GenericSchemaDocument(const GenericSchemaDocument&);
@@ -1529,6 +1998,214 @@ private:
 
     const SchemaType* GetTypeless() const { return typeless_; }
 
+    static const char* GetImageMagic() {
+        static const char magic[] = { 'R', 'J', 'S', 'I' };
+        return magic;
+    }
+
+    static const uint32_t kImageVersion = 1;
+    static const uint32_t kImageByteOrder = 0x01020304u;
+    static const SizeType kNullSchemaIndex = ~SizeType(0);
+    static const SizeType kTypelessSchemaIndex = ~SizeType(0) - 1;
+
+    // O(n), as GetPointer()
+    SizeType GetSchemaIndex(const SchemaType* schema, bool& valid) const {
+        if (!schema)
+            return kNullSchemaIndex;
+        if (schema == typeless_)
+            return kTypelessSchemaIndex;
+        SizeType index = 0;
+        for (const SchemaEntry* target = schemaMap_.template Bottom<SchemaEntry>(); target != schemaMap_.template End<SchemaEntry>(); ++target)
+            if (target->owned) {
+                if (schema == target->schema)
+                    return index;
+                index++;
+            }
+        valid = false; // Schema of a remote document
+        return kNullSchemaIndex;
+    }
+
+    template <typename OutputStream>
+    class ImageWriter {
+    public:
+        ImageWriter(const GenericSchemaDocument& document, OutputStream& os) : document_(document), os_(os), size_(), valid_(true) {}
+
+        void Write(const void* data, size_t length) {
+            const unsigned char* p = static_cast<const unsigned char*>(data);
+            for (size_t i = 0; i < length; i++)
+                os_.Put(static_cast<typename OutputStream::Ch>(p[i]));
+            size_ += length;
+        }
+
+        template <typename T>
+        void Write(const T& v) { Write(&v, sizeof(T)); }
+
+        void Write(bool b) { Write(static_cast<unsigned char>(b ? 1 : 0)); }
+
+        // Null-terminated, aligned to sizeof(Ch) so that it can be referenced in place.
+        void WriteString(const Ch* s, SizeType length) {
+            Write(length);
+            while (size_ % sizeof(Ch) != 0)
+                Write(static_cast<unsigned char>(0));
+            Write(s, sizeof(Ch) * length);
+            Write(Ch());
+        }
+
+        void WriteSchema(const SchemaType* schema) { Write(document_.GetSchemaIndex(schema, valid_)); }
+
+        bool IsValid() const { return valid_; }
+
+    private:
+        ImageWriter(const ImageWriter&);
+        ImageWriter& operator=(const ImageWriter&);
+
+        const GenericSchemaDocument& document_;
+        OutputStream& os_;
+        size_t size_;
+        bool valid_;
+    };
+
+    class ImageReader {
+    public:
+        ImageReader(const char* begin, size_t length, const SchemaType* typeless) :
+            begin_(begin), cur_(begin), end_(begin + length), typeless_(typeless), schemas_(), schemaCount_() {}
+
+        bool CanRead(size_t count, size_t size) const { return count <= static_cast<size_t>(end_ - cur_) / size; }
+
+        bool Read(void* data, size_t length) {
+            if (!CanRead(length, 1))
+                return false;
+            std::memcpy(data, cur_, length);
+            cur_ += length;
+            return true;
+        }
+
+        template <typename T>
+        bool Read(T& v) { return Read(&v, sizeof(T)); }
+
+        bool Read(bool& b) {
+            unsigned char c;
+            if (!Read(c) || c > 1)
+                return false;
+            b = c != 0;
+            return true;
+        }
+
+        bool ReadString(const Ch*& s, SizeType& length) {
+            if (!Read(length))
+                return false;
+            while (static_cast<size_t>(cur_ - begin_) % sizeof(Ch) != 0)
+                if (cur_++ == end_)
+                    return false;
+            if (!CanRead(static_cast<size_t>(length) + 1, sizeof(Ch)))
+                return false;
+            s = reinterpret_cast<const Ch*>(cur_);
+            cur_ += sizeof(Ch) * (static_cast<size_t>(length) + 1);
+            return s[length] == '\0';
+        }
+
+        bool ReadSchema(const SchemaType*& schema) {
+            SizeType index;
+            return Read(index) && GetSchema(index, schema);
+        }
+
+        bool GetSchema(SizeType index, const SchemaType*& schema) const {
+            if (index == kNullSchemaIndex)
+                schema = 0;
+            else if (index == kTypelessSchemaIndex)
+                schema = typeless_;
+            else if (index < schemaCount_)
+                schema = schemas_[index].schema;
+            else
+                return false;
+            return true;
+        }
+
+        void SetSchemas(const SchemaEntry* schemas, SizeType count) { schemas_ = schemas; schemaCount_ = count; }
+
+        bool AtEnd() const { return cur_ == end_; }
+
+    private:
+        const char* begin_;
+        const char* cur_;
+        const char* end_;
+        const SchemaType* typeless_;
+        const SchemaEntry* schemas_;
+        SizeType schemaCount_;
+    };
+
+    template <typename Writer>
+    static void SerializePointer(Writer& w, const PointerType& pointer) {
+        SizeType tokenCount = static_cast<SizeType>(pointer.GetTokenCount());
+        w.Write(tokenCount);
+        for (const typename PointerType::Token* t = pointer.GetTokens(); t != pointer.GetTokens() + tokenCount; ++t) {
+            w.Write(t->index);
+            w.WriteString(t->name, t->length);
+        }
+    }
+
+    bool DeserializePointer(ImageReader& r, PointerType& pointer) {
+        SizeType tokenCount;
+        if (!r.Read(tokenCount) || !r.CanRead(tokenCount, sizeof(SizeType) * 2))
+            return false;
+        for (SizeType i = 0; i < tokenCount; i++) {
+            typename PointerType::Token t;
+            if (!r.Read(t.index) || !r.ReadString(t.name, t.length))
+                return false;
+            pointer = pointer.Append(t, allocator_);
+        }
+        return true;
+    }
+
+    bool LoadImage(const char* image, size_t length) {
+        ImageReader r(image, length, typeless_);
+
+        char magic[4];
+        uint32_t version, byteOrder;
+        unsigned char chSize, sizeTypeSize;
+        if (!r.Read(magic, 4) || std::memcmp(magic, GetImageMagic(), 4) != 0 ||
+            !r.Read(version) || version != kImageVersion ||
+            !r.Read(byteOrder) || byteOrder != kImageByteOrder ||
+            !r.Read(chSize) || chSize != sizeof(Ch) ||
+            !r.Read(sizeTypeSize) || sizeTypeSize != sizeof(SizeType))
+            return false;
+
+        SizeType schemaCount, aliasCount, rootIndex;
+        if (!r.Read(schemaCount) || !r.Read(aliasCount) || !r.Read(rootIndex) || !r.CanRead(static_cast<size_t>(schemaCount) + aliasCount, sizeof(SizeType)))
+            return false;
+
+        schemaMap_.template Reserve<SchemaEntry>(static_cast<size_t>(schemaCount) + aliasCount); // Entries must not move while being referenced by r
+        for (SizeType i = 0; i < schemaCount; i++) {
+            PointerType pointer;
+            if (!DeserializePointer(r, pointer))
+                return false;
+            SchemaType* s = new (allocator_->Malloc(sizeof(SchemaType))) SchemaType(this, PointerType(), ValueType(kObjectType).Move(), ValueType(kObjectType).Move(), allocator_);
+            new (schemaMap_.template Push<SchemaEntry>()) SchemaEntry(pointer, s, true, allocator_);
+        }
+        r.SetSchemas(schemaMap_.template Bottom<SchemaEntry>(), schemaCount);
+
+        for (SizeType i = 0; i < aliasCount; i++) {
+            PointerType pointer;
+            const SchemaType* s;
+            if (!DeserializePointer(r, pointer) || !r.ReadSchema(s) || !s)
+                return false;
+            new (schemaMap_.template Push<SchemaEntry>()) SchemaEntry(pointer, const_cast<SchemaType*>(s), false, allocator_);
+        }
+
+        if (!r.GetSchema(rootIndex, root_) || !root_)
+            return false;
+
+        SchemaEntry* entries = schemaMap_.template Bottom<SchemaEntry>();
+        for (SizeType i = 0; i < schemaCount; i++)
+            if (!entries[i].schema->Deserialize(r))
+                return false;
+
+        for (SizeType i = 0; i < schemaCount; i++)
+            entries[i].schema->ResolveDiscriminators();
+
+        return r.AtEnd();
+    }
+
     static const size_t kInitialSchemaMapSize = 64;
     static const size_t kInitialSchemaRefSize = 64;
 
@@ -1539,6 +2216,7 @@ private:
     SchemaType* typeless_;
     internal::Stack<Allocator> schemaMap_;  // Stores created Pointer -> Schemas
     internal::Stack<Allocator> schemaRef_;  // Stores Pointer from $ref and schema which holds the $ref
+    bool imageError_;                       //!< Whether the image given to the constructor was rejected.
 };
 
 //! GenericSchemaDocument using Value type.
@@ -1556,6 +2234,13 @@ typedef IGenericRemoteSchemaDocumentProvider<SchemaDocument> IRemoteSchemaDocume
     It delegates the incoming SAX events to an output handler.
     The default output handler does nothing.
     It can be reused multiple times by calling \c Reset().
+    Child validators, hashers and state arrays are pooled instead of being freed,
+    so that validating documents after a \c Reset() requires no allocation once the pools are warm.
+
+    Child validators (of allOf, anyOf, oneOf, not, dependencies and patternProperties) do not forward events to
+    an output handler of \c OutputHandler type, and do not track the document path, which is only reported by the
+    outermost validator. Array indices of the document path are formatted only when \c GetInvalidDocumentPointer()
+    is called.
 
     \tparam SchemaDocumentType Type of schema document.
     \tparam OutputHandler Type of output handler. Default handler does nothing.
@@ -1574,6 +2259,8 @@ public:
     typedef typename SchemaDocumentType::PointerType PointerType;
     typedef typename SchemaType::EncodingType EncodingType;
     typedef typename EncodingType::Ch Ch;
+    template <typename, typename, typename>
+    friend class GenericSchemaValidator;
 
     //! Constructor without output handler.
     /*!
@@ -1589,17 +2276,22 @@ public:
         size_t documentStackCapacity = kDefaultDocumentStackCapacity)
         :
         schemaDocument_(&schemaDocument),
-        root_(schemaDocument.GetRoot()),
+        root_(&schemaDocument.GetRoot()),
         stateAllocator_(allocator),
         ownStateAllocator_(0),
         schemaStack_(allocator, schemaStackCapacity),
         documentStack_(allocator, documentStackCapacity),
+        validatorPool_(allocator, kDefaultPoolCapacity),
+        hasherPool_(allocator, kDefaultPoolCapacity),
+        statePoolAllocator_(this),
         outputHandler_(CreateNullHandler()),
-        valid_(true)
+        valid_(true),
+        trackDocumentPath_(true)
 #if RAPIDJSON_SCHEMA_VERBOSE
         , depth_(0)
 #endif
     {
+        std::memset(statePool_, 0, sizeof(statePool_));
     }
 
     //! Constructor with output handler.
@@ -1617,23 +2309,29 @@ public:
         size_t documentStackCapacity = kDefaultDocumentStackCapacity)
         :
         schemaDocument_(&schemaDocument),
-        root_(schemaDocument.GetRoot()),
+        root_(&schemaDocument.GetRoot()),
         stateAllocator_(allocator),
         ownStateAllocator_(0),
         schemaStack_(allocator, schemaStackCapacity),
         documentStack_(allocator, documentStackCapacity),
+        validatorPool_(allocator, kDefaultPoolCapacity),
+        hasherPool_(allocator, kDefaultPoolCapacity),
+        statePoolAllocator_(this),
         outputHandler_(outputHandler),
         nullHandler_(0),
-        valid_(true)
+        valid_(true),
+        trackDocumentPath_(true)
 #if RAPIDJSON_SCHEMA_VERBOSE
         , depth_(0)
 #endif
     {
+        std::memset(statePool_, 0, sizeof(statePool_));
     }
 
     //! Destructor.
     ~GenericSchemaValidator() {
         Reset();
+        ReleasePools();
         if (nullHandler_) {
             nullHandler_->~OutputHandler();
             StateAllocator::Free(nullHandler_);
@@ -1642,6 +2340,7 @@ public:
     }
 
     //! Reset the internal states.
+    /*! Memory of the internal states is kept in pools for reusing in subsequent validation. */
     void Reset() {
         while (!schemaStack_.Empty())
             PopSchema();
@@ -1665,15 +2364,20 @@ public:
 
     //! Gets the JSON pointer pointed to the invalid value.
     PointerType GetInvalidDocumentPointer() const {
-        return documentStack_.Empty() ? PointerType() : PointerType(documentStack_.template Bottom<Ch>(), documentStack_.GetSize() / sizeof(Ch));
+        if (documentStack_.Empty())
+            return PointerType();
+        internal::Stack<StateAllocator> path(stateAllocator_, documentStack_.GetSize() + kDefaultDocumentStackCapacity);
+        GetDocumentPath(path);
+        return PointerType(path.template Bottom<Ch>(), path.GetSize() / sizeof(Ch));
     }
 
 #if RAPIDJSON_SCHEMA_VERBOSE
 #define RAPIDJSON_SCHEMA_HANDLE_BEGIN_VERBOSE_() \
 RAPIDJSON_MULTILINEMACRO_BEGIN\
-    *documentStack_.template Push<Ch>() = '\0';\
-    documentStack_.template Pop<Ch>(1);\
-    internal::PrintInvalidDocument(documentStack_.template Bottom<Ch>());\
+    internal::Stack<StateAllocator> path_(stateAllocator_, kDefaultDocumentStackCapacity);\
+    GetDocumentPath(path_);\
+    *path_.template Push<Ch>() = '\0';\
+    internal::PrintInvalidDocument(path_.template Bottom<Ch>());\
 RAPIDJSON_MULTILINEMACRO_END
 #else
 #define RAPIDJSON_SCHEMA_HANDLE_BEGIN_VERBOSE_()
@@ -1686,25 +2390,39 @@ RAPIDJSON_MULTILINEMACRO_END
         return valid_ = false;\
     }
 
+#define RAPIDJSON_SCHEMA_HANDLE_DISCRIMINATOR_(method, arg2)\
+    if (schemaStack_.GetSize() > sizeof(Context)) {\
+        Context& parent_ = *(schemaStack_.template Top<Context>() - 1);\
+        if (parent_.discriminatorPending) {\
+            char buffer_[256 + 24];\
+            MemoryPoolAllocator<> hasherAllocator_(buffer_, sizeof(buffer_));\
+            internal::Hasher<EncodingType, MemoryPoolAllocator<> > hasher_(&hasherAllocator_, 256);\
+            hasher_.method arg2;\
+            parent_.schema->PruneBranches(parent_, hasher_.GetHashCode());\
+        }\
+    }
+
 #define RAPIDJSON_SCHEMA_HANDLE_PARALLEL_(method, arg2)\
     for (Context* context = schemaStack_.template Bottom<Context>(); context != schemaStack_.template End<Context>(); context++) {\
         if (context->hasher)\
             static_cast<HasherType*>(context->hasher)->method arg2;\
         if (context->validators)\
             for (SizeType i_ = 0; i_ < context->validatorCount; i_++)\
-                static_cast<GenericSchemaValidator*>(context->validators[i_])->method arg2;\
+                if (context->validators[i_])\
+                    static_cast<ChildValidator*>(context->validators[i_])->method arg2;\
         if (context->patternPropertiesValidators)\
             for (SizeType i_ = 0; i_ < context->patternPropertiesValidatorCount; i_++)\
-                static_cast<GenericSchemaValidator*>(context->patternPropertiesValidators[i_])->method arg2;\
+                static_cast<ChildValidator*>(context->patternPropertiesValidators[i_])->method arg2;\
     }
 
 #define RAPIDJSON_SCHEMA_HANDLE_END_(method, arg2)\
     return valid_ = EndValue() && outputHandler_.method arg2
 
 #define RAPIDJSON_SCHEMA_HANDLE_VALUE_(method, arg1, arg2) \
-    RAPIDJSON_SCHEMA_HANDLE_BEGIN_   (method, arg1);\
-    RAPIDJSON_SCHEMA_HANDLE_PARALLEL_(method, arg2);\
-    RAPIDJSON_SCHEMA_HANDLE_END_     (method, arg2)
+    RAPIDJSON_SCHEMA_HANDLE_BEGIN_        (method, arg1);\
+    RAPIDJSON_SCHEMA_HANDLE_DISCRIMINATOR_(method, arg2);\
+    RAPIDJSON_SCHEMA_HANDLE_PARALLEL_     (method, arg2);\
+    RAPIDJSON_SCHEMA_HANDLE_END_          (method, arg2)
 
     bool Null()             { RAPIDJSON_SCHEMA_HANDLE_VALUE_(Null,   (CurrentContext()   ), ( )); }
     bool Bool(bool b)       { RAPIDJSON_SCHEMA_HANDLE_VALUE_(Bool,   (CurrentContext(), b), (b)); }
@@ -1726,7 +2444,8 @@ RAPIDJSON_MULTILINEMACRO_END
     
     bool Key(const Ch* str, SizeType len, bool copy) {
         if (!valid_) return false;
-        AppendToken(str, len);
+        if (trackDocumentPath_)
+            AppendToken(str, len);
         if (!CurrentSchema().Key(CurrentContext(), str, len, copy)) return valid_ = false;
         RAPIDJSON_SCHEMA_HANDLE_PARALLEL_(Key, (str, len, copy));
         return valid_ = outputHandler_.Key(str, len, copy);
@@ -1754,12 +2473,18 @@ RAPIDJSON_MULTILINEMACRO_END
 
 #undef RAPIDJSON_SCHEMA_HANDLE_BEGIN_VERBOSE_
 #undef RAPIDJSON_SCHEMA_HANDLE_BEGIN_
+#undef RAPIDJSON_SCHEMA_HANDLE_DISCRIMINATOR_
 #undef RAPIDJSON_SCHEMA_HANDLE_PARALLEL_
 #undef RAPIDJSON_SCHEMA_HANDLE_VALUE_
 
     // Implementation of ISchemaStateFactory<SchemaType>
     virtual ISchemaValidator* CreateSchemaValidator(const SchemaType& root) {
-        return new (GetStateAllocator().Malloc(sizeof(GenericSchemaValidator))) GenericSchemaValidator(*schemaDocument_, root,
+        if (!validatorPool_.Empty()) {
+            ChildValidator* v = *validatorPool_.template Pop<ChildValidator*>(1);
+            v->root_ = &root;
+            return v;
+        }
+        return new (GetStateAllocator().Malloc(sizeof(ChildValidator))) ChildValidator(*schemaDocument_, root,
 #if RAPIDJSON_SCHEMA_VERBOSE
         depth_ + 1,
 #endif
@@ -1767,12 +2492,14 @@ RAPIDJSON_MULTILINEMACRO_END
     }
 
     virtual void DestroySchemaValidator(ISchemaValidator* validator) {
-        GenericSchemaValidator* v = static_cast<GenericSchemaValidator*>(validator);
-        v->~GenericSchemaValidator();
-        StateAllocator::Free(v);
+        ChildValidator* v = static_cast<ChildValidator*>(validator);
+        v->Reset();
+        *validatorPool_.template Push<ChildValidator*>() = v;
     }
 
     virtual void* CreateHasher() {
+        if (!hasherPool_.Empty())
+            return *hasherPool_.template Pop<HasherType*>(1);
         return new (GetStateAllocator().Malloc(sizeof(HasherType))) HasherType(&GetStateAllocator());
     }
 
@@ -1782,21 +2509,51 @@ RAPIDJSON_MULTILINEMACRO_END
 
     virtual void DestroryHasher(void* hasher) {
         HasherType* h = static_cast<HasherType*>(hasher);
-        h->~HasherType();
-        StateAllocator::Free(h);
+        h->Reset();
+        *hasherPool_.template Push<HasherType*>() = h;
     }
 
     virtual void* MallocState(size_t size) {
-        return GetStateAllocator().Malloc(size);
+        size_t sizeClass = 0;
+        while (size > 0 && ((size - 1) >> sizeClass) >= kMinStateSize) // kMinStateSize << sizeClass < size, without overflow
+            sizeClass++;
+        RAPIDJSON_ASSERT(sizeClass < kStateSizeClassCount);
+
+        char* block;
+        if (statePool_[sizeClass]) {
+            block = static_cast<char*>(statePool_[sizeClass]);
+            statePool_[sizeClass] = *reinterpret_cast<void**>(block + kStateHeaderSize);
+        }
+        else {
+            block = static_cast<char*>(GetStateAllocator().Malloc(kStateHeaderSize + (kMinStateSize << sizeClass)));
+            *reinterpret_cast<size_t*>(block) = sizeClass;
+        }
+        return block + kStateHeaderSize;
     }
 
     virtual void FreeState(void* p) {
-        StateAllocator::Free(p);
+        char* block = static_cast<char*>(p) - kStateHeaderSize;
+        size_t sizeClass = *reinterpret_cast<size_t*>(block);
+        *static_cast<void**>(p) = statePool_[sizeClass];
+        statePool_[sizeClass] = block;
     }
 
 private:
     typedef typename SchemaType::Context Context;
-    typedef GenericValue<UTF8<>, StateAllocator> HashCodeArray;
+    typedef GenericSchemaValidator<SchemaDocumentType, BaseReaderHandler<EncodingType>, StateAllocator> ChildValidator;
+
+    // Allocator taking blocks from the state pool, so that the slots of a HashCodeSet are reused as the sets are.
+    class StatePoolAllocator {
+    public:
+        static const bool kNeedFree = true;
+        explicit StatePoolAllocator(GenericSchemaValidator* validator) : validator_(validator) {}
+        void* Malloc(size_t size) { return size ? validator_->MallocState(size) : 0; }
+        void Free(void* p) { if (p) validator_->FreeState(p); }
+    private:
+        GenericSchemaValidator* validator_;
+    };
+
+    typedef internal::HashCodeSet<StatePoolAllocator> HashCodeSetType;
     typedef internal::Hasher<EncodingType, StateAllocator> HasherType;
 
     GenericSchemaValidator( 
@@ -1810,17 +2567,22 @@ private:
         size_t documentStackCapacity = kDefaultDocumentStackCapacity)
         :
         schemaDocument_(&schemaDocument),
-        root_(root),
+        root_(&root),
         stateAllocator_(allocator),
         ownStateAllocator_(0),
         schemaStack_(allocator, schemaStackCapacity),
         documentStack_(allocator, documentStackCapacity),
+        validatorPool_(allocator, kDefaultPoolCapacity),
+        hasherPool_(allocator, kDefaultPoolCapacity),
+        statePoolAllocator_(this),
         outputHandler_(CreateNullHandler()),
-        valid_(true)
+        valid_(true),
+        trackDocumentPath_(RAPIDJSON_SCHEMA_VERBOSE != 0) // Only for printing
 #if RAPIDJSON_SCHEMA_VERBOSE
         , depth_(depth)
 #endif
     {
+        std::memset(statePool_, 0, sizeof(statePool_));
     }
 
     StateAllocator& GetStateAllocator() {
@@ -1829,12 +2591,30 @@ private:
         return *stateAllocator_;
     }
 
+    void ReleasePools() {
+        while (!validatorPool_.Empty()) {
+            ChildValidator* v = *validatorPool_.template Pop<ChildValidator*>(1);
+            v->~ChildValidator();
+            StateAllocator::Free(v);
+        }
+        while (!hasherPool_.Empty()) {
+            HasherType* h = *hasherPool_.template Pop<HasherType*>(1);
+            h->~HasherType();
+            StateAllocator::Free(h);
+        }
+        for (size_t i = 0; i < kStateSizeClassCount; i++)
+            while (void* block = statePool_[i]) {
+                statePool_[i] = *reinterpret_cast<void**>(static_cast<char*>(block) + kStateHeaderSize);
+                StateAllocator::Free(block);
+            }
+    }
+
     bool BeginValue() {
         if (schemaStack_.Empty())
-            PushSchema(root_);
+            PushSchema(*root_);
         else {
-            if (CurrentContext().inArray)
-                internal::TokenHelper<internal::Stack<StateAllocator>, Ch>::AppendIndexToken(documentStack_, CurrentContext().arrayElementIndex);
+            if (CurrentContext().inArray && trackDocumentPath_)
+                *documentStack_.template Push<Ch>() = '/'; // Index is formatted by GetDocumentPath()
 
             if (!CurrentSchema().BeginValue(CurrentContext()))
                 return false;
@@ -1868,9 +2648,10 @@ private:
         GenericStringBuffer<EncodingType> sb;
         schemaDocument_->GetPointer(&CurrentSchema()).Stringify(sb);
 
-        *documentStack_.template Push<Ch>() = '\0';
-        documentStack_.template Pop<Ch>(1);
-        internal::PrintValidatorPointers(depth_, sb.GetString(), documentStack_.template Bottom<Ch>());
+        internal::Stack<StateAllocator> path(stateAllocator_, kDefaultDocumentStackCapacity);
+        GetDocumentPath(path);
+        *path.template Push<Ch>() = '\0';
+        internal::PrintValidatorPointers(depth_, sb.GetString(), path.template Bottom<Ch>());
 #endif
 
         uint64_t h = CurrentContext().arrayUniqueness ? static_cast<HasherType*>(CurrentContext().hasher)->GetHashCode() : 0;
@@ -1880,13 +2661,11 @@ private:
         if (!schemaStack_.Empty()) {
             Context& context = CurrentContext();
             if (context.valueUniqueness) {
-                HashCodeArray* a = static_cast<HashCodeArray*>(context.arrayElementHashCodes);
+                HashCodeSetType* a = static_cast<HashCodeSetType*>(context.arrayElementHashCodes);
                 if (!a)
-                    CurrentContext().arrayElementHashCodes = a = new (GetStateAllocator().Malloc(sizeof(HashCodeArray))) HashCodeArray(kArrayType);
-                for (typename HashCodeArray::ConstValueIterator itr = a->Begin(); itr != a->End(); ++itr)
-                    if (itr->GetUint64() == h)
-                        RAPIDJSON_INVALID_KEYWORD_RETURN(SchemaType::GetUniqueItemsString());
-                a->PushBack(h, GetStateAllocator());
+                    context.arrayElementHashCodes = a = new (MallocState(sizeof(HashCodeSetType))) HashCodeSetType(&statePoolAllocator_);
+                if (!a->Insert(h))
+                    RAPIDJSON_INVALID_KEYWORD_RETURN(SchemaType::GetUniqueItemsString());
             }
         }
 
@@ -1897,6 +2676,24 @@ private:
         return true;
     }
 
+    // documentStack_ holds one token per context from the bottom of schemaStack_: an escaped key for objects,
+    // or a bare '/' for arrays, whose index (arrayElementIndex - 1) is only formatted here.
+    void GetDocumentPath(internal::Stack<StateAllocator>& path) const {
+        const Context* context = schemaStack_.template Bottom<Context>();
+        const Ch* end = documentStack_.template End<Ch>();
+        for (const Ch* token = documentStack_.template Bottom<Ch>(); token != end; ++context) {
+            RAPIDJSON_ASSERT(*token == '/' && context != schemaStack_.template End<Context>());
+            const Ch* next = token + 1;
+            while (next != end && *next != '/')
+                ++next;
+            if (context->inArray)
+                internal::TokenHelper<internal::Stack<StateAllocator>, Ch>::AppendIndexToken(path, context->arrayElementIndex - 1);
+            else
+                std::memcpy(path.template Push<Ch>(static_cast<size_t>(next - token)), token, sizeof(Ch) * static_cast<size_t>(next - token));
+            token = next;
+        }
+    }
+
     void AppendToken(const Ch* str, SizeType len) {
         documentStack_.template Reserve<Ch>(1 + len * 2); // worst case all characters are escaped as two characters
         *documentStack_.template PushUnsafe<Ch>() = '/';
@@ -1918,9 +2715,9 @@ private:
     
     RAPIDJSON_FORCEINLINE void PopSchema() {
         Context* c = schemaStack_.template Pop<Context>(1);
-        if (HashCodeArray* a = static_cast<HashCodeArray*>(c->arrayElementHashCodes)) {
-            a->~HashCodeArray();
-            StateAllocator::Free(a);
+        if (HashCodeSetType* a = static_cast<HashCodeSetType*>(c->arrayElementHashCodes)) {
+            a->~HashCodeSetType();
+            FreeState(a);
         }
         c->~Context();
     }
@@ -1935,15 +2732,24 @@ private:
 
     static const size_t kDefaultSchemaStackCapacity = 1024;
     static const size_t kDefaultDocumentStackCapacity = 256;
+    static const size_t kDefaultPoolCapacity = 16 * sizeof(void*);
+    static const size_t kMinStateSize = 16;
+    static const size_t kStateSizeClassCount = sizeof(size_t) * 8 - 4;  // kMinStateSize << (kStateSizeClassCount - 1) fits in size_t
+    static const size_t kStateHeaderSize = RAPIDJSON_ALIGN(sizeof(size_t));
     const SchemaDocumentType* schemaDocument_;
-    const SchemaType& root_;
+    const SchemaType* root_;
     StateAllocator* stateAllocator_;
     StateAllocator* ownStateAllocator_;
     internal::Stack<StateAllocator> schemaStack_;    //!< stack to store the current path of schema (BaseSchemaType *)
     internal::Stack<StateAllocator> documentStack_;  //!< stack to store the current path of validating document (Ch)
+    internal::Stack<StateAllocator> validatorPool_;  //!< released child validators for reuse (GenericSchemaValidator *)
+    internal::Stack<StateAllocator> hasherPool_;     //!< released hashers for reuse (HasherType *)
+    void* statePool_[kStateSizeClassCount];          //!< free lists of state blocks, by power-of-two size class
+    StatePoolAllocator statePoolAllocator_;          //!< gives state blocks to hash code sets
     OutputHandler& outputHandler_;
     OutputHandler* nullHandler_;
     bool valid_;
+    bool trackDocumentPath_;                         //!< false for child validators, whose document path is never reported
 #if RAPIDJSON_SCHEMA_VERBOSE
     unsigned depth_;
 #endif
@@ -0,0 +1,246 @@
+// Tencent is pleased to support the open source community by making RapidJSON available.
+//
+// Copyright (C) 2015 THL A29 Limited, a Tencent company, and Milo Yip. All rights reserved.
+//
+// Licensed under the MIT License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// http://opensource.org/licenses/MIT
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#ifndef RAPIDJSON_SERIALIZEDSIZE_H_
+#define RAPIDJSON_SERIALIZEDSIZE_H_
+
+#include "document.h"
+#include "writer.h"
+#include "internal/hashtable.h"
+
+#ifdef _MSC_VER
+RAPIDJSON_DIAG_PUSH
+RAPIDJSON_DIAG_OFF(4512) // assignment operator could not be generated
+#endif
+
+RAPIDJSON_NAMESPACE_BEGIN
+
+namespace internal {
+
+inline size_t CountDecimalDigit64(uint64_t n) {
+    size_t count = 1;
+    for (; n >= 10000; n /= 10000)
+        count += 4;
+    return count + (n >= 10) + (n >= 100) + (n >= 1000);
+}
+
+//! Extra characters written by Writer for each byte of a string: 1 for "\n" and the like, 5 for "\u00XX".
+inline const unsigned char* EscapeLengthTable() {
+#define Z16 0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0
+    static const unsigned char table[256] = {
+        //0  1  2  3  4  5  6  7  8  9  A  B  C  D  E  F
+          5, 5, 5, 5, 5, 5, 5, 5, 1, 1, 1, 5, 1, 1, 5, 5, // 00
+          5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, // 10
+          0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 20
+        Z16, Z16,                                         // 30~4F
+          0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, // 50
+        Z16, Z16, Z16, Z16, Z16, Z16, Z16, Z16, Z16, Z16  // 60~FF
+    };
+#undef Z16
+    return table;
+}
+
+} // namespace internal
+
+//! Computes the exact length of the JSON text written by a Writer for a value.
+/*! The length is the number of UTF-8 code units written by
+    <tt>Writer<OutputStream, UTF8<>, UTF8<>, StackAllocator, writeFlags></tt>, with the same
+    maximum decimal places, so that the output can be allocated once or written straight
+    into a fixed buffer. Escapes are counted with table lookups and integers by their number
+    of digits; only doubles are formatted.
+
+    When caching is enabled, the lengths of arrays and objects having at least
+    \ref kMinCachedCount elements are remembered by address, so that asking again for a
+    value or for one of its ancestors does not traverse these subtrees again. Clear() must be
+    called after any of them is modified, moved or destroyed.
+
+    \code
+    SerializedSize size;
+    size_t length = size.Get(d);
+    std::vector<char> buffer(length);
+    // ... write d with a Writer into buffer through a custom output stream
+    \endcode
+
+    \note Writer<StringBuffer> and Writer<MemoryBuffer> reserve the worst case of each value
+        before writing it (6 characters per character of a string, 25 for a double), so a
+        buffer reserved with exactly the returned length may still be expanded once near its end.
+
+    \tparam ValueType Type of value, its encoding must be UTF-8.
+    \tparam writeFlags Flags of the Writer, see \ref WriteFlag.
+    \tparam Allocator Allocator of the cache.
+*/
+template <typename ValueType, unsigned writeFlags = kWriteDefaultFlags, typename Allocator = CrtAllocator>
+class GenericSerializedSize {
+public:
+    typedef typename ValueType::Ch Ch;
+
+    //! Arrays and objects with fewer elements are not cached.
+    static const SizeType kMinCachedCount = 16;
+
+    //! Constructor
+    /*! \param cache Whether to remember the lengths of large arrays and objects.
+        \param allocator Allocator of the cache. If 0, an internal one is used.
+    */
+    explicit GenericSerializedSize(bool cache = false, Allocator* allocator = 0) :
+        ownAllocator_(cache && !allocator ? RAPIDJSON_NEW(Allocator)() : 0), cache_(cache),
+        table_(allocator ? allocator : ownAllocator_, kInitialCapacity),
+        maxDecimalPlaces_(Writer<StringBuffer>::kDefaultMaxDecimalPlaces)
+    {
+        RAPIDJSON_STATIC_ASSERT(sizeof(Ch) == 1);
+    }
+
+    ~GenericSerializedSize() {
+        table_.Release();   // before deleting its allocator
+        RAPIDJSON_DELETE(ownAllocator_);
+    }
+
+    int GetMaxDecimalPlaces() const { return maxDecimalPlaces_; }
+
+    //! Sets the maximum number of decimal places of the Writer, see Writer::SetMaxDecimalPlaces().
+    /*! Cached lengths are dropped.
+    */
+    void SetMaxDecimalPlaces(int maxDecimalPlaces) {
+        maxDecimalPlaces_ = maxDecimalPlaces;
+        Clear();
+    }
+
+    //! Returns the length of the JSON text of a value.
+    /*! \return Number of characters, or 0 if the Writer would fail because of NaN or infinity
+            without \ref kWriteNanAndInfFlag, or invalid UTF-8 with \ref kWriteValidateEncodingFlag.
+    */
+    size_t Get(const ValueType& v) {
+        switch (v.GetType()) {
+        case kNullType:     return 4;
+        case kFalseType:    return 5;
+        case kTrueType:     return 4;
+        case kStringType:   return StringLength(v.GetString(), v.GetStringLength());
+
+        case kObjectType:
+        case kArrayType: {
+            const SizeType count = v.IsObject() ? v.MemberCount() : v.Size();
+            const bool cached = cache_ && count >= kMinCachedCount;
+            if (cached) {
+                const Slot* slot = table_.Find(&v);
+                if (slot && slot->key == &v)
+                    return slot->length;
+            }
+            const size_t length = v.IsObject() ? ObjectLength(v) : ArrayLength(v);
+            if (cached && length != 0)
+                table_.Insert(&v)->length = length;
+            return length;
+        }
+
+        default:
+            RAPIDJSON_ASSERT(v.IsNumber());
+            if (v.IsDouble())       return DoubleLength(v.GetDouble());
+            else if (v.IsInt())     return (v.GetInt() < 0) + internal::CountDecimalDigit64(v.GetInt() < 0 ? 0 - static_cast<uint64_t>(v.GetInt()) : static_cast<uint64_t>(v.GetInt()));
+            else if (v.IsUint())    return internal::CountDecimalDigit64(v.GetUint());
+            else if (v.IsInt64())   return (v.GetInt64() < 0) + internal::CountDecimalDigit64(v.GetInt64() < 0 ? 0 - static_cast<uint64_t>(v.GetInt64()) : static_cast<uint64_t>(v.GetInt64()));
+            else                    return internal::CountDecimalDigit64(v.GetUint64());
+        }
+    }
+
+    //! Drops all cached lengths.
+    void Clear() { table_.Clear(); }
+
+private:
+    GenericSerializedSize(const GenericSerializedSize&);
+    GenericSerializedSize& operator=(const GenericSerializedSize&);
+
+    // Length of a container, by address
+    struct Slot {
+        typedef const ValueType* KeyType;
+        const ValueType* key;   // 0 for empty slots
+        size_t length;
+    };
+
+    static const size_t kInitialCapacity = 64;
+
+    size_t ArrayLength(const ValueType& v) {
+        size_t length = 2 + (v.Empty() ? 0 : v.Size() - 1);
+        for (typename ValueType::ConstValueIterator e = v.Begin(); e != v.End(); ++e) {
+            const size_t n = Get(*e);
+            if (n == 0)
+                return 0;
+            length += n;
+        }
+        return length;
+    }
+
+    size_t ObjectLength(const ValueType& v) {
+        size_t length = 2 + (v.ObjectEmpty() ? 0 : v.MemberCount() - 1);
+        for (typename ValueType::ConstMemberIterator m = v.MemberBegin(); m != v.MemberEnd(); ++m) {
+            const size_t key = StringLength(m->name.GetString(), m->name.GetStringLength());
+            const size_t value = Get(m->value);
+            if (key == 0 || value == 0)
+                return 0;
+            length += key + 1 + value;
+        }
+        return length;
+    }
+
+    size_t StringLength(const Ch* str, SizeType length) const {
+        const unsigned char* escape = internal::EscapeLengthTable();
+        const char* p = reinterpret_cast<const char*>(str);
+        const char* end = p + length;
+        size_t extra = 0;
+#if defined(RAPIDJSON_SSE2) || defined(RAPIDJSON_SSE42) || defined(RAPIDJSON_AVX2) || defined(RAPIDJSON_NEON)
+        // Skip blocks without escapes
+        for (; end - p >= 16; p += 16)
+            if (RAPIDJSON_UNLIKELY(internal::EscapeMask16(p) != 0))
+                for (size_t i = 0; i < 16; i++)
+                    extra += escape[static_cast<unsigned char>(p[i])];
+#endif
+        for (; p != end; ++p)
+            extra += escape[static_cast<unsigned char>(*p)];
+
+        if (writeFlags & kWriteValidateEncodingFlag) {
+            GenericStringStream<UTF8<> > is(reinterpret_cast<const char*>(str));
+            while (is.Tell() < length) {
+                unsigned codepoint;
+                if (RAPIDJSON_UNLIKELY(!UTF8<>::Decode(is, &codepoint)))
+                    return 0;
+            }
+        }
+        return 2 + length + extra;
+    }
+
+    size_t DoubleLength(double d) const {
+        if (internal::Double(d).IsNanOrInf()) {
+            if (!(writeFlags & kWriteNanAndInfFlag))
+                return 0;
+            if (internal::Double(d).IsNan())
+                return 3;
+            return internal::Double(d).Sign() ? 9 : 8;
+        }
+        char buffer[25];
+        return static_cast<size_t>(internal::dtoa(d, buffer, maxDecimalPlaces_) - buffer);
+    }
+
+    Allocator* ownAllocator_;
+    bool cache_;
+    internal::HashTable<Slot, Allocator> table_;
+    int maxDecimalPlaces_;
+};
+
+//! GenericSerializedSize for Value with the default write flags.
+typedef GenericSerializedSize<Value> SerializedSize;
+
+RAPIDJSON_NAMESPACE_END
+
+#ifdef _MSC_VER
+RAPIDJSON_DIAG_POP
+#endif
+
+#endif // RAPIDJSON_SERIALIZEDSIZE_H_
@@ -100,6 +100,33 @@ inline void PutN(Stream& stream, Ch c, size_t n) {
         PutUnsafe(stream, c);
 }
 
+//! Provides additional information for output stream.
+/*!
+    Kept apart from StreamTraits so that existing specializations of the latter stay complete.
+*/
+template<typename Stream>
+struct OutputStreamTraits {
+    //! Whether the stream may keep pointers to the characters given to PutReference().
+    /*!
+        When set, Writer gives each run of characters of a string which needs no escaping
+        to PutReference() at once, instead of putting the characters one by one.
+    */
+    enum { referenceOptimization = 0 };
+};
+
+//! Write a run of characters which the stream may reference instead of copying.
+/*!
+    \param copy Whether the characters may be invalidated before the stream is flushed,
+        with the same meaning as the \c copy parameter of the Handler concept.
+    \note Streams which set OutputStreamTraits::referenceOptimization overload this.
+*/
+template<typename Stream, typename Ch>
+inline void PutReference(Stream& stream, const Ch* s, size_t length, bool copy) {
+    (void)copy;
+    for (size_t i = 0; i < length; i++)
+        stream.Put(static_cast<typename Stream::Ch>(s[i]));
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // StringStream
 
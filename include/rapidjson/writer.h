@@ -22,9 +22,10 @@
 #include "internal/dtoa.h"
 #include "internal/itoa.h"
 #include "stringbuffer.h"
+#include "memorybuffer.h"
 #include <new>      // placement new
 
-#if defined(RAPIDJSON_SIMD) && defined(_MSC_VER)
+#if (defined(RAPIDJSON_SIMD) || defined(RAPIDJSON_AVX2)) && defined(_MSC_VER)
 #include <intrin.h>
 #pragma intrinsic(_BitScanForward)
 #endif
@@ -35,6 +36,9 @@
 #elif defined(RAPIDJSON_NEON)
 #include <arm_neon.h>
 #endif
+#ifdef RAPIDJSON_AVX2
+#include <immintrin.h>
+#endif
 
 #ifdef _MSC_VER
 RAPIDJSON_DIAG_PUSH
@@ -71,6 +75,69 @@ enum WriteFlag {
     kWriteDefaultFlags = RAPIDJSON_WRITE_DEFAULT_FLAGS  //!< Default write flags. Can be customized by defining RAPIDJSON_WRITE_DEFAULT_FLAGS
 };
 
+///////////////////////////////////////////////////////////////////////////////
+// GenericPreEscapedKey
+
+//! A member name in its JSON form, which a writer copies without escaping.
+/*!
+    It refers to the quoted name followed by a colon, e.g. \c "\"id\":". Writer::Key() copies
+    it as a whole, instead of checking every character of the name for escaping on each call.
+    The name must consist of printable ASCII characters other than '"' and '\\', so that it
+    needs neither escaping nor transcoding.
+
+    Use RAPIDJSON_PREESCAPED_KEY() to make one from a string literal.
+    \code
+    static const PreEscapedKey kId = RAPIDJSON_PREESCAPED_KEY("id");
+    writer.StartObject();
+    writer.Key(kId);
+    writer.Int(1);
+    writer.EndObject();
+    \endcode
+
+    \note The string is referenced, not copied. It must outlive the key.
+    \tparam CharType Character type of the string.
+*/
+template <typename CharType>
+struct GenericPreEscapedKey {
+    typedef CharType Ch; //!< character type of the string
+
+    //! Constructor from the JSON form of a name.
+    /*!
+        \param str Quoted name followed by a colon. It is not required to be null-terminated.
+        \param len Length of \c str, including the quotes and the colon.
+    */
+    GenericPreEscapedKey(const CharType* str, SizeType len) : s(str), length(len) { RAPIDJSON_ASSERT(IsValid()); }
+
+    //! Check whether the string is a quoted name without characters to be escaped, followed by a colon.
+    bool IsValid() const {
+        if (!s || length < 3 || s[0] != '"' || s[length - 2] != '"' || s[length - 1] != ':')
+            return false;
+        for (SizeType i = 1; i < length - 2; i++)
+            if (static_cast<unsigned>(s[i]) < 0x20 || static_cast<unsigned>(s[i]) >= 0x80 || s[i] == '"' || s[i] == '\\')
+                return false;
+        return true;
+    }
+
+    const Ch* const s;      //!< plain CharType pointer to the JSON form
+    const SizeType length;  //!< length of the JSON form (excluding the trailing NULL terminator)
+
+private:
+    //! Disallow assignment
+    GenericPreEscapedKey& operator=(const GenericPreEscapedKey&);
+};
+
+//! GenericPreEscapedKey with char.
+typedef GenericPreEscapedKey<char> PreEscapedKey;
+
+//! Make a PreEscapedKey from a string literal of a name.
+/*!
+    The JSON form is concatenated at compile time.
+    \code
+    static const PreEscapedKey kName = RAPIDJSON_PREESCAPED_KEY("name"); // refers to "\"name\":"
+    \endcode
+*/
+#define RAPIDJSON_PREESCAPED_KEY(name) ::RAPIDJSON_NAMESPACE::PreEscapedKey("\"" name "\":", sizeof("\"" name "\":") - 1)
+
 //! JSON writer
 /*! Writer implements the concept Handler.
     It generates JSON text by events to an output os.
@@ -101,15 +168,15 @@ public:
     */
     explicit
     Writer(OutputStream& os, StackAllocator* stackAllocator = 0, size_t levelDepth = kDefaultLevelDepth) : 
-        os_(&os), level_stack_(stackAllocator, levelDepth * sizeof(Level)), maxDecimalPlaces_(kDefaultMaxDecimalPlaces), hasRoot_(false) {}
+        os_(&os), level_stack_(stackAllocator, levelDepth * sizeof(Level)), maxDecimalPlaces_(kDefaultMaxDecimalPlaces), hasRoot_(false), hasKeyColon_(false) {}
 
     explicit
     Writer(StackAllocator* allocator = 0, size_t levelDepth = kDefaultLevelDepth) :
-        os_(0), level_stack_(allocator, levelDepth * sizeof(Level)), maxDecimalPlaces_(kDefaultMaxDecimalPlaces), hasRoot_(false) {}
+        os_(0), level_stack_(allocator, levelDepth * sizeof(Level)), maxDecimalPlaces_(kDefaultMaxDecimalPlaces), hasRoot_(false), hasKeyColon_(false) {}
 
 #if RAPIDJSON_HAS_CXX11_RVALUE_REFS
     Writer(Writer&& rhs) :
-        os_(rhs.os_), level_stack_(std::move(rhs.level_stack_)), maxDecimalPlaces_(rhs.maxDecimalPlaces_), hasRoot_(rhs.hasRoot_) {
+        os_(rhs.os_), level_stack_(std::move(rhs.level_stack_)), maxDecimalPlaces_(rhs.maxDecimalPlaces_), hasRoot_(rhs.hasRoot_), hasKeyColon_(rhs.hasKeyColon_) {
         rhs.os_ = 0;
     }
 #endif
@@ -135,6 +202,7 @@ public:
     void Reset(OutputStream& os) {
         os_ = &os;
         hasRoot_ = false;
+        hasKeyColon_ = false;
         level_stack_.Clear();
     }
 
@@ -203,14 +271,13 @@ public:
 
     bool String(const Ch* str, SizeType length, bool copy = false) {
         RAPIDJSON_ASSERT(str != 0);
-        (void)copy;
         Prefix(kStringType);
-        return EndValue(WriteString(str, length));
+        return EndValue(WriteString(str, length, copy));
     }
 
 #if RAPIDJSON_HAS_STDSTRING
     bool String(const std::basic_string<Ch>& str) {
-        return String(str.data(), SizeType(str.size()));
+        return String(str.data(), SizeType(str.size()), true);
     }
 #endif
 
@@ -225,9 +292,21 @@ public:
 #if RAPIDJSON_HAS_STDSTRING
     bool Key(const std::basic_string<Ch>& str)
     {
-      return Key(str.data(), SizeType(str.size()));
+      return Key(str.data(), SizeType(str.size()), true);
     }
 #endif
+
+    //! Write a member name in its JSON form, including the colon, with one copy.
+    /*!
+        \param key A name without characters to be escaped, e.g. made by RAPIDJSON_PREESCAPED_KEY().
+        \note It is written as is, so the name is not validated even with kWriteValidateEncodingFlag.
+    */
+    bool Key(const GenericPreEscapedKey<Ch>& key) {
+        RAPIDJSON_ASSERT(!level_stack_.Empty()); // must be inside an Object
+        Prefix(kStringType);
+        hasKeyColon_ = true;
+        return WriteRawValue(key.s, key.length);
+    }
 	
     bool EndObject(SizeType memberCount = 0) {
         (void)memberCount;
@@ -257,8 +336,8 @@ public:
     //@{
 
     //! Simpler but slower overload.
-    bool String(const Ch* const& str) { return String(str, internal::StrLen(str)); }
-    bool Key(const Ch* const& str) { return Key(str, internal::StrLen(str)); }
+    bool String(const Ch* const& str) { return String(str, internal::StrLen(str), true); }
+    bool Key(const Ch* const& str) { return Key(str, internal::StrLen(str), true); }
     
     //@}
 
@@ -375,7 +454,7 @@ protected:
         return true;
     }
 
-    bool WriteString(const Ch* str, SizeType length)  {
+    bool WriteString(const Ch* str, SizeType length, bool copy = true)  {
         static const typename OutputStream::Ch hexDigits[16] = { '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'A', 'B', 'C', 'D', 'E', 'F' };
         static const char escape[256] = {
 #define Z16 0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0
@@ -396,7 +475,7 @@ protected:
 
         PutUnsafe(*os_, '\"');
         GenericStringStream<SourceEncoding> is(str);
-        while (ScanWriteUnescapedString(is, length)) {
+        while (ScanWriteUnescapedString(is, length, copy)) {
             const Ch c = is.Peek();
             if (!TargetEncoding::supportUnicode && static_cast<unsigned>(c) >= 0x80) {
                 // Unicode escaping
@@ -449,7 +528,21 @@ protected:
         return true;
     }
 
-    bool ScanWriteUnescapedString(GenericStringStream<SourceEncoding>& is, size_t length) {
+    bool ScanWriteUnescapedString(GenericStringStream<SourceEncoding>& is, size_t length, bool copy) {
+        // Hand runs needing neither escaping nor transcoding to streams which can reference them
+        if (OutputStreamTraits<OutputStream>::referenceOptimization && TargetEncoding::supportUnicode &&
+            internal::IsSame<SourceEncoding, TargetEncoding>::Value && !(writeFlags & kWriteValidateEncodingFlag))
+        {
+            const Ch* p = is.src_;
+            const Ch* end = is.head_ + length;
+            const Ch* q = p;
+            while (q != end && static_cast<unsigned>(*q) >= 0x20 && *q != '"' && *q != '\\')
+                ++q;
+            if (q != p) {
+                PutReference(*os_, p, static_cast<size_t>(q - p), copy);
+                is.src_ = q;
+            }
+        }
         return RAPIDJSON_LIKELY(is.Tell() < length);
     }
 
@@ -474,8 +567,12 @@ protected:
             if (level->valueCount > 0) {
                 if (level->inArray) 
                     os_->Put(','); // add comma if it is not the first element in array
-                else  // in object
-                    os_->Put((level->valueCount % 2 == 0) ? ',' : ':');
+                else if (level->valueCount % 2 == 0) // in object
+                    os_->Put(',');
+                else if (RAPIDJSON_LIKELY(!hasKeyColon_))
+                    os_->Put(':');
+                else
+                    hasKeyColon_ = false; // written by Key(const GenericPreEscapedKey&)
             }
             if (!level->inArray && level->valueCount % 2 == 0)
                 RAPIDJSON_ASSERT(type == kStringType);  // if it's in object, then even number should be a name
@@ -498,6 +595,7 @@ protected:
     internal::Stack<StackAllocator> level_stack_;
     int maxDecimalPlaces_;
     bool hasRoot_;
+    bool hasKeyColon_;  //!< Whether the colon after the last key is written.
 
 private:
     // Prohibit copy constructor & assignment operator.
@@ -505,93 +603,88 @@ private:
     Writer& operator=(const Writer&);
 };
 
-// Full specialization for StringStream to prevent memory copying
+namespace internal {
 
-template<>
-inline bool Writer<StringBuffer>::WriteInt(int i) {
-    char *buffer = os_->Push(11);
-    const char* end = internal::i32toa(i, buffer);
-    os_->Pop(static_cast<size_t>(11 - (end - buffer)));
-    return true;
+//! Writes the escape sequence of a control character, quotation mark or reverse solidus.
+/*! \return Pointer past the last written character (2 or 6 characters are written).
+*/
+inline char* WriteEscapedAscii(char* q, char c) {
+    static const char hexDigits[16] = { '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'A', 'B', 'C', 'D', 'E', 'F' };
+    *q++ = '\\';
+    switch (c) {
+        case '\"': *q++ = '\"'; break;
+        case '\\': *q++ = '\\'; break;
+        case '\b': *q++ = 'b'; break;
+        case '\t': *q++ = 't'; break;
+        case '\n': *q++ = 'n'; break;
+        case '\f': *q++ = 'f'; break;
+        case '\r': *q++ = 'r'; break;
+        default:
+            RAPIDJSON_ASSERT(static_cast<unsigned char>(c) < 0x20);
+            *q++ = 'u';
+            *q++ = '0';
+            *q++ = '0';
+            *q++ = hexDigits[static_cast<unsigned char>(c) >> 4];
+            *q++ = hexDigits[static_cast<unsigned char>(c) & 0xF];
+    }
+    return q;
 }
 
-template<>
-inline bool Writer<StringBuffer>::WriteUint(unsigned u) {
-    char *buffer = os_->Push(10);
-    const char* end = internal::u32toa(u, buffer);
-    os_->Pop(static_cast<size_t>(10 - (end - buffer)));
-    return true;
+inline bool NeedEscape(char c) {
+    return static_cast<unsigned char>(c) < 0x20 || c == '\"' || c == '\\';
 }
 
-template<>
-inline bool Writer<StringBuffer>::WriteInt64(int64_t i64) {
-    char *buffer = os_->Push(21);
-    const char* end = internal::i64toa(i64, buffer);
-    os_->Pop(static_cast<size_t>(21 - (end - buffer)));
-    return true;
+#if defined(RAPIDJSON_SIMD) || defined(RAPIDJSON_AVX2)
+inline unsigned CountTrailingZeros(uint32_t x) {
+    RAPIDJSON_ASSERT(x != 0);
+#ifdef _MSC_VER
+    unsigned long offset;
+    _BitScanForward(&offset, x);
+    return static_cast<unsigned>(offset);
+#else
+    return static_cast<unsigned>(__builtin_ctz(x));
+#endif
 }
 
-template<>
-inline bool Writer<StringBuffer>::WriteUint64(uint64_t u) {
-    char *buffer = os_->Push(20);
-    const char* end = internal::u64toa(u, buffer);
-    os_->Pop(static_cast<size_t>(20 - (end - buffer)));
-    return true;
+inline unsigned CountTrailingZeros(uint64_t x) {
+    RAPIDJSON_ASSERT(x != 0);
+#ifdef _MSC_VER
+    unsigned long offset;
+    if (_BitScanForward(&offset, static_cast<unsigned long>(x & 0xFFFFFFFFu)))
+        return static_cast<unsigned>(offset);
+    _BitScanForward(&offset, static_cast<unsigned long>(x >> 32));
+    return static_cast<unsigned>(offset) + 32;
+#else
+    return static_cast<unsigned>(__builtin_ctzll(x));
+#endif
 }
 
-template<>
-inline bool Writer<StringBuffer>::WriteDouble(double d) {
-    if (internal::Double(d).IsNanOrInf()) {
-        // Note: This code path can only be reached if (RAPIDJSON_WRITE_DEFAULT_FLAGS & kWriteNanAndInfFlag).
-        if (!(kWriteDefaultFlags & kWriteNanAndInfFlag))
-            return false;
-        if (internal::Double(d).IsNan()) {
-            PutReserve(*os_, 3);
-            PutUnsafe(*os_, 'N'); PutUnsafe(*os_, 'a'); PutUnsafe(*os_, 'N');
-            return true;
-        }
-        if (internal::Double(d).Sign()) {
-            PutReserve(*os_, 9);
-            PutUnsafe(*os_, '-');
-        }
-        else
-            PutReserve(*os_, 8);
-        PutUnsafe(*os_, 'I'); PutUnsafe(*os_, 'n'); PutUnsafe(*os_, 'f');
-        PutUnsafe(*os_, 'i'); PutUnsafe(*os_, 'n'); PutUnsafe(*os_, 'i'); PutUnsafe(*os_, 't'); PutUnsafe(*os_, 'y');
-        return true;
-    }
-    
-    char *buffer = os_->Push(25);
-    char* end = internal::dtoa(d, buffer, maxDecimalPlaces_);
-    os_->Pop(static_cast<size_t>(25 - (end - buffer)));
-    return true;
+//! Writes a block of \c n characters, escaping those flagged in \c mask.
+/*! Each character owns <tt>1 << Shift</tt> bits of \c mask, of which only the lowest may be set.
+    Runs between escaped characters are copied at once, so that a block with several
+    escapes is handled without falling back to a character-wise loop.
+    \return Pointer past the last written character.
+*/
+template <unsigned Shift, typename Mask>
+inline char* WriteEscapedBlock(char* q, const char* p, size_t n, Mask mask) {
+    size_t start = 0;
+    do {
+        const size_t i = CountTrailingZeros(mask) >> Shift;
+        std::memcpy(q, p + start, i - start);
+        q = WriteEscapedAscii(q + (i - start), p[i]);
+        start = i + 1;
+        mask &= mask - 1;
+    } while (mask != 0);
+    std::memcpy(q, p + start, n - start);
+    return q + (n - start);
 }
 
-#if defined(RAPIDJSON_SSE2) || defined(RAPIDJSON_SSE42)
-template<>
-inline bool Writer<StringBuffer>::ScanWriteUnescapedString(StringStream& is, size_t length) {
-    if (length < 16)
-        return RAPIDJSON_LIKELY(is.Tell() < length);
-
-    if (!RAPIDJSON_LIKELY(is.Tell() < length))
-        return false;
-
-    const char* p = is.src_;
-    const char* end = is.head_ + length;
-    const char* nextAligned = reinterpret_cast<const char*>((reinterpret_cast<size_t>(p) + 15) & static_cast<size_t>(~15));
-    const char* endAligned = reinterpret_cast<const char*>(reinterpret_cast<size_t>(end) & static_cast<size_t>(~15));
-    if (nextAligned > end)
-        return true;
+#if defined(RAPIDJSON_SSE2) || defined(RAPIDJSON_SSE42) || defined(RAPIDJSON_AVX2)
+typedef uint32_t EscapeMask;
+static const unsigned kEscapeMaskShift = 0;
 
-    while (p != nextAligned)
-        if (*p < 0x20 || *p == '\"' || *p == '\\') {
-            is.src_ = p;
-            return RAPIDJSON_LIKELY(is.Tell() < length);
-        }
-        else
-            os_->PutUnsafe(*p++);
-
-    // The rest of string using SIMD
+//! Flags the characters of a 16-byte block which must be escaped, one bit per character.
+inline uint32_t EscapeMask16(const char* p) {
     static const char dquote[16] = { '\"', '\"', '\"', '\"', '\"', '\"', '\"', '\"', '\"', '\"', '\"', '\"', '\"', '\"', '\"', '\"' };
     static const char bslash[16] = { '\\', '\\', '\\', '\\', '\\', '\\', '\\', '\\', '\\', '\\', '\\', '\\', '\\', '\\', '\\', '\\' };
     static const char space[16]  = { 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F };
@@ -599,104 +692,239 @@ inline bool Writer<StringBuffer>::ScanWriteUnescapedString(StringStream& is, siz
     const __m128i bs = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&bslash[0]));
     const __m128i sp = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&space[0]));
 
-    for (; p != endAligned; p += 16) {
-        const __m128i s = _mm_load_si128(reinterpret_cast<const __m128i *>(p));
-        const __m128i t1 = _mm_cmpeq_epi8(s, dq);
-        const __m128i t2 = _mm_cmpeq_epi8(s, bs);
-        const __m128i t3 = _mm_cmpeq_epi8(_mm_max_epu8(s, sp), sp); // s < 0x20 <=> max(s, 0x1F) == 0x1F
-        const __m128i x = _mm_or_si128(_mm_or_si128(t1, t2), t3);
-        unsigned short r = static_cast<unsigned short>(_mm_movemask_epi8(x));
-        if (RAPIDJSON_UNLIKELY(r != 0)) {   // some of characters is escaped
-            SizeType len;
-#ifdef _MSC_VER         // Find the index of first escaped
-            unsigned long offset;
-            _BitScanForward(&offset, r);
-            len = offset;
-#else
-            len = static_cast<SizeType>(__builtin_ffs(r) - 1);
+    const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    const __m128i t1 = _mm_cmpeq_epi8(s, dq);
+    const __m128i t2 = _mm_cmpeq_epi8(s, bs);
+    const __m128i t3 = _mm_cmpeq_epi8(_mm_max_epu8(s, sp), sp); // s < 0x20 <=> max(s, 0x1F) == 0x1F
+    const __m128i x = _mm_or_si128(_mm_or_si128(t1, t2), t3);
+    return static_cast<uint32_t>(_mm_movemask_epi8(x));
+}
 #endif
-            char* q = reinterpret_cast<char*>(os_->PushUnsafe(len));
-            for (size_t i = 0; i < len; i++)
-                q[i] = p[i];
-
-            p += len;
-            break;
-        }
-        _mm_storeu_si128(reinterpret_cast<__m128i *>(os_->PushUnsafe(16)), s);
-    }
 
-    is.src_ = p;
-    return RAPIDJSON_LIKELY(is.Tell() < length);
+#ifdef RAPIDJSON_AVX2
+//! Flags the characters of a 32-byte block which must be escaped, one bit per character.
+inline uint32_t EscapeMask32(const char* p) {
+    const __m256i dq = _mm256_set1_epi8('\"');
+    const __m256i bs = _mm256_set1_epi8('\\');
+    const __m256i sp = _mm256_set1_epi8(0x1F);
+
+    const __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+    const __m256i t1 = _mm256_cmpeq_epi8(s, dq);
+    const __m256i t2 = _mm256_cmpeq_epi8(s, bs);
+    const __m256i t3 = _mm256_cmpeq_epi8(_mm256_max_epu8(s, sp), sp);
+    const __m256i x = _mm256_or_si256(_mm256_or_si256(t1, t2), t3);
+    return static_cast<uint32_t>(_mm256_movemask_epi8(x));
 }
-#elif defined(RAPIDJSON_NEON)
-template<>
-inline bool Writer<StringBuffer>::ScanWriteUnescapedString(StringStream& is, size_t length) {
-    if (length < 16)
-        return RAPIDJSON_LIKELY(is.Tell() < length);
-
-    if (!RAPIDJSON_LIKELY(is.Tell() < length))
-        return false;
-
-    const char* p = is.src_;
-    const char* end = is.head_ + length;
-    const char* nextAligned = reinterpret_cast<const char*>((reinterpret_cast<size_t>(p) + 15) & static_cast<size_t>(~15));
-    const char* endAligned = reinterpret_cast<const char*>(reinterpret_cast<size_t>(end) & static_cast<size_t>(~15));
-    if (nextAligned > end)
-        return true;
+#endif
 
-    while (p != nextAligned)
-        if (*p < 0x20 || *p == '\"' || *p == '\\') {
-            is.src_ = p;
-            return RAPIDJSON_LIKELY(is.Tell() < length);
-        }
-        else
-            os_->PutUnsafe(*p++);
+#ifdef RAPIDJSON_NEON
+typedef uint64_t EscapeMask;
+static const unsigned kEscapeMaskShift = 2;
 
-    // The rest of string using SIMD
+//! Flags the characters of a 16-byte block which must be escaped, in the lowest of four bits per character.
+inline uint64_t EscapeMask16(const char* p) {
     const uint8x16_t s0 = vmovq_n_u8('"');
     const uint8x16_t s1 = vmovq_n_u8('\\');
-    const uint8x16_t s2 = vmovq_n_u8('\b');
     const uint8x16_t s3 = vmovq_n_u8(32);
 
-    for (; p != endAligned; p += 16) {
-        const uint8x16_t s = vld1q_u8(reinterpret_cast<const uint8_t *>(p));
-        uint8x16_t x = vceqq_u8(s, s0);
-        x = vorrq_u8(x, vceqq_u8(s, s1));
-        x = vorrq_u8(x, vceqq_u8(s, s2));
-        x = vorrq_u8(x, vcltq_u8(s, s3));
-
-        x = vrev64q_u8(x);                     // Rev in 64
-        uint64_t low = vgetq_lane_u64(reinterpret_cast<uint64x2_t>(x), 0);   // extract
-        uint64_t high = vgetq_lane_u64(reinterpret_cast<uint64x2_t>(x), 1);  // extract
-
-        SizeType len = 0;
-        bool escaped = false;
-        if (low == 0) {
-            if (high != 0) {
-                unsigned lz = (unsigned)__builtin_clzll(high);
-                len = 8 + (lz >> 3);
-                escaped = true;
+    const uint8x16_t s = vld1q_u8(reinterpret_cast<const uint8_t *>(p));
+    uint8x16_t x = vceqq_u8(s, s0);
+    x = vorrq_u8(x, vceqq_u8(s, s1));
+    x = vorrq_u8(x, vcltq_u8(s, s3));
+
+    // Narrow each byte to a nibble
+    const uint8x8_t n = vshrn_n_u16(vreinterpretq_u16_u8(x), 4);
+    return vget_lane_u64(vreinterpret_u64_u8(n), 0) & RAPIDJSON_UINT64_C2(0x11111111, 0x11111111);
+}
+#endif
+#endif // RAPIDJSON_SIMD || RAPIDJSON_AVX2
+
+//! Output stream writing through a raw pointer into space reserved beforehand.
+struct CursorStream {
+    typedef char Ch;
+    explicit CursorStream(char* q) : q_(q) {}
+    void Put(char c) { *q_++ = c; }
+    char* q_;
+};
+
+//! Writes values directly into the contiguous storage of GenericStringBuffer or GenericMemoryBuffer.
+/*! Each value reserves its worst-case length with one Push(), is formatted through a raw
+    pointer and gives the unused space back with one Pop(), instead of checking the capacity
+    and updating the stack top for every character.
+    \tparam OutputStream Stream providing \c Push(size_t) and \c Pop(size_t) for UTF-8 characters.
+    \tparam writeFlags Flags of the Writer.
+*/
+template <typename OutputStream, unsigned writeFlags>
+struct DirectOutput {
+    static void Int(OutputStream& os, int i) {
+        char* buffer = os.Push(11);
+        const char* end = i32toa(i, buffer);
+        os.Pop(static_cast<size_t>(11 - (end - buffer)));
+    }
+
+    static void Uint(OutputStream& os, unsigned u) {
+        char* buffer = os.Push(10);
+        const char* end = u32toa(u, buffer);
+        os.Pop(static_cast<size_t>(10 - (end - buffer)));
+    }
+
+    static void Int64(OutputStream& os, int64_t i64) {
+        char* buffer = os.Push(21);
+        const char* end = i64toa(i64, buffer);
+        os.Pop(static_cast<size_t>(21 - (end - buffer)));
+    }
+
+    static void Uint64(OutputStream& os, uint64_t u64) {
+        char* buffer = os.Push(20);
+        const char* end = u64toa(u64, buffer);
+        os.Pop(static_cast<size_t>(20 - (end - buffer)));
+    }
+
+    static bool Double(OutputStream& os, double d, int maxDecimalPlaces) {
+        if (internal::Double(d).IsNanOrInf()) {
+            // Note: This code path can only be reached if (writeFlags & kWriteNanAndInfFlag).
+            if (!(writeFlags & kWriteNanAndInfFlag))
+                return false;
+            if (internal::Double(d).IsNan()) {
+                std::memcpy(os.Push(3), "NaN", 3);
+                return true;
             }
-        } else {
-            unsigned lz = (unsigned)__builtin_clzll(low);
-            len = lz >> 3;
-            escaped = true;
+            if (internal::Double(d).Sign())
+                std::memcpy(os.Push(9), "-Infinity", 9);
+            else
+                std::memcpy(os.Push(8), "Infinity", 8);
+            return true;
         }
-        if (RAPIDJSON_UNLIKELY(escaped)) {   // some of characters is escaped
-            char* q = reinterpret_cast<char*>(os_->PushUnsafe(len));
-            for (size_t i = 0; i < len; i++)
-                q[i] = p[i];
 
-            p += len;
-            break;
+        char* buffer = os.Push(25);
+        const char* end = dtoa(d, buffer, maxDecimalPlaces);
+        os.Pop(static_cast<size_t>(25 - (end - buffer)));
+        return true;
+    }
+
+    static bool String(OutputStream& os, const char* str, SizeType length) {
+        const size_t capacity = 2 + static_cast<size_t>(length) * 6; // "\u00xx..."
+        char* const buffer = os.Push(capacity);
+        char* q = buffer;
+        const char* p = str;
+        const char* const end = str + length;
+        *q++ = '\"';
+
+        if (!(writeFlags & kWriteValidateEncodingFlag)) {
+#ifdef RAPIDJSON_AVX2
+            for (; end - p >= 32; p += 32) {
+                const uint32_t r = EscapeMask32(p);
+                if (RAPIDJSON_LIKELY(r == 0)) {
+                    std::memcpy(q, p, 32);
+                    q += 32;
+                }
+                else
+                    q = WriteEscapedBlock<0>(q, p, 32, r);
+            }
+#endif
+#if defined(RAPIDJSON_SSE2) || defined(RAPIDJSON_SSE42) || defined(RAPIDJSON_AVX2) || defined(RAPIDJSON_NEON)
+            if (length >= 16) {
+                for (; end - p >= 16; p += 16) {
+                    const EscapeMask r = EscapeMask16(p);
+                    if (RAPIDJSON_LIKELY(r == 0)) {
+                        std::memcpy(q, p, 16);
+                        q += 16;
+                    }
+                    else
+                        q = WriteEscapedBlock<kEscapeMaskShift>(q, p, 16, r);
+                }
+                // Reload the last full block and discard the characters already written
+                if (p != end) {
+                    const size_t n = static_cast<size_t>(end - p);
+                    const EscapeMask r = EscapeMask16(end - 16) >> ((16 - n) << kEscapeMaskShift);
+                    if (RAPIDJSON_LIKELY(r == 0)) {
+                        std::memcpy(q, p, n);
+                        q += n;
+                    }
+                    else
+                        q = WriteEscapedBlock<kEscapeMaskShift>(q, p, n, r);
+                    p = end;
+                }
+            }
+#endif
+            for (; p != end; ++p) {
+                if (RAPIDJSON_UNLIKELY(NeedEscape(*p)))
+                    q = WriteEscapedAscii(q, *p);
+                else
+                    *q++ = *p;
+            }
         }
-        vst1q_u8(reinterpret_cast<uint8_t *>(os_->PushUnsafe(16)), s);
+        else {
+            GenericStringStream<UTF8<> > is(str);
+            CursorStream cs(q);
+            while (is.Tell() < length) {
+                const char c = is.Peek();
+                if (RAPIDJSON_UNLIKELY(NeedEscape(c))) {
+                    is.Take();
+                    cs.q_ = WriteEscapedAscii(cs.q_, c);
+                }
+                else if (RAPIDJSON_UNLIKELY(!UTF8<>::Validate(is, cs))) {
+                    os.Pop(static_cast<size_t>(buffer + capacity - cs.q_));
+                    return false;
+                }
+            }
+            q = cs.q_;
+        }
+
+        *q++ = '\"';
+        os.Pop(static_cast<size_t>(buffer + capacity - q));
+        return true;
+    }
+
+    static void RawValue(OutputStream& os, const char* json, size_t length) {
+        RAPIDJSON_ASSERT(std::memchr(json, '\0', length) == 0);
+        std::memcpy(os.Push(length), json, length);
     }
+};
 
-    is.src_ = p;
-    return RAPIDJSON_LIKELY(is.Tell() < length);
+} // namespace internal
+
+// Full specializations for StringBuffer and MemoryBuffer writing straight into their storage
+
+#define RAPIDJSON_WRITER_DIRECT_OUTPUT(Buffer) \
+template<> \
+inline bool Writer<Buffer>::WriteInt(int i) { \
+    internal::DirectOutput<Buffer, kWriteDefaultFlags>::Int(*os_, i); \
+    return true; \
+} \
+template<> \
+inline bool Writer<Buffer>::WriteUint(unsigned u) { \
+    internal::DirectOutput<Buffer, kWriteDefaultFlags>::Uint(*os_, u); \
+    return true; \
+} \
+template<> \
+inline bool Writer<Buffer>::WriteInt64(int64_t i64) { \
+    internal::DirectOutput<Buffer, kWriteDefaultFlags>::Int64(*os_, i64); \
+    return true; \
+} \
+template<> \
+inline bool Writer<Buffer>::WriteUint64(uint64_t u64) { \
+    internal::DirectOutput<Buffer, kWriteDefaultFlags>::Uint64(*os_, u64); \
+    return true; \
+} \
+template<> \
+inline bool Writer<Buffer>::WriteDouble(double d) { \
+    return internal::DirectOutput<Buffer, kWriteDefaultFlags>::Double(*os_, d, maxDecimalPlaces_); \
+} \
+template<> \
+inline bool Writer<Buffer>::WriteString(const char* str, SizeType length, bool) { \
+    return internal::DirectOutput<Buffer, kWriteDefaultFlags>::String(*os_, str, length); \
+} \
+template<> \
+inline bool Writer<Buffer>::WriteRawValue(const char* json, size_t length) { \
+    internal::DirectOutput<Buffer, kWriteDefaultFlags>::RawValue(*os_, json, length); \
+    return true; \
 }
-#endif // RAPIDJSON_NEON
+
+RAPIDJSON_WRITER_DIRECT_OUTPUT(StringBuffer)
+RAPIDJSON_WRITER_DIRECT_OUTPUT(MemoryBuffer)
+
+#undef RAPIDJSON_WRITER_DIRECT_OUTPUT
 
 RAPIDJSON_NAMESPACE_END
 
@@ -0,0 +1,117 @@
+// Tencent is pleased to support the open source community by making RapidJSON available.
+// 
+// Copyright (C) 2015 THL A29 Limited, a Tencent company, and Milo Yip. All rights reserved.
+//
+// Licensed under the MIT License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// http://opensource.org/licenses/MIT
+//
+// Unless required by applicable law or agreed to in writing, software distributed 
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR 
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the 
+// specific language governing permissions and limitations under the License.
+
+#include "perftest.h"
+
+#if TEST_RAPIDJSON
+
+#include "rapidjson/patch.h"
+#include <ctime>
+
+using namespace rapidjson;
+
+// A batch of operations on the fields of many records, grouped by record as produced by a diff.
+class Patch : public PerfTest {
+public:
+    Patch() : source_(), patch_() {}
+
+    virtual void SetUp() {
+        PerfTest::SetUp();
+
+        Document::AllocatorType& a = source_.GetAllocator();
+        source_.SetObject();
+        Value records(kObjectType);
+        patch_.SetArray();
+        char buffer[64];
+        for (int i = 0; i < kRecordCount; i++) {
+            Value record(kObjectType);
+            for (int j = 0; j < kFieldCount; j++) {
+                sprintf(buffer, "field%d", j);
+                record.AddMember(Value(buffer, a).Move(), j, a);
+            }
+            Value tags(kArrayType);
+            tags.PushBack(i, a);
+            record.AddMember("tags", tags, a);
+            sprintf(buffer, "record%d", i);
+            records.AddMember(Value(buffer, a).Move(), record, a);
+
+            for (int j = 0; j < kFieldCount; j++) {
+                sprintf(buffer, "/data/records/record%d/field%d", i, j);
+                AddOperation(j % 2 ? "replace" : "test", buffer, j);
+            }
+            sprintf(buffer, "/data/records/record%d/tags/-", i);
+            AddOperation("add", buffer, i + 1);
+            sprintf(buffer, "/data/records/record%d/field0", i);
+            AddOperation("remove", buffer, 0);
+        }
+        Value data(kObjectType);
+        data.AddMember("records", records, a);
+        source_.AddMember("data", data, a);
+    }
+
+protected:
+    void AddOperation(const char* op, const char* path, int value) {
+        Document::AllocatorType& a = patch_.GetAllocator();
+        Value o(kObjectType);
+        o.AddMember("op", Value(op, a).Move(), a);
+        o.AddMember("path", Value(path, a).Move(), a);
+        o.AddMember("value", value, a);
+        patch_.PushBack(o, a);
+    }
+
+    static const int kRecordCount = 100;
+    static const int kFieldCount = 20;
+
+    Document source_;
+    Document patch_;
+};
+
+TEST_F(Patch, Apply) {
+    PatchApplier applier;
+    clock_t duration = 0;
+    for (size_t i = 0; i < kTrialCount; i++) {
+        Document d;
+        d.CopyFrom(source_, d.GetAllocator());
+        clock_t start = clock();
+        ASSERT_TRUE(applier.Apply(d, patch_));
+        duration += clock() - start;
+    }
+    double seconds = double(duration) / CLOCKS_PER_SEC;
+    printf("%u patches of %u operations in %f s -> %f operations per sec\n", static_cast<unsigned>(kTrialCount), patch_.Size(), seconds, kTrialCount * patch_.Size() / seconds);
+}
+
+// Baseline: one GenericPointer call per operation, each resolving from the root.
+TEST_F(Patch, PointerPerOperation) {
+    clock_t duration = 0;
+    for (size_t i = 0; i < kTrialCount; i++) {
+        Document d;
+        d.CopyFrom(source_, d.GetAllocator());
+        clock_t start = clock();
+        for (Value::ConstValueIterator o = patch_.Begin(); o != patch_.End(); ++o) {
+            const char* op = (*o)["op"].GetString();
+            Pointer p((*o)["path"].GetString(), (*o)["path"].GetStringLength());
+            if (op[0] == 't')
+                ASSERT_TRUE(*p.Get(d) == (*o)["value"]);
+            else if (op[0] == 'r' && op[2] == 'm')
+                ASSERT_TRUE(p.Erase(d));
+            else
+                p.Set(d, (*o)["value"]);
+        }
+        duration += clock() - start;
+    }
+    double seconds = double(duration) / CLOCKS_PER_SEC;
+    printf("%u patches of %u operations in %f s -> %f operations per sec\n", static_cast<unsigned>(kTrialCount), patch_.Size(), seconds, kTrialCount * patch_.Size() / seconds);
+}
+
+#endif // TEST_RAPIDJSON
@@ -32,6 +32,9 @@
 #elif defined(__ARM_NEON)
 #  define RAPIDJSON_NEON
 #endif
+#if defined(__AVX2__)
+#  define RAPIDJSON_AVX2
+#endif
 
 #define RAPIDJSON_HAS_STDSTRING 1
 
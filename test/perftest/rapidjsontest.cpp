@@ -23,6 +23,11 @@
 #include "rapidjson/filereadstream.h"
 #include "rapidjson/encodedstream.h"
 #include "rapidjson/memorystream.h"
+#include "rapidjson/serializedsize.h"
+#include "rapidjson/binaryimage.h"
+#include "rapidjson/memorybuffer.h"
+#include <algorithm>
+#include <vector>
 
 #ifdef RAPIDJSON_SSE2
 #define SIMD_SUFFIX(name) name##_SSE2
@@ -363,6 +368,28 @@ TEST_F(RapidJson, SIMD_SUFFIX(Writer_StringBuffer)) {
     }
 }
 
+TEST_F(RapidJson, SIMD_SUFFIX(SerializedSize)) {
+    for (size_t i = 0; i < kTrialCount; i++) {
+        SerializedSize size;
+        EXPECT_NE(0u, size.Get(doc_));
+    }
+}
+
+TEST_F(RapidJson, SIMD_SUFFIX(BinaryImageLoad)) {
+    MemoryBuffer mb;
+    BinaryImage::Write(mb, doc_);
+    ASSERT_NE(0u, mb.GetSize());
+    std::vector<uint64_t> aligned((mb.GetSize() + 7) / 8);
+    std::copy(mb.GetBuffer(), mb.GetBuffer() + mb.GetSize(), reinterpret_cast<char*>(aligned.data()));
+    BinaryImage image(aligned.data(), mb.GetSize());
+    ASSERT_TRUE(image.Validate());
+    for (size_t i = 0; i < kTrialCount; i++) {
+        Document doc;
+        image.Load(doc);
+        ASSERT_TRUE(doc.IsObject());
+    }
+}
+
 #define TEST_TYPED(index, Name)\
 TEST_F(RapidJson, SIMD_SUFFIX(Writer_StringBuffer_##Name)) {\
     for (size_t i = 0; i < kTrialCount * 10; i++) {\
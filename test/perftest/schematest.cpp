@@ -213,4 +213,73 @@ TEST_F(Schema, TestSuite) {
     printf("%d tests per trial\n", testCount / trialCount);
 }
 
+// Counts the allocations of validation states, to make sure the pools of the validator are reused.
+class CountingAllocator {
+public:
+    static const bool kNeedFree = true;
+    void* Malloc(size_t size) { mallocCount++; return CrtAllocator().Malloc(size); }
+    void* Realloc(void* originalPtr, size_t originalSize, size_t newSize) {
+        mallocCount++;
+        return CrtAllocator().Realloc(originalPtr, originalSize, newSize);
+    }
+    static void Free(void *ptr) { CrtAllocator::Free(ptr); }
+
+    static size_t mallocCount;
+};
+
+size_t CountingAllocator::mallocCount = 0;
+
+TEST_F(Schema, TestSuiteAllocation) {
+    typedef GenericSchemaValidator<SchemaDocument, BaseReaderHandler<UTF8<> >, CountingAllocator> ValidatorType;
+
+    const int trialCount = 1000;
+    size_t warmupMallocCount = 0;
+    size_t mallocCount = 0;
+    size_t documentCount = 0;
+    for (TestSuiteList::const_iterator itr = testSuites.begin(); itr != testSuites.end(); ++itr) {
+        const TestSuite& ts = **itr;
+        CountingAllocator allocator;
+        ValidatorType validator(*ts.schema, &allocator);
+        for (int i = 0; i < trialCount; i++) {
+            size_t start = CountingAllocator::mallocCount;
+            for (DocumentList::const_iterator testItr = ts.tests.begin(); testItr != ts.tests.end(); ++testItr) {
+                validator.Reset();
+                (*testItr)->Accept(validator);
+            }
+            if (i == 0)
+                warmupMallocCount += CountingAllocator::mallocCount - start;
+            else {
+                mallocCount += CountingAllocator::mallocCount - start;
+                documentCount += ts.tests.size();
+            }
+        }
+    }
+    printf("%u allocations in warm-up trial, %f allocations per document afterwards\n",
+        static_cast<unsigned>(warmupMallocCount),
+        documentCount ? double(mallocCount) / double(documentCount) : 0.0);
+}
+
+
+TEST_F(Schema, UniqueItemsLarge) {
+    Document sd;
+    sd.Parse("{\"type\":\"array\",\"uniqueItems\":true,\"items\":{\"type\":\"integer\"}}");
+    SchemaDocument schema(sd);
+
+    Document d;
+    d.SetArray();
+    for (int i = 0; i < 10000; i++)
+        d.PushBack(i * 7919, d.GetAllocator());
+
+    SchemaValidator validator(schema);
+    const int trialCount = 100;
+    clock_t start = clock();
+    for (int i = 0; i < trialCount; i++) {
+        validator.Reset();
+        EXPECT_TRUE(d.Accept(validator));
+    }
+    clock_t end = clock();
+    double duration = double(end - start) / CLOCKS_PER_SEC;
+    printf("%d arrays of %u items in %f s -> %f arrays per sec\n", trialCount, d.Size(), duration, trialCount / duration);
+}
+
 #endif
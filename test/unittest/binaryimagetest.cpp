@@ -0,0 +1,304 @@
+// Tencent is pleased to support the open source community by making RapidJSON available.
+//
+// Copyright (C) 2015 THL A29 Limited, a Tencent company, and Milo Yip. All rights reserved.
+//
+// Licensed under the MIT License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// http://opensource.org/licenses/MIT
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#define UNITTEST_HANDLERS
+#include "unittest.h"
+#include "rapidjson/binaryimage.h"
+#include "rapidjson/memorybuffer.h"
+#include "rapidjson/stringbuffer.h"
+#include "rapidjson/writer.h"
+#include <iterator>
+#include <vector>
+
+using namespace rapidjson;
+
+static const char kJson[] =
+    "{\"null\":null,\"t\":true,\"f\":false,\"int\":-123,\"uint\":4294967295,"
+    "\"i64\":-1234567890123,\"u64\":18446744073709551615,\"pi\":3.1416,\"s\":\"a\\u0000b\\n\","
+    "\"empty\":\"\",\"a\":[1,[],{},[[\"x\"]],{\"k\":[2,3]}],\"o\":{\"\":0,\"dup\":1,\"dup\":2}}";
+
+// Copies an image into 8-byte aligned memory
+static std::vector<uint64_t> Align(const MemoryBuffer& mb) {
+    std::vector<uint64_t> aligned((mb.GetSize() + 7) / 8);
+    std::memcpy(&aligned[0], mb.GetBuffer(), mb.GetSize());
+    return aligned;
+}
+
+TEST(BinaryImage, Roundtrip) {
+    Document d;
+    d.Parse(kJson);
+    ASSERT_FALSE(d.HasParseError());
+
+    MemoryBuffer mb;
+    size_t size = BinaryImage::Write(mb, d);
+    EXPECT_EQ(mb.GetSize(), size);
+    EXPECT_EQ(0u, size % 8);
+    std::vector<uint64_t> aligned = Align(mb);
+
+    BinaryImage image(&aligned[0], size);
+    ASSERT_TRUE(image.Validate());
+
+    // Copied strings
+    Document d2;
+    image.Load(d2);
+    EXPECT_EQ(Serialize(d), Serialize(d2));
+    EXPECT_TRUE(d2["uint"].IsUint());
+    EXPECT_FALSE(d2["uint"].IsInt());
+    EXPECT_TRUE(d2["u64"].IsUint64());
+    EXPECT_FALSE(d2["u64"].IsInt64());
+    EXPECT_TRUE(d2["pi"].IsDouble());
+    EXPECT_EQ(4u, d2["s"].GetStringLength());
+    EXPECT_TRUE(d2["s"].GetString() < reinterpret_cast<const char*>(&aligned[0]) ||
+                d2["s"].GetString() >= reinterpret_cast<const char*>(&aligned[0]) + size);
+
+    // Referenced strings
+    Document d3;
+    image.Load(d3, false);
+    EXPECT_EQ(Serialize(d), Serialize(d3));
+    EXPECT_TRUE(d3["s"].GetString() >= reinterpret_cast<const char*>(&aligned[0]) &&
+                d3["s"].GetString() < reinterpret_cast<const char*>(&aligned[0]) + size);
+
+    // In place
+    BinaryImage::ValueType root = image.GetRoot();
+    EXPECT_EQ(Serialize(d), Serialize(root));
+    EXPECT_TRUE(root.IsObject());
+    EXPECT_EQ(12u, root.MemberCount());
+    EXPECT_TRUE(root["null"].IsNull());
+    EXPECT_TRUE(root["t"].GetBool());
+    EXPECT_FALSE(root["f"].GetBool());
+    EXPECT_EQ(-123, root["int"].GetInt());
+    EXPECT_EQ(4294967295u, root["uint"].GetUint());
+    EXPECT_FALSE(root["uint"].IsInt());
+    EXPECT_EQ(-1234567890123, root["i64"].GetInt64());
+    EXPECT_FALSE(root["i64"].IsUint64());
+    EXPECT_EQ(RAPIDJSON_UINT64_C2(0xFFFFFFFF, 0xFFFFFFFF), root["u64"].GetUint64());
+    EXPECT_FALSE(root["u64"].IsInt64());
+    EXPECT_DOUBLE_EQ(3.1416, root["pi"].GetDouble());
+    EXPECT_DOUBLE_EQ(-123.0, root["int"].GetDouble());
+    EXPECT_EQ(0, std::memcmp("a\0b\n", root["s"].GetString(), 5));
+    EXPECT_STREQ("", root["empty"].GetString());
+    EXPECT_EQ(5u, root["a"].Size());
+    EXPECT_TRUE(root["a"][1].Empty());
+    EXPECT_TRUE(root["a"][2].ObjectEmpty());
+    EXPECT_STREQ("x", root["a"][3][0][0].GetString());
+    EXPECT_EQ(3, root["a"][4]["k"][1].GetInt());
+    EXPECT_EQ(1, root["o"]["dup"].GetInt());
+    EXPECT_EQ(1, root["o"].FindMember("dup") - root["o"].MemberBegin());
+    EXPECT_EQ(1, root["o"].FindMember("dup")->value.GetInt());
+    EXPECT_TRUE(root["o"].FindMember("missing") == root["o"].MemberEnd());
+    EXPECT_STREQ("dup", root["o"].GetMemberName(2).GetString());
+    EXPECT_EQ(2, root["o"].GetMemberValue(2).GetInt());
+    EXPECT_FALSE(root["o"].HasMember("missing"));
+
+    // Scalar root and empty containers
+    const char* scalars[] = { "null", "\"\"", "[]", "{}", "-0.0", "[[],[[]]]" };
+    for (size_t i = 0; i < sizeof(scalars) / sizeof(scalars[0]); i++) {
+        Document s;
+        s.Parse(scalars[i]);
+        MemoryBuffer smb;
+        BinaryImage::Write(smb, s);
+        std::vector<uint64_t> sa = Align(smb);
+        BinaryImage si(&sa[0], smb.GetSize());
+        EXPECT_TRUE(si.Validate()) << scalars[i];
+        Document sd;
+        si.Load(sd);
+        EXPECT_EQ(Serialize(s), Serialize(sd));
+    }
+}
+
+TEST(BinaryImage, Writer) {
+    const char* jsons[] = { kJson, "null", "\"\"", "[]", "{}", "-0.0", "[[],[[]]]", "[{\"a\":[{}]},[1,[2]],{\"b\":{\"c\":[3]}}]" };
+    for (size_t i = 0; i < sizeof(jsons) / sizeof(jsons[0]); i++) {
+        Document d;
+        d.Parse(jsons[i]);
+        MemoryBuffer expected;
+        BinaryImage::Write(expected, d);
+
+        // Straight from the JSON text, without a DOM
+        MemoryBuffer mb;
+        BinaryImageWriter<MemoryBuffer> writer(mb);
+        StringStream ss(jsons[i]);
+        Reader reader;
+        EXPECT_FALSE(reader.Parse(ss, writer).IsError());
+        EXPECT_TRUE(writer.IsComplete());
+        ASSERT_EQ(expected.GetSize(), mb.GetSize()) << jsons[i];
+        EXPECT_EQ(0, std::memcmp(expected.GetBuffer(), mb.GetBuffer(), mb.GetSize())) << jsons[i];
+
+        // Reused for another image
+        MemoryBuffer mb2;
+        writer.Reset(mb2);
+        EXPECT_TRUE(d.Accept(writer));
+        ASSERT_EQ(expected.GetSize(), mb2.GetSize());
+        EXPECT_EQ(0, std::memcmp(expected.GetBuffer(), mb2.GetBuffer(), mb2.GetSize()));
+    }
+}
+
+TEST(BinaryImage, Iterators) {
+    Document d;
+    d.Parse(kJson);
+    MemoryBuffer mb;
+    BinaryImage::Write(mb, d);
+    std::vector<uint64_t> aligned = Align(mb);
+    BinaryImage::ValueType root = BinaryImage(&aligned[0], mb.GetSize()).GetRoot();
+
+    Value::ConstMemberIterator dm = d.MemberBegin();
+    for (BinaryImage::ValueType::ConstMemberIterator m = root.MemberBegin(); m != root.MemberEnd(); ++m, ++dm) {
+        EXPECT_STREQ(dm->name.GetString(), m->name.GetString());
+        EXPECT_EQ(dm->value.GetType(), m->value.GetType());
+    }
+    EXPECT_TRUE(dm == d.MemberEnd());
+    EXPECT_EQ(12, root.MemberEnd() - root.MemberBegin());
+    EXPECT_STREQ("int", root.MemberBegin()[3].name.GetString());
+    EXPECT_EQ(3u, (root.MemberEnd() - 1)->value.MemberCount());
+
+    const BinaryImage::ValueType a = root["a"];
+    EXPECT_EQ(5, std::distance(a.Begin(), a.End()));
+    BinaryImage::ValueType::ConstValueIterator e = a.Begin();
+    EXPECT_EQ(1, e->GetInt());
+    EXPECT_TRUE((*++e).Empty());
+    e += 2;
+    EXPECT_STREQ("x", (*e)[0][0].GetString());
+    EXPECT_TRUE(e + 2 == a.End());
+    EXPECT_TRUE(a.Begin() < e);
+    EXPECT_TRUE(root["a"][1].Begin() == root["a"][1].End());
+    EXPECT_TRUE(root["a"][2].MemberBegin() == root["a"][2].MemberEnd());
+}
+
+TEST(BinaryImage, Pointer) {
+    Document d;
+    d.Parse(kJson);
+    MemoryBuffer mb;
+    BinaryImage::Write(mb, d);
+    std::vector<uint64_t> aligned = Align(mb);
+    const BinaryImage::ValueType root = BinaryImage(&aligned[0], mb.GetSize()).GetRoot();
+
+    BinaryImage::ValueType v = root;
+    EXPECT_TRUE(GetValueByPointer(root, "/a/4/k/1", v));
+    EXPECT_EQ(3, v.GetInt());
+    EXPECT_TRUE(GetValueByPointer(root, "/a/3/0/0", v));
+    EXPECT_STREQ("x", v.GetString());
+    EXPECT_TRUE(GetValueByPointer(root, Pointer("/o/dup"), v));
+    EXPECT_EQ(1, v.GetInt());
+    EXPECT_TRUE(GetValueByPointer(root, Pointer("/o/"), v));
+    EXPECT_EQ(0, v.GetInt());
+    EXPECT_TRUE(GetValueByPointer(root, PointerView("/a/4/k/1"), v));
+    EXPECT_EQ(3, v.GetInt());
+    EXPECT_TRUE(GetValueByPointer(root, "#/o/d%75p", v));
+    EXPECT_EQ(1, v.GetInt());
+    EXPECT_TRUE(GetValueByPointer(root, "", v));
+    EXPECT_TRUE(v.IsObject());
+
+    size_t unresolvedTokenIndex;
+    EXPECT_FALSE(GetValueByPointer(root, "/a/5", v, &unresolvedTokenIndex));
+    EXPECT_EQ(1u, unresolvedTokenIndex);
+    EXPECT_FALSE(GetValueByPointer(root, "/a/x", v, &unresolvedTokenIndex));
+    EXPECT_EQ(1u, unresolvedTokenIndex);
+    EXPECT_FALSE(GetValueByPointer(root, "/s/0", v, &unresolvedTokenIndex));
+    EXPECT_EQ(1u, unresolvedTokenIndex);
+    EXPECT_FALSE(GetValueByPointer(root, "/missing", v, &unresolvedTokenIndex));
+    EXPECT_EQ(0u, unresolvedTokenIndex);
+    EXPECT_TRUE(v.IsObject());
+}
+
+TEST(BinaryImage, Utf16) {
+    typedef GenericDocument<UTF16<> > Document16;
+    Document16 d;
+    d.Parse(L"{\"\\u20AC\":[\"\\uD834\\uDD1E\",1]}");
+    ASSERT_FALSE(d.HasParseError());
+
+    MemoryBuffer mb;
+    GenericBinaryImage<UTF16<> >::Write(mb, d);
+    std::vector<uint64_t> aligned = Align(mb);
+    GenericBinaryImage<UTF16<> > image(&aligned[0], mb.GetSize());
+    ASSERT_TRUE(image.Validate());
+    EXPECT_FALSE(BinaryImage(&aligned[0], mb.GetSize()).Validate());
+
+    Document16 d2;
+    image.Load(d2);
+    EXPECT_TRUE(d == d2);
+    EXPECT_EQ(0x20ACu, static_cast<unsigned>(image.GetRoot().GetMemberName(0).GetString()[0]));
+}
+
+TEST(BinaryImage, Invalid) {
+    Document d;
+    d.Parse(kJson);
+    MemoryBuffer mb;
+    size_t size = BinaryImage::Write(mb, d);
+    std::vector<uint64_t> aligned = Align(mb);
+    char* p = reinterpret_cast<char*>(&aligned[0]);
+
+    EXPECT_FALSE(BinaryImage(p, size - 8).Validate());
+    EXPECT_FALSE(BinaryImage(p, 16).Validate());
+
+    // Changes in the header and in the structure of the tree are detected
+    const size_t nodes = 40;
+    const size_t offsets[] = {
+        0, 4, 8, 12, 16, 24, 32,
+        nodes + 12,                 // type of the root
+        nodes + 8,                  // member count of the root
+        nodes,                      // offset of the members
+        nodes + 16 + 12,            // type of the first name
+        nodes + 16 * 8 + 12,        // type of "int"
+        nodes + 16 * 22,            // offset of the elements of "a"
+    };
+    for (size_t i = 0; i < sizeof(offsets) / sizeof(offsets[0]); i++) {
+        for (int delta = 1; delta < 256; delta <<= 1) {
+            p[offsets[i]] = static_cast<char>(p[offsets[i]] + delta);
+            EXPECT_FALSE(BinaryImage(p, size).Validate()) << offsets[i] << " " << delta;
+            p[offsets[i]] = static_cast<char>(p[offsets[i]] - delta);
+        }
+    }
+    EXPECT_TRUE(BinaryImage(p, size).Validate());
+
+    // Missing terminator
+    const size_t stringOffset = static_cast<size_t>(reinterpret_cast<const internal::BinaryImageHeader*>(p)->stringOffset);
+    p[stringOffset + 4] = 'x';
+    EXPECT_FALSE(BinaryImage(p, size).Validate());
+}
+
+// Writes n nested arrays around a null
+static std::vector<uint64_t> NestedArrays(uint32_t n) {
+    const size_t headerSize = sizeof(internal::BinaryImageHeader);
+    const size_t size = headerSize + (n + 1) * sizeof(internal::BinaryImageNode);
+    std::vector<uint64_t> aligned(size / 8);
+    internal::BinaryImageHeader* h = reinterpret_cast<internal::BinaryImageHeader*>(&aligned[0]);
+    std::memcpy(h->magic, "RJBI", 4);
+    h->byteOrder = 0x01020304u;
+    h->version = BinaryImage::kVersion;
+    h->charSize = 1;
+    h->nodeCount = n + 1;
+    h->stringOffset = h->size = size;
+    internal::BinaryImageNode* nodes = reinterpret_cast<internal::BinaryImageNode*>(h + 1);
+    for (uint32_t i = 0; i < n; i++) {
+        nodes[i].payload = headerSize + (i + 1) * sizeof(internal::BinaryImageNode);
+        nodes[i].count = 1;
+        nodes[i].type = kArrayType;
+    }
+    return aligned;
+}
+
+TEST(BinaryImage, Depth) {
+    std::vector<uint64_t> image = NestedArrays(BinaryImage::kDefaultMaxDepth);
+    BinaryImage view(&image[0], image.size() * 8);
+    EXPECT_TRUE(view.Validate());
+    EXPECT_FALSE(view.Validate(BinaryImage::kDefaultMaxDepth - 1));
+    Document d;
+    view.Load(d);
+    EXPECT_TRUE(d.IsArray());
+
+    // Rejected without exhausting the stack
+    image = NestedArrays(10000000);
+    EXPECT_FALSE(BinaryImage(&image[0], image.size() * 8).Validate());
+    EXPECT_FALSE(BinaryImage(&image[0], image.size() * 8).Validate(0));
+}
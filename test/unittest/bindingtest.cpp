@@ -0,0 +1,192 @@
+// Tencent is pleased to support the open source community by making RapidJSON available.
+//
+// Copyright (C) 2015 THL A29 Limited, a Tencent company, and Milo Yip. All rights reserved.
+//
+// Licensed under the MIT License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// http://opensource.org/licenses/MIT
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "unittest.h"
+#include "rapidjson/binding.h"
+#include "rapidjson/document.h"
+#include "rapidjson/reader.h"
+#include "rapidjson/stringbuffer.h"
+#include "rapidjson/writer.h"
+
+using namespace rapidjson;
+
+struct BindingPoint {
+    BindingPoint() : x(), y(), label() {}
+    int x;
+    int y;
+    std::string label;
+};
+
+struct BindingShape {
+    BindingShape() : points(), width(1.5), count(), id(), big(), visible(true), scale(), matrix(), children() {}
+    std::vector<BindingPoint> points;
+    double width;
+    unsigned count;
+    int64_t id;
+    uint64_t big;
+    bool visible;
+    float scale;
+    std::vector<std::vector<int> > matrix;
+    std::vector<BindingShape> children;
+};
+
+RAPIDJSON_BINDING_BEGIN(BindingPoint)
+    RAPIDJSON_BINDING_FIELD(x)
+    RAPIDJSON_BINDING_FIELD(y)
+    RAPIDJSON_BINDING_FIELD_NAMED(label, "name")
+RAPIDJSON_BINDING_END()
+
+RAPIDJSON_BINDING_BEGIN(BindingShape)
+    RAPIDJSON_BINDING_FIELD(points)
+    RAPIDJSON_BINDING_FIELD(width)
+    RAPIDJSON_BINDING_FIELD(count)
+    RAPIDJSON_BINDING_FIELD(id)
+    RAPIDJSON_BINDING_FIELD(big)
+    RAPIDJSON_BINDING_FIELD(visible)
+    RAPIDJSON_BINDING_FIELD(scale)
+    RAPIDJSON_BINDING_FIELD(matrix)
+    RAPIDJSON_BINDING_FIELD(children)
+RAPIDJSON_BINDING_END()
+
+template <typename T>
+struct BindingGenerator {
+    explicit BindingGenerator(const T& v) : value(v) {}
+    template <typename Handler>
+    bool operator()(Handler& handler) { return BindingAccept(value, handler); }
+    const T& value;
+};
+
+template <typename T>
+static bool ParseBound(const char* json, T& value) {
+    BindingHandler<T> handler(value);
+    Reader reader;
+    StringStream ss(json);
+    return !reader.Parse(ss, handler).IsError();
+}
+
+template <typename T>
+static std::string WriteBound(const T& value) {
+    StringBuffer sb;
+    Writer<StringBuffer> writer(sb);
+    EXPECT_TRUE(BindingAccept(value, writer));
+    return sb.GetString();
+}
+
+TEST(Binding, Parse) {
+    BindingShape shape;
+    ASSERT_TRUE(ParseBound(
+        "{\"points\":[{\"x\":1,\"y\":-2,\"name\":\"a\"},{\"name\":\"b\",\"y\":3,\"unknown\":{\"x\":[1,{}]}}],"
+        " \"count\":4000000000,\"id\":-5000000000,\"big\":18446744073709551615,\"scale\":0.5,"
+        " \"extra\":[[1]],\"matrix\":[[1,2],[],[3]],\"visible\":false,"
+        " \"children\":[{\"width\":2,\"children\":[{}]}]}", shape));
+
+    ASSERT_EQ(2u, shape.points.size());
+    EXPECT_EQ(1, shape.points[0].x);
+    EXPECT_EQ(-2, shape.points[0].y);
+    EXPECT_EQ("a", shape.points[0].label);
+    EXPECT_EQ(0, shape.points[1].x);    // Absent members keep their value
+    EXPECT_EQ(3, shape.points[1].y);
+    EXPECT_EQ("b", shape.points[1].label);
+    EXPECT_DOUBLE_EQ(1.5, shape.width);
+    EXPECT_EQ(4000000000u, shape.count);
+    EXPECT_EQ(-static_cast<int64_t>(5000000000.0), shape.id);
+    EXPECT_EQ(RAPIDJSON_UINT64_C2(0xFFFFFFFF, 0xFFFFFFFF), shape.big);
+    EXPECT_FALSE(shape.visible);
+    EXPECT_FLOAT_EQ(0.5f, shape.scale);
+    ASSERT_EQ(3u, shape.matrix.size());
+    EXPECT_EQ(2, shape.matrix[0][1]);
+    EXPECT_TRUE(shape.matrix[1].empty());
+    EXPECT_EQ(3, shape.matrix[2][0]);
+    ASSERT_EQ(1u, shape.children.size());
+    EXPECT_DOUBLE_EQ(2.0, shape.children[0].width);
+    EXPECT_EQ(1u, shape.children[0].children.size());
+
+    // Arrays replace the elements
+    ASSERT_TRUE(ParseBound("{\"points\":[{\"x\":7}],\"width\":3}", shape));
+    ASSERT_EQ(1u, shape.points.size());
+    EXPECT_EQ(7, shape.points[0].x);
+    EXPECT_DOUBLE_EQ(3.0, shape.width);
+
+    std::vector<int> ints;
+    ASSERT_TRUE(ParseBound("[1,2,3]", ints));
+    EXPECT_EQ(3u, ints.size());
+    std::string s;
+    ASSERT_TRUE(ParseBound("\"str\"", s));
+    EXPECT_EQ("str", s);
+}
+
+TEST(Binding, Initialize) {
+    // Recursive structs are initialized once
+    BindingHandler<BindingShape>::Initialize();
+    BindingHandler<std::vector<BindingPoint> >::Initialize();
+    BindingHandler<int>::Initialize();
+
+    std::vector<BindingPoint> points;
+    ASSERT_TRUE(ParseBound("[{\"x\":1,\"name\":\"p\"}]", points));
+    ASSERT_EQ(1u, points.size());
+    EXPECT_EQ(1, points[0].x);
+    EXPECT_EQ("p", points[0].label);
+}
+
+TEST(Binding, Mismatch) {
+    const char* jsons[] = {
+        "[]", "1", "null", "{\"x\":\"1\"}", "{\"x\":1.5}", "{\"x\":2147483648}", "{\"x\":null}",
+        "{\"name\":1}", "{\"x\":[]}", "{\"name\":{}}"
+    };
+    for (size_t i = 0; i < sizeof(jsons) / sizeof(jsons[0]); i++) {
+        BindingPoint p;
+        BindingHandler<BindingPoint> handler(p);
+        Reader reader;
+        StringStream ss(jsons[i]);
+        EXPECT_EQ(kParseErrorTermination, reader.Parse(ss, handler).Code()) << jsons[i];
+    }
+
+    const char* shapes[] = {
+        "{\"count\":-1}", "{\"count\":4294967296}", "{\"big\":-1}", "{\"id\":9223372036854775808}",
+        "{\"visible\":1}", "{\"points\":{}}", "{\"matrix\":[1]}", "{\"width\":true}"
+    };
+    for (size_t i = 0; i < sizeof(shapes) / sizeof(shapes[0]); i++) {
+        BindingShape shape;
+        EXPECT_FALSE(ParseBound(shapes[i], shape)) << shapes[i];
+    }
+}
+
+TEST(Binding, Write) {
+    BindingShape shape;
+    shape.points.resize(1);
+    shape.points[0].x = 1;
+    shape.points[0].label = "p\"";
+    shape.count = 4000000000u;
+    shape.id = -1;
+    shape.scale = 0.25f;
+    shape.matrix.resize(2);
+    shape.matrix[0].push_back(1);
+    std::string json = WriteBound(shape);
+    EXPECT_EQ(
+        "{\"points\":[{\"x\":1,\"y\":0,\"name\":\"p\\\"\"}],\"width\":1.5,\"count\":4000000000,\"id\":-1,"
+        "\"big\":0,\"visible\":true,\"scale\":0.25,\"matrix\":[[1],[]],\"children\":[]}", json);
+
+    // Round trip
+    BindingShape copy;
+    ASSERT_TRUE(ParseBound(json.c_str(), copy));
+    EXPECT_EQ(json, WriteBound(copy));
+
+    // Into a DOM
+    Document d;
+    BindingGenerator<BindingShape> g(shape);
+    d.Populate(g);
+    ASSERT_FALSE(d.HasParseError());
+    EXPECT_STREQ("p\"", d["points"][0]["name"].GetString());
+    EXPECT_EQ(4000000000u, d["count"].GetUint());
+}
@@ -0,0 +1,301 @@
+// Tencent is pleased to support the open source community by making RapidJSON available.
+//
+// Copyright (C) 2015 THL A29 Limited, a Tencent company, and Milo Yip. All rights reserved.
+//
+// Licensed under the MIT License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// http://opensource.org/licenses/MIT
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#define UNITTEST_HANDLERS
+#include "unittest.h"
+#include "rapidjson/cbor.h"
+#include "rapidjson/document.h"
+#include "rapidjson/memorybuffer.h"
+#include "rapidjson/stringbuffer.h"
+#include "rapidjson/writer.h"
+#include <string>
+
+using namespace rapidjson;
+
+static std::string Hex(const std::string& bytes) {
+    static const char kHex[] = "0123456789abcdef";
+    std::string hex;
+    for (size_t i = 0; i < bytes.size(); i++) {
+        hex += kHex[static_cast<unsigned char>(bytes[i]) >> 4];
+        hex += kHex[static_cast<unsigned char>(bytes[i]) & 15];
+    }
+    return hex;
+}
+
+static std::string Bytes(const char* hex) {
+    std::string bytes;
+    for (; hex[0] && hex[1]; hex += 2) {
+        unsigned b;
+        sscanf(hex, "%2x", &b);
+        bytes += static_cast<char>(b);
+    }
+    return bytes;
+}
+
+// Encodes the JSON text as CBOR, in hexadecimal
+static std::string Encode(const char* json) {
+    Document d;
+    d.Parse<kParseFullPrecisionFlag | kParseNanAndInfFlag>(json);
+    EXPECT_FALSE(d.HasParseError()) << json;
+    MemoryBuffer mb;
+    CborWriter<MemoryBuffer> writer(mb);
+    EXPECT_TRUE(d.Accept(writer));
+    EXPECT_TRUE(writer.IsComplete());
+    return Hex(std::string(mb.GetBuffer(), mb.GetSize()));
+}
+
+// Decodes the CBOR data item, in hexadecimal, as JSON text
+static std::string Decode(const char* hex) {
+    const std::string bytes = Bytes(hex);
+    MemoryStream ms(bytes.data(), bytes.size());
+    CborReader reader;
+    Document d;
+    EXPECT_TRUE(reader.Populate(ms, d)) << hex << ": " << reader.GetParseErrorCode() << " at " << reader.GetErrorOffset();
+    EXPECT_EQ(bytes.size(), ms.Tell()) << hex;
+    return Serialize(d);
+}
+
+TEST(Cbor, Writer) {
+    // Examples of RFC 8949, appendix A
+    EXPECT_EQ("00", Encode("0"));
+    EXPECT_EQ("17", Encode("23"));
+    EXPECT_EQ("1818", Encode("24"));
+    EXPECT_EQ("1864", Encode("100"));
+    EXPECT_EQ("1903e8", Encode("1000"));
+    EXPECT_EQ("1a000f4240", Encode("1000000"));
+    EXPECT_EQ("1b000000e8d4a51000", Encode("1000000000000"));
+    EXPECT_EQ("1bffffffffffffffff", Encode("18446744073709551615"));
+    EXPECT_EQ("3b7fffffffffffffff", Encode("-9223372036854775808"));
+    EXPECT_EQ("20", Encode("-1"));
+    EXPECT_EQ("29", Encode("-10"));
+    EXPECT_EQ("3863", Encode("-100"));
+    EXPECT_EQ("3903e7", Encode("-1000"));
+    EXPECT_EQ("f90000", Encode("0.0"));
+    EXPECT_EQ("f98000", Encode("-0.0"));
+    EXPECT_EQ("f93c00", Encode("1.0"));
+    EXPECT_EQ("fb3ff199999999999a", Encode("1.1"));
+    EXPECT_EQ("f93e00", Encode("1.5"));
+    EXPECT_EQ("f97bff", Encode("65504.0"));
+    EXPECT_EQ("fa47c35000", Encode("100000.0"));
+    EXPECT_EQ("fa7f7fffff", Encode("3.4028234663852886e+38"));
+    EXPECT_EQ("fb7e37e43c8800759c", Encode("1.0e+300"));
+    EXPECT_EQ("f90001", Encode("5.960464477539063e-8"));
+    EXPECT_EQ("f90400", Encode("0.00006103515625"));
+    EXPECT_EQ("f9c400", Encode("-4.0"));
+    EXPECT_EQ("fbc010666666666666", Encode("-4.1"));
+    EXPECT_EQ("f97c00", Encode("Infinity"));
+    EXPECT_EQ("f97e00", Encode("NaN"));
+    EXPECT_EQ("f9fc00", Encode("-Infinity"));
+    EXPECT_EQ("f4", Encode("false"));
+    EXPECT_EQ("f5", Encode("true"));
+    EXPECT_EQ("f6", Encode("null"));
+    EXPECT_EQ("60", Encode("\"\""));
+    EXPECT_EQ("6161", Encode("\"a\""));
+    EXPECT_EQ("6449455446", Encode("\"IETF\""));
+    EXPECT_EQ("62225c", Encode("\"\\\"\\\\\""));
+    EXPECT_EQ("62c3bc", Encode("\"\\u00fc\""));
+    EXPECT_EQ("64f0908591", Encode("\"\\ud800\\udd51\""));
+    EXPECT_EQ("9fff", Encode("[]"));
+    EXPECT_EQ("9f01029f0304ffff", Encode("[1,2,[3,4]]"));
+    EXPECT_EQ("bf61610161629f0203ffff", Encode("{\"a\":1,\"b\":[2,3]}"));
+
+    // Lengths of long strings
+    const std::string s = "\"" + std::string(300, 'x') + "\"";
+    EXPECT_EQ("79012c" + Hex(std::string(300, 'x')), Encode(s.c_str()));
+
+    // Writing from UTF-16
+    GenericDocument<UTF16<> > d16;
+    d16.Parse(L"{\"\\u20AC\":1}");
+    MemoryBuffer mb;
+    CborWriter<MemoryBuffer, UTF16<> > writer16(mb);
+    EXPECT_TRUE(d16.Accept(writer16));
+    EXPECT_EQ("bf63e282ac01ff", Hex(std::string(mb.GetBuffer(), mb.GetSize())));
+
+    // Directly from the JSON reader
+    StringStream ss("[\"a\",{\"b\":-2}]");
+    MemoryBuffer mb2;
+    CborWriter<MemoryBuffer> writer(mb2);
+    Reader reader;
+    EXPECT_FALSE(reader.Parse(ss, writer).IsError());
+    EXPECT_EQ("9f6161bf616221ffff", Hex(std::string(mb2.GetBuffer(), mb2.GetSize())));
+}
+
+TEST(Cbor, Reader) {
+    // Examples of RFC 8949, appendix A
+    EXPECT_EQ("0", Decode("00"));
+    EXPECT_EQ("1000000", Decode("1a000f4240"));
+    EXPECT_EQ("18446744073709551615", Decode("1bffffffffffffffff"));
+    EXPECT_EQ("-9223372036854775808", Decode("3b7fffffffffffffff"));
+    EXPECT_EQ("-1000", Decode("3903e7"));
+    EXPECT_EQ("-0.0", Decode("f98000"));
+    EXPECT_EQ("65504.0", Decode("f97bff"));
+    EXPECT_EQ("5.960464477539063e-8", Decode("f90001"));
+    EXPECT_EQ("-4.0", Decode("f9c400"));
+    EXPECT_EQ("100000.0", Decode("fa47c35000"));
+    EXPECT_EQ("1e300", Decode("fb7e37e43c8800759c"));
+    EXPECT_EQ("Infinity", Decode("f97c00"));
+    EXPECT_EQ("NaN", Decode("f97e00"));
+    EXPECT_EQ("-Infinity", Decode("faff800000"));
+    EXPECT_EQ("NaN", Decode("fb7ff8000000000000"));
+    EXPECT_EQ("null", Decode("f7"));
+    EXPECT_EQ("1363896240", Decode("c11a514b67b0"));
+    EXPECT_EQ("\"2013-03-21T20:04:00Z\"", Decode("c074323031332d30332d32315432303a30343a30305a"));
+    EXPECT_EQ("\"\\u0001\\u0002\\u0003\\u0004\"", Decode("4401020304"));
+    EXPECT_EQ("\"\xC3\xBC\"", Decode("62c3bc"));
+    EXPECT_EQ("[1,[2,3],[4,5]]", Decode("8301820203820405"));
+    EXPECT_EQ("{\"a\":1,\"b\":[2,3]}", Decode("a26161016162820203"));
+    EXPECT_EQ("[\"a\",{\"b\":\"c\"}]", Decode("826161a161626163"));
+    EXPECT_EQ("\"streaming\"", Decode("7f657374726561646d696e67ff"));
+    EXPECT_EQ("\"\\u0001\\u0002\\u0003\\u0004\\u0005\"", Decode("5f42010243030405ff"));
+    EXPECT_EQ("[]", Decode("9fff"));
+    EXPECT_EQ("[1,[2,3],[4,5]]", Decode("9f018202039f0405ffff"));
+    EXPECT_EQ("[1,[2,3],[4,5]]", Decode("83019f0203ff820405"));
+    EXPECT_EQ("{\"a\":1,\"b\":[2,3]}", Decode("bf61610161629f0203ffff"));
+    EXPECT_EQ("{\"Fun\":true,\"Amt\":-2}", Decode("bf6346756ef563416d7421ff"));
+
+    // Negative integer below -2^63
+    const std::string big = Bytes("3bffffffffffffffff");
+    MemoryStream bms(big.data(), big.size());
+    CborReader reader;
+    Document d;
+    EXPECT_TRUE(reader.Populate(bms, d));
+    EXPECT_TRUE(d.IsDouble());
+    EXPECT_DOUBLE_EQ(-18446744073709551616.0, d.GetDouble());
+
+    // Several data items in one stream
+    const std::string bytes = Bytes("8101f5");
+    MemoryStream ms(bytes.data(), bytes.size());
+    EXPECT_TRUE(reader.Populate(ms, d));
+    EXPECT_EQ("[1]", Serialize(d));
+    EXPECT_TRUE(reader.Populate(ms, d));
+    EXPECT_TRUE(d.GetBool());
+    EXPECT_FALSE(reader.Populate(ms, d));
+    EXPECT_EQ(kParseErrorDocumentEmpty, reader.GetParseErrorCode());
+
+    // Transcoding
+    const std::string euro = Bytes("63e282ac");
+    MemoryStream ms16(euro.data(), euro.size());
+    GenericCborReader<UTF16<> > reader16;
+    GenericDocument<UTF16<> > d16;
+    EXPECT_TRUE(reader16.Populate(ms16, d16));
+    EXPECT_EQ(1u, d16.GetStringLength());
+    EXPECT_EQ(0x20ACu, static_cast<unsigned>(d16.GetString()[0]));
+
+    // Directly to the JSON writer
+    const std::string doc = Bytes("a2616101616282f6f4");
+    MemoryStream ms2(doc.data(), doc.size());
+    StringBuffer sb;
+    Writer<StringBuffer> writer(sb);
+    EXPECT_FALSE(reader.Parse(ms2, writer).IsError());
+    EXPECT_STREQ("{\"a\":1,\"b\":[null,false]}", sb.GetString());
+}
+
+TEST(Cbor, Roundtrip) {
+    const char* jsons[] = {
+        "null", "true", "0", "-1", "4294967295", "-2147483648", "9223372036854775807",
+        "-9223372036854775808", "18446744073709551615", "0.5", "-1e300", "1e-310",
+        "\"\\u0000a\\u20AC\"",
+        "{\"a\":[1,{\"b\":{}},[[]],\"c\"],\"\":{\"x\":null,\"y\":[false,true]}}"
+    };
+    for (size_t i = 0; i < sizeof(jsons) / sizeof(jsons[0]); i++) {
+        Document d;
+        d.Parse(jsons[i]);
+        EXPECT_EQ(Serialize(d), Decode(Encode(jsons[i]).c_str())) << jsons[i];
+    }
+}
+
+TEST(Cbor, Insitu) {
+    // {"key": ["abc", "de" "f", h'00'], "": ""} with a tagged key
+    std::string bytes = Bytes("a2c1636b657983636162637f6264656166ff41006060");
+    char* buffer = &bytes[0];
+    InsituMemoryStream is(buffer, bytes.size());
+    CborReader reader;
+    Document d;
+    EXPECT_TRUE(reader.Populate<kParseInsituFlag | kParseValidateEncodingFlag>(is, d));
+    EXPECT_EQ(bytes.size(), is.Tell());
+    EXPECT_EQ("{\"key\":[\"abc\",\"def\",\"\\u0000\"],\"\":\"\"}", Serialize(d));
+
+    // Strings reference the buffer, at the position of their header
+    const Value& a = d["key"];
+    EXPECT_EQ(buffer + 2, d.MemberBegin()->name.GetString());
+    EXPECT_EQ(buffer + 7, a[0].GetString());
+    EXPECT_EQ(buffer + 11, a[1].GetString());
+    EXPECT_EQ(buffer + 18, a[2].GetString());
+    EXPECT_EQ(1u, a[2].GetStringLength());
+    EXPECT_EQ(buffer + 20, d.MemberBegin()[1].name.GetString());
+    EXPECT_EQ(buffer + 21, d.MemberBegin()[1].value.GetString());
+
+    // Errors
+    std::string invalid = Bytes("7f6264654166ff");
+    InsituMemoryStream is2(&invalid[0], invalid.size());
+    EXPECT_FALSE(reader.Populate<kParseInsituFlag>(is2, d));
+    EXPECT_EQ(kParseErrorValueInvalid, reader.GetParseErrorCode());
+    EXPECT_EQ(4u, reader.GetErrorOffset());
+}
+
+TEST(Cbor, ReaderError) {
+#define TEST_ERROR(errorCode, hex, offset)\
+    {\
+        const std::string s = Bytes(hex);\
+        MemoryStream ms(s.data(), s.size());\
+        CborReader reader;\
+        BaseReaderHandler<> h;\
+        EXPECT_TRUE(reader.Parse(ms, h).IsError()) << hex;\
+        EXPECT_EQ(errorCode, reader.GetParseErrorCode()) << hex;\
+        EXPECT_EQ(offset, reader.GetErrorOffset()) << hex;\
+    }
+
+    TEST_ERROR(kParseErrorDocumentEmpty, "", 0u);
+    TEST_ERROR(kParseErrorValueInvalid, "1c", 0u);          // reserved additional information
+    TEST_ERROR(kParseErrorValueInvalid, "1f", 0u);          // indefinite integer
+    TEST_ERROR(kParseErrorValueInvalid, "ff", 0u);          // break outside a container
+    TEST_ERROR(kParseErrorValueInvalid, "8201ff", 2u);      // break in a definite array
+    TEST_ERROR(kParseErrorValueInvalid, "bf6161ff", 3u);    // break instead of a value
+    TEST_ERROR(kParseErrorValueInvalid, "f0", 0u);          // unassigned simple value
+    TEST_ERROR(kParseErrorValueInvalid, "f820", 0u);        // simple value in one byte
+    TEST_ERROR(kParseErrorValueInvalid, "8201", 0u);        // more elements than bytes
+    TEST_ERROR(kParseErrorValueInvalid, "8119", 1u);        // truncated uint16
+    TEST_ERROR(kParseErrorValueInvalid, "637879", 0u);      // truncated string
+    TEST_ERROR(kParseErrorValueInvalid, "9f01", 2u);        // missing break
+    TEST_ERROR(kParseErrorValueInvalid, "7f4161ff", 1u);    // byte string chunk in a text string
+    TEST_ERROR(kParseErrorValueInvalid, "7f7f6161ffff", 1u);
+    TEST_ERROR(kParseErrorValueInvalid, "c1", 1u);          // tag without a data item
+    TEST_ERROR(kParseErrorValueInvalid, "9b00000000ffffffff", 0u);
+    TEST_ERROR(kParseErrorObjectMissName, "a10102", 1u);
+    TEST_ERROR(kParseErrorObjectMissName, "bff5f5ff", 1u);
+#undef TEST_ERROR
+
+    // Invalid UTF-8 is only detected when validating or transcoding
+    const std::string invalid = Bytes("61ff");
+    MemoryStream ms(invalid.data(), invalid.size());
+    CborReader reader;
+    BaseReaderHandler<> h;
+    EXPECT_FALSE(reader.Parse(ms, h).IsError());
+    MemoryStream ms2(invalid.data(), invalid.size());
+    EXPECT_TRUE(reader.Parse<kParseValidateEncodingFlag>(ms2, h).IsError());
+    EXPECT_EQ(kParseErrorStringInvalidEncoding, reader.GetParseErrorCode());
+
+    // Byte strings are not validated
+    const std::string binary = Bytes("41ff");
+    MemoryStream ms3(binary.data(), binary.size());
+    EXPECT_FALSE(reader.Parse<kParseValidateEncodingFlag>(ms3, h).IsError());
+
+    // Termination by the handler
+    StopAtUint stop;
+    const std::string bytes = Bytes("9f01ff");
+    MemoryStream ms4(bytes.data(), bytes.size());
+    EXPECT_TRUE(reader.Parse(ms4, stop).IsError());
+    EXPECT_EQ(kParseErrorTermination, reader.GetParseErrorCode());
+    EXPECT_EQ(1u, reader.GetErrorOffset());
+}
@@ -0,0 +1,155 @@
+// Tencent is pleased to support the open source community by making RapidJSON available.
+//
+// Copyright (C) 2015 THL A29 Limited, a Tencent company, and Milo Yip. All rights reserved.
+//
+// Licensed under the MIT License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// http://opensource.org/licenses/MIT
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "unittest.h"
+#include "rapidjson/columnar.h"
+#include "rapidjson/document.h"
+#include "rapidjson/reader.h"
+#include <string>
+
+using namespace rapidjson;
+
+static std::string GetString(const ColumnTable::Column& c, SizeType row) {
+    return std::string(c.GetString(row), c.GetStringLength(row));
+}
+
+TEST(Columnar, Types) {
+    const char* json =
+        "[{\"id\":1,\"name\":\"a\",\"ok\":true,\"x\":1,\"tags\":[\"t\"]},"
+        " {\"id\":2,\"ok\":false,\"x\":2.5,\"name\":\"bc\",\"tags\":{\"k\":[null]}},"
+        " {\"name\":null,\"id\":-3,\"x\":18446744073709551615,\"extra\":\"e\",\"tags\":3}]";
+    ColumnTable table;
+    Reader reader;
+    StringStream ss(json);
+    ASSERT_FALSE(reader.Parse(ss, table).IsError());
+    EXPECT_EQ(3u, table.GetRowCount());
+    ASSERT_EQ(6u, table.GetColumnCount());
+    EXPECT_STREQ("extra", table.GetColumn(5).GetName());
+
+    const ColumnTable::Column* id = table.FindColumn("id");
+    ASSERT_TRUE(id != 0);
+    EXPECT_EQ(kInt64Column, id->GetType());
+    EXPECT_EQ(3u, id->Size());
+    EXPECT_EQ(-3, id->GetInt64s()[2]);
+    EXPECT_EQ(0u, id->GetNullCount());
+
+    // Nulls and missing members
+    const ColumnTable::Column* name = table.FindColumn("name");
+    EXPECT_EQ(kStringColumn, name->GetType());
+    EXPECT_EQ("bc", GetString(*name, 1));
+    EXPECT_TRUE(name->IsNull(2));
+    EXPECT_EQ(0u, name->GetStringLength(2));
+    EXPECT_EQ(3u, name->GetOffsets()[3]);
+    const ColumnTable::Column* ok = table.FindColumn("ok");
+    EXPECT_EQ(kBoolColumn, ok->GetType());
+    EXPECT_EQ(1, ok->GetBools()[0]);
+    EXPECT_EQ(0, ok->GetBools()[2]);
+    EXPECT_EQ(0x03, ok->GetValidity()[0]);
+    const ColumnTable::Column* extra = table.FindColumn("extra");
+    EXPECT_EQ(2u, extra->GetNullCount());
+    EXPECT_EQ("e", GetString(*extra, 2));
+
+    // Integers turned into doubles
+    const ColumnTable::Column* x = table.FindColumn("x");
+    EXPECT_EQ(kDoubleColumn, x->GetType());
+    EXPECT_DOUBLE_EQ(1.0, x->GetDoubles()[0]);
+    EXPECT_DOUBLE_EQ(2.5, x->GetDoubles()[1]);
+    EXPECT_DOUBLE_EQ(18446744073709551615.0, x->GetDoubles()[2]);
+
+    // Nested and mixed values as JSON
+    const ColumnTable::Column* tags = table.FindColumn("tags");
+    EXPECT_EQ(kJsonColumn, tags->GetType());
+    EXPECT_EQ("[\"t\"]", GetString(*tags, 0));
+    EXPECT_EQ("{\"k\":[null]}", GetString(*tags, 1));
+    EXPECT_EQ("3", GetString(*tags, 2));
+    EXPECT_TRUE(table.FindColumn("missing") == 0);
+}
+
+TEST(Columnar, Conversions) {
+    const char* json =
+        "[{\"a\":null,\"b\":\"s\\\"\",\"c\":true,\"d\":1},{\"a\":null,\"b\":1,\"c\":null,\"d\":18446744073709551615},"
+        " {\"a\":[],\"b\":\"t\",\"c\":\"u\",\"d\":-1,\"d\":{\"dup\":[1]},\"a\":1}]";
+    ColumnTable table;
+    Reader reader;
+    StringStream ss(json);
+    ASSERT_FALSE(reader.Parse(ss, table).IsError());
+
+    const ColumnTable::Column& a = table.GetColumn(0);
+    EXPECT_EQ(kJsonColumn, a.GetType());
+    EXPECT_TRUE(a.IsNull(0));
+    EXPECT_TRUE(a.IsNull(1));
+    EXPECT_EQ("[]", GetString(a, 2));
+
+    const ColumnTable::Column& b = table.GetColumn(1);
+    EXPECT_EQ(kJsonColumn, b.GetType());
+    EXPECT_EQ("\"s\\\"\"", GetString(b, 0));
+    EXPECT_EQ("1", GetString(b, 1));
+    EXPECT_EQ("\"t\"", GetString(b, 2));
+
+    const ColumnTable::Column& c = table.GetColumn(2);
+    EXPECT_EQ(kJsonColumn, c.GetType());
+    EXPECT_EQ("true", GetString(c, 0));
+    EXPECT_TRUE(c.IsNull(1));
+    EXPECT_EQ("\"u\"", GetString(c, 2));
+
+    // Duplicated names keep the first value
+    const ColumnTable::Column& d = table.GetColumn(3);
+    EXPECT_EQ(kDoubleColumn, d.GetType());
+    EXPECT_DOUBLE_EQ(-1.0, d.GetDoubles()[2]);
+    EXPECT_EQ(3u, d.Size());
+
+    // Reuse
+    table.Clear();
+    StringStream ss2("[]");
+    ASSERT_FALSE(reader.Parse(ss2, table).IsError());
+    EXPECT_EQ(0u, table.GetRowCount());
+    EXPECT_EQ(0u, table.GetColumnCount());
+}
+
+TEST(Columnar, NotRecords) {
+    const char* jsons[] = { "{}", "1", "[1]", "[{},[]]", "[{\"a\":1},null]" };
+    for (size_t i = 0; i < sizeof(jsons) / sizeof(jsons[0]); i++) {
+        ColumnTable table;
+        Reader reader;
+        StringStream ss(jsons[i]);
+        EXPECT_EQ(kParseErrorTermination, reader.Parse(ss, table).Code()) << jsons[i];
+    }
+}
+
+TEST(Columnar, SameAsDocument) {
+    std::string json = "[";
+    for (int i = 0; i < 1000; i++) {
+        char record[128];
+        sprintf(record, "%s{\"i\":%d,\"d\":%d.5,\"s\":\"%x\",\"b\":%s}", i ? "," : "", i * 7, i, i, i % 3 ? "true" : "false");
+        json += record;
+    }
+    json += "]";
+    Document doc;
+    doc.Parse(json.c_str());
+    ColumnTable table;
+    Reader reader;
+    StringStream ss(json.c_str());
+    ASSERT_FALSE(reader.Parse(ss, table).IsError());
+    ASSERT_EQ(doc.Size(), table.GetRowCount());
+    const int64_t* ints = table.FindColumn("i")->GetInt64s();
+    const double* doubles = table.FindColumn("d")->GetDoubles();
+    const ColumnTable::Column& s = *table.FindColumn("s");
+    const uint8_t* bools = table.FindColumn("b")->GetBools();
+    for (SizeType r = 0; r < doc.Size(); r++) {
+        EXPECT_EQ(doc[r]["i"].GetInt64(), ints[r]);
+        EXPECT_DOUBLE_EQ(doc[r]["d"].GetDouble(), doubles[r]);
+        EXPECT_EQ(std::string(doc[r]["s"].GetString()), GetString(s, r));
+        EXPECT_EQ(doc[r]["b"].GetBool(), bools[r] != 0);
+    }
+}
@@ -20,6 +20,7 @@
 #include "rapidjson/stringbuffer.h"
 #include <sstream>
 #include <algorithm>
+#include <vector>
 
 #ifdef __clang__
 RAPIDJSON_DIAG_PUSH
@@ -395,6 +396,324 @@ TEST(Document, UTF16_Document) {
     EXPECT_EQ(0, memcmp(L"Wed Oct 30 17:13:20 +0000 2012", s.GetString(), (s.GetStringLength() + 1) * sizeof(wchar_t)));
 }
 
+TEST(Document, Freeze) {
+    const std::string longString(100, 'l');
+    const std::string mediumString(40, 'm');
+    std::string json = "{\"b\":[1,{\"z\":\"" + mediumString + "\",\"y\":[]}],\"a\":\"" + longString +
+        "\",\"c\":{\"dup\":1,\"a\":{},\"dup\":2},\"\":\"s\",\"" + mediumString + "\":true}";
+    std::vector<char> buffer(json.begin(), json.end());
+    buffer.push_back('\0');
+
+    Document doc;
+    doc.ParseInsitu(&buffer[0]);
+    ASSERT_FALSE(doc.HasParseError());
+    doc.Freeze();
+    std::fill(buffer.begin(), buffer.end(), 'x');   // strings are copied
+
+    // Members are sorted by name, keeping duplicates in order
+    StringBuffer sb;
+    Writer<StringBuffer> writer(sb);
+    doc.Accept(writer);
+    EXPECT_EQ("{\"\":\"s\",\"a\":\"" + longString + "\",\"b\":[1,{\"y\":[],\"z\":\"" + mediumString +
+        "\"}],\"c\":{\"a\":{},\"dup\":1,\"dup\":2},\"" + mediumString + "\":true}", std::string(sb.GetString()));
+
+    // Binary search
+    EXPECT_STREQ("s", doc[""].GetString());
+    EXPECT_EQ(longString, doc["a"].GetString());
+    EXPECT_TRUE(doc[mediumString.c_str()].GetBool());
+    EXPECT_EQ(1, doc["c"]["dup"].GetInt());
+    EXPECT_TRUE(doc["c"]["a"].ObjectEmpty());
+    EXPECT_TRUE(doc.FindMember("0") == doc.MemberEnd());
+    EXPECT_TRUE(doc.FindMember("bb") == doc.MemberEnd());
+    EXPECT_TRUE(doc.FindMember("d") == doc.MemberEnd());
+    EXPECT_TRUE(doc["c"].FindMember("b") == doc["c"].MemberEnd());
+
+    // Breadth-first layout in one block aligned on a cache line
+    const char* root = reinterpret_cast<const char*>(&*doc.MemberBegin());
+    EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(root) % 64);
+    const char* b = reinterpret_cast<const char*>(&doc["b"][0]);
+    const char* c = reinterpret_cast<const char*>(&*doc["c"].MemberBegin());
+    const char* b1 = reinterpret_cast<const char*>(&*doc["b"][1].MemberBegin());
+    EXPECT_LT(root, b);
+    EXPECT_LT(b, c);
+    EXPECT_LT(c, b1);
+    EXPECT_LT(b1 - root, 1024);
+
+    // Short strings next to their owner, long ones after all the values
+    const char* medium = doc["b"][1]["z"].GetString();
+    EXPECT_GT(medium, b1);
+    EXPECT_LT(medium, b1 + 128);
+    EXPECT_GT(doc["a"].GetString(), medium);
+    EXPECT_EQ(doc[""].GetString(), reinterpret_cast<const char*>(&doc[""]));  // inline
+
+    // Still modifiable, back to linear search
+    doc.AddMember("0", 0, doc.GetAllocator());
+    EXPECT_EQ(0, doc["0"].GetInt());
+    EXPECT_TRUE(doc["a"].IsString());
+    doc["b"].PushBack(2, doc.GetAllocator());
+    EXPECT_EQ(3u, doc["b"].Size());
+    doc["c"].EraseMember("a");
+    EXPECT_EQ(1, doc["c"]["dup"].GetInt());
+
+    // Scalars and copies
+    Document s;
+    s.Parse(("\"" + longString + "\"").c_str());
+    s.Freeze();
+    EXPECT_EQ(longString, s.GetString());
+    Document copy;
+    copy.CopyFrom(doc, copy.GetAllocator());
+    StringBuffer sb2;
+    Writer<StringBuffer> writer2(sb2);
+    copy.Accept(writer2);
+    sb.Clear();
+    writer.Reset(sb);
+    doc.Accept(writer);
+    EXPECT_STREQ(sb.GetString(), sb2.GetString());
+    s.Parse("[]");
+    s.Freeze();
+    EXPECT_TRUE(s.Empty());
+
+    // Empty containers do not keep their reserved children
+    s.SetArray().Reserve(8, s.GetAllocator());
+    s.Freeze();
+    EXPECT_TRUE(s.Empty());
+    s.PushBack(1, s.GetAllocator());
+    EXPECT_EQ(1, s[0].GetInt());
+    s.Parse("{\"a\":[],\"b\":{}}");
+    s["a"].Reserve(4, s.GetAllocator());
+    s.Freeze();
+    EXPECT_TRUE(s["a"].Empty());
+    EXPECT_TRUE(s["b"].ObjectEmpty());
+    s["b"].AddMember("c", 1, s.GetAllocator());
+    EXPECT_EQ(1, s["b"]["c"].GetInt());
+}
+
+TEST(Document, SortMembers) {
+    const char* json = "[{\"b\":1,\"a\":{\"z\":[{\"y\":0,\"x\":1}],\"dup\":1,\"c\":2,\"dup\":3}},\"s\",{}]";
+    const char* sortedJson = "[{\"a\":{\"c\":2,\"dup\":1,\"dup\":3,\"z\":[{\"x\":1,\"y\":0}]},\"b\":1},\"s\",{}]";
+
+    // After parsing
+    Document doc;
+    doc.Parse(json);
+    ASSERT_FALSE(doc.HasParseError());
+    doc.SortMembers();
+    StringBuffer sb;
+    Writer<StringBuffer> writer(sb);
+    doc.Accept(writer);
+    EXPECT_STREQ(sortedJson, sb.GetString());
+    EXPECT_EQ(1, doc[0]["a"]["dup"].GetInt());
+    EXPECT_EQ(0, doc[0]["a"]["z"][0]["y"].GetInt());
+    EXPECT_TRUE(doc[0].FindMember("aa") == doc[0].MemberEnd());
+
+    // While parsing
+    Document parsed;
+    parsed.Parse<kParseSortKeysFlag>(json);
+    ASSERT_FALSE(parsed.HasParseError());
+    sb.Clear();
+    writer.Reset(sb);
+    parsed.Accept(writer);
+    EXPECT_STREQ(sortedJson, sb.GetString());
+
+    // Wide objects
+    std::string wide = "{";
+    for (int i = 999; i >= 0; i--) {
+        char member[32];
+        sprintf(member, "%s\"k%d\":%d", i < 999 ? "," : "", i, i);
+        wide += member;
+    }
+    wide += "}";
+    parsed.Parse<kParseSortKeysFlag>(wide.c_str());
+    ASSERT_FALSE(parsed.HasParseError());
+    for (int i = 0; i < 1000; i++) {
+        char name[16];
+        sprintf(name, "k%d", i);
+        EXPECT_EQ(i, parsed[name].GetInt());
+    }
+    EXPECT_STREQ("k0", parsed.MemberBegin()->name.GetString());
+
+    // Adding a member turns back to linear search
+    parsed.AddMember("a", 1, parsed.GetAllocator());
+    EXPECT_EQ(1, parsed["a"].GetInt());
+    EXPECT_EQ(999, parsed["k999"].GetInt());
+
+    // With an allocator which needs Free(), whose stack is emptied by destroying values
+    GenericDocument<UTF8<>, CrtAllocator> crt;
+    crt.Parse(json);
+    ASSERT_FALSE(crt.HasParseError());
+    crt.SortMembers();
+    sb.Clear();
+    writer.Reset(sb);
+    crt.Accept(writer);
+    EXPECT_STREQ(sortedJson, sb.GetString());
+    crt.Parse("{\"b\":1,\"a\":2}").SortMembers();
+    EXPECT_STREQ("a", crt.MemberBegin()->name.GetString());
+}
+
+TEST(Document, InternKeys) {
+    std::string json = "[";
+    for (int i = 0; i < 200; i++) {
+        char key[32];
+        sprintf(key, "a_key_too_long_to_be_inline_%d", i % 100);
+        json += std::string(i ? "," : "") + "{\"" + key + "\":\"a value too long to be inline\",\"id\":" + (i % 2 ? "1" : "2") + "}";
+    }
+    json += "]";
+
+    Document d;
+    d.Parse<kParseInternKeysFlag>(json.c_str());
+    ASSERT_FALSE(d.HasParseError());
+    EXPECT_EQ(d[0].MemberBegin()->name.GetString(), d[100].MemberBegin()->name.GetString());
+    EXPECT_NE(d[0].MemberBegin()->name.GetString(), d[1].MemberBegin()->name.GetString());
+    EXPECT_NE(d[0].MemberBegin()->value.GetString(), d[100].MemberBegin()->value.GetString());
+    EXPECT_STREQ("a_key_too_long_to_be_inline_99", d[199].MemberBegin()->name.GetString());
+    EXPECT_EQ(1, d[199]["id"].GetInt());
+    EXPECT_TRUE(d[100].HasMember(d[0].MemberBegin()->name));
+
+    Document plain;
+    plain.Parse(json.c_str());
+    EXPECT_TRUE(d == plain);
+    EXPECT_LT(d.GetAllocator().Size(), plain.GetAllocator().Size());
+    EXPECT_NE(plain[0].MemberBegin()->name.GetString(), plain[100].MemberBegin()->name.GetString());
+
+    // Copies do not refer to the interned keys
+    Document* source = new Document;
+    source->Parse<kParseInternKeysFlag>(json.c_str());
+    Document copy;
+    copy.CopyFrom(*source, copy.GetAllocator());
+    delete source;
+    EXPECT_TRUE(copy == plain);
+
+    // Not for allocators which need Free()
+    GenericDocument<UTF8<>, CrtAllocator> crt;
+    crt.Parse<kParseInternKeysFlag>(json.c_str());
+    EXPECT_NE(crt[0].MemberBegin()->name.GetString(), crt[100].MemberBegin()->name.GetString());
+
+    // Only for this parse
+    d.Parse(json.c_str());
+    EXPECT_NE(d[0].MemberBegin()->name.GetString(), d[100].MemberBegin()->name.GetString());
+}
+
+template <typename DocumentType>
+static std::string SerializeShared(const DocumentType& d) {
+    GenericStringBuffer<typename DocumentType::EncodingType> sb;
+    Writer<GenericStringBuffer<typename DocumentType::EncodingType>, typename DocumentType::EncodingType> writer(sb);
+    d.Accept(writer);
+    return sb.GetString();
+}
+
+template <typename DocumentType>
+static void TestSharedValue() {
+    typedef typename DocumentType::ValueType ValueType;
+    typedef typename DocumentType::SharedValueType SharedValueType;
+    const char* json = "{\"name\":\"a string longer than a short string\",\"list\":[1,[2],{\"x\":3}],\"empty\":{},\"o\":{\"b\":true}}";
+
+    DocumentType* source = new DocumentType;
+    source->Parse(json);
+    SharedValueType shared(*source);
+    delete source;
+    EXPECT_EQ(1u, shared.UseCount());
+
+    DocumentType d1, d2;
+    d1.SetObject();
+    ValueType v;
+    d1.AddMember("h", d1.Attach(v, shared), d1.GetAllocator());
+    d1.AddMember("i", d1.Attach(v, shared), d1.GetAllocator());
+    d2.Attach(d2, shared);
+    EXPECT_EQ(3u, shared.UseCount());
+
+    // Const access reads the shared subtree
+    const ValueType& h = static_cast<const DocumentType&>(d1)["h"];
+    EXPECT_EQ(shared.Get()["list"].Begin(), h["list"].Begin());
+    EXPECT_EQ(shared.Get().MemberBegin(), h.MemberBegin());
+    EXPECT_EQ(shared.Get()["name"].GetString(), h["name"].GetString());
+    EXPECT_TRUE(h == shared.Get());
+    EXPECT_EQ(std::string(json), SerializeShared(d2));
+
+    // Non-const access copies one level at a time
+    d1["h"]["list"].PushBack(4, d1.GetAllocator());
+    d1["h"]["list"][1].PushBack(5, d1.GetAllocator());
+    d1["h"]["name"].SetString("changed");
+    d1["h"]["o"].RemoveMember("b");
+    d1["h"].EraseMember("empty");
+    EXPECT_EQ(std::string("{\"h\":{\"name\":\"changed\",\"list\":[1,[2,5],{\"x\":3},4],\"o\":{}},\"i\":") + json + "}", SerializeShared(d1));
+    EXPECT_NE(shared.Get()["list"].Begin(), h["list"].Begin());
+    EXPECT_EQ(shared.Get()["list"][2].MemberBegin(), h["list"][2].MemberBegin());
+    EXPECT_EQ(shared.Get()["list"].Begin(), static_cast<const DocumentType&>(d1)["i"]["list"].Begin());
+
+    d2["list"].Clear();
+    d2.RemoveAllMembers();
+    EXPECT_TRUE(d2.ObjectEmpty());
+    EXPECT_EQ(std::string(json), SerializeShared(shared.Get()));
+
+    // Copies are deep
+    ValueType copy(d1["i"], d1.GetAllocator());
+    EXPECT_TRUE(copy == shared.Get());
+    EXPECT_NE(shared.Get().MemberBegin(), static_cast<const ValueType&>(copy).MemberBegin());
+
+    // Ranges obtained by const access are erased from the copied children
+    DocumentType d3;
+    d3.Attach(d3, shared);
+    const DocumentType& c3 = d3;
+    typename ValueType::MemberIterator m = d3.EraseMember(c3.MemberBegin() + 1, c3.MemberBegin() + 3);
+    EXPECT_STREQ("o", m->name.GetString());
+    EXPECT_EQ(std::string("{\"name\":\"a string longer than a short string\",\"o\":{\"b\":true}}"), SerializeShared(d3));
+    ValueType& list = d2.Attach(d2, shared)["list"];
+    const ValueType& c2 = list;
+    typename ValueType::ValueIterator e = list.Erase(c2.Begin() + 1, c2.Begin() + 2);
+    EXPECT_TRUE(e->IsObject());
+    EXPECT_EQ(std::string("[1,{\"x\":3}]"), SerializeShared(list));
+    EXPECT_EQ(std::string(json), SerializeShared(shared.Get()));
+}
+
+TEST(Document, SharedValue) {
+    TestSharedValue<Document>();
+    TestSharedValue<GenericDocument<UTF8<>, CrtAllocator> >();
+
+    // Copies of unshared values do not refer to the strings of the subtree
+    Document copy;
+    {
+        Document source;
+        source.Parse("{\"o\":{\"s\":\"a string longer than a short string\",\"n\":1}}");
+        SharedValue subtree(source);
+        Document d;
+        d.Attach(d, subtree);
+        d["o"]["n"] = 2;
+        copy.CopyFrom(d, copy.GetAllocator());
+    }
+    EXPECT_STREQ("a string longer than a short string", copy["o"]["s"].GetString());
+    EXPECT_EQ(2, copy["o"]["n"].GetInt());
+
+    // Documents keep the subtree alive
+    Document source;
+    source.Parse("[\"a string longer than a short string\",{\"a\":[]}]");
+    SharedValue shared(source);
+    {
+        Document d;
+        d.Attach(d, shared);
+        SharedValue copy(shared);
+        EXPECT_EQ(3u, shared.UseCount());
+        Document moved;
+        moved.Swap(d);
+        EXPECT_EQ(3u, shared.UseCount());
+        d.Parse("1");
+        EXPECT_EQ(3u, shared.UseCount());
+
+        // Freezing copies the subtree
+        moved.Freeze();
+        EXPECT_EQ(2u, shared.UseCount());
+        EXPECT_TRUE(moved == source);
+        EXPECT_NE(shared.Get()[0].GetString(), moved[0].GetString());
+    }
+    EXPECT_EQ(1u, shared.UseCount());
+
+    // Scalars
+    Document s;
+    s.Parse("\"a string longer than a short string\"");
+    SharedValue sharedString(s);
+    Document d;
+    d.Attach(d, sharedString);
+    EXPECT_EQ(sharedString.Get().GetString(), d.GetString());
+}
+
 #if RAPIDJSON_HAS_CXX11_RVALUE_REFS
 
 #if 0 // Many old compiler does not support these. Turn it off temporaily.
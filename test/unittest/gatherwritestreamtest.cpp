@@ -0,0 +1,244 @@
+// Tencent is pleased to support the open source community by making RapidJSON available.
+//
+// Copyright (C) 2015 THL A29 Limited, a Tencent company, and Milo Yip. All rights reserved.
+//
+// Licensed under the MIT License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// http://opensource.org/licenses/MIT
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "unittest.h"
+#include "rapidjson/gatherwritestream.h"
+#include "rapidjson/document.h"
+#include "rapidjson/prettywriter.h"
+#include <cstring>
+#include <string>
+
+using namespace rapidjson;
+
+namespace {
+
+struct Sink {
+    Sink(const char* source, size_t length) : output(), source(source), sourceEnd(source + length), flushes(), references() {}
+
+    static bool Flush(void* userData, const GatherWriteStream::Segment* segments, size_t count) {
+        Sink& sink = *static_cast<Sink*>(userData);
+        sink.flushes++;
+        for (size_t i = 0; i < count; i++) {
+            sink.output.append(segments[i].data, segments[i].length);
+            if (segments[i].data >= sink.source && segments[i].data < sink.sourceEnd)
+                sink.references++;
+        }
+        return true;
+    }
+
+    std::string output;
+    const char* source;
+    const char* sourceEnd;
+    unsigned flushes;
+    unsigned references;
+
+private:
+    Sink(const Sink&);
+    Sink& operator=(const Sink&);
+};
+
+} // namespace
+
+static std::string MakeJson() {
+    std::string json = "{\"short\":\"a\\\"b\",\"long\":[";
+    for (int i = 0; i < 100; i++) {
+        if (i != 0)
+            json += ',';
+        json += '"';
+        json += std::string(static_cast<size_t>(300 + i), static_cast<char>('a' + i % 26));
+        if (i % 3 == 0)
+            json += "\\n\\u0001\xE2\x82\xAC";
+        json += std::string(static_cast<size_t>(260), 'z');
+        json += '"';
+    }
+    json += "],\"n\":[1,2.5,null,true]}";
+    return json;
+}
+
+TEST(GatherWriteStream, Insitu) {
+    std::string json = MakeJson();
+    StringBuffer expected;
+    {
+        Document d;
+        d.Parse(json.c_str());
+        Writer<StringBuffer> writer(expected);
+        d.Accept(writer);
+    }
+
+    std::string insitu = json;
+    Document d;
+    d.ParseInsitu(&insitu[0]);
+    ASSERT_FALSE(d.HasParseError());
+
+    char buffer[64];
+    Sink sink(insitu.data(), insitu.size());
+    GatherWriteStream os(Sink::Flush, &sink, buffer, sizeof(buffer));
+    os.SetReferenceMode(GatherWriteStream::kReferenceBorrowed);
+    Writer<GatherWriteStream> writer(os);
+    d.Accept(writer);
+    EXPECT_FALSE(os.HasError());
+    EXPECT_EQ(std::string(expected.GetString()), sink.output);
+    // Two runs in each escaped string, one in the others
+    EXPECT_EQ(134u, sink.references);
+    EXPECT_GT(sink.flushes, 1u);
+
+    // PrettyWriter goes through the same path
+    StringBuffer prettyExpected;
+    PrettyWriter<StringBuffer> prettyWriter(prettyExpected);
+    d.Accept(prettyWriter);
+    Sink prettySink(insitu.data(), insitu.size());
+    GatherWriteStream prettyOs(Sink::Flush, &prettySink, buffer, sizeof(buffer));
+    prettyOs.SetReferenceMode(GatherWriteStream::kReferenceBorrowed);
+    PrettyWriter<GatherWriteStream> prettyGather(prettyOs);
+    d.Accept(prettyGather);
+    EXPECT_EQ(std::string(prettyExpected.GetString()), prettySink.output);
+    EXPECT_EQ(134u, prettySink.references);
+
+    // Nothing is referenced by default
+    Sink copied(insitu.data(), insitu.size());
+    GatherWriteStream copiedOs(Sink::Flush, &copied, buffer, sizeof(buffer));
+    Writer<GatherWriteStream> copiedWriter(copiedOs);
+    d.Accept(copiedWriter);
+    EXPECT_EQ(std::string(expected.GetString()), copied.output);
+    EXPECT_EQ(0u, copied.references);
+}
+
+TEST(GatherWriteStream, Copies) {
+    std::string json = MakeJson();
+    Document d;
+    d.Parse(json.c_str());
+    StringBuffer expected;
+    Writer<StringBuffer> writer(expected);
+    d.Accept(writer);
+
+    // Copied strings are only referenced on request
+    char buffer[1024];
+    Sink sink(0, 0);
+    GatherWriteStream os(Sink::Flush, &sink, buffer, sizeof(buffer));
+    Writer<GatherWriteStream> w(os);
+    d.Accept(w);
+    EXPECT_EQ(std::string(expected.GetString()), sink.output);
+    EXPECT_EQ(1u + (sink.output.size() - 1) / sizeof(buffer), sink.flushes);
+
+    Sink referenced(0, 0);
+    GatherWriteStream os2(Sink::Flush, &referenced, buffer, sizeof(buffer), 16);
+    os2.SetReferenceMode(GatherWriteStream::kReferenceAll);
+    Writer<GatherWriteStream> w2(os2);
+    d.Accept(w2);
+    EXPECT_EQ(std::string(expected.GetString()), referenced.output);
+
+    // Validation and transcoding never reference
+    Sink validated(0, 0);
+    GatherWriteStream os3(Sink::Flush, &validated, buffer, sizeof(buffer));
+    os3.SetReferenceMode(GatherWriteStream::kReferenceAll);
+    Writer<GatherWriteStream, UTF8<>, UTF8<>, CrtAllocator, kWriteValidateEncodingFlag> w3(os3);
+    d.Accept(w3);
+    EXPECT_EQ(std::string(expected.GetString()), validated.output);
+}
+
+static void WriteTemporaries(Writer<GatherWriteStream>& w, std::string& expected) {
+    w.StartArray();
+    expected = "[";
+    for (int i = 0; i < 20; i++) {
+        // Each string is overwritten before the stream is flushed
+        std::string s(static_cast<size_t>(300 + i), static_cast<char>('a' + i % 26));
+        std::string k(static_cast<size_t>(280), static_cast<char>('A' + i % 26));
+        char t[320];
+        std::memset(t, '0' + i % 10, sizeof(t));
+        t[sizeof(t) - 1] = '\0';
+        w.StartObject();
+        w.Key(k);
+        w.String(s);
+        w.Key(t);
+        w.String(t, static_cast<SizeType>(sizeof(t) - 1));
+        w.Key("c");
+        const char* p = t;
+        w.String(p);
+        w.EndObject();
+        expected += std::string(i ? ",{\"" : "{\"") + k + "\":\"" + s + "\",\"" + t + "\":\"" + t + "\",\"c\":\"" + t + "\"}";
+        s.assign(s.size(), '#');
+        k.assign(k.size(), '#');
+        std::memset(t, '#', sizeof(t) - 1);
+    }
+    w.EndArray();
+    expected += "]";
+}
+
+TEST(GatherWriteStream, Temporaries) {
+    char buffer[1 << 16];
+    std::string expected;
+
+    // Temporary buffers given with the default copy flag are copied by default
+    Sink sink(0, 0);
+    GatherWriteStream os(Sink::Flush, &sink, buffer, sizeof(buffer));
+    Writer<GatherWriteStream> w(os);
+    WriteTemporaries(w, expected);
+    os.Flush();
+    EXPECT_EQ(1u, sink.flushes);
+    EXPECT_EQ(expected, sink.output);
+
+    // The std::string and null-terminated overloads copy even when borrowed strings are referenced
+    Sink borrowed(0, 0);
+    GatherWriteStream os2(Sink::Flush, &borrowed, buffer, sizeof(buffer));
+    os2.SetReferenceMode(GatherWriteStream::kReferenceBorrowed);
+    PrettyWriter<GatherWriteStream> w2(os2);
+    w2.SetFormatOptions(kFormatSingleLineArray);
+    w2.SetIndent(' ', 0);
+    std::string prettyExpected;
+    w2.StartArray();
+    for (int i = 0; i < 20; i++) {
+        std::string s(static_cast<size_t>(300 + i), static_cast<char>('a' + i % 26));
+        w2.String(s);
+        w2.String(s.c_str());
+        prettyExpected += std::string(i ? ", \"" : "\"") + s + "\", \"" + s + "\"";
+        s.assign(s.size(), '#');
+    }
+    w2.EndArray();
+    os2.Flush();
+    EXPECT_EQ("[" + prettyExpected + "]", borrowed.output);
+}
+
+#if !defined(_WIN32)
+TEST(GatherWriteStream, Writev) {
+    std::string json = MakeJson();
+    Document d;
+    d.Parse(json.c_str());
+    StringBuffer expected;
+    Writer<StringBuffer> writer(expected);
+    d.Accept(writer);
+
+    FILE* fp = tmpfile();
+    ASSERT_TRUE(fp != 0);
+    int fd = fileno(fp);
+    char buffer[100];
+    GatherWriteStream os(GatherWriteStream::Writev, &fd, buffer, sizeof(buffer));
+    os.SetReferenceMode(GatherWriteStream::kReferenceAll);
+    Writer<GatherWriteStream> w(os);
+    d.Accept(w);
+    EXPECT_FALSE(os.HasError());
+
+    std::string output(expected.GetSize(), '\0');
+    fseek(fp, 0, SEEK_SET);
+    EXPECT_EQ(output.size(), fread(&output[0], 1, output.size(), fp));
+    EXPECT_EQ(EOF, fgetc(fp));
+    EXPECT_EQ(std::string(expected.GetString()), output);
+    fclose(fp);
+
+    int bad = -1;
+    GatherWriteStream os2(GatherWriteStream::Writev, &bad, buffer, sizeof(buffer));
+    os2.Put('x');
+    os2.Flush();
+    EXPECT_TRUE(os2.HasError());
+}
+#endif
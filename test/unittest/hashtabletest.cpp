@@ -0,0 +1,77 @@
+// Tencent is pleased to support the open source community by making RapidJSON available.
+// 
+// Copyright (C) 2015 THL A29 Limited, a Tencent company, and Milo Yip. All rights reserved.
+//
+// Licensed under the MIT License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// http://opensource.org/licenses/MIT
+//
+// Unless required by applicable law or agreed to in writing, software distributed 
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR 
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the 
+// specific language governing permissions and limitations under the License.
+
+#include "unittest.h"
+#include "rapidjson/internal/hashtable.h"
+#include "rapidjson/allocators.h"
+
+using namespace rapidjson;
+using namespace rapidjson::internal;
+
+namespace {
+
+struct IntegerSlot {
+    typedef uint64_t KeyType;
+    uint64_t key;
+    int value;
+};
+
+struct PointerSlot {
+    typedef const int* KeyType;
+    const int* key;
+};
+
+} // namespace
+
+TEST(HashTable, Integer) {
+    CrtAllocator allocator;
+    HashTable<IntegerSlot, CrtAllocator> table(&allocator, 4);
+    EXPECT_TRUE(table.Find(1) == 0);
+
+    // Keys differing only in their high bits, which the top bits of the product must spread
+    bool inserted;
+    for (uint64_t i = 1; i <= 1000; i++) {
+        table.Insert(i << 40, &inserted)->value = static_cast<int>(i);
+        EXPECT_TRUE(inserted);
+    }
+    EXPECT_EQ(1000u, table.GetSize());
+    for (uint64_t i = 1; i <= 1000; i++) {
+        IntegerSlot* slot = table.Insert(i << 40, &inserted);
+        EXPECT_FALSE(inserted);
+        EXPECT_EQ(static_cast<int>(i), slot->value);
+    }
+    EXPECT_EQ(1000u, table.GetSize());
+    EXPECT_NE(static_cast<uint64_t>(1001) << 40, table.Find(static_cast<uint64_t>(1001) << 40)->key);
+
+    table.Clear();
+    EXPECT_EQ(0u, table.GetSize());
+    EXPECT_EQ(0u, table.Find(static_cast<uint64_t>(1) << 40)->key);
+    table.Release();
+    EXPECT_TRUE(table.Find(1) == 0);
+    table.Insert(1);
+    EXPECT_EQ(1u, table.Find(1)->key);
+}
+
+TEST(HashTable, Pointer) {
+    int values[100];
+    CrtAllocator allocator;
+    HashTable<PointerSlot, CrtAllocator> table(&allocator, 16);
+    for (int i = 0; i < 100; i++)
+        table.Insert(&values[i]);
+    EXPECT_EQ(100u, table.GetSize());
+    for (int i = 0; i < 100; i++)
+        EXPECT_EQ(&values[i], table.Find(&values[i])->key);
+    int other;
+    EXPECT_TRUE(table.Find(&other)->key == 0);
+}
@@ -0,0 +1,185 @@
+// Tencent is pleased to support the open source community by making RapidJSON available.
+//
+// Copyright (C) 2015 THL A29 Limited, a Tencent company, and Milo Yip. All rights reserved.
+//
+// Licensed under the MIT License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// http://opensource.org/licenses/MIT
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#define UNITTEST_HANDLERS
+#include "unittest.h"
+#include "rapidjson/msgpack.h"
+#include "rapidjson/document.h"
+#include "rapidjson/memorybuffer.h"
+#include "rapidjson/stringbuffer.h"
+#include "rapidjson/writer.h"
+#include <string>
+
+using namespace rapidjson;
+
+static std::string Pack(const char* json) {
+    Document d;
+    d.Parse(json);
+    EXPECT_FALSE(d.HasParseError()) << json;
+    MemoryBuffer mb;
+    MsgPackWriter<MemoryBuffer> writer(mb);
+    EXPECT_TRUE(d.Accept(writer));
+    EXPECT_TRUE(writer.IsComplete());
+    return std::string(mb.GetBuffer(), mb.GetSize());
+}
+
+static std::string Unpack(const std::string& bytes) {
+    MemoryStream ms(bytes.data(), bytes.size());
+    MsgPackReader reader;
+    Document d;
+    EXPECT_TRUE(reader.Populate(ms, d)) << reader.GetParseErrorCode() << " at " << reader.GetErrorOffset();
+    EXPECT_EQ(bytes.size(), ms.Tell());
+    return Serialize(d);
+}
+
+TEST(MsgPack, Encoding) {
+    EXPECT_EQ(std::string("\x82\xA1" "a\x01\xA1" "b\x94\xC3\xC0\xFF\xCB\x40\x0C\0\0\0\0\0\0", 19),
+              Pack("{\"a\":1,\"b\":[true,null,-1,3.5]}"));
+
+    // Smallest integer encodings
+    EXPECT_EQ(std::string("\x7F"), Pack("127"));
+    EXPECT_EQ(std::string("\xCC\x80"), Pack("128"));
+    EXPECT_EQ(std::string("\xCD\x01\x00", 3), Pack("256"));
+    EXPECT_EQ(std::string("\xCE\x00\x01\x00\x00", 5), Pack("65536"));
+    EXPECT_EQ(std::string("\xCF\x00\x00\x00\x01\x00\x00\x00\x00", 9), Pack("4294967296"));
+    EXPECT_EQ(std::string("\xE0"), Pack("-32"));
+    EXPECT_EQ(std::string("\xD0\xDF"), Pack("-33"));
+    EXPECT_EQ(std::string("\xD1\xFF\x7F"), Pack("-129"));
+    EXPECT_EQ(std::string("\xD2\xFF\xFF\x7F\xFF"), Pack("-32769"));
+    EXPECT_EQ(std::string("\xD3\xFF\xFF\xFF\xFF\x7F\xFF\xFF\xFF"), Pack("-2147483649"));
+
+    // Headers growing with the counts
+    EXPECT_EQ(std::string("\x90"), Pack("[]"));
+    EXPECT_EQ(std::string("\x80"), Pack("{}"));
+    EXPECT_EQ(std::string("\xA0"), Pack("\"\""));
+    std::string json = "[";
+    for (int i = 0; i < 16; i++)
+        json += i == 0 ? "0" : ",0";
+    json += "]";
+    EXPECT_EQ(std::string("\xDC\x00\x10", 3) + std::string(16, '\0'), Pack(json.c_str()));
+    std::string s32 = "\"" + std::string(32, 'x') + "\"";
+    EXPECT_EQ("\xD9\x20" + std::string(32, 'x'), Pack(s32.c_str()));
+    std::string s256 = "\"" + std::string(256, 'x') + "\"";
+    EXPECT_EQ(std::string("\xDA\x01\x00", 3) + std::string(256, 'x'), Pack(s256.c_str()));
+}
+
+TEST(MsgPack, Roundtrip) {
+    const char* jsons[] = {
+        "null", "true", "0", "-1", "4294967295", "-2147483648", "9223372036854775807",
+        "-9223372036854775808", "18446744073709551615", "0.5", "-1e300",
+        "\"\\u0000a\\u20AC\"",
+        "{\"a\":[1,{\"b\":{}},[[]],\"c\"],\"\":{\"x\":null,\"y\":[false,true]}}"
+    };
+    for (size_t i = 0; i < sizeof(jsons) / sizeof(jsons[0]); i++) {
+        Document d;
+        d.Parse(jsons[i]);
+        EXPECT_EQ(Serialize(d), Unpack(Pack(jsons[i]))) << jsons[i];
+    }
+
+    // Large containers
+    Document d;
+    d.SetObject();
+    Value a(kArrayType);
+    for (int i = 0; i < 70000; i++)
+        a.PushBack(i - 35000, d.GetAllocator());
+    d.AddMember("a", a, d.GetAllocator());
+    for (int i = 0; i < 300; i++) {
+        char name[8];
+        sprintf(name, "%d", i);
+        d.AddMember(Value(name, d.GetAllocator()), Value(std::string(static_cast<size_t>(i), 'z').c_str(), d.GetAllocator()), d.GetAllocator());
+    }
+    MemoryBuffer mb;
+    MsgPackWriter<MemoryBuffer> writer(mb);
+    d.Accept(writer);
+    EXPECT_EQ(Serialize(d), Unpack(std::string(mb.GetBuffer(), mb.GetSize())));
+}
+
+TEST(MsgPack, Reader) {
+    // float32, str8, uint8, int16, several objects in one stream
+    const std::string bytes("\x92\xCA\x3F\xC0\x00\x00\xD9\x01" "a" "\x81\xA1k\xCC\xFF\xD1\x80\x00", 17);
+    MemoryStream ms(bytes.data(), bytes.size());
+    MsgPackReader reader;
+    Document d;
+    EXPECT_TRUE(reader.Populate(ms, d));
+    EXPECT_EQ("[1.5,\"a\"]", Serialize(d));
+    EXPECT_TRUE(reader.Populate(ms, d));
+    EXPECT_EQ("{\"k\":255}", Serialize(d));
+    EXPECT_TRUE(reader.Populate(ms, d));
+    EXPECT_EQ(-32768, d.GetInt());
+    EXPECT_FALSE(reader.Populate(ms, d));
+    EXPECT_EQ(kParseErrorDocumentEmpty, reader.GetParseErrorCode());
+    EXPECT_EQ(-32768, d.GetInt());
+
+    // Any byte stream
+    StringStream ss("\x92\x01\xA1x");
+    EXPECT_TRUE(reader.Populate(ss, d));
+    EXPECT_EQ("[1,\"x\"]", Serialize(d));
+
+    // Transcoding
+    const std::string euro("\xA3\xE2\x82\xAC");
+    MemoryStream ms16(euro.data(), euro.size());
+    GenericMsgPackReader<UTF16<> > reader16;
+    GenericDocument<UTF16<> > d16;
+    EXPECT_TRUE(reader16.Populate(ms16, d16));
+    EXPECT_EQ(1u, d16.GetStringLength());
+    EXPECT_EQ(0x20ACu, static_cast<unsigned>(d16.GetString()[0]));
+
+    // Writing from UTF-16
+    MemoryBuffer mb;
+    MsgPackWriter<MemoryBuffer, UTF16<> > writer16(mb);
+    EXPECT_TRUE(d16.Accept(writer16));
+    EXPECT_EQ(euro, std::string(mb.GetBuffer(), mb.GetSize()));
+}
+
+TEST(MsgPack, ReaderError) {
+#define TEST_ERROR(errorCode, bytes, offset)\
+    {\
+        const std::string s(bytes, sizeof(bytes) - 1);\
+        MemoryStream ms(s.data(), s.size());\
+        MsgPackReader reader;\
+        BaseReaderHandler<> h;\
+        EXPECT_TRUE(reader.Parse(ms, h).IsError());\
+        EXPECT_EQ(errorCode, reader.GetParseErrorCode());\
+        EXPECT_EQ(offset, reader.GetErrorOffset());\
+    }
+
+    TEST_ERROR(kParseErrorDocumentEmpty, "", 0u);
+    TEST_ERROR(kParseErrorValueInvalid, "\xC1", 0u);
+    TEST_ERROR(kParseErrorValueInvalid, "\xC4\x01x", 0u);       // bin 8
+    TEST_ERROR(kParseErrorValueInvalid, "\xD4\x01x", 0u);       // fixext 1
+    TEST_ERROR(kParseErrorValueInvalid, "\x92\x01", 0u);        // more elements than bytes
+    TEST_ERROR(kParseErrorValueInvalid, "\x91\xCD\x01", 1u);    // truncated uint16
+    TEST_ERROR(kParseErrorValueInvalid, "\xA3xy", 0u);          // truncated string
+    TEST_ERROR(kParseErrorValueInvalid, "\xDD\xFF\xFF\xFF\xFF", 0u);
+    TEST_ERROR(kParseErrorObjectMissName, "\x81\x01\x02", 1u);
+#undef TEST_ERROR
+
+    // Invalid UTF-8 is only detected when validating or transcoding
+    const std::string invalid("\xA1\xFF");
+    MemoryStream ms(invalid.data(), invalid.size());
+    MsgPackReader reader;
+    BaseReaderHandler<> h;
+    EXPECT_FALSE(reader.Parse(ms, h).IsError());
+    MemoryStream ms2(invalid.data(), invalid.size());
+    EXPECT_TRUE(reader.Parse<kParseValidateEncodingFlag>(ms2, h).IsError());
+    EXPECT_EQ(kParseErrorStringInvalidEncoding, reader.GetParseErrorCode());
+
+    // Termination by the handler
+    StopAtUint stop;
+    const std::string bytes("\x91\x01");
+    MemoryStream ms3(bytes.data(), bytes.size());
+    EXPECT_TRUE(reader.Parse(ms3, stop).IsError());
+    EXPECT_EQ(kParseErrorTermination, reader.GetParseErrorCode());
+    EXPECT_EQ(1u, reader.GetErrorOffset());
+}
@@ -0,0 +1,111 @@
+// Tencent is pleased to support the open source community by making RapidJSON available.
+//
+// Copyright (C) 2015 THL A29 Limited, a Tencent company, and Milo Yip. All rights reserved.
+//
+// Licensed under the MIT License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// http://opensource.org/licenses/MIT
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "unittest.h"
+#include "rapidjson/document.h"
+#include "rapidjson/parallelwriter.h"
+#include <limits>
+
+#if RAPIDJSON_HAS_CXX11_RVALUE_REFS
+
+using namespace rapidjson;
+
+static void MakeDocument(Document& d) {
+    Document::AllocatorType& a = d.GetAllocator();
+    d.SetObject();
+    Value big(kArrayType);
+    for (int i = 0; i < 200; i++) {
+        Value o(kObjectType);
+        o.AddMember("id", i, a);
+        o.AddMember("name\t", Value("a\"b\\c\n", a), a);
+        o.AddMember("ratio", 1.0 / (i + 1), a);
+        Value tags(kArrayType);
+        for (int j = 0; j < i % 5; j++)
+            tags.PushBack(j, a);
+        o.AddMember("tags", tags, a);
+        big.PushBack(o, a);
+    }
+    Value nested(kArrayType);
+    for (int i = 0; i < 3; i++) {
+        Value inner(kArrayType);
+        for (int j = 0; j < 50 * i; j++)
+            inner.PushBack(static_cast<int64_t>(j) * 1000000007, a);
+        nested.PushBack(inner, a);
+    }
+    Value members(kObjectType);
+    for (int i = 0; i < 100; i++) {
+        char name[16];
+        sprintf(name, "k%d", i);
+        members.AddMember(Value(name, a), Value(i % 3 == 0), a);
+    }
+    d.AddMember("empty", Value(kArrayType), a);
+    d.AddMember("big", big, a);
+    d.AddMember("nested", nested, a);
+    d.AddMember("\xE2\x82\xAC", members, a);
+    d.AddMember("last", Value(), a);
+}
+
+TEST(ParallelWriter, Identical) {
+    Document d;
+    MakeDocument(d);
+    StringBuffer expected;
+    Writer<StringBuffer> writer(expected);
+    d.Accept(writer);
+
+    static const size_t chunkSizes[] = { 1, 2, 7, 64, 1000 };
+    for (size_t c = 0; c < sizeof(chunkSizes) / sizeof(chunkSizes[0]); c++) {
+        for (unsigned threads = 2; threads <= 4; threads += 2) {
+            StringBuffer sb;
+            ParallelWriter<> pw(threads, chunkSizes[c]);
+            EXPECT_TRUE(pw.Write(sb, d));
+            EXPECT_STREQ(expected.GetString(), sb.GetString()) << chunkSizes[c] << " " << threads;
+
+            // Writing again reuses the writer
+            sb.Clear();
+            EXPECT_TRUE(pw.Write(sb, d["big"]));
+            StringBuffer expectedBig;
+            Writer<StringBuffer> writerBig(expectedBig);
+            d["big"].Accept(writerBig);
+            EXPECT_STREQ(expectedBig.GetString(), sb.GetString());
+        }
+    }
+
+    // Transcoding and decimal places
+    GenericStringBuffer<UTF16<> > expected16;
+    Writer<GenericStringBuffer<UTF16<> >, UTF8<>, UTF16<> > writer16(expected16);
+    writer16.SetMaxDecimalPlaces(3);
+    d.Accept(writer16);
+    GenericStringBuffer<UTF16<> > sb16;
+    ParallelWriter<UTF8<>, UTF16<> > pw16(4, 8);
+    pw16.SetMaxDecimalPlaces(3);
+    EXPECT_TRUE(pw16.Write(sb16, d));
+    EXPECT_TRUE(std::basic_string<UTF16<>::Ch>(expected16.GetString()) == sb16.GetString());
+}
+
+TEST(ParallelWriter, Failure) {
+    Document d;
+    MakeDocument(d);
+    d["big"][150]["ratio"].SetDouble(std::numeric_limits<double>::quiet_NaN());
+
+    StringBuffer sb;
+    ParallelWriter<> pw(4, 4);
+    EXPECT_FALSE(pw.Write(sb, d));
+    EXPECT_EQ(0u, sb.GetSize());
+
+    ParallelWriter<UTF8<>, UTF8<>, CrtAllocator, kWriteNanAndInfFlag> pwNan(4, 4);
+    EXPECT_TRUE(pwNan.Write(sb, d));
+    EXPECT_TRUE(strstr(sb.GetString(), "\"ratio\":NaN") != 0);
+}
+
+#endif // RAPIDJSON_HAS_CXX11_RVALUE_REFS
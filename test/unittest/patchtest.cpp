@@ -0,0 +1,135 @@
+// Tencent is pleased to support the open source community by making RapidJSON available.
+// 
+// Copyright (C) 2015 THL A29 Limited, a Tencent company, and Milo Yip. All rights reserved.
+//
+// Licensed under the MIT License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// http://opensource.org/licenses/MIT
+//
+// Unless required by applicable law or agreed to in writing, software distributed 
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR 
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the 
+// specific language governing permissions and limitations under the License.
+
+#include "unittest.h"
+#include "rapidjson/patch.h"
+
+using namespace rapidjson;
+
+static void TestPatch(const char* json, const char* patchJson, const char* expected, PatchErrorCode code = kPatchErrorNone, SizeType operation = 0) {
+    for (int move = 0; move < 2; move++) {
+        Document d;
+        d.Parse(json);
+        ASSERT_FALSE(d.HasParseError());
+        Document patch(&d.GetAllocator());  // Moved values must be in the allocator of d
+        patch.Parse(patchJson);
+        ASSERT_FALSE(patch.HasParseError());
+        PatchApplier applier;
+        bool result = move ? applier.ApplyMove(d, patch) : applier.Apply(d, patch);
+        EXPECT_EQ(code == kPatchErrorNone, result) << patchJson;
+        EXPECT_EQ(code, applier.GetErrorCode()) << patchJson;
+        if (code != kPatchErrorNone)
+            EXPECT_EQ(operation, applier.GetErrorOperation()) << patchJson;
+        else {
+            Document e;
+            e.Parse(expected);
+            EXPECT_TRUE(d == e) << patchJson;
+        }
+    }
+}
+
+// Examples of RFC 6902 Appendix A
+TEST(Patch, Examples) {
+    TestPatch("{\"foo\":\"bar\"}", "[{\"op\":\"add\",\"path\":\"/baz\",\"value\":\"qux\"}]", "{\"baz\":\"qux\",\"foo\":\"bar\"}");
+    TestPatch("{\"foo\":[\"bar\",\"baz\"]}", "[{\"op\":\"add\",\"path\":\"/foo/1\",\"value\":\"qux\"}]", "{\"foo\":[\"bar\",\"qux\",\"baz\"]}");
+    TestPatch("{\"baz\":\"qux\",\"foo\":\"bar\"}", "[{\"op\":\"remove\",\"path\":\"/baz\"}]", "{\"foo\":\"bar\"}");
+    TestPatch("{\"foo\":[\"bar\",\"qux\",\"baz\"]}", "[{\"op\":\"remove\",\"path\":\"/foo/1\"}]", "{\"foo\":[\"bar\",\"baz\"]}");
+    TestPatch("{\"baz\":\"qux\",\"foo\":\"bar\"}", "[{\"op\":\"replace\",\"path\":\"/baz\",\"value\":\"boo\"}]", "{\"baz\":\"boo\",\"foo\":\"bar\"}");
+    TestPatch("{\"foo\":{\"bar\":\"baz\",\"waldo\":\"fred\"},\"qux\":{\"corge\":\"grault\"}}",
+        "[{\"op\":\"move\",\"from\":\"/foo/waldo\",\"path\":\"/qux/thud\"}]",
+        "{\"foo\":{\"bar\":\"baz\"},\"qux\":{\"corge\":\"grault\",\"thud\":\"fred\"}}");
+    TestPatch("{\"foo\":[\"all\",\"grass\",\"cows\",\"eat\"]}", "[{\"op\":\"move\",\"from\":\"/foo/1\",\"path\":\"/foo/3\"}]", "{\"foo\":[\"all\",\"cows\",\"eat\",\"grass\"]}");
+    TestPatch("{\"baz\":\"qux\",\"foo\":[\"a\",2,\"c\"]}",
+        "[{\"op\":\"test\",\"path\":\"/baz\",\"value\":\"qux\"},{\"op\":\"test\",\"path\":\"/foo/1\",\"value\":2}]",
+        "{\"baz\":\"qux\",\"foo\":[\"a\",2,\"c\"]}");
+    TestPatch("{\"baz\":\"qux\"}", "[{\"op\":\"test\",\"path\":\"/baz\",\"value\":\"bar\"}]", 0, kPatchErrorTestFailed);
+    TestPatch("{\"foo\":\"bar\"}", "[{\"op\":\"add\",\"path\":\"/child\",\"value\":{\"grandchild\":{}}}]", "{\"foo\":\"bar\",\"child\":{\"grandchild\":{}}}");
+    TestPatch("{\"foo\":\"bar\"}", "[{\"op\":\"add\",\"path\":\"/baz\",\"value\":\"qux\",\"xyz\":123}]", "{\"foo\":\"bar\",\"baz\":\"qux\"}");
+    TestPatch("{\"foo\":\"bar\"}", "[{\"op\":\"add\",\"path\":\"/baz/bat\",\"value\":\"qux\"}]", 0, kPatchErrorPathNotFound);
+    TestPatch("{\"/\":9,\"~1\":10}", "[{\"op\":\"test\",\"path\":\"/~01\",\"value\":10}]", "{\"/\":9,\"~1\":10}");
+    TestPatch("{\"/\":9,\"~1\":10}", "[{\"op\":\"test\",\"path\":\"/~01\",\"value\":\"10\"}]", 0, kPatchErrorTestFailed);
+    TestPatch("{\"foo\":[\"bar\"]}", "[{\"op\":\"add\",\"path\":\"/foo/-\",\"value\":[\"abc\",\"def\"]}]", "{\"foo\":[\"bar\",[\"abc\",\"def\"]]}");
+}
+
+TEST(Patch, Operations) {
+    // Root
+    TestPatch("{\"a\":1}", "[{\"op\":\"replace\",\"path\":\"\",\"value\":[1]},{\"op\":\"add\",\"path\":\"/0\",\"value\":0}]", "[0,1]");
+    TestPatch("{\"a\":1}", "[{\"op\":\"add\",\"path\":\"\",\"value\":2}]", "2");
+    TestPatch("{\"a\":{\"b\":1}}", "[{\"op\":\"move\",\"from\":\"/a\",\"path\":\"\"}]", "{\"b\":1}");
+
+    // Copy, move onto itself, and move out of a parent
+    TestPatch("{\"a\":{\"b\":[1]}}", "[{\"op\":\"copy\",\"from\":\"/a\",\"path\":\"/a/b/0\"},{\"op\":\"test\",\"path\":\"/a/b/0/b/0\",\"value\":1}]", "{\"a\":{\"b\":[{\"b\":[1]},1]}}");
+    TestPatch("{\"a\":{\"b\":1}}", "[{\"op\":\"move\",\"from\":\"/a\",\"path\":\"/a\"}]", "{\"a\":{\"b\":1}}");
+    TestPatch("{\"a\":{\"b\":{\"c\":1}}}", "[{\"op\":\"move\",\"from\":\"/a/b\",\"path\":\"/a\"}]", "{\"a\":{\"c\":1}}");
+
+    // Shared prefixes across operations which modify the containers on the prefix
+    TestPatch("{\"a\":{\"x\":[{\"v\":0}]}}",
+        "[{\"op\":\"add\",\"path\":\"/a/x/-\",\"value\":{\"v\":1}},{\"op\":\"add\",\"path\":\"/a/x/-\",\"value\":{\"v\":2}},{\"op\":\"add\",\"path\":\"/a/x/-\",\"value\":{\"v\":3}},"
+        "{\"op\":\"replace\",\"path\":\"/a/x/0/v\",\"value\":4},{\"op\":\"add\",\"path\":\"/a/x/0\",\"value\":{\"v\":5}},{\"op\":\"replace\",\"path\":\"/a/x/0/v\",\"value\":6},"
+        "{\"op\":\"remove\",\"path\":\"/a/x/1\"},{\"op\":\"add\",\"path\":\"/a/y\",\"value\":7},{\"op\":\"remove\",\"path\":\"/a/x/3/v\"},{\"op\":\"add\",\"path\":\"/a/x/3/w\",\"value\":8}]",
+        "{\"a\":{\"x\":[{\"v\":6},{\"v\":1},{\"v\":2},{\"w\":8}],\"y\":7}}");
+    TestPatch("{\"a\":{\"b\":1,\"c\":{\"d\":2}}}",
+        "[{\"op\":\"test\",\"path\":\"/a/c/d\",\"value\":2},{\"op\":\"replace\",\"path\":\"/a\",\"value\":{\"c\":{\"d\":3}}},{\"op\":\"test\",\"path\":\"/a/c/d\",\"value\":3},{\"op\":\"test\",\"path\":\"#/a/c/d\",\"value\":3}]",
+        "{\"a\":{\"c\":{\"d\":3}}}");
+}
+
+TEST(Patch, Error) {
+    TestPatch("{}", "{}", 0, kPatchErrorInvalidPatch);
+    TestPatch("{}", "[1]", 0, kPatchErrorInvalidOperation);
+    TestPatch("{}", "[{\"op\":\"test\",\"path\":\"\",\"value\":{}},{\"op\":\"add\",\"value\":1}]", 0, kPatchErrorInvalidOperation, 1);
+    TestPatch("{}", "[{\"op\":\"add\",\"path\":\"/a\"}]", 0, kPatchErrorInvalidOperation);
+    TestPatch("{}", "[{\"op\":\"unknown\",\"path\":\"/a\",\"value\":1}]", 0, kPatchErrorInvalidOperation);
+    TestPatch("{}", "[{\"op\":\"add\",\"path\":\"a\",\"value\":1}]", 0, kPatchErrorInvalidOperation);
+    TestPatch("{}", "[{\"op\":\"move\",\"path\":\"/a\"}]", 0, kPatchErrorInvalidOperation);
+    TestPatch("{}", "[{\"op\":\"remove\",\"path\":\"\"}]", 0, kPatchErrorInvalidOperation);
+    TestPatch("{\"a\":[]}", "[{\"op\":\"add\",\"path\":\"/a/1\",\"value\":1}]", 0, kPatchErrorPathNotFound);
+    TestPatch("{\"a\":[]}", "[{\"op\":\"remove\",\"path\":\"/a/0\"}]", 0, kPatchErrorPathNotFound);
+    TestPatch("{\"a\":[]}", "[{\"op\":\"replace\",\"path\":\"/b\",\"value\":1}]", 0, kPatchErrorPathNotFound);
+    TestPatch("{\"a\":1}", "[{\"op\":\"copy\",\"from\":\"/b\",\"path\":\"/c\"}]", 0, kPatchErrorPathNotFound);
+    TestPatch("{\"a\":{}}", "[{\"op\":\"move\",\"from\":\"/a\",\"path\":\"/a/b\"}]", 0, kPatchErrorMoveIntoChild);
+}
+
+TEST(Patch, MoveValues) {
+    Document d;
+    d.Parse("{\"a\":[]}");
+    const char* json = "[{\"op\":\"add\",\"path\":\"/a/-\",\"value\":{\"b\":\"a long string which is not stored inline\"}}]";
+    PatchApplier applier;
+
+    // Copied by default, the patch can be destroyed
+    {
+        Document patch;
+        patch.Parse(json);
+        EXPECT_TRUE(applier.Apply(d, patch));
+        EXPECT_FALSE(patch[0]["value"].IsNull());
+    }
+    EXPECT_STREQ("a long string which is not stored inline", d["a"][0]["b"].GetString());
+
+    // Moved from a patch in the allocator of the document
+    Document patch(&d.GetAllocator());
+    patch.Parse(json);
+    EXPECT_TRUE(applier.ApplyMove(d, patch));
+    EXPECT_TRUE(patch[0]["value"].IsNull());
+    EXPECT_STREQ("a long string which is not stored inline", d["a"][1]["b"].GetString());
+
+    // Copied from a const patch sharing a subtree, which is not copied into the patch
+    Document source;
+    source.Parse(json);
+    SharedValue shared(source);
+    Document sharedPatch;
+    sharedPatch.Attach(sharedPatch, shared);
+    size_t size = sharedPatch.GetAllocator().Size();
+    EXPECT_TRUE(applier.Apply(d, static_cast<const Value&>(sharedPatch), d.GetAllocator()));
+    EXPECT_EQ(size, sharedPatch.GetAllocator().Size());
+    EXPECT_STREQ("a long string which is not stored inline", d["a"][2]["b"].GetString());
+}
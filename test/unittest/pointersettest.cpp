@@ -0,0 +1,186 @@
+// Tencent is pleased to support the open source community by making RapidJSON available.
+// 
+// Copyright (C) 2015 THL A29 Limited, a Tencent company, and Milo Yip. All rights reserved.
+//
+// Licensed under the MIT License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// http://opensource.org/licenses/MIT
+//
+// Unless required by applicable law or agreed to in writing, software distributed 
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR 
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the 
+// specific language governing permissions and limitations under the License.
+
+#include "unittest.h"
+#include "rapidjson/pointerset.h"
+
+using namespace rapidjson;
+
+static const char kJson[] = "{\n"
+"    \"foo\":[\"bar\", \"baz\"],\n"
+"    \"\" : 0,\n"
+"    \"a/b\" : 1,\n"
+"    \"obj\" : { \"x\": { \"y\": 2 }, \"z\": 3 },\n"
+"    \"m~n\" : 8\n"
+"}";
+
+TEST(PointerSet, Empty) {
+    PointerSet set;
+    EXPECT_EQ(0u, set.GetPointerCount());
+    Document d;
+    d.Parse(kJson);
+    EXPECT_EQ(0u, set.Get(d, static_cast<Value**>(0)));
+}
+
+TEST(PointerSet, Get) {
+    const char* sources[] = { "", "/foo", "/foo/0", "/foo/1", "/foo/2", "/foo/-", "/", "/a~1b", "/obj/x/y", "/obj/z", "/obj/w", "/m~0n", "/obj/x/y/0" };
+    const size_t count = sizeof(sources) / sizeof(sources[0]);
+
+    PointerSet set;
+    SizeType ids[count];
+    for (size_t i = 0; i < count; i++)
+        ids[i] = set.Add(Pointer(sources[i]));
+    EXPECT_EQ(count, set.GetPointerCount());
+    EXPECT_EQ(ids[8], set.Add(Pointer("/obj/x/y"))); // Same pointer, same identifier
+    EXPECT_EQ(count, set.GetPointerCount());
+
+    Document d;
+    d.Parse(kJson);
+    EXPECT_FALSE(d.HasParseError());
+
+    // Twice for the member index hints
+    for (int trial = 0; trial < 2; trial++) {
+        Value* values[count];
+        SizeType resolved = set.Get(d, values);
+        SizeType expected = 0;
+        for (size_t i = 0; i < count; i++) {
+            EXPECT_EQ(Pointer(sources[i]).Get(d), values[ids[i]]);
+            if (values[ids[i]])
+                expected++;
+        }
+        EXPECT_EQ(9u, resolved);
+        EXPECT_EQ(expected, resolved);
+    }
+
+    // Document of another shape
+    Document d2;
+    d2.Parse("{\"obj\":{\"z\":4,\"w\":5,\"x\":[{\"y\":6}]},\"foo\":{\"0\":7}}");
+    const Value* values[count];
+    set.Get(static_cast<const Value&>(d2), values);
+    for (size_t i = 0; i < count; i++)
+        EXPECT_EQ(Pointer(sources[i]).Get(d2), values[ids[i]]);
+    EXPECT_EQ(4, values[ids[9]]->GetInt());
+    EXPECT_EQ(5, values[ids[10]]->GetInt());
+    EXPECT_EQ(7, values[ids[2]]->GetInt());
+    EXPECT_TRUE(values[ids[8]] == 0);
+
+    // Const access reads a shared subtree without copying it
+    SharedValue shared(d2);
+    Document d3;
+    d3.Attach(d3, shared);
+    size_t size = d3.GetAllocator().Size();
+    EXPECT_EQ(5u, set.Get(static_cast<const Value&>(d3), values));
+    EXPECT_EQ(&shared.Get()["obj"]["z"], values[ids[9]]);
+    EXPECT_EQ(size, d3.GetAllocator().Size());
+}
+
+TEST(PointerSet, ManyPointers) {
+    Document d;
+    d.SetObject();
+    PointerSet set;
+    for (int i = 0; i < 100; i++) {
+        char name[16];
+        sprintf(name, "k%d", i);
+        Value v(kObjectType);
+        v.AddMember("v", i, d.GetAllocator());
+        d.AddMember(Value(name, d.GetAllocator()).Move(), v, d.GetAllocator());
+        char source[32];
+        sprintf(source, "/k%d/v", 99 - i);
+        EXPECT_EQ(static_cast<SizeType>(i), set.Add(Pointer(source)));
+    }
+
+    Value* values[100];
+    EXPECT_EQ(100u, set.Get(d, values));
+    for (int i = 0; i < 100; i++)
+        EXPECT_EQ(99 - i, values[i]->GetInt());
+}
+
+TEST(PointerExtractor, Extract) {
+    const char* sources[] = { "/foo", "/foo/1", "/obj/x", "/obj/x/y", "/obj/z", "/a~1b", "/obj/w", "/foo/2", "/m~0n/0" };
+    const size_t count = sizeof(sources) / sizeof(sources[0]);
+
+    PointerSet set;
+    SizeType ids[count];
+    for (size_t i = 0; i < count; i++)
+        ids[i] = set.Add(Pointer(sources[i]));
+
+    Document d;
+    d.Parse(kJson);
+    Document result;
+    PointerExtractor extractor(set, result.GetAllocator());
+    Reader reader;
+    StringStream s(kJson);
+    reader.Parse(s, extractor);
+    EXPECT_TRUE(extractor.IsDone());
+    for (size_t i = 0; i < count; i++) {
+        const Value* expected = Pointer(sources[i]).Get(d);
+        const Value* actual = extractor.GetValue(ids[i]);
+        if (expected) {
+            ASSERT_TRUE(actual != 0);
+            EXPECT_TRUE(*expected == *actual);
+        }
+        else
+            EXPECT_TRUE(actual == 0);
+    }
+    EXPECT_EQ(extractor.GetValue(ids[0])->Begin() + 1, extractor.GetValue(ids[1]));
+
+    // Reuse
+    extractor.Reset();
+    EXPECT_FALSE(extractor.IsDone());
+    EXPECT_TRUE(extractor.GetValue(ids[0]) == 0);
+    StringStream s2("{\"foo\":[1,[2]],\"a/b\":{}}");
+    EXPECT_FALSE(reader.Parse(s2, extractor).IsError());
+    EXPECT_TRUE(extractor.IsDone());
+    EXPECT_EQ(1u, extractor.GetValue(ids[1])->Size());
+    EXPECT_TRUE(extractor.GetValue(ids[5])->IsObject());
+    EXPECT_TRUE(extractor.GetValue(ids[2]) == 0);
+}
+
+TEST(PointerExtractor, EarlyStop) {
+    PointerSet set;
+    SizeType a = set.Add(Pointer("/a/1"));
+    SizeType b = set.Add(Pointer("/b"));
+    Document result;
+    PointerExtractor extractor(set, result.GetAllocator());
+    Reader reader;
+
+    // Stops after /b without reading the invalid remainder.
+    const char json[] = "{\"x\":{\"b\":0,\"a\":[0]},\"a\":[true,{\"c\":[null,\"s\"]},3],\"b\":\"t\",\"c\":invalid";
+    StringStream s(json);
+    ParseResult r = reader.Parse(s, extractor);
+    EXPECT_EQ(kParseErrorTermination, r.Code());
+    EXPECT_TRUE(extractor.IsDone());
+    EXPECT_TRUE(*extractor.GetValue(a) == Document().Parse("{\"c\":[null,\"s\"]}"));
+    EXPECT_STREQ("t", extractor.GetValue(b)->GetString());
+
+    // A scalar root cannot contain any pointer.
+    extractor.Reset();
+    StringStream s2("1");
+    EXPECT_FALSE(reader.Parse(s2, extractor).IsError());
+    EXPECT_TRUE(extractor.IsDone());
+    EXPECT_TRUE(extractor.GetValue(a) == 0);
+
+    // Duplicated names extract the first one.
+    extractor.Reset();
+    StringStream s3("{\"b\":1,\"b\":2,\"a\":[]}");
+    EXPECT_EQ(kParseErrorTermination, reader.Parse(s3, extractor).Code());
+    EXPECT_EQ(1, extractor.GetValue(b)->GetInt());
+
+    // An empty set stops immediately.
+    PointerSet empty;
+    PointerExtractor emptyExtractor(empty, result.GetAllocator());
+    EXPECT_TRUE(emptyExtractor.IsDone());
+    StringStream s4("[1");
+    EXPECT_EQ(kParseErrorTermination, reader.Parse(s4, emptyExtractor).Code());
+}
@@ -638,6 +638,27 @@ TEST(Pointer, Get) {
     EXPECT_EQ(2, unresolvedTokenIndex);
 }
 
+TEST(Pointer, Get_SharedValue) {
+    Document source;
+    source.Parse(kJson);
+    SharedValue shared(source);
+    Document d;
+    d.Attach(d, shared);
+
+    // Const access reads the shared subtree without copying it
+    const Document& c = d;
+    size_t size = d.GetAllocator().Size();
+    EXPECT_EQ(&shared.Get()["foo"][1], Pointer("/foo/1").Get(c));
+    EXPECT_EQ(&shared.Get()["m~n"], PointerView("/m~0n").Get(c));
+    EXPECT_EQ(&shared.Get()["a/b"], PointerView("/a~1b").Get(c));
+    EXPECT_EQ(size, d.GetAllocator().Size());
+
+    // Non-const access copies the path
+    EXPECT_NE(&shared.Get()["foo"][1], Pointer("/foo/1").Get(d));
+    EXPECT_STREQ("baz", Pointer("/foo/1").Get(d)->GetString());
+    EXPECT_LT(size, d.GetAllocator().Size());
+}
+
 TEST(Pointer, GetWithDefault) {
     Document d;
     d.Parse(kJson);
@@ -1522,3 +1543,44 @@ TEST(Pointer, Issue483) {
     value.SetString(mystr.c_str(), static_cast<SizeType>(mystr.length()), document.GetAllocator());
     myjson::Pointer(path.c_str()).Set(document, value, document.GetAllocator());
 }
+
+TEST(Pointer, View) {
+    const char* sources[] = {
+        "", "/", "/foo", "/foo/0", "/foo/1", "/foo/2", "/foo/-", "/foo/01", "/a~1b", "/m~0n", "/c%d", "/ ", "/~", "/~2", "/~01", " ",
+        "#", "#/", "#/foo/0", "#/a~1b", "#/m~0n", "#/c%25d", "#/e%5Ef", "#/g%7Ch", "#/i%5Cj", "#/k%22l", "#/%20", "#/%7E0n", "#/%66oo/%30",
+        "#/%", "#/%0g", "#/%C2", "#/~", "#/~2", "#/ ", "# ", "/4294967296", "/01"
+    };
+
+    Document d;
+    d.Parse(kJson);
+    for (size_t i = 0; i < sizeof(sources) / sizeof(sources[0]); i++) {
+        Pointer p(sources[i]);
+        PointerView v(sources[i]);
+        EXPECT_EQ(p.IsValid(), v.IsValid()) << sources[i];
+        EXPECT_EQ(p.GetParseErrorCode(), v.GetParseErrorCode()) << sources[i];
+        EXPECT_EQ(p.GetParseErrorOffset(), v.GetParseErrorOffset()) << sources[i];
+        if (p.IsValid()) {
+            size_t pIndex = 0, vIndex = 0;
+            EXPECT_EQ(p.Get(d, &pIndex), v.Get(d, &vIndex)) << sources[i];
+            EXPECT_EQ(pIndex, vIndex) << sources[i];
+        }
+    }
+
+    // Create with escaped names, including one longer than the internal buffer.
+    std::string longName(100, 'x');
+    std::string longSource = "/" + longName + "~1/%7E";
+    Document d2;
+    d2.SetObject();
+    bool exist = true;
+    PointerView("/a~1b/~0/0/1").Create(d2, &exist);
+    EXPECT_FALSE(exist);
+    PointerView(longSource).Set(d2, 1);
+    PointerView("#/%C2%A2").Set(d2, "cent");
+    EXPECT_TRUE(Pointer("/a~1b/~0/0/1").Get(d2)->IsNull());
+    EXPECT_EQ(1, d2[(longName + "/").c_str()]["%7E"].GetInt());
+    EXPECT_STREQ("cent", d2["\xC2\xA2"].GetString());
+    PointerView("/a~1b/~0/0/1").Create(d2, &exist);
+    EXPECT_TRUE(exist);
+    PointerView("/a~1b/~0/-").Set(d2, 2);
+    EXPECT_EQ(2, d2["a/b"]["~"][1].GetInt());
+}
@@ -302,6 +302,19 @@ TEST(PrettyWriter, Inf) {
     EXPECT_STREQ("Infinity-Infinity", buffer.GetString());
 }
 
+TEST(PrettyWriter, PreEscapedKey) {
+    StringBuffer buffer;
+    PrettyWriter<StringBuffer> writer(buffer);
+    writer.StartObject();
+    writer.Key(RAPIDJSON_PREESCAPED_KEY("hello"));
+    writer.String("world");
+    writer.Key(RAPIDJSON_PREESCAPED_KEY("a"));
+    writer.StartArray();
+    writer.EndArray();
+    writer.EndObject();
+    EXPECT_STREQ("{\n    \"hello\": \"world\",\n    \"a\": []\n}", buffer.GetString());
+}
+
 TEST(PrettyWriter, Issue_889) {
     char buf[100] = "Hello";
     
@@ -199,6 +199,30 @@ TEST(SchemaValidator, Enum_InvalidType) {
     INVALIDATE(s, "null", "", "type", "");
 }
 
+TEST(SchemaValidator, Enum_Large) {
+    std::string json = "{ \"enum\": [";
+    for (int i = 0; i < 1000; i++) {
+        char buffer[32];
+        sprintf(buffer, "\"%d\",%d,", i, i * 2);
+        json += buffer;
+    }
+    json += "null, 0.5, [1], {\"a\":1}] }";
+    Document sd;
+    sd.Parse(json.c_str());
+    ASSERT_FALSE(sd.HasParseError());
+    SchemaDocument s(sd);
+
+    VALIDATE(s, "\"999\"", true);
+    VALIDATE(s, "1998", true);
+    VALIDATE(s, "null", true);
+    VALIDATE(s, "0.5", true);
+    VALIDATE(s, "[1]", true);
+    VALIDATE(s, "{\"a\":1}", true);
+    INVALIDATE(s, "\"1000\"", "", "enum", "");
+    INVALIDATE(s, "1999", "", "enum", "");
+    INVALIDATE(s, "[2]", "", "enum", "");
+}
+
 TEST(SchemaValidator, AllOf) {
     {
         Document sd;
@@ -239,6 +263,61 @@ TEST(SchemaValidator, OneOf) {
     INVALIDATE(s, "15", "", "oneOf", "");
 }
 
+TEST(SchemaValidator, OneOf_TypePruning) {
+    Document sd;
+    sd.Parse("{\"oneOf\": [{ \"type\": \"string\" }, { \"type\": \"integer\" }, { \"type\": \"object\", \"required\": [\"a\"] } ] }");
+    SchemaDocument s(sd);
+
+    VALIDATE(s, "\"s\"", true);
+    VALIDATE(s, "1", true);
+    VALIDATE(s, "{ \"a\": 1 }", true);
+    INVALIDATE(s, "1.5", "", "oneOf", "");
+    INVALIDATE(s, "[1, 2]", "", "oneOf", "");
+    INVALIDATE(s, "{ \"b\": 1 }", "", "oneOf", "");
+}
+
+TEST(SchemaValidator, OneOf_Discriminator) {
+    Document sd;
+    sd.Parse(
+        "{"
+        "    \"oneOf\": ["
+        "        { \"properties\": { \"kind\": { \"enum\": [\"circle\"] }, \"radius\": { \"type\": \"number\" } }, \"required\": [\"kind\", \"radius\"] },"
+        "        { \"properties\": { \"kind\": { \"enum\": [\"square\"] }, \"side\": { \"type\": \"number\" } }, \"required\": [\"kind\", \"side\"] },"
+        "        { \"properties\": { \"kind\": { \"enum\": [\"rect\", 42] }, \"size\": { \"type\": \"array\" } }, \"required\": [\"kind\"] }"
+        "    ]"
+        "}");
+    SchemaDocument s(sd);
+
+    VALIDATE(s, "{ \"kind\": \"circle\", \"radius\": 1 }", true);
+    VALIDATE(s, "{ \"side\": 2, \"kind\": \"square\" }", true);
+    VALIDATE(s, "{ \"kind\": \"rect\", \"size\": [1, 2] }", true);
+    VALIDATE(s, "{ \"kind\": 42 }", true);
+    VALIDATE(s, "{ \"kind\": \"rect\", \"extra\": { \"kind\": \"circle\" } }", true);
+    INVALIDATE(s, "{ \"kind\": \"circle\", \"side\": 1 }", "", "oneOf", "");
+    INVALIDATE(s, "{ \"kind\": \"triangle\" }", "", "oneOf", "");
+    INVALIDATE(s, "{ \"kind\": { \"name\": \"circle\" } }", "", "oneOf", "");
+}
+
+TEST(SchemaValidator, AnyOf_Discriminator) {
+    Document sd;
+    sd.Parse(
+        "{"
+        "    \"definitions\": {"
+        "        \"a\": { \"properties\": { \"t\": { \"enum\": [1] }, \"v\": { \"type\": \"string\" } } },"
+        "        \"b\": { \"properties\": { \"t\": { \"enum\": [1, 2] }, \"v\": { \"type\": \"integer\" } } }"
+        "    },"
+        "    \"anyOf\": [ { \"$ref\": \"#/definitions/a\" }, { \"$ref\": \"#/definitions/b\" } ]"
+        "}");
+    SchemaDocument s(sd);
+
+    VALIDATE(s, "{ \"t\": 1, \"v\": \"x\" }", true);
+    VALIDATE(s, "{ \"t\": 1, \"v\": 1 }", true);
+    VALIDATE(s, "{ \"t\": 2.0, \"v\": 1 }", true);
+    VALIDATE(s, "{ \"v\": 1 }", true);
+    INVALIDATE(s, "{ \"t\": 2, \"v\": \"x\" }", "", "anyOf", "");
+    INVALIDATE(s, "{ \"t\": 3, \"v\": 1 }", "", "anyOf", "");
+}
+
 TEST(SchemaValidator, Not) {
     Document sd;
     sd.Parse("{\"not\":{ \"type\": \"string\"}}");
@@ -869,6 +948,50 @@ TEST(SchemaValidator, Array_UniqueItems) {
     VALIDATE(s, "[]", true);
 }
 
+TEST(SchemaValidator, Array_UniqueItemsLarge) {
+    Document sd;
+    sd.Parse("{\"type\": \"array\", \"uniqueItems\": true}");
+    SchemaDocument s(sd);
+
+    std::string json = "[";
+    for (int i = 0; i < 1000; i++) {
+        char buffer[32];
+        sprintf(buffer, "%d,{\"id\":%d},", i, i);
+        json += buffer;
+    }
+    VALIDATE(s, (json + "[]]").c_str(), true);
+    INVALIDATE(s, (json + "{\"id\":999}]").c_str(), "", "uniqueItems", "/2000");
+    INVALIDATE(s, (json + "0]").c_str(), "", "uniqueItems", "/2000");
+}
+
+TEST(SchemaValidator, StatePool) {
+    Document sd;
+    sd.Parse("{\"type\": \"array\", \"uniqueItems\": true}");
+    SchemaDocument s(sd);
+    SchemaValidator validator(s);
+
+    // Blocks are reused within their power-of-two size class
+    void* p = validator.MallocState(17);
+    validator.FreeState(p);
+    EXPECT_EQ(p, validator.MallocState(32));
+    void* q = validator.MallocState(33);
+    EXPECT_NE(p, q);
+    validator.FreeState(p);
+    validator.FreeState(q);
+    void* large = validator.MallocState(1000000);
+    validator.FreeState(large);
+    EXPECT_EQ(large, validator.MallocState(1 << 20));
+    validator.FreeState(large);
+
+    // The slots of the uniqueItems sets come from the pool, and are reused after Reset()
+    Document d;
+    d.Parse("[0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,16,17,18,19,20,21,22,23,24,25,26,27,28,29,30,31,32]");
+    for (int i = 0; i < 2; i++) {
+        EXPECT_TRUE(d.Accept(validator));
+        validator.Reset();
+    }
+}
+
 TEST(SchemaValidator, Boolean) {
     Document sd;
     sd.Parse("{\"type\":\"boolean\"}");
@@ -1224,6 +1347,96 @@ TEST(SchemaValidator, TestSuite) {
     //     ADD_FAILURE();
 }
 
+TEST(SchemaValidator, Image) {
+    const char* filenames[] = {
+        "additionalItems.json",
+        "additionalProperties.json",
+        "allOf.json",
+        "anyOf.json",
+        "definitions.json",
+        "dependencies.json",
+        "enum.json",
+        "items.json",
+        "maximum.json",
+        "minimum.json",
+        "multipleOf.json",
+        "not.json",
+        "oneOf.json",
+        "pattern.json",
+        "patternProperties.json",
+        "properties.json",
+        "ref.json",
+        "required.json",
+        "type.json",
+        "uniqueItems.json"
+    };
+
+    CrtAllocator allocator;
+    unsigned testCount = 0;
+    for (size_t i = 0; i < sizeof(filenames) / sizeof(filenames[0]); i++) {
+        char filename[FILENAME_MAX];
+        sprintf(filename, "jsonschema/tests/draft4/%s", filenames[i]);
+        char* json = ReadFile(filename, allocator);
+        ASSERT_TRUE(json != 0);
+        Document d;
+        d.Parse(json);
+        ASSERT_FALSE(d.HasParseError());
+        for (Value::ConstValueIterator schemaItr = d.Begin(); schemaItr != d.End(); ++schemaItr) {
+            SchemaDocument schema((*schemaItr)["schema"]);
+            StringBuffer image;
+            ASSERT_TRUE(schema.Serialize(image));
+
+            SchemaDocument loaded(image.GetString(), image.GetSize());
+            ASSERT_FALSE(loaded.HasImageError());
+            StringBuffer image2;
+            ASSERT_TRUE(loaded.Serialize(image2));
+            EXPECT_EQ(image.GetSize(), image2.GetSize());
+            EXPECT_EQ(0, memcmp(image.GetString(), image2.GetString(), image.GetSize()));
+
+            const Value& tests = (*schemaItr)["tests"];
+            for (Value::ConstValueIterator testItr = tests.Begin(); testItr != tests.End(); ++testItr) {
+                SchemaValidator validator(schema), loadedValidator(loaded);
+                bool valid = (*testItr)["data"].Accept(validator);
+                EXPECT_EQ(valid, (*testItr)["data"].Accept(loadedValidator));
+                if (!valid) {
+                    EXPECT_TRUE(validator.GetInvalidSchemaPointer() == loadedValidator.GetInvalidSchemaPointer());
+                    EXPECT_STREQ(validator.GetInvalidSchemaKeyword(), loadedValidator.GetInvalidSchemaKeyword());
+                    EXPECT_TRUE(validator.GetInvalidDocumentPointer() == loadedValidator.GetInvalidDocumentPointer());
+                }
+                testCount++;
+            }
+        }
+        CrtAllocator::Free(json);
+    }
+    EXPECT_LT(0u, testCount);
+}
+
+TEST(SchemaValidator, Image_Invalid) {
+    Document sd;
+    sd.Parse("{\"properties\":{\"a\":{\"type\":\"string\",\"pattern\":\"^x\"}},\"required\":[\"a\"]}");
+    SchemaDocument s(sd);
+    StringBuffer image;
+    ASSERT_TRUE(s.Serialize(image));
+
+    // Every truncation is rejected and the root accepts everything.
+    for (size_t length = 0; length < image.GetSize(); length++) {
+        SchemaDocument loaded(image.GetString(), length);
+        EXPECT_TRUE(loaded.HasImageError());
+        VALIDATE(loaded, "{}", true);
+    }
+
+    SchemaDocument loaded(image.GetString(), image.GetSize());
+    EXPECT_FALSE(loaded.HasImageError());
+    VALIDATE(loaded, "{\"a\":\"xyz\"}", true);
+    INVALIDATE(loaded, "{\"a\":\"abc\"}", "/properties/a", "pattern", "/a");
+    INVALIDATE(loaded, "{}", "", "required", "");
+
+    std::string corrupted(image.GetString(), image.GetSize());
+    corrupted[0] = 'X';
+    EXPECT_TRUE(SchemaDocument(corrupted.data(), corrupted.size()).HasImageError());
+    EXPECT_TRUE(SchemaDocument(0, 0).HasImageError());
+}
+
 TEST(SchemaValidatingReader, Simple) {
     Document sd;
     sd.Parse("{ \"type\": \"string\", \"enum\" : [\"red\", \"amber\", \"green\"] }");
@@ -1257,6 +1470,34 @@ TEST(SchemaValidatingReader, Invalid) {
     EXPECT_TRUE(d.IsNull());
 }
 
+TEST(SchemaValidatingReader, Branches) {
+    Document sd;
+    sd.Parse("{\"properties\":{\"a\":{\"items\":{\"anyOf\":[{\"type\":\"string\"},{\"properties\":{\"b/c\":{\"minimum\":3}}}]}}}}");
+    SchemaDocument s(sd);
+
+    {
+        Document d;
+        StringStream ss("{\"a\":[\"x\",{\"b/c\":[4]},{\"b/c\":5}]}");
+        SchemaValidatingReader<kParseDefaultFlags, StringStream, UTF8<> > reader(ss, s);
+        d.Populate(reader);
+        EXPECT_TRUE(reader.GetParseResult());
+        EXPECT_TRUE(reader.IsValid());
+        Document expected;
+        expected.Parse("{\"a\":[\"x\",{\"b/c\":[4]},{\"b/c\":5}]}");
+        EXPECT_TRUE(d == expected);
+    }
+    {
+        Document d;
+        StringStream ss("{\"a\":[\"x\",{\"b/c\":[4]},{\"b/c\":1}]}");
+        SchemaValidatingReader<kParseDefaultFlags, StringStream, UTF8<> > reader(ss, s);
+        d.Populate(reader);
+        EXPECT_FALSE(reader.IsValid());
+        EXPECT_STREQ("anyOf", reader.GetInvalidSchemaKeyword());
+        EXPECT_TRUE(reader.GetInvalidSchemaPointer() == SchemaDocument::PointerType("/properties/a/items"));
+        EXPECT_TRUE(reader.GetInvalidDocumentPointer() == SchemaDocument::PointerType("/a/2"));
+    }
+}
+
 TEST(SchemaValidatingWriter, Simple) {
     Document sd;
     sd.Parse("{\"type\":\"string\",\"minLength\":2,\"maxLength\":3}");
@@ -0,0 +1,91 @@
+// Tencent is pleased to support the open source community by making RapidJSON available.
+//
+// Copyright (C) 2015 THL A29 Limited, a Tencent company, and Milo Yip. All rights reserved.
+//
+// Licensed under the MIT License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// http://opensource.org/licenses/MIT
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "unittest.h"
+#include "rapidjson/serializedsize.h"
+#include <limits>
+
+using namespace rapidjson;
+
+template <unsigned writeFlags>
+static void TestSize(const Value& v, int maxDecimalPlaces = Writer<StringBuffer>::kDefaultMaxDecimalPlaces) {
+    StringBuffer sb;
+    Writer<StringBuffer, UTF8<>, UTF8<>, CrtAllocator, writeFlags> writer(sb);
+    writer.SetMaxDecimalPlaces(maxDecimalPlaces);
+    bool ok = v.Accept(writer);
+
+    for (int cache = 0; cache < 2; cache++) {
+        GenericSerializedSize<Value, writeFlags> size(cache != 0);
+        size.SetMaxDecimalPlaces(maxDecimalPlaces);
+        EXPECT_EQ(ok ? sb.GetSize() : 0u, size.Get(v)) << sb.GetString();
+        EXPECT_EQ(ok ? sb.GetSize() : 0u, size.Get(v)) << sb.GetString();
+    }
+}
+
+static void TestSize(const char* json) {
+    Document d;
+    d.Parse<kParseNanAndInfFlag>(json);
+    ASSERT_FALSE(d.HasParseError()) << json;
+    TestSize<kWriteDefaultFlags>(d);
+    TestSize<kWriteNanAndInfFlag>(d);
+    TestSize<kWriteDefaultFlags>(d, 3);
+}
+
+TEST(SerializedSize, Values) {
+    TestSize("null");
+    TestSize("[true,false,null]");
+    TestSize("[0,-0,1,-1,9,10,-10,99,100,2147483647,-2147483648,4294967295,4294967296]");
+    TestSize("[9223372036854775807,-9223372036854775808,18446744073709551615,10000000000000000000]");
+    TestSize("[0.0,-0.0,1.5,-1.5,0.1,1e100,1e-100,123456.789e3,1.7976931348623157e308,5e-324,3.14159265358979]");
+    TestSize("[NaN,Infinity,-Infinity]");
+    TestSize("[\"\",\"abc\",\"\\\"\\\\\\/\\b\\f\\n\\r\\t\",\"\\u0000\\u0001\\u001f\\u007f\",\"\\u20AC\\uD834\\uDD1E\"]");
+    TestSize("\"A long string with an escape \\n in its second block and another at the end\\t\"");
+    TestSize("{\"\":{},\"a\\nb\":[],\"c\":{\"d\":[1,[2,{\"e\":\"f\"}]]}}");
+
+    Document d;
+    d.SetString("invalid \xfe utf-8");
+    TestSize<kWriteDefaultFlags>(d);
+    TestSize<kWriteValidateEncodingFlag>(d);
+}
+
+TEST(SerializedSize, Cache) {
+    Document d;
+    d.SetArray();
+    for (int i = 0; i < 100; i++) {
+        Value o(kObjectType);
+        for (int j = 0; j < 20; j++)
+            o.AddMember("key", i, d.GetAllocator());
+        d.PushBack(o, d.GetAllocator());
+    }
+
+    StringBuffer sb;
+    Writer<StringBuffer> writer(sb);
+    d.Accept(writer);
+
+    SerializedSize size(true);
+    EXPECT_EQ(sb.GetSize(), size.Get(d));
+    EXPECT_EQ(sb.GetSize(), size.Get(d));
+
+    // Subtrees are cached as well
+    StringBuffer sb0;
+    Writer<StringBuffer> writer0(sb0);
+    d[0].Accept(writer0);
+    EXPECT_EQ(sb0.GetSize(), size.Get(d[0]));
+
+    // Stale until cleared
+    d[0].RemoveMember(d[0].MemberBegin());
+    EXPECT_EQ(sb.GetSize(), size.Get(d));
+    size.Clear();
+    EXPECT_EQ(sb.GetSize() - 8, size.Get(d));
+}
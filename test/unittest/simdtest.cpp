@@ -24,6 +24,9 @@
 #elif defined(__ARM_NEON)
 #  define RAPIDJSON_NEON
 #endif
+#if defined(__AVX2__)
+#  define RAPIDJSON_AVX2
+#endif
 
 #define RAPIDJSON_NAMESPACE rapidjson_simd
 
@@ -214,6 +217,33 @@ TEST(SIMD, SIMD_SUFFIX(ScanWriteUnescapedString)) {
     }
 }
 
+TEST(SIMD, SIMD_SUFFIX(ScanWriteEscapedString)) {
+    // Dense escapes, including several within a block and in the final partial block
+    static const char alphabet[] = "ab\"\\\n\t\x01\x1F \x7F\xC3\xA9/";
+    char buffer[256 + 32];
+    unsigned seed = 1;
+    for (size_t i = 0; i < sizeof(buffer); i++) {
+        seed = seed * 1103515245u + 12345u;
+        buffer[i] = alphabet[(seed >> 16) % (sizeof(alphabet) - 1)];
+    }
+
+    for (size_t offset = 0; offset < 32; offset++) {
+        for (size_t length = 0; length <= 256; length++) {
+            StringBuffer sb;
+            Writer<StringBuffer> writer(sb);
+            writer.String(buffer + offset, SizeType(length));
+
+            // Writer with a different allocator does not use the SIMD specialization
+            typedef GenericStringBuffer<UTF8<>, MemoryPoolAllocator<> > ReferenceBuffer;
+            ReferenceBuffer rb;
+            Writer<ReferenceBuffer> reference(rb);
+            reference.String(buffer + offset, SizeType(length));
+
+            ASSERT_STREQ(rb.GetString(), sb.GetString()) << "offset " << offset << " length " << length;
+        }
+    }
+}
+
 #ifdef __GNUC__
 RAPIDJSON_DIAG_POP
 #endif
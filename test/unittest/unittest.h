@@ -132,4 +132,33 @@ private:
     unsigned mSeed;
 };
 
+// Helpers for the tests of readers and writers speaking the Handler concept.
+// Define UNITTEST_HANDLERS before including this file to get them, so that the other
+// tests still choose which RapidJSON headers they include, and in which namespace.
+#ifdef UNITTEST_HANDLERS
+
+#include "rapidjson/reader.h"
+#include "rapidjson/stringbuffer.h"
+#include "rapidjson/writer.h"
+#include <string>
+
+//! JSON text of a value, or of anything sending Handler events with Accept().
+/*! NaN and infinities are written, as some binary formats can hold them.
+*/
+template <typename ValueType>
+inline std::string Serialize(const ValueType& v) {
+    RAPIDJSON_NAMESPACE::StringBuffer sb;
+    RAPIDJSON_NAMESPACE::Writer<RAPIDJSON_NAMESPACE::StringBuffer, RAPIDJSON_NAMESPACE::UTF8<>, RAPIDJSON_NAMESPACE::UTF8<>,
+        RAPIDJSON_NAMESPACE::CrtAllocator, RAPIDJSON_NAMESPACE::kWriteNanAndInfFlag> writer(sb);
+    v.Accept(writer);
+    return sb.GetString();
+}
+
+//! Handler ending the parsing at the first unsigned integer, to test termination.
+struct StopAtUint : RAPIDJSON_NAMESPACE::BaseReaderHandler<RAPIDJSON_NAMESPACE::UTF8<>, StopAtUint> {
+    bool Uint(unsigned) { return false; }
+};
+
+#endif // UNITTEST_HANDLERS
+
 #endif // UNITTEST_H_
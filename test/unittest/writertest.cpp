@@ -538,6 +538,71 @@ TEST(Writer, RawValue) {
     EXPECT_STREQ("{\"a\":1,\"raw\":[\"Hello\\nWorld\", 123.456]}", buffer.GetString());
 }
 
+TEST(Writer, DirectOutput) {
+    // MemoryBuffer is written through the same direct path as StringBuffer
+    MemoryBuffer mb;
+    Writer<MemoryBuffer> writer(mb);
+    writer.StartArray();
+    writer.Int(-123);
+    writer.Uint(4294967295u);
+    writer.Int64(static_cast<int64_t>(RAPIDJSON_UINT64_C2(0x80000000, 0x00000000)));
+    writer.Uint64(RAPIDJSON_UINT64_C2(0xFFFFFFFF, 0xFFFFFFFF));
+    writer.Double(1.5);
+    writer.String("Hello\tWorld \"quoted\" \\ with a longer tail\x01");
+    writer.RawValue("{}", 2, kObjectType);
+    writer.EndArray();
+    EXPECT_TRUE(writer.IsComplete());
+    EXPECT_EQ("[-123,4294967295,-9223372036854775808,18446744073709551615,1.5,"
+              "\"Hello\\tWorld \\\"quoted\\\" \\\\ with a longer tail\\u0001\",{}]",
+              std::string(mb.GetBuffer(), mb.GetSize()));
+
+    // Flags of the Writer are honoured
+    typedef internal::DirectOutput<StringBuffer, kWriteValidateEncodingFlag | kWriteNanAndInfFlag> Output;
+    StringBuffer sb;
+    EXPECT_TRUE(Output::String(sb, "\xE2\x82\xAC\n", 4));
+    EXPECT_TRUE(Output::Double(sb, -std::numeric_limits<double>::infinity(), Writer<StringBuffer>::kDefaultMaxDecimalPlaces));
+    EXPECT_STREQ("\"\xE2\x82\xAC\\n\"-Infinity", sb.GetString());
+    EXPECT_FALSE(Output::String(sb, "\xfe\xfe\xff\xff", 4));
+}
+
+TEST(Writer, PreEscapedKey) {
+    static const PreEscapedKey kA = RAPIDJSON_PREESCAPED_KEY("a");
+    static const PreEscapedKey kB = RAPIDJSON_PREESCAPED_KEY("b c");
+    EXPECT_TRUE(kA.IsValid());
+    EXPECT_THROW(PreEscapedKey("\"a\"", 3), AssertException);
+    EXPECT_THROW(PreEscapedKey("\"\\\":", 4), AssertException);
+
+    StringBuffer buffer;
+    Writer<StringBuffer> writer(buffer);
+    writer.StartObject();
+    writer.Key(kA);
+    writer.StartArray();
+    writer.StartObject();
+    writer.Key(kB);
+    writer.Int(1);
+    writer.Key("d");
+    writer.Null();
+    writer.Key(kA);
+    writer.String("e");
+    writer.EndObject();
+    writer.EndArray();
+    writer.Key(kB);
+    writer.StartObject();
+    writer.EndObject();
+    writer.EndObject();
+    EXPECT_TRUE(writer.IsComplete());
+    EXPECT_STREQ("{\"a\":[{\"b c\":1,\"d\":null,\"a\":\"e\"}],\"b c\":{}}", buffer.GetString());
+
+    // Generic output stream
+    GenericStringBuffer<UTF16<> > buffer16;
+    Writer<GenericStringBuffer<UTF16<> >, UTF8<>, UTF16<> > writer16(buffer16);
+    writer16.StartObject();
+    writer16.Key(kA);
+    writer16.Bool(true);
+    writer16.EndObject();
+    EXPECT_EQ(0, StrCmp(L"{\"a\":true}", buffer16.GetString()));
+}
+
 #if RAPIDJSON_HAS_CXX11_RVALUE_REFS
 static Writer<StringBuffer> WriterGen(StringBuffer &target) {
     Writer<StringBuffer> writer(target);